@@ -380,6 +380,27 @@ public:
   /// @return ReturnCode 调用结果
   ReturnCode GetOneInstance(const GetOneInstanceRequest& req, InstancesResponse*& resp);
 
+  /// @brief 同步获取单个服务实例，结果填充到调用方持有的应答对象中
+  ///
+  /// 应答对象可在多次调用间复用，复用时不再为应答分配内存
+  /// @param req 获取单个服务实例请求
+  /// @param resp 服务实例获取结果，调用成功时覆盖原有内容。失败时内容不变
+  /// @return ReturnCode 调用结果
+  ReturnCode GetOneInstance(const GetOneInstanceRequest& req, InstancesResponse& resp);
+
+  /// @brief 同步批量获取多个服务的单个服务实例
+  ///
+  /// 一次调用完成所有请求的路由和负载均衡，只记录一次API统计。
+  /// 所有请求的服务数据先统一发起加载，再分别等待就绪，总等待时间不超过最大的请求超时时间
+  /// 服务数据在请求自身的超时时间内未就绪时，该请求返回kReturnTimeout
+  /// @param reqs 获取单个服务实例请求列表
+  /// @param instances 与请求一一对应的服务实例
+  /// @param ret_codes 与请求一一对应的调用结果
+  /// @return ReturnCode 全部请求成功返回kReturnOk，否则返回第一个失败请求的调用结果
+  ReturnCode BatchGetOneInstance(const std::vector<GetOneInstanceRequest*>& reqs,
+                                 std::vector<Instance>& instances,
+                                 std::vector<ReturnCode>& ret_codes);
+
   /// @brief 同步获取批量服务实例
   ///
   /// @note 该接口不会返回熔断半开实例，实例熔断后，进入半开如何没有请求一段时间后会自动恢复
@@ -17,6 +17,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "polaris/context.h"
 #include "polaris/noncopyable.h"
@@ -78,8 +79,11 @@ struct QuotaResultInfo {
 
 class QuotaResponseImpl;
 /// @brief 限流配额应答
-class QuotaResponse {
+class QuotaResponse : Noncopyable {
 public:
+  /// @brief 构造空的配额应答，用于传入LimitApi::GetQuota复用
+  QuotaResponse();
+
   /// @brief 构造配额应答
   explicit QuotaResponse(QuotaResponseImpl* impl);
 
@@ -102,6 +106,7 @@ public:
   uint64_t GetWaitTime() const;
 
 private:
+  friend class LimitApi;
   QuotaResponseImpl* impl_;
 };
 
@@ -185,6 +190,14 @@ public:
   /// @return ReturnCode    获取返回码
   ReturnCode GetQuota(const QuotaRequest& quota_request, QuotaResponse*& quota_response);
 
+  /// @brief 获取配额，结果填充到调用方持有的应答对象中
+  ///
+  /// 应答对象可在多次调用间复用，稳定状态下分配配额不申请内存
+  /// @param quota_request  获取配额请求
+  /// @param quota_response 获取配额应答，调用成功时覆盖原有内容。失败时内容不变
+  /// @return ReturnCode    获取返回码
+  ReturnCode GetQuota(const QuotaRequest& quota_request, QuotaResponse& quota_response);
+
   /// @brief 获取配额
   ///
   /// @param quota_request  获取配额请求
@@ -210,6 +223,19 @@ public:
   ReturnCode GetQuota(const QuotaRequest& quota_request, QuotaResultCode& quota_result,
                       uint64_t& wait_time);
 
+  /// @brief 批量获取配额，所有请求都获取到配额时才占用配额
+  ///
+  /// 同一服务的限流规则只准备一次，命中同一限流窗口的请求合并分配，只记录一次API统计。
+  /// 按请求顺序分配配额，某个请求被限流时归还前面请求已占用的配额。
+  /// 匀速排队的排队时间无法归还，请求命中匀速排队规则时返回kReturnInvalidArgument
+  /// @param quota_requests 获取配额请求列表
+  /// @param quota_results  与请求一一对应的结果，全部获取成功时均为kQuotaResultOk，
+  ///                       否则被限流的请求为kQuotaResultLimited，其他请求为kQuotaResultWait
+  /// @param wait_time      全部获取成功时需要等待的最长时间，单位ms，不支持匀速排队故始终为0
+  /// @return ReturnCode    全部请求处理成功返回kReturnOk，失败时不占用任何配额
+  ReturnCode BatchGetQuota(const std::vector<QuotaRequest*>& quota_requests,
+                           std::vector<QuotaResultCode>& quota_results, uint64_t& wait_time);
+
   /// @brief 更新请求配额调用结果
   ///
   /// @param call_result  配额调用结果
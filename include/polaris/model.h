@@ -211,6 +211,7 @@ public:
                                    uint64_t cache_version = 0);
 
 private:
+  friend class ServiceDataImpl;
   static ServiceData* CreateFromPbJson(void* pb_content, const std::string& json_content,
                                        ServiceDataStatus data_status, uint64_t cache_version);
 
@@ -324,6 +325,8 @@ public:
 
   ServiceKey& GetServiceKey();
 
+  ServiceImpl* GetServiceImpl();
+
   /// @brief 将服务关联到服务数据
   ///
   /// @param service_data 服务数据
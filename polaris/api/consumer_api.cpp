@@ -27,6 +27,7 @@
 #include "model/model_impl.h"
 #include "monitor/api_stat.h"
 #include "plugin/load_balancer/locality_aware/locality_aware.h"
+#include "plugin/service_router/service_router.h"
 #include "polaris/accessors.h"
 #include "polaris/config.h"
 #include "polaris/consumer.h"
@@ -309,6 +310,19 @@ ReturnCode ConsumerApiImpl::GetOneInstance(ServiceContext* service_context, Rout
 ReturnCode ConsumerApiImpl::GetOneInstance(ServiceContext* service_context, RouteInfo& route_info,
                                            GetOneInstanceRequestAccessor& request,
                                            InstancesResponse*& resp) {
+  InstancesResponse* response = new InstancesResponse();
+  ReturnCode ret              = GetOneInstance(service_context, route_info, request, *response);
+  if (ret != kReturnOk) {
+    delete response;
+    return ret;
+  }
+  resp = response;
+  return kReturnOk;
+}
+
+ReturnCode ConsumerApiImpl::GetOneInstance(ServiceContext* service_context, RouteInfo& route_info,
+                                           GetOneInstanceRequestAccessor& request,
+                                           InstancesResponse& resp) {
   const ServiceKey& service_key    = route_info.GetServiceKey();
   ServiceRouterChain* router_chain = service_context->GetServiceRouterChain();
   if (!request.GetLabels().empty()) {
@@ -343,22 +357,27 @@ ReturnCode ConsumerApiImpl::GetOneInstance(ServiceContext* service_context, Rout
     return kReturnInstanceNotFound;
   }
 
-  // 选取backup实例
-  std::vector<Instance*> backup_instances;
-  backup_instances.push_back(instance);
-  GetBackupInstances(service_instances, load_balancer, request, backup_instances);
-
-  // 返回结果
-  resp = new InstancesResponse();
-  InstancesResponseSetter resp_setter(*resp);
+  // 返回结果，复用应答对象中已分配的内存
+  InstancesResponseSetter resp_setter(resp);
   resp_setter.SetFlowId(request.GetFlowId());
   resp_setter.SetMetadata(service_instances->GetServiceMetadata());
   resp_setter.SetServiceName(route_info.GetServiceKey().name_);
   resp_setter.SetServiceNamespace(route_info.GetServiceKey().namespace_);
   resp_setter.SetRevision(service_instances->GetServiceData()->GetRevision());
   resp_setter.SetSubset(route_result.GetSubset());
+  std::vector<Instance>& resp_instances = resp.GetInstances();
+  if (request.GetBackupInstanceNum() == 0) {
+    resp_instances.resize(1);
+    resp_instances[0] = *instance;
+    return kReturnOk;
+  }
+  // 选取backup实例
+  std::vector<Instance*> backup_instances;
+  backup_instances.push_back(instance);
+  GetBackupInstances(service_instances, load_balancer, request, backup_instances);
+  resp_instances.resize(backup_instances.size());
   for (size_t i = 0; i < backup_instances.size(); ++i) {
-    resp_setter.AddInstance(*(backup_instances[i]));
+    resp_instances[i] = *(backup_instances[i]);
   }
   return kReturnOk;
 }
@@ -373,10 +392,10 @@ void ConsumerApiImpl::GetBackupInstances(ServiceInstances* service_instances,
   }
 
   LoadBalanceType lb_type = load_balancer->GetLoadBalanceType();  // 不从request中取，规避default
-  InstancesSet* instances_set      = service_instances->GetAvailableInstances();
-  std::vector<Instance*> instances = instances_set->GetInstances();
-  Instance* instance               = NULL;
-  ReturnCode ret                   = kReturnOk;
+  InstancesSet* instances_set             = service_instances->GetAvailableInstances();
+  const std::vector<Instance*>& instances = instances_set->GetInstances();
+  Instance* instance                      = NULL;
+  ReturnCode ret                          = kReturnOk;
 
   // 内部ringhash, 返回节点后相邻的backup个不重复节点
   if (lb_type == kLoadBalanceTypeRingHash || lb_type == kLoadBalanceTypeL5CstHash ||
@@ -444,7 +463,7 @@ void ConsumerApiImpl::GetBackupInstances(ServiceInstances* service_instances,
     if (index == instances.size()) {
       index = 0;  // 回到起点
     }
-    Instance*& item = instances[index];
+    Instance* item = instances[index];
     if (item->GetId() == instance->GetId() ||
         half_open_instances.find(item) != half_open_instances.end()) {
       continue;  // 实例是负载均衡器选择的实例，或是一个半开实例
@@ -459,11 +478,12 @@ ReturnCode ConsumerApiImpl::GetInstances(ServiceContext* service_context, RouteI
   ReturnCode ret;
   ServiceRouterChain* router_chain = service_context->GetServiceRouterChain();
   ServiceInstances* service_instances;
-  std::set<std::string> open_instances_set;
+  CircuitBreakerSnapshot* open_snapshot = NULL;
   if (request.GetSkipRouteFilter()) {
     service_instances = route_info.GetServiceInstances();
     if (!request.GetIncludeCircuitBreakerInstances()) {  // 需要过滤熔断实例
-      open_instances_set = service_instances->GetService()->GetCircuitBreakerOpenInstances();
+      ServiceImpl* service_impl = service_instances->GetService()->GetServiceImpl();
+      open_snapshot = service_impl->GetCircuitBreakerSnapshot(service_instances->GetServiceData());
     }
     route_info.SetServiceInstances(NULL);
   } else {
@@ -485,7 +505,7 @@ ReturnCode ConsumerApiImpl::GetInstances(ServiceContext* service_context, RouteI
   InstancesSet* instances_set             = service_instances->GetAvailableInstances();
   const std::vector<Instance*>& instances = instances_set->GetInstances();
   if (instances.empty()) {
-    delete service_instances;
+    RouteObjectCache::DeleteServiceInstances(service_instances);
     service_instances = NULL;
     return kReturnInstanceNotFound;
   }
@@ -497,13 +517,14 @@ ReturnCode ConsumerApiImpl::GetInstances(ServiceContext* service_context, RouteI
   resp_setter.SetServiceName(route_info.GetServiceKey().name_);
   resp_setter.SetServiceNamespace(route_info.GetServiceKey().namespace_);
   resp_setter.SetRevision(service_instances->GetServiceData()->GetRevision());
+  ServiceData* service_data = service_instances->GetServiceData();
   for (std::size_t i = 0; i < instances.size(); ++i) {
-    if (open_instances_set.find(instances[i]->GetId()) != open_instances_set.end()) {
+    if (open_snapshot != NULL && open_snapshot->IsOpen(instances[i], service_data)) {
       continue;
     }
     resp_setter.AddInstance(*instances[i]);
   }
-  delete service_instances;
+  RouteObjectCache::DeleteServiceInstances(service_instances);
   service_instances = NULL;
   return kReturnOk;
 }
@@ -571,11 +592,15 @@ ReturnCode ConsumerApi::GetOneInstance(const GetOneInstanceRequest& req, Instanc
     RECORD_THEN_RETURN(kReturnInvalidConfig);
   }
 
-  RouteInfo route_info(request.GetServiceKey(), request.DumpSourceService());
-  ReturnCode ret = ConsumerApiImpl::PrepareRouteInfo(service_context, route_info, __func__,
-                                                     request.GetTimeout());
-  if (POLARIS_LIKELY(ret == kReturnOk)) {
-    ret = ConsumerApiImpl::GetOneInstance(service_context, route_info, request, instance);
+  ReturnCode ret;
+  {
+    ThreadLocalRouteInfo thread_route_info(request.GetServiceKey(), request.DumpSourceService());
+    RouteInfo& route_info = thread_route_info.Get();
+    ret = ConsumerApiImpl::PrepareRouteInfo(service_context, route_info, __func__,
+                                            request.GetTimeout());
+    if (POLARIS_LIKELY(ret == kReturnOk)) {
+      ret = ConsumerApiImpl::GetOneInstance(service_context, route_info, request, instance);
+    }
   }
   service_context->DecrementRef();
   context_impl->RcuExit();
@@ -598,17 +623,195 @@ ReturnCode ConsumerApi::GetOneInstance(const GetOneInstanceRequest& req, Instanc
     RECORD_THEN_RETURN(kReturnInvalidConfig);
   }
 
-  RouteInfo route_info(request.GetServiceKey(), request.DumpSourceService());
-  ReturnCode ret = ConsumerApiImpl::PrepareRouteInfo(service_context, route_info, __func__,
-                                                     request.GetTimeout());
-  if (ret == kReturnOk) {
-    ret = ConsumerApiImpl::GetOneInstance(service_context, route_info, request, resp);
+  ReturnCode ret;
+  {
+    ThreadLocalRouteInfo thread_route_info(request.GetServiceKey(), request.DumpSourceService());
+    RouteInfo& route_info = thread_route_info.Get();
+    ret = ConsumerApiImpl::PrepareRouteInfo(service_context, route_info, __func__,
+                                            request.GetTimeout());
+    if (ret == kReturnOk) {
+      ret = ConsumerApiImpl::GetOneInstance(service_context, route_info, request, resp);
+    }
+  }
+  service_context->DecrementRef();
+  context_impl->RcuExit();
+  RECORD_THEN_RETURN(ret);
+}
+
+ReturnCode ConsumerApi::GetOneInstance(const GetOneInstanceRequest& req, InstancesResponse& resp) {
+  ApiStat api_stat(impl_->context_, kApiStatConsumerGetOne);
+  GetOneInstanceRequestAccessor request(req);
+  if (POLARIS_UNLIKELY(!CheckAndSetRequest(request, __func__, impl_->context_))) {
+    RECORD_THEN_RETURN(kReturnInvalidArgument);
+  }
+
+  ContextImpl* context_impl = impl_->context_->GetContextImpl();
+  context_impl->RcuEnter();
+  ServiceContext* service_context =
+      context_impl->GetOrCreateServiceContext(request.GetServiceKey());
+  if (POLARIS_UNLIKELY(service_context == NULL)) {
+    context_impl->RcuExit();
+    RECORD_THEN_RETURN(kReturnInvalidConfig);
+  }
+
+  ReturnCode ret;
+  {
+    ThreadLocalRouteInfo thread_route_info(request.GetServiceKey(), request.DumpSourceService());
+    RouteInfo& route_info = thread_route_info.Get();
+    ret = ConsumerApiImpl::PrepareRouteInfo(service_context, route_info, __func__,
+                                            request.GetTimeout());
+    if (POLARIS_LIKELY(ret == kReturnOk)) {
+      ret = ConsumerApiImpl::GetOneInstance(service_context, route_info, request, resp);
+    }
   }
   service_context->DecrementRef();
   context_impl->RcuExit();
   RECORD_THEN_RETURN(ret);
 }
 
+// 批量获取单个实例时，被调服务和主调服务都相同的请求共用一份准备好的路由数据
+struct BatchRouteGroup {
+  BatchRouteGroup()
+      : service_context_(NULL), route_info_(NULL), ret_code_(kReturnOk), ready_time_(0) {}
+
+  ServiceContext* service_context_;
+  RouteInfo* route_info_;  // 只用于持有准备好的服务数据，不执行路由
+  ReturnCode ret_code_;
+  uint64_t ready_time_;  // 从批量请求开始到路由数据就绪的时间，无需等待时为0
+};
+
+// 将准备好的服务数据设置到本次请求的路由信息中，增加的引用由路由信息释放
+static void SetPreparedRouteData(RouteInfo& prepared, RouteInfo& route_info) {
+  ServiceData* service_data = prepared.GetServiceInstances()->GetServiceData();
+  service_data->IncrementRef();
+  route_info.SetServiceInstances(RouteObjectCache::NewServiceInstances(service_data));
+  if (prepared.GetServiceRouteRule() != NULL) {
+    service_data = prepared.GetServiceRouteRule()->GetServiceData();
+    service_data->IncrementRef();
+    route_info.SetServiceRouteRule(RouteObjectCache::NewServiceRouteRule(service_data));
+  }
+  if (prepared.GetSourceServiceRouteRule() != NULL) {
+    service_data = prepared.GetSourceServiceRouteRule()->GetServiceData();
+    service_data->IncrementRef();
+    route_info.SetSourceServiceRouteRule(RouteObjectCache::NewServiceRouteRule(service_data));
+  }
+}
+
+ReturnCode ConsumerApi::BatchGetOneInstance(const std::vector<GetOneInstanceRequest*>& reqs,
+                                            std::vector<Instance>& instances,
+                                            std::vector<ReturnCode>& ret_codes) {
+  ApiStat api_stat(impl_->context_, kApiStatConsumerBatchGetOne);
+  instances.resize(reqs.size());
+  ret_codes.assign(reqs.size(), kReturnOk);
+  if (reqs.empty()) {
+    POLARIS_LOG(LOG_ERROR, "%s failed: requests is empty", __func__);
+    RECORD_THEN_RETURN(kReturnInvalidArgument);
+  }
+  typedef std::map<std::pair<ServiceKey, ServiceKey>, std::size_t> GroupIndexMap;
+  GroupIndexMap group_index_map;
+  std::vector<BatchRouteGroup> groups;
+  std::vector<RouteInfoNotify*> notifies;
+  std::vector<uint64_t> timeouts;
+  std::vector<std::size_t> request_groups(reqs.size());
+
+  ContextImpl* context_impl = impl_->context_->GetContextImpl();
+  uint64_t begin_time       = Time::GetCurrentTimeMs();
+  context_impl->RcuEnter();
+  // 先为每组请求准备路由数据，未就绪的服务数据同时发起加载
+  for (std::size_t i = 0; i < reqs.size(); ++i) {
+    if (reqs[i] == NULL) {
+      ret_codes[i] = kReturnInvalidArgument;
+      continue;
+    }
+    GetOneInstanceRequestAccessor request(*reqs[i]);
+    if (!CheckAndSetRequest(request, __func__, impl_->context_)) {
+      ret_codes[i] = kReturnInvalidArgument;
+      continue;
+    }
+    std::pair<ServiceKey, ServiceKey> group_key(request.GetServiceKey(), ServiceKey());
+    if (request.HasSourceService()) {
+      group_key.second = request.GetSourceService()->service_key_;
+    }
+    std::pair<GroupIndexMap::iterator, bool> result =
+        group_index_map.insert(std::make_pair(group_key, groups.size()));
+    request_groups[i] = result.first->second;
+    if (!result.second) {  // 同组请求使用最长的超时时间等待，超时较短的请求在就绪后单独判断
+      if (timeouts[request_groups[i]] < request.GetTimeout()) {
+        timeouts[request_groups[i]] = request.GetTimeout();
+      }
+      continue;
+    }
+    groups.push_back(BatchRouteGroup());
+    notifies.push_back(NULL);
+    timeouts.push_back(request.GetTimeout());
+    BatchRouteGroup& group = groups.back();
+    group.service_context_ = context_impl->GetOrCreateServiceContext(request.GetServiceKey());
+    if (group.service_context_ == NULL) {
+      group.ret_code_ = kReturnInvalidConfig;
+      continue;
+    }
+    group.route_info_ = new RouteInfo(request.GetServiceKey(), request.DumpSourceService());
+    notifies.back() = group.service_context_->GetServiceRouterChain()->PrepareRouteInfoWithNotify(
+        *group.route_info_);
+  }
+  // 每组只等待一次路由数据就绪
+  for (std::size_t i = 0; i < groups.size(); ++i) {
+    BatchRouteGroup& group = groups[i];
+    if (notifies[i] != NULL) {
+      // 超时时间从批量请求开始时计算
+      uint64_t used_time = Time::GetCurrentTimeMs() - begin_time;
+      uint64_t timeout   = timeouts[i] > used_time ? timeouts[i] - used_time : 0;
+      timespec deadline  = Time::CurrentTimeAddWith(timeout);
+      group.ret_code_    = WaitRouteInfoReady(notifies[i], deadline, *group.route_info_);
+      group.ready_time_  = Time::GetCurrentTimeMs() - begin_time;
+      delete notifies[i];
+      if (group.ret_code_ != kReturnOk) {
+        const ServiceKey& service_key = group.route_info_->GetServiceKey();
+        POLARIS_LOG(LOG_ERROR, "%s prepare route info for service[%s/%s] with error:%s", __func__,
+                    service_key.namespace_.c_str(), service_key.name_.c_str(),
+                    ReturnCodeToMsg(group.ret_code_).c_str());
+      }
+    }
+    if (group.ret_code_ == kReturnOk) {
+      // 触发（非阻塞）拉取熔断配置
+      group.service_context_->GetCircuitBreakerChain()->PrepareServicePbConfTrigger();
+    }
+  }
+
+  ReturnCode ret = kReturnOk;
+  for (std::size_t i = 0; i < reqs.size(); ++i) {
+    if (ret_codes[i] == kReturnOk) {
+      BatchRouteGroup& group = groups[request_groups[i]];
+      ret_codes[i]           = group.ret_code_;
+      GetOneInstanceRequestAccessor request(*reqs[i]);
+      if (ret_codes[i] == kReturnOk && group.ready_time_ > request.GetTimeout()) {
+        ret_codes[i] = kReturnTimeout;  // 路由数据在本请求的超时时间之后才就绪
+      }
+      if (ret_codes[i] == kReturnOk) {
+        ThreadLocalRouteInfo thread_route_info(request.GetServiceKey(),
+                                               request.DumpSourceService());
+        RouteInfo& route_info = thread_route_info.Get();
+        SetPreparedRouteData(*group.route_info_, route_info);
+        ret_codes[i] = ConsumerApiImpl::GetOneInstance(group.service_context_, route_info, request,
+                                                       instances[i]);
+      }
+    }
+    if (ret_codes[i] != kReturnOk && ret == kReturnOk) {
+      ret = ret_codes[i];
+    }
+  }
+  for (std::size_t i = 0; i < groups.size(); ++i) {
+    if (groups[i].route_info_ != NULL) {
+      delete groups[i].route_info_;
+    }
+    if (groups[i].service_context_ != NULL) {
+      groups[i].service_context_->DecrementRef();
+    }
+  }
+  context_impl->RcuExit();
+  RECORD_THEN_RETURN(ret);
+}
+
 ReturnCode ConsumerApi::GetInstances(const GetInstancesRequest& req, InstancesResponse*& resp) {
   ApiStat api_stat(impl_->context_, kApiStatConsumerGetBatch);
   GetInstancesRequestAccessor request(req);
@@ -775,6 +978,12 @@ ReturnCode ConsumerApi::UpdateServiceCallResult(const ServiceCallResult& req) {
       RECORD_THEN_RETURN(ret_code);
     }
   }
+  // 异步上报时只写入线程局部队列，队列满时同步处理
+  ContextImpl* context_impl = impl_->context_->GetContextImpl();
+  if (context_impl->IsCallResultAsync() &&
+      context_impl->GetCallResultExecutor()->Enqueue(instance_gauge)) {
+    RECORD_THEN_RETURN(kReturnOk);
+  }
   ret_code = impl_->UpdateServiceCallResult(impl_->context_, instance_gauge);
   RECORD_THEN_RETURN(ret_code);
 }
@@ -824,6 +1033,15 @@ ReturnCode ConsumerApiImpl::UpdateServiceCallResult(Context* context, const Inst
     context_impl->RcuExit();
     return kReturnInvalidArgument;
   }
+  UpdateServiceCallResult(context_impl, service_context, gauge);
+  service_context->DecrementRef();
+  context_impl->RcuExit();
+  return kReturnOk;
+}
+
+void ConsumerApiImpl::UpdateServiceCallResult(ContextImpl* context_impl,
+                                              ServiceContext* service_context,
+                                              const InstanceGauge& gauge) {
   // 执行上报统计插件
   StatReporter* stat_reporter = context_impl->GetStatReporter();
   stat_reporter->ReportStat(gauge);
@@ -853,9 +1071,6 @@ ReturnCode ConsumerApiImpl::UpdateServiceCallResult(Context* context, const Inst
   // 执行熔断插件
   CircuitBreakerChain* circuit_breaker_chain = service_context->GetCircuitBreakerChain();
   circuit_breaker_chain->RealTimeCircuitBreak(gauge);
-  service_context->DecrementRef();
-  context_impl->RcuExit();
-  return kReturnOk;
 }
 
 ReturnCode ConsumerApiImpl::GetSystemServer(Context* context, const ServiceKey& service_key,
@@ -86,11 +86,19 @@ public:
                                    GetOneInstanceRequestAccessor& request,
                                    InstancesResponse*& resp);
 
+  static ReturnCode GetOneInstance(ServiceContext* service_context, RouteInfo& route_info,
+                                   GetOneInstanceRequestAccessor& request,
+                                   InstancesResponse& resp);
+
   static ReturnCode GetInstances(ServiceContext* service_context, RouteInfo& route_info,
                                  GetInstancesRequestAccessor& request, InstancesResponse*& resp);
 
   static ReturnCode UpdateServiceCallResult(Context* context, const InstanceGauge& gauge);
 
+  // 依次执行统计上报、动态权重调整、LA反馈和熔断插件
+  static void UpdateServiceCallResult(ContextImpl* context_impl, ServiceContext* service_context,
+                                      const InstanceGauge& gauge);
+
   static ReturnCode GetSystemServer(Context* context, const ServiceKey& service_key,
                                     const Criteria& criteria, Instance*& instance, uint64_t timeout,
                                     const std::string& protocol = "grpc");
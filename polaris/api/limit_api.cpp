@@ -16,6 +16,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 #include "context_internal.h"
 #include "logger.h"
@@ -23,6 +24,7 @@
 #include "polaris/config.h"
 #include "polaris/context.h"
 #include "polaris/limit.h"
+#include "polaris/noncopyable.h"
 #include "quota/quota_manager.h"
 #include "quota/quota_model.h"
 
@@ -122,15 +124,16 @@ LimitApiImpl::~LimitApiImpl() {
   context_ = NULL;
 }
 
-ReturnCode LimitApi::GetQuota(const QuotaRequest& quota_request, QuotaResponse*& quota_response) {
-  ApiStat api_stat(impl_->context_, kApiStatLimitGetQuota);
+ReturnCode LimitApiImpl::GetQuota(const QuotaRequest& quota_request,
+                                  QuotaResponseImpl& quota_response) {
+  ApiStat api_stat(context_, kApiStatLimitGetQuota);
   QuotaRequestAccessor request(quota_request);
-  ReturnCode ret_code = impl_->CheckRequest(request);
+  ReturnCode ret_code = CheckRequest(request);
   if (ret_code != kReturnOk) {
     RECORD_THEN_RETURN(ret_code);
   }
 
-  QuotaManager* quota_manager = impl_->context_->GetContextImpl()->GetQuotaManager();
+  QuotaManager* quota_manager = context_->GetContextImpl()->GetQuotaManager();
   QuotaInfo quota_info;
   if ((ret_code = quota_manager->PrepareQuotaInfo(quota_request, &quota_info)) == kReturnOk) {
     // 调用配额管理对象分配配额
@@ -139,40 +142,136 @@ ReturnCode LimitApi::GetQuota(const QuotaRequest& quota_request, QuotaResponse*&
   RECORD_THEN_RETURN(ret_code);
 }
 
+ReturnCode LimitApi::GetQuota(const QuotaRequest& quota_request, QuotaResponse*& quota_response) {
+  QuotaResponseImpl* response_impl = new QuotaResponseImpl();
+  ReturnCode ret_code              = impl_->GetQuota(quota_request, *response_impl);
+  if (ret_code == kReturnOk) {
+    quota_response = new QuotaResponse(response_impl);
+  } else {
+    delete response_impl;
+  }
+  return ret_code;
+}
+
+ReturnCode LimitApi::GetQuota(const QuotaRequest& quota_request, QuotaResponse& quota_response) {
+  return impl_->GetQuota(quota_request, *quota_response.impl_);
+}
+
 ReturnCode LimitApi::GetQuota(const QuotaRequest& quota_request, QuotaResultCode& quota_result) {
-  QuotaResponse* quota_response = NULL;
+  QuotaResponseImpl quota_response;
   ReturnCode ret_code;
-  if ((ret_code = GetQuota(quota_request, quota_response)) == kReturnOk) {
-    quota_result = quota_response->GetResultCode();
-    delete quota_response;
+  if ((ret_code = impl_->GetQuota(quota_request, quota_response)) == kReturnOk) {
+    quota_result = quota_response.result_code_;
   }
   return ret_code;
 }
 
 ReturnCode LimitApi::GetQuota(const QuotaRequest& quota_request, QuotaResultCode& quota_result,
                               QuotaResultInfo& quota_info) {
-  QuotaResponse* quota_response = NULL;
+  QuotaResponseImpl quota_response;
   ReturnCode ret_code;
-  if ((ret_code = GetQuota(quota_request, quota_response)) == kReturnOk) {
-    quota_result = quota_response->GetResultCode();
-    quota_info   = quota_response->GetQuotaResultInfo();
-    delete quota_response;
+  if ((ret_code = impl_->GetQuota(quota_request, quota_response)) == kReturnOk) {
+    quota_result = quota_response.result_code_;
+    quota_info   = quota_response.info_;
   }
   return ret_code;
 }
 
 ReturnCode LimitApi::GetQuota(const QuotaRequest& quota_request, QuotaResultCode& quota_result,
                               uint64_t& wait_time) {
-  QuotaResponse* quota_response = NULL;
+  QuotaResponseImpl quota_response;
   ReturnCode ret_code;
-  if ((ret_code = GetQuota(quota_request, quota_response)) == kReturnOk) {
-    quota_result = quota_response->GetResultCode();
-    wait_time    = quota_response->GetWaitTime();
-    delete quota_response;
+  if ((ret_code = impl_->GetQuota(quota_request, quota_response)) == kReturnOk) {
+    quota_result = quota_response.result_code_;
+    wait_time    = quota_response.wait_time_;
   }
   return ret_code;
 }
 
+// 批量获取配额时各服务的限流规则，涉及的服务较少时直接使用栈上空间，超出时才从堆上分配
+class BatchQuotaInfos : public Noncopyable {
+public:
+  BatchQuotaInfos() : size_(0) {}
+
+  ~BatchQuotaInfos() {
+    for (std::size_t i = 0; i < more_infos_.size(); ++i) {
+      delete more_infos_[i];
+    }
+  }
+
+  // 查找服务已准备的限流规则，未准备时返回NULL
+  const QuotaInfo* Find(const ServiceKey& service) const {
+    for (std::size_t i = 0; i < size_; ++i) {
+      if (*services_[i] == service) {
+        return &local_infos_[i];
+      }
+    }
+    for (std::size_t i = 0; i < more_services_.size(); ++i) {
+      if (*more_services_[i] == service) {
+        return more_infos_[i];
+      }
+    }
+    return NULL;
+  }
+
+  // 为服务添加待准备的限流规则，服务的key由请求持有，生命周期覆盖整个批量请求
+  QuotaInfo* Add(const ServiceKey& service) {
+    if (size_ < kLocalSize) {
+      services_[size_] = &service;
+      return &local_infos_[size_++];
+    }
+    QuotaInfo* quota_info = new QuotaInfo();
+    more_services_.push_back(&service);
+    more_infos_.push_back(quota_info);
+    return quota_info;
+  }
+
+private:
+  static const std::size_t kLocalSize = 8;
+  std::size_t size_;  // 栈上已使用的数量
+  const ServiceKey* services_[kLocalSize];
+  QuotaInfo local_infos_[kLocalSize];
+  std::vector<const ServiceKey*> more_services_;
+  std::vector<QuotaInfo*> more_infos_;
+};
+
+ReturnCode LimitApi::BatchGetQuota(const std::vector<QuotaRequest*>& quota_requests,
+                                   std::vector<QuotaResultCode>& quota_results,
+                                   uint64_t& wait_time) {
+  ApiStat api_stat(impl_->context_, kApiStatLimitBatchGetQuota);
+  if (quota_requests.empty()) {
+    POLARIS_LOG(LOG_ERROR, "%s failed: requests is empty", __func__);
+    RECORD_THEN_RETURN(kReturnInvalidArgument);
+  }
+  QuotaManager* quota_manager = impl_->context_->GetContextImpl()->GetQuotaManager();
+  ReturnCode ret_code = kReturnOk;
+  for (std::size_t i = 0; i < quota_requests.size(); ++i) {  // 先检查所有请求，避免无效请求等待
+    if (quota_requests[i] == NULL) {
+      POLARIS_LOG(LOG_ERROR, "%s failed: request[%zu] is null", __func__, i);
+      RECORD_THEN_RETURN(kReturnInvalidArgument);
+    }
+    QuotaRequestAccessor request(*quota_requests[i]);
+    if ((ret_code = impl_->CheckRequest(request)) != kReturnOk) {
+      RECORD_THEN_RETURN(ret_code);
+    }
+  }
+  BatchQuotaInfos batch_infos;  // 每个服务只准备一次限流规则
+  std::vector<const QuotaInfo*> quota_infos(quota_requests.size(), NULL);
+  for (std::size_t i = 0; i < quota_requests.size() && ret_code == kReturnOk; ++i) {
+    const ServiceKey& service = QuotaRequestAccessor(*quota_requests[i]).GetService();
+    if ((quota_infos[i] = batch_infos.Find(service)) == NULL) {
+      QuotaInfo* quota_info = batch_infos.Add(service);
+      ret_code              = quota_manager->PrepareQuotaInfo(*quota_requests[i], quota_info);
+      quota_infos[i]        = quota_info;
+    }
+  }
+  if (ret_code == kReturnOk) {
+    ret_code =
+        quota_manager->BatchGetQuotaResponse(quota_requests, quota_infos, quota_results, wait_time);
+  }
+  RECORD_THEN_RETURN(ret_code);
+}
+
 ReturnCode LimitApi::UpdateCallResult(const LimitCallResult& call_result) {
   ApiStat api_stat(impl_->context_, kApiStatLimitUpdateCallResult);
   LimitCallResultAccessor request(call_result);
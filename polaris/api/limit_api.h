@@ -19,7 +19,9 @@
 namespace polaris {
 
 class Context;
+class QuotaRequest;
 class QuotaRequestAccessor;
+class QuotaResponseImpl;
 
 class LimitApiImpl {
 public:
@@ -29,6 +31,9 @@ public:
 
   ReturnCode CheckRequest(QuotaRequestAccessor& request);
 
+  // 获取配额，结果写入调用方提供的应答中
+  ReturnCode GetQuota(const QuotaRequest& quota_request, QuotaResponseImpl& quota_response);
+
 private:
   friend class LimitApi;
   Context* context_;
@@ -182,6 +182,14 @@ void CachePersist::PersistServiceData(const ServiceKey& service_key, ServiceData
   reactor_.SubmitTask(persist_task);
 }
 
+void CachePersist::PersistServiceData(ServiceData* service_data) {
+  PersistTask* persist_task = new PersistTask(
+      persist_config_.GetPersistDir() +
+          BuildFileName(service_data->GetServiceKey(), service_data->GetDataType()),
+      service_data, persist_config_.GetMaxWriteRetry(), persist_config_.GetRetryInterval());
+  reactor_.SubmitTask(persist_task);
+}
+
 void CachePersist::UpdateSyncTime(const ServiceKey& service_key, ServiceDataType data_type) {
   reactor_.SubmitTask(new PersistRefreshTimeTask(persist_config_.GetPersistDir() +
                                                  BuildFileName(service_key, data_type)));
@@ -77,6 +77,9 @@ public:
   void PersistServiceData(const ServiceKey& service_key, ServiceDataType data_type,
                           const std::string& data);
 
+  // 持久化服务数据，json格式转换在持久化线程中执行
+  void PersistServiceData(ServiceData* service_data);
+
   // 更新缓存文件时间
   void UpdateSyncTime(const ServiceKey& service_key, ServiceDataType data_type);
 
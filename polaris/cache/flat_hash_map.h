@@ -0,0 +1,273 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#ifndef POLARIS_CPP_POLARIS_CACHE_FLAT_HASH_MAP_H_
+#define POLARIS_CPP_POLARIS_CACHE_FLAT_HASH_MAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+
+namespace polaris {
+
+/// @brief 开放寻址(线性探测)的扁平哈希表
+///
+/// 1. 哈希值单独存放在连续数组中，探测时只扫描哈希数组，一个cache line可比较16个槽位
+/// 2. 哈希值相等时才比较key，key和value存放在与哈希数组平行的数组中
+/// 3. 删除采用后移(backward shift)方式，不使用墓碑，探测链始终保持紧凑
+/// 4. 接口为std::map的子集，用于替换RcuMap的内部map，非线程安全
+template <typename Key, typename T, uint32_t (*HashFunc)(const Key&)>
+class FlatHashMap {
+public:
+  typedef std::pair<Key, T> value_type;
+
+  class iterator {
+  public:
+    iterator() : map_(NULL), index_(0) {}
+
+    iterator(FlatHashMap* map, std::size_t index) : map_(map), index_(index) { SkipEmpty(); }
+
+    value_type& operator*() const { return map_->slots_[index_]; }
+
+    value_type* operator->() const { return &map_->slots_[index_]; }
+
+    iterator& operator++() {
+      ++index_;
+      SkipEmpty();
+      return *this;
+    }
+
+    bool operator==(const iterator& rhs) const { return index_ == rhs.index_; }
+
+    bool operator!=(const iterator& rhs) const { return index_ != rhs.index_; }
+
+    // 当前元素所在槽位
+    std::size_t bucket() const { return index_; }
+
+  private:
+    friend class FlatHashMap;
+
+    void SkipEmpty() {
+      while (index_ < map_->capacity_ && map_->hashes_[index_] == kEmptyHash) {
+        ++index_;
+      }
+    }
+
+    FlatHashMap* map_;
+    std::size_t index_;
+  };
+
+  FlatHashMap() : capacity_(0), size_(0), hashes_(NULL), slots_(NULL) {}
+
+  FlatHashMap(const FlatHashMap& other);
+
+  ~FlatHashMap() {
+    delete[] hashes_;
+    delete[] slots_;
+  }
+
+  std::size_t size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+  iterator begin() { return iterator(this, 0); }
+
+  iterator end() { return iterator(this, capacity_); }
+
+  // 从指定槽位开始的第一个元素，用于按槽位顺序扫描
+  iterator bucket_begin(std::size_t bucket) {
+    return iterator(this, bucket < capacity_ ? bucket : capacity_);
+  }
+
+  std::size_t bucket_count() const { return capacity_; }
+
+  iterator find(const Key& key);
+
+  T& operator[](const Key& key);
+
+  void erase(iterator it);
+
+  std::size_t erase(const Key& key);
+
+private:
+  static const uint32_t kEmptyHash = 0;
+
+  static const std::size_t kMinCapacity = 16;
+
+  // 哈希值0表示空槽位，所以计算出的0需要映射成非0值
+  static uint32_t Hash(const Key& key) {
+    uint32_t hash = HashFunc(key);
+    return hash == kEmptyHash ? 1 : hash;
+  }
+
+  // 返回key所在的槽位，不存在时返回capacity_
+  std::size_t FindIndex(const Key& key, uint32_t hash) const;
+
+  // 容量为2的幂，负载因子超过3/4时扩容
+  void Reserve(std::size_t new_size);
+
+  void Rehash(std::size_t new_capacity);
+
+  void EraseIndex(std::size_t index);
+
+  FlatHashMap& operator=(const FlatHashMap&);
+
+private:
+  std::size_t capacity_;
+  std::size_t size_;
+  uint32_t* hashes_;
+  value_type* slots_;
+};
+
+template <typename Key, typename T, uint32_t (*HashFunc)(const Key&)>
+FlatHashMap<Key, T, HashFunc>::FlatHashMap(const FlatHashMap& other)
+    : capacity_(other.capacity_), size_(other.size_), hashes_(NULL), slots_(NULL) {
+  if (capacity_ == 0) {
+    return;
+  }
+  hashes_ = new uint32_t[capacity_];
+  slots_  = new value_type[capacity_];
+  for (std::size_t i = 0; i < capacity_; ++i) {
+    hashes_[i] = other.hashes_[i];
+    if (hashes_[i] != kEmptyHash) {
+      slots_[i] = other.slots_[i];
+    }
+  }
+}
+
+template <typename Key, typename T, uint32_t (*HashFunc)(const Key&)>
+std::size_t FlatHashMap<Key, T, HashFunc>::FindIndex(const Key& key, uint32_t hash) const {
+  if (size_ == 0) {
+    return capacity_;
+  }
+  std::size_t mask  = capacity_ - 1;
+  std::size_t index = hash & mask;
+  while (hashes_[index] != kEmptyHash) {
+    if (hashes_[index] == hash && slots_[index].first == key) {
+      return index;
+    }
+    index = (index + 1) & mask;
+  }
+  return capacity_;
+}
+
+template <typename Key, typename T, uint32_t (*HashFunc)(const Key&)>
+typename FlatHashMap<Key, T, HashFunc>::iterator FlatHashMap<Key, T, HashFunc>::find(
+    const Key& key) {
+  iterator it;
+  it.map_   = this;
+  it.index_ = FindIndex(key, Hash(key));
+  return it;
+}
+
+template <typename Key, typename T, uint32_t (*HashFunc)(const Key&)>
+T& FlatHashMap<Key, T, HashFunc>::operator[](const Key& key) {
+  uint32_t hash     = Hash(key);
+  std::size_t index = FindIndex(key, hash);
+  if (index != capacity_) {
+    return slots_[index].second;
+  }
+  Reserve(size_ + 1);
+  std::size_t mask = capacity_ - 1;
+  index            = hash & mask;
+  while (hashes_[index] != kEmptyHash) {
+    index = (index + 1) & mask;
+  }
+  hashes_[index]       = hash;
+  slots_[index].first  = key;
+  slots_[index].second = T();
+  size_++;
+  return slots_[index].second;
+}
+
+template <typename Key, typename T, uint32_t (*HashFunc)(const Key&)>
+void FlatHashMap<Key, T, HashFunc>::erase(iterator it) {
+  if (it.index_ < capacity_ && hashes_[it.index_] != kEmptyHash) {
+    EraseIndex(it.index_);
+  }
+}
+
+template <typename Key, typename T, uint32_t (*HashFunc)(const Key&)>
+std::size_t FlatHashMap<Key, T, HashFunc>::erase(const Key& key) {
+  std::size_t index = FindIndex(key, Hash(key));
+  if (index == capacity_) {
+    return 0;
+  }
+  EraseIndex(index);
+  return 1;
+}
+
+template <typename Key, typename T, uint32_t (*HashFunc)(const Key&)>
+void FlatHashMap<Key, T, HashFunc>::EraseIndex(std::size_t index) {
+  std::size_t mask = capacity_ - 1;
+  std::size_t hole = index;
+  std::size_t next = (hole + 1) & mask;
+  // 将后续探测链上的元素前移填补空洞，直到遇到空槽位或已在理想位置上的元素
+  while (hashes_[next] != kEmptyHash) {
+    std::size_t ideal = hashes_[next] & mask;
+    if (((next - ideal) & mask) >= ((next - hole) & mask)) {
+      hashes_[hole] = hashes_[next];
+      slots_[hole]  = slots_[next];
+      hole          = next;
+    }
+    next = (next + 1) & mask;
+  }
+  hashes_[hole] = kEmptyHash;
+  slots_[hole]  = value_type();  // 释放key和value持有的资源
+  size_--;
+}
+
+template <typename Key, typename T, uint32_t (*HashFunc)(const Key&)>
+void FlatHashMap<Key, T, HashFunc>::Reserve(std::size_t new_size) {
+  if (new_size * 4 <= capacity_ * 3) {
+    return;
+  }
+  std::size_t new_capacity = capacity_ == 0 ? kMinCapacity : capacity_ * 2;
+  while (new_size * 4 > new_capacity * 3) {
+    new_capacity *= 2;
+  }
+  Rehash(new_capacity);
+}
+
+template <typename Key, typename T, uint32_t (*HashFunc)(const Key&)>
+void FlatHashMap<Key, T, HashFunc>::Rehash(std::size_t new_capacity) {
+  uint32_t* old_hashes     = hashes_;
+  value_type* old_slots    = slots_;
+  std::size_t old_capacity = capacity_;
+
+  capacity_ = new_capacity;
+  hashes_   = new uint32_t[capacity_];
+  slots_    = new value_type[capacity_];
+  for (std::size_t i = 0; i < capacity_; ++i) {
+    hashes_[i] = kEmptyHash;
+  }
+  std::size_t mask = capacity_ - 1;
+  for (std::size_t i = 0; i < old_capacity; ++i) {
+    if (old_hashes[i] == kEmptyHash) {
+      continue;
+    }
+    std::size_t index = old_hashes[i] & mask;
+    while (hashes_[index] != kEmptyHash) {
+      index = (index + 1) & mask;
+    }
+    hashes_[index] = old_hashes[i];
+    slots_[index]  = old_slots[i];
+  }
+  delete[] old_hashes;
+  delete[] old_slots;
+}
+
+}  // namespace polaris
+
+#endif  //  POLARIS_CPP_POLARIS_CACHE_FLAT_HASH_MAP_H_
@@ -0,0 +1,56 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#include "cache/hashed_service_key.h"
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "cache/lru_map.h"
+#include "logger.h"
+
+namespace polaris {
+
+void SetHashedServiceKey(HashedServiceKey& key, const ServiceKey& service_key) {
+  key.service_key_.namespace_ = service_key.namespace_;
+  key.service_key_.name_      = service_key.name_;
+  key.hash_                   = MurmurServiceKey(service_key);
+}
+
+static __thread HashedServiceKey* thread_local_service_key = NULL;
+static pthread_key_t g_service_key_key;
+static pthread_once_t g_service_key_once = PTHREAD_ONCE_INIT;
+
+static void DeleteThreadLocalServiceKey(void* ptr) {
+  if (thread_local_service_key == ptr) {
+    thread_local_service_key = NULL;
+  }
+  delete static_cast<HashedServiceKey*>(ptr);
+}
+
+static void CreateServiceKeyKey() {
+  int rc = pthread_key_create(&g_service_key_key, &DeleteThreadLocalServiceKey);
+  POLARIS_ASSERT(rc == 0);
+}
+
+const HashedServiceKey& ThreadLocalHashedServiceKey(const ServiceKey& service_key) {
+  if (thread_local_service_key == NULL) {
+    pthread_once(&g_service_key_once, &CreateServiceKeyKey);
+    thread_local_service_key = new HashedServiceKey();
+    pthread_setspecific(g_service_key_key, thread_local_service_key);  // 线程退出时释放
+  }
+  SetHashedServiceKey(*thread_local_service_key, service_key);
+  return *thread_local_service_key;
+}
+
+}  // namespace polaris
@@ -0,0 +1,57 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#ifndef POLARIS_CPP_POLARIS_CACHE_HASHED_SERVICE_KEY_H_
+#define POLARIS_CPP_POLARIS_CACHE_HASHED_SERVICE_KEY_H_
+
+#include <stdint.h>
+
+#include "polaris/defs.h"
+
+namespace polaris {
+
+/// @brief 预先计算哈希值的ServiceKey，用作哈希表的key
+///
+/// 哈希值在设置服务名时计算一次，哈希表探测和key比较时先比较哈希值，相等时才比较字符串。
+/// key由哈希表持有，随表项删除释放
+struct HashedServiceKey {
+  HashedServiceKey() : hash_(0) {}
+
+  ServiceKey service_key_;
+  uint32_t hash_;
+};
+
+inline bool operator==(const HashedServiceKey& lhs, const HashedServiceKey& rhs) {
+  return lhs.hash_ == rhs.hash_ && lhs.service_key_ == rhs.service_key_;
+}
+
+// RcuMap内部记录key集合时使用，先比较哈希值
+inline bool operator<(const HashedServiceKey& lhs, const HashedServiceKey& rhs) {
+  if (lhs.hash_ != rhs.hash_) {
+    return lhs.hash_ < rhs.hash_;
+  }
+  return lhs.service_key_ < rhs.service_key_;
+}
+
+inline uint32_t HashedServiceKeyHash(const HashedServiceKey& key) { return key.hash_; }
+
+/// @brief 设置服务名并计算哈希值，服务名复用key已分配的内存
+void SetHashedServiceKey(HashedServiceKey& key, const ServiceKey& service_key);
+
+/// @brief 返回用于查询的线程本地key，服务名复用本线程上次查询分配的内存
+/// @note 返回的key在本线程下次调用前有效，插入哈希表时需使用独立的key
+const HashedServiceKey& ThreadLocalHashedServiceKey(const ServiceKey& service_key);
+
+}  // namespace polaris
+
+#endif  //  POLARIS_CPP_POLARIS_CACHE_HASHED_SERVICE_KEY_H_
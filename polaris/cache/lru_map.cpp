@@ -29,4 +29,11 @@ uint32_t MurmurString(const std::string& key) {
   return hash[0];
 }
 
+uint32_t MurmurServiceKey(const ServiceKey& key) {
+  uint32_t s = MurmurString(key.namespace_);
+  // see https://stackoverflow.com/q/4948780
+  s ^= MurmurString(key.name_) + 0x9e3779b9 + (s << 6) + (s >> 2);
+  return s;
+}
+
 }  // namespace polaris
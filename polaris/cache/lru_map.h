@@ -18,6 +18,7 @@
 #include <vector>
 
 #include "cache/lru_queue.h"
+#include "polaris/defs.h"
 #include "sync/atomic.h"
 #include "sync/mutex.h"
 
@@ -27,6 +28,8 @@ uint32_t MurmurInt32(const int& key);
 
 uint32_t MurmurString(const std::string& key);
 
+uint32_t MurmurServiceKey(const ServiceKey& key);
+
 template <typename Value>
 void LruValueNoOp(Value* /*value*/) {}
 
@@ -16,6 +16,8 @@
 #include <fstream>
 
 #include "logger.h"
+#include "model/model_impl.h"
+#include "polaris/model.h"
 #include "utils/file_utils.h"
 #include "utils/string_utils.h"
 #include "utils/time_clock.h"
@@ -24,9 +26,35 @@ namespace polaris {
 
 PersistTask::PersistTask(const std::string& file, const std::string& data, int retry_times,
                          uint64_t interval)
-    : TimingTask(interval), file_(file), data_(data), retry_times_(retry_times) {}
+    : TimingTask(interval),
+      file_(file),
+      data_(data),
+      pb_response_(NULL),
+      retry_times_(retry_times) {}
+
+PersistTask::PersistTask(const std::string& file, ServiceData* service_data, int retry_times,
+                         uint64_t interval)
+    : TimingTask(interval), file_(file), retry_times_(retry_times) {
+  pb_response_ = service_data->GetServiceDataImpl()->GetPersistContent(data_);
+}
+
+PersistTask::~PersistTask() {
+  if (pb_response_ != NULL) {
+    pb_response_->DecrementRef();
+    pb_response_ = NULL;
+  }
+}
 
 void PersistTask::Run() {
+  if (pb_response_ != NULL) {  // 首次执行时转换，转换后释放原始数据
+    pb_response_->ToJson(data_);
+    pb_response_->DecrementRef();
+    pb_response_ = NULL;
+    if (data_.empty()) {  // 转换失败时不能删除已有的持久化文件
+      retry_times_ = 0;
+      return;
+    }
+  }
   if (data_.empty() ? DoDelete() : DoPersist()) {
     retry_times_ = 0;  // 成功以后不用在重试
   }
@@ -22,11 +22,20 @@
 
 namespace polaris {
 
+class ServiceData;
+class SharedDiscoverResponse;
+
 // 服务数据持久化异步任务
 class PersistTask : public TimingTask {
 public:
   PersistTask(const std::string& file, const std::string& data, int retry_times, uint64_t interval);
 
+  // 持久化服务数据，在任务执行时才将服务数据转换成json格式
+  PersistTask(const std::string& file, ServiceData* service_data, int retry_times,
+              uint64_t interval);
+
+  virtual ~PersistTask();
+
   virtual void Run();
 
   virtual uint64_t NextRunTime();
@@ -36,9 +45,10 @@ public:
   bool DoDelete();  // 执行删除持久化文件操作
 
 private:
-  std::string file_;  // 持久化文件名
-  std::string data_;  // 持久化数据
-  int retry_times_;   // 剩余重试次数
+  std::string file_;                    // 持久化文件名
+  std::string data_;                    // 持久化数据
+  SharedDiscoverResponse* pb_response_;  // 待转换成json的原始数据
+  int retry_times_;                     // 剩余重试次数
 };
 
 // 执行刷新磁盘文件缓存时间任务
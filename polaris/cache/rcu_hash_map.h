@@ -0,0 +1,109 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#ifndef POLARIS_CPP_POLARIS_CACHE_RCU_HASH_MAP_H_
+#define POLARIS_CPP_POLARIS_CACHE_RCU_HASH_MAP_H_
+
+#include <stdint.h>
+
+#include "cache/flat_hash_map.h"
+#include "cache/rcu_map.h"
+
+namespace polaris {
+
+/// @brief 使用开放寻址哈希表作为内部map的RcuMap
+///
+/// 读写语义与RcuMap完全一致，查询由O(log n)次key比较变为一次哈希计算加平均O(1)次探测
+/// 适用于key数量多且key比较代价高的场景，例如ServiceKey和RateLimitWindowKey
+///
+/// 设置容量后可作为读无锁的LRU使用：读操作只在read map中记录访问时间，
+/// 写操作在dirty map超过容量时，从时钟指针处采样若干个key淘汰其中最久未访问的一个(采样LRU)
+/// 被淘汰的value与Delete一样加入待释放列表，由CheckGc延迟释放
+template <typename Key, typename Value, uint32_t (*HashFunc)(const Key&)>
+class RcuHashMap : public RcuMap<Key, Value, FlatHashMap<Key, RcuMapValue<Value>*, HashFunc> > {
+private:
+  typedef void (*ValueOp)(Value* value);
+  typedef FlatHashMap<Key, RcuMapValue<Value>*, HashFunc> InnerMap;
+  typedef RcuMap<Key, Value, InnerMap> Base;
+
+public:
+  explicit RcuHashMap(ValueOp allocator   = ValueIncrementRef,
+                      ValueOp deallocator = ValueDecrementRef)
+      : Base(allocator, deallocator), capacity_(0), clock_hand_(0) {}
+
+  /// @brief 设置容量，超过容量时淘汰最久未访问的key，0表示不限制容量
+  void SetCapacity(std::size_t capacity) { capacity_ = capacity; }
+
+  /// @brief 同RcuMap::Update，设置了容量时插入后检查淘汰
+  virtual void Update(const Key& key, Value* value);
+
+  /// @brief 同RcuMap::PutIfAbsent，设置了容量时插入后检查淘汰
+  virtual Value* PutIfAbsent(const Key& key, Value* value);
+
+private:
+  // 淘汰时不采样刚插入的key，避免访问时间相同时淘汰刚插入的key
+  void EvictInLock(const Key& inserted_key);
+
+  static const std::size_t kEvictSampleSize = 8;
+
+  std::size_t capacity_;
+  std::size_t clock_hand_;  // 淘汰采样的起始槽位，每次淘汰后前移
+};
+
+template <typename Key, typename Value, uint32_t (*HashFunc)(const Key&)>
+void RcuHashMap<Key, Value, HashFunc>::Update(const Key& key, Value* value) {
+  Base::Update(key, value);
+  if (capacity_ > 0 && value != NULL) {
+    sync::MutexGuard mutex_guard(this->dirty_lock_);
+    EvictInLock(key);
+  }
+}
+
+template <typename Key, typename Value, uint32_t (*HashFunc)(const Key&)>
+Value* RcuHashMap<Key, Value, HashFunc>::PutIfAbsent(const Key& key, Value* value) {
+  Value* old_value = Base::PutIfAbsent(key, value);
+  if (capacity_ > 0 && old_value == NULL) {
+    sync::MutexGuard mutex_guard(this->dirty_lock_);
+    EvictInLock(key);
+  }
+  return old_value;
+}
+
+template <typename Key, typename Value, uint32_t (*HashFunc)(const Key&)>
+void RcuHashMap<Key, Value, HashFunc>::EvictInLock(const Key& inserted_key) {
+  InnerMap* dirty_map = this->dirty_map_;
+  while (dirty_map->size() > capacity_) {
+    typename InnerMap::iterator it = dirty_map->bucket_begin(clock_hand_);
+    typename InnerMap::iterator oldest_it = dirty_map->end();
+    for (std::size_t sampled = 0; sampled < kEvictSampleSize; ++it) {
+      if (it == dirty_map->end()) {  // 到达末尾从头继续
+        it = dirty_map->begin();
+      }
+      if (!(it->first == inserted_key) &&
+          (oldest_it == dirty_map->end() ||
+           it->second->used_time_ < oldest_it->second->used_time_)) {
+        oldest_it = it;
+      }
+      clock_hand_ = it.bucket() + 1;
+      if (++sampled >= dirty_map->size()) {
+        break;
+      }
+    }
+    Key oldest_key = oldest_it->first;
+    this->DeleteInLock(oldest_key);
+  }
+}
+
+}  // namespace polaris
+
+#endif  //  POLARIS_CPP_POLARIS_CACHE_RCU_HASH_MAP_H_
@@ -44,6 +44,13 @@ void ValueDelete(Value* value) {
   delete value;
 }
 
+/// @brief RcuMap中保存的value及其访问时间
+template <typename Value>
+struct RcuMapValue {
+  Value* value_;
+  volatile uint64_t used_time_;
+};
+
 /// @brief 双缓冲少写多读Map
 ///
 /// 两个map，read map提供无锁读，dirty map加锁写
@@ -55,14 +62,13 @@ void ValueDelete(Value* value) {
 /// 所以
 /// 4.1 一个item在dirty map中，那么它的value包含的指针一定不为NULL（删除操作保证）
 /// 4.2 一个item不在dirty map中，如果它在read map中，那么它的value包含的指针一定为NULL
-template <typename Key, typename Value>
+///
+/// 内部map默认使用std::map，可通过InnerMap替换成提供相同接口子集的容器，参见RcuHashMap
+template <typename Key, typename Value,
+          typename InnerMap = std::map<Key, RcuMapValue<Value>*> >
 class RcuMap {
 private:
-  struct MapValue {
-    Value* value_;
-    volatile uint64_t used_time_;
-  };
-  typedef std::map<Key, MapValue*> InnerMap;
+  typedef RcuMapValue<Value> MapValue;
 
   typedef void (*ValueOp)(Value* value);
 
@@ -75,7 +81,7 @@ private:
 public:
   explicit RcuMap(ValueOp allocator = ValueIncrementRef, ValueOp deallocator = ValueDecrementRef);
 
-  ~RcuMap();
+  virtual ~RcuMap();
 
   /// @brief 根据Key获取指向Value的指针，key不存在返回NULL
   Value* Get(const Key& key, bool update_access_time = true);
@@ -83,11 +89,11 @@ public:
   /// @brief 更新Key对应的Value
   /// 如果key对应的value已存在，则将旧的value加入待释放列表，内部线程会延迟一定时间释放
   /// 如果传入的value为NULL，则效果等同于调用Delete方法删除key
-  void Update(const Key& key, Value* value);
+  virtual void Update(const Key& key, Value* value);
 
   /// @brief 添加新的Key,Value
   /// 如果key对应的value已存在，返回false
-  Value* PutIfAbsent(const Key& key, Value* value);
+  virtual Value* PutIfAbsent(const Key& key, Value* value);
 
   /// @brief 删除指定key，并将value加入待释放列表
   void Delete(const Key& key);
@@ -101,10 +107,13 @@ public:
   /// @brief 获取所有Value的引用
   void GetAllValuesWithRef(std::vector<Value*>& values);
 
-private:
+protected:
   void CheckSwapInLock();
 
-private:
+  // 在持有dirty_lock_的情况下删除指定key
+  void DeleteInLock(const Key& key);
+
+protected:
   InnerMap* volatile read_map_;  // 多线程读线程安全map
   std::size_t miss_time_;        // 用于记录从dirty map中查到的次数
 
@@ -120,8 +129,8 @@ private:
   ValueOp deallocator_;
 };
 
-template <typename Key, typename Value>
-RcuMap<Key, Value>::RcuMap(ValueOp allocator, ValueOp deallocator) {
+template <typename Key, typename Value, typename InnerMap>
+RcuMap<Key, Value, InnerMap>::RcuMap(ValueOp allocator, ValueOp deallocator) {
   read_map_    = new InnerMap();
   miss_time_   = 0;
   dirty_map_   = new InnerMap();
@@ -129,8 +138,8 @@ RcuMap<Key, Value>::RcuMap(ValueOp allocator, ValueOp deallocator) {
   deallocator_ = deallocator;
 }
 
-template <typename Key, typename Value>
-RcuMap<Key, Value>::~RcuMap() {
+template <typename Key, typename Value, typename InnerMap>
+RcuMap<Key, Value, InnerMap>::~RcuMap() {
   for (typename InnerMap::iterator it = dirty_map_->begin(); it != dirty_map_->end(); ++it) {
     POLARIS_ASSERT(it->second->value_ != NULL);  // dirty map中的MapValue，其value一定不为NULL
     deallocator_(it->second->value_);
@@ -165,8 +174,8 @@ RcuMap<Key, Value>::~RcuMap() {
   }
 }
 
-template <typename Key, typename Value>
-Value* RcuMap<Key, Value>::Get(const Key& key, bool update_access_time) {
+template <typename Key, typename Value, typename InnerMap>
+Value* RcuMap<Key, Value, InnerMap>::Get(const Key& key, bool update_access_time) {
   // 查询read map，获取结果
   Value* read_result             = NULL;
   InnerMap* current_read         = read_map_;
@@ -197,8 +206,8 @@ Value* RcuMap<Key, Value>::Get(const Key& key, bool update_access_time) {
   return read_result;
 }
 
-template <typename Key, typename Value>
-void RcuMap<Key, Value>::CheckSwapInLock() {
+template <typename Key, typename Value, typename InnerMap>
+void RcuMap<Key, Value, InnerMap>::CheckSwapInLock() {
   if (miss_time_ < dirty_map_->size()) {
     return;
   }
@@ -215,8 +224,8 @@ void RcuMap<Key, Value>::CheckSwapInLock() {
   miss_time_ = 0;
 }
 
-template <typename Key, typename Value>
-void RcuMap<Key, Value>::Update(const Key& key, Value* value) {
+template <typename Key, typename Value, typename InnerMap>
+void RcuMap<Key, Value, InnerMap>::Update(const Key& key, Value* value) {
   if (value == NULL) {  // 直接调用Delete
     this->Delete(key);
     return;
@@ -252,8 +261,8 @@ void RcuMap<Key, Value>::Update(const Key& key, Value* value) {
   }
 }
 
-template <typename Key, typename Value>
-Value* RcuMap<Key, Value>::PutIfAbsent(const Key& key, Value* value) {
+template <typename Key, typename Value, typename InnerMap>
+Value* RcuMap<Key, Value, InnerMap>::PutIfAbsent(const Key& key, Value* value) {
   // 加锁将数据写入dirty map。
   sync::MutexGuard mutex_guard(dirty_lock_);
   typename InnerMap::iterator it = dirty_map_->find(key);
@@ -268,9 +277,14 @@ Value* RcuMap<Key, Value>::PutIfAbsent(const Key& key, Value* value) {
   return NULL;
 }
 
-template <typename Key, typename Value>
-void RcuMap<Key, Value>::Delete(const Key& key) {
+template <typename Key, typename Value, typename InnerMap>
+void RcuMap<Key, Value, InnerMap>::Delete(const Key& key) {
   sync::MutexGuard mutex_guard(dirty_lock_);
+  DeleteInLock(key);
+}
+
+template <typename Key, typename Value, typename InnerMap>
+void RcuMap<Key, Value, InnerMap>::DeleteInLock(const Key& key) {
   typename InnerMap::iterator it = dirty_map_->find(key);
   // dirty map中没有的话，read map即使有value也已经释放成了NULL，退出即可
   if (it == dirty_map_->end()) {
@@ -294,8 +308,8 @@ void RcuMap<Key, Value>::Delete(const Key& key) {
   }
 }
 
-template <typename Key, typename Value>
-void RcuMap<Key, Value>::CheckGc(uint64_t min_delete_time) {
+template <typename Key, typename Value, typename InnerMap>
+void RcuMap<Key, Value, InnerMap>::CheckGc(uint64_t min_delete_time) {
   std::vector<Value*> values_need_delete;
   do {  // 加锁获取需要删除的values
     sync::MutexGuard mutex_guard(dirty_lock_);
@@ -337,8 +351,8 @@ void RcuMap<Key, Value>::CheckGc(uint64_t min_delete_time) {
   }
 }
 
-template <typename Key, typename Value>
-void RcuMap<Key, Value>::CheckExpired(uint64_t min_access_time,
+template <typename Key, typename Value, typename InnerMap>
+void RcuMap<Key, Value, InnerMap>::CheckExpired(uint64_t min_access_time,
                                       std::vector<Key>& keys_need_expired) {
   sync::MutexGuard mutex_guard(dirty_lock_);
   for (typename InnerMap::iterator it = dirty_map_->begin(); it != dirty_map_->end(); ++it) {
@@ -348,8 +362,8 @@ void RcuMap<Key, Value>::CheckExpired(uint64_t min_access_time,
   }
 }
 
-template <typename Key, typename Value>
-void RcuMap<Key, Value>::GetAllValuesWithRef(std::vector<Value*>& values) {
+template <typename Key, typename Value, typename InnerMap>
+void RcuMap<Key, Value, InnerMap>::GetAllValuesWithRef(std::vector<Value*>& values) {
   sync::MutexGuard mutex_guard(dirty_lock_);
   for (typename InnerMap::iterator it = dirty_map_->begin(); it != dirty_map_->end(); ++it) {
     allocator_(it->second->value_);
@@ -50,4 +50,40 @@ RuleRouterCacheValue::~RuleRouterCacheValue() {
   data_.clear();
 }
 
+RouteChainCacheValue::RouteChainCacheValue()
+    : instances_data_(NULL),
+      route_rule_(NULL),
+      source_route_rule_(NULL),
+      prior_data_(NULL),
+      result_data_(NULL),
+      verify_time_(0),
+      has_source_service_(false) {}
+
+RouteChainCacheValue::~RouteChainCacheValue() {
+  if (instances_data_ != NULL) {
+    instances_data_->DecrementRef();
+    instances_data_ = NULL;
+  }
+  if (route_rule_ != NULL) {
+    route_rule_->DecrementRef();
+    route_rule_ = NULL;
+  }
+  if (source_route_rule_ != NULL) {
+    source_route_rule_->DecrementRef();
+    source_route_rule_ = NULL;
+  }
+  if (prior_data_ != NULL) {
+    prior_data_->DecrementRef();
+    prior_data_ = NULL;
+  }
+  if (result_data_ != NULL) {
+    result_data_->DecrementRef();
+    result_data_ = NULL;
+  }
+  for (std::size_t i = 0; i < counted_data_.size(); ++i) {
+    counted_data_[i]->DecrementRef();
+  }
+  counted_data_.clear();
+}
+
 }  // namespace polaris
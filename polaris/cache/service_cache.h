@@ -219,6 +219,72 @@ struct MetadataCacheKey {
   }
 };
 
+///////////////////////////////////////////////////////////////////////////////
+// 路由链结果缓存Key，包含路由链所有插件的输入
+// 主调服务、主调metadata、labels和metadata路由参数只记录摘要，避免每次路由拷贝，
+// 命中后再与缓存值中保存的原始输入比较
+struct RouteChainCacheKey {
+  InstancesSet* prior_data_;
+  ServiceData* route_rule_;
+  ServiceData* source_route_rule_;
+  uint64_t circuit_breaker_version_;
+  uint64_t subset_circuit_breaker_version_;
+  uint64_t location_version_;
+  uint64_t input_digest_;     // 主调服务和各map参数的摘要
+  uint32_t disable_routers_;  // 请求禁用的路由插件，按插件在路由链中的位置记录
+  uint8_t request_flags_;
+  MetadataFailoverType failover_type_;
+
+  bool operator<(const RouteChainCacheKey& rhs) const {
+    if (this->prior_data_ != rhs.prior_data_) {
+      return this->prior_data_ < rhs.prior_data_;
+    } else if (this->route_rule_ != rhs.route_rule_) {
+      return this->route_rule_ < rhs.route_rule_;
+    } else if (this->source_route_rule_ != rhs.source_route_rule_) {
+      return this->source_route_rule_ < rhs.source_route_rule_;
+    } else if (this->circuit_breaker_version_ != rhs.circuit_breaker_version_) {
+      return this->circuit_breaker_version_ < rhs.circuit_breaker_version_;
+    } else if (this->subset_circuit_breaker_version_ != rhs.subset_circuit_breaker_version_) {
+      return this->subset_circuit_breaker_version_ < rhs.subset_circuit_breaker_version_;
+    } else if (this->location_version_ != rhs.location_version_) {
+      return this->location_version_ < rhs.location_version_;
+    } else if (this->input_digest_ != rhs.input_digest_) {
+      return this->input_digest_ < rhs.input_digest_;
+    } else if (this->disable_routers_ != rhs.disable_routers_) {
+      return this->disable_routers_ < rhs.disable_routers_;
+    } else if (this->request_flags_ != rhs.request_flags_) {
+      return this->request_flags_ < rhs.request_flags_;
+    } else {
+      return this->failover_type_ < rhs.failover_type_;
+    }
+  }
+};
+
+// 路由链结果缓存Value
+class RouteChainCacheValue : public CacheValueBase {
+public:
+  RouteChainCacheValue();
+
+  virtual ~RouteChainCacheValue();
+
+public:
+  // 持有key中各指针指向的数据，保证缓存有效期间指针不会被复用
+  ServiceData* instances_data_;
+  ServiceData* route_rule_;
+  ServiceData* source_route_rule_;
+  InstancesSet* prior_data_;
+  InstancesSet* result_data_;                // 路由链输出的实例分组
+  std::vector<InstancesSet*> counted_data_;  // 执行路由链时各插件增加了访问计数的分组
+  std::map<std::string, std::string> subset_;
+  uint64_t verify_time_;  // 上次执行路由链校验结果的时间
+  // key中只记录了摘要的原始输入，命中时比较，避免摘要冲突时返回错误的结果
+  bool has_source_service_;
+  ServiceKey source_service_key_;
+  std::map<std::string, std::string> source_metadata_;
+  std::map<std::string, std::string> labels_;
+  std::map<std::string, std::string> metadata_;
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 class Clearable : public ServiceBase {
 public:
@@ -285,6 +285,11 @@ ContextImpl::ContextImpl() {
   report_client_interval_ = 0;
   cache_clear_time_       = 0;
 
+  health_check_max_in_flight_ = HealthCheckerConfig::kMaxInFlightDefault;
+  call_result_async_          = CallResultConfig::kAsyncReportDefault;
+  call_result_buffer_size_    = CallResultConfig::kBufferSizeDefault;
+  call_result_max_delay_      = CallResultConfig::kMaxDelayDefault;
+
   server_connector_ = NULL;
   local_registry_   = NULL;
   stat_reporter_    = NULL;
@@ -293,7 +298,7 @@ ContextImpl::ContextImpl() {
 
   global_service_config_ = NULL;
   pthread_rwlock_init(&rwlock_, NULL);
-  service_context_map_ = new RcuMap<ServiceKey, ServiceContext>();
+  service_context_map_ = new RcuHashMap<HashedServiceKey, ServiceContext, HashedServiceKeyHash>();
 
   api_stat_registry_ = NULL;
   service_record_    = NULL;
@@ -383,14 +388,17 @@ static const char kInnerServiceConfig[] =
     "      successCountAfterHalfOpen: 2";
 
 ServiceContext* ContextImpl::GetOrCreateServiceContext(const ServiceKey& service_key) {
-  ServiceContext* service_context = service_context_map_->Get(service_key);
+  ServiceContext* service_context =
+      service_context_map_->Get(ThreadLocalHashedServiceKey(service_key));
   if (service_context != NULL) {
     return service_context;
   }
 
   // 读取失败升级成写锁再尝试读，读取失败则创建并写入
   pthread_rwlock_wrlock(&rwlock_);
-  service_context = service_context_map_->Get(service_key);
+  HashedServiceKey hashed_key;  // 创建服务上下文时会查询服务数据，不能使用线程本地的key
+  SetHashedServiceKey(hashed_key, service_key);
+  service_context = service_context_map_->Get(hashed_key);
   if (service_context == NULL) {
     ServiceContextImpl* service_context_impl = new ServiceContextImpl();
     ReturnCode ret                           = kReturnOk;
@@ -410,7 +418,7 @@ ServiceContext* ContextImpl::GetOrCreateServiceContext(const ServiceKey& service
       delete service_context_impl;
     } else {
       service_context = new ServiceContext(service_context_impl);
-      service_context_map_->Update(service_key, service_context);
+      service_context_map_->Update(hashed_key, service_context);
       service_context->IncrementRef();
     }
   }
@@ -419,7 +427,9 @@ ServiceContext* ContextImpl::GetOrCreateServiceContext(const ServiceKey& service
 }
 
 void ContextImpl::DeleteServiceContext(const ServiceKey& service_key) {
-  service_context_map_->Delete(service_key);
+  HashedServiceKey hashed_key;
+  SetHashedServiceKey(hashed_key, service_key);
+  service_context_map_->Delete(hashed_key);
 }
 
 void ContextImpl::GetAllServiceContext(std::vector<ServiceContext*>& all_service_contexts) {
@@ -675,7 +685,39 @@ ReturnCode ContextImpl::InitConsumerConfig(Config* consumer_config, Context* con
   }
   ReturnCode ret = local_registry_->Init(plugin_config, context);
   delete plugin_config;
-  return ret;
+  if (ret != kReturnOk) {
+    return ret;
+  }
+
+  // 健康探测的并发数是所有服务共享的
+  plugin_config               = consumer_config->GetSubConfig("healthCheck");
+  health_check_max_in_flight_ = plugin_config->GetIntOrDefault(
+      HealthCheckerConfig::kMaxInFlightKey, HealthCheckerConfig::kMaxInFlightDefault);
+  delete plugin_config;
+  if (health_check_max_in_flight_ <= 0) {
+    POLARIS_LOG(LOG_ERROR, "health check config %s must be positive",
+                HealthCheckerConfig::kMaxInFlightKey);
+    return kReturnInvalidConfig;
+  }
+
+  // 调用结果上报配置
+  plugin_config = consumer_config->GetSubConfig("callResult");
+  // 不启动线程时无法处理异步上报的调用结果
+  call_result_async_ = context_mode_ != kShareContextWithoutEngine &&
+                       plugin_config->GetBoolOrDefault(CallResultConfig::kAsyncReportKey,
+                                                       CallResultConfig::kAsyncReportDefault);
+  int buffer_size = plugin_config->GetIntOrDefault(CallResultConfig::kBufferSizeKey,
+                                                   CallResultConfig::kBufferSizeDefault);
+  call_result_max_delay_ = plugin_config->GetMsOrDefault(CallResultConfig::kMaxDelayKey,
+                                                         CallResultConfig::kMaxDelayDefault);
+  delete plugin_config;
+  if (buffer_size <= 0 || call_result_max_delay_ == 0) {
+    POLARIS_LOG(LOG_ERROR, "call result config %s and %s must be positive",
+                CallResultConfig::kBufferSizeKey, CallResultConfig::kMaxDelayKey);
+    return kReturnInvalidConfig;
+  }
+  call_result_buffer_size_ = buffer_size;
+  return kReturnOk;
 }
 
 ReturnCode ContextImpl::VerifyServiceConfig(Config* config) {
@@ -23,6 +23,9 @@
 
 #include "cache/cache_manager.h"
 #include "cache/cache_persist.h"
+#include "cache/hashed_service_key.h"
+#include "cache/lru_map.h"
+#include "cache/rcu_hash_map.h"
 #include "cache/rcu_map.h"
 #include "cache/rcu_time.h"
 #include "config/seed_server.h"
@@ -132,6 +135,14 @@ public:
 
   uint64_t GetCacheClearTime() const { return cache_clear_time_; }
 
+  int GetHealthCheckMaxInFlight() const { return health_check_max_in_flight_; }
+
+  bool IsCallResultAsync() const { return call_result_async_; }
+
+  uint32_t GetCallResultBufferSize() const { return call_result_buffer_size_; }
+
+  uint64_t GetCallResultMaxDelay() const { return call_result_max_delay_; }
+
   void SetApiBindIp(const std::string& bind_ip) { bind_ip_ = bind_ip; }
 
   SeedServerConfig& GetSeedConfig() { return seed_config_; }
@@ -158,6 +169,8 @@ public:
     return engine_->GetCircuitBreakerExecutor();
   }
 
+  CallResultExecutor* GetCallResultExecutor() { return engine_->GetCallResultExecutor(); }
+
   QuotaManager* GetQuotaManager() { return quota_manager_; }
 
   const v1::SDKToken& GetSdkToken() { return sdk_token_; }
@@ -212,6 +225,12 @@ private:
   uint64_t report_client_interval_;  // TODO 待确定范围
   model::ClientLocation client_location_;
   uint64_t cache_clear_time_;
+  int health_check_max_in_flight_;  // 健康探测同时进行的探测数上限
+
+  // 调用结果异步上报配置
+  bool call_result_async_;
+  uint32_t call_result_buffer_size_;
+  uint64_t call_result_max_delay_;
 
   SeedServerConfig seed_config_;
   SystemVariables system_variables_;
@@ -227,7 +246,7 @@ private:
   // Service config and Service level context
   Config* global_service_config_;
   pthread_rwlock_t rwlock_;
-  RcuMap<ServiceKey, ServiceContext>* service_context_map_;
+  RcuHashMap<HashedServiceKey, ServiceContext, HashedServiceKeyHash>* service_context_map_;
 
   Engine* engine_;
 
@@ -0,0 +1,176 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#include "engine/call_result_executor.h"
+
+#include <stddef.h>
+
+#include <string>
+
+#include "api/consumer_api.h"
+#include "context_internal.h"
+#include "logger.h"
+#include "polaris/context.h"
+#include "reactor/reactor.h"
+#include "reactor/task.h"
+
+namespace polaris {
+
+CallResultRing::CallResultRing(uint32_t capacity) {
+  uint32_t size = 1;
+  while (size < capacity) {  // 容量取整到2的幂
+    size <<= 1;
+  }
+  slots_ = new InstanceGauge[size];
+  mask_  = size - 1;
+}
+
+CallResultRing::~CallResultRing() {
+  delete[] slots_;
+  slots_ = NULL;
+}
+
+bool CallResultRing::Push(InstanceGauge& gauge) {
+  uint64_t tail = tail_.Load();
+  if (tail - head_.Load() > mask_) {
+    return false;
+  }
+  InstanceGauge& slot = slots_[tail & mask_];
+  // 字符串赋值复用位置上已分配的内存，map直接交换
+  slot.service_namespace   = gauge.service_namespace;
+  slot.service_name        = gauge.service_name;
+  slot.instance_id         = gauge.instance_id;
+  slot.call_ret_status     = gauge.call_ret_status;
+  slot.call_ret_code       = gauge.call_ret_code;
+  slot.call_daley          = gauge.call_daley;
+  slot.locality_aware_info = gauge.locality_aware_info;
+  slot.source_service_key  = gauge.source_service_key;
+  slot.subset_.swap(gauge.subset_);
+  slot.labels_.swap(gauge.labels_);
+  tail_.Store(tail + 1);  // 写完数据再发布
+  return true;
+}
+
+CallResultExecutor::CallResultExecutor(Context* context)
+    : Executor(context), max_delay_(CallResultConfig::kMaxDelayDefault) {
+  tls_key_ = 0;
+  int rc   = pthread_key_create(&tls_key_, &OnThreadExit);
+  POLARIS_ASSERT(rc == 0);
+}
+
+CallResultExecutor::~CallResultExecutor() {
+  StopAndWait();
+  pthread_key_delete(tls_key_);
+  for (std::set<CallResultRing*>::iterator it = ring_set_.begin(); it != ring_set_.end(); ++it) {
+    delete *it;
+  }
+  ring_set_.clear();
+}
+
+void CallResultExecutor::SetupWork() {
+  max_delay_ = context_->GetContextImpl()->GetCallResultMaxDelay();
+  reactor_.AddTimingTask(
+      new TimingFuncTask<CallResultExecutor>(TimingDrain, this, max_delay_));
+}
+
+ReturnCode CallResultExecutor::StopAndWait() {
+  bool running = tid_ != 0;
+  Executor::StopAndWait();
+  if (running) {  // 线程已退出，由当前线程最后处理一次，避免调用结果丢失
+    Drain();
+  }
+  return kReturnOk;
+}
+
+bool CallResultExecutor::Enqueue(InstanceGauge& gauge) {
+  CallResultRing* ring = static_cast<CallResultRing*>(pthread_getspecific(tls_key_));
+  if (ring == NULL) {
+    ring = CreateRing();
+  }
+  return ring->Push(gauge);
+}
+
+void CallResultExecutor::TimingDrain(CallResultExecutor* executor) {
+  executor->Drain();
+  executor->reactor_.AddTimingTask(
+      new TimingFuncTask<CallResultExecutor>(TimingDrain, executor, executor->max_delay_));
+}
+
+void CallResultExecutor::Drain() {
+  ContextImpl* context_impl       = context_->GetContextImpl();
+  ServiceContext* service_context = NULL;
+  ServiceKey service_key;
+  context_impl->RcuEnter();
+  sync::MutexGuard mutex_guard(lock_);
+  for (std::set<CallResultRing*>::iterator it = ring_set_.begin(); it != ring_set_.end();) {
+    CallResultRing* ring = *it;
+    bool active          = ring->active_.Load();  // 线程退出后的最后一次读取包含全部数据
+    uint64_t end         = ring->ReadEnd();
+    for (uint64_t index = ring->ReadBegin(); index < end; ++index) {
+      InstanceGauge& gauge = ring->At(index);
+      // 同一线程的调用结果通常属于少数几个服务，服务不变时复用服务上下文
+      if (service_context == NULL || gauge.service_name != service_key.name_ ||
+          gauge.service_namespace != service_key.namespace_) {
+        if (service_context != NULL) {
+          service_context->DecrementRef();
+        }
+        service_key.namespace_ = gauge.service_namespace;
+        service_key.name_      = gauge.service_name;
+        service_context        = context_impl->GetOrCreateServiceContext(service_key);
+        if (service_context == NULL) {
+          POLARIS_LOG(LOG_ERROR,
+                      "update service call result failed because context of service[%s/%s] "
+                      "not exist",
+                      service_key.namespace_.c_str(), service_key.name_.c_str());
+          gauge.subset_.clear();
+          gauge.labels_.clear();
+          continue;
+        }
+      }
+      ConsumerApiImpl::UpdateServiceCallResult(context_impl, service_context, gauge);
+      gauge.subset_.clear();
+      gauge.labels_.clear();
+    }
+    ring->Consume(end);
+    if (active) {
+      ++it;
+    } else {  // 线程已经退出，则删除线程局部队列
+      delete ring;
+      ring_set_.erase(it++);
+    }
+  }
+  if (service_context != NULL) {
+    service_context->DecrementRef();
+  }
+  context_impl->RcuExit();
+}
+
+CallResultRing* CallResultExecutor::CreateRing() {
+  CallResultRing* ring =
+      new CallResultRing(context_->GetContextImpl()->GetCallResultBufferSize());
+  ring->active_.Store(true);
+  pthread_setspecific(tls_key_, ring);
+  sync::MutexGuard mutex_guard(lock_);
+  ring_set_.insert(ring);
+  return ring;
+}
+
+void CallResultExecutor::OnThreadExit(void* ptr) {
+  if (ptr != NULL) {
+    CallResultRing* ring = static_cast<CallResultRing*>(ptr);
+    // 线程退出的时候设置线程局部队列active为false
+    ring->active_.Store(false);
+  }
+}
+
+}  // namespace polaris
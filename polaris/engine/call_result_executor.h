@@ -0,0 +1,115 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#ifndef POLARIS_CPP_POLARIS_ENGINE_CALL_RESULT_EXECUTOR_H_
+#define POLARIS_CPP_POLARIS_ENGINE_CALL_RESULT_EXECUTOR_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <set>
+
+#include "engine/executor.h"
+#include "polaris/plugin.h"
+#include "sync/atomic.h"
+#include "sync/mutex.h"
+
+namespace polaris {
+
+class Context;
+
+namespace CallResultConfig {
+static const char kAsyncReportKey[]     = "asyncReport";  // 是否异步处理调用结果
+static const bool kAsyncReportDefault   = false;
+static const char kBufferSizeKey[]      = "bufferSize";  // 每个线程缓存的调用结果数
+static const int kBufferSizeDefault     = 4096;
+static const char kMaxDelayKey[]        = "maxDelay";  // 调用结果最长延迟处理时间
+static const uint64_t kMaxDelayDefault  = 10;
+}  // namespace CallResultConfig
+
+/// @brief 单个线程的调用结果环形队列
+///
+/// 只有所属线程写入，后台线程读取，读写均无锁
+class CallResultRing {
+public:
+  explicit CallResultRing(uint32_t capacity);
+
+  ~CallResultRing();
+
+  // 所属线程写入调用结果，队列满时返回false
+  bool Push(InstanceGauge& gauge);
+
+  // 后台线程读取：返回可读取的区间[begin, end)
+  uint64_t ReadBegin() const { return head_.Load(); }
+
+  uint64_t ReadEnd() const { return tail_.Load(); }
+
+  InstanceGauge& At(uint64_t index) { return slots_[index & mask_]; }
+
+  // 后台线程处理完后释放区间内的位置
+  void Consume(uint64_t end) { head_.Store(end); }
+
+  sync::Atomic<bool> active_;
+
+private:
+  InstanceGauge* slots_;
+  uint32_t mask_;
+  char padding1_[64];
+  sync::Atomic<uint64_t> head_;  // 读写位置分别占用缓存行，避免伪共享
+  char padding2_[64 - sizeof(sync::Atomic<uint64_t>)];
+  sync::Atomic<uint64_t> tail_;
+  char padding3_[64 - sizeof(sync::Atomic<uint64_t>)];
+};
+
+/// @brief 调用结果处理任务
+///
+/// 开启异步上报后，调用线程只将调用结果写入线程局部的环形队列，
+/// 由本线程定期批量执行统计上报、动态权重调整、LA反馈和熔断
+class CallResultExecutor : public Executor {
+public:
+  explicit CallResultExecutor(Context* context);
+
+  virtual ~CallResultExecutor();
+
+  // 获取线程名字
+  virtual const char* GetName() { return "call_result"; }
+
+  virtual void SetupWork();
+
+  // 停止处理线程，线程退出后处理队列中剩余的调用结果
+  virtual ReturnCode StopAndWait();
+
+  // 调用线程写入调用结果，返回false时需要调用线程同步处理
+  bool Enqueue(InstanceGauge& gauge);
+
+  static void TimingDrain(CallResultExecutor* executor);
+
+  // 批量处理所有线程队列中的调用结果
+  void Drain();
+
+private:
+  CallResultRing* CreateRing();
+
+  static void OnThreadExit(void* ptr);
+
+private:
+  uint64_t max_delay_;
+
+  sync::Mutex lock_;
+  pthread_key_t tls_key_;
+  std::set<CallResultRing*> ring_set_;
+};
+
+}  // namespace polaris
+
+#endif  //  POLARIS_CPP_POLARIS_ENGINE_CALL_RESULT_EXECUTOR_H_
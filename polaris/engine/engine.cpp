@@ -15,7 +15,9 @@
 
 #include <stddef.h>
 
+#include "context_internal.h"
 #include "logger.h"
+#include "polaris/context.h"
 
 namespace polaris {
 
@@ -24,7 +26,7 @@ class Context;
 Engine::Engine(Context* context)
     : context_(context), main_executor_(context), cache_manager_(context),
       monitor_reporter_(context_), circuit_breaker_executor_(context),
-      health_checker_executor_(context) {}
+      health_checker_executor_(context), call_result_executor_(context) {}
 
 Engine::~Engine() {
   StopAndWait();
@@ -41,10 +43,17 @@ ReturnCode Engine::Start() {
       (ret_code = health_checker_executor_.Start()) != kReturnOk) {
     return ret_code;
   }
+  // 开启异步上报调用结果时才启动处理线程
+  if (context_->GetContextImpl()->IsCallResultAsync() &&
+      (ret_code = call_result_executor_.Start()) != kReturnOk) {
+    return ret_code;
+  }
   return kReturnOk;
 }
 
 ReturnCode Engine::StopAndWait() {
+  // 先停止调用结果处理线程，剩余的调用结果在其他线程停止前更新到统计和熔断数据中
+  call_result_executor_.StopAndWait();
   main_executor_.StopAndWait();
   cache_manager_.StopAndWait();
   monitor_reporter_.StopAndWait();
@@ -15,6 +15,7 @@
 #define POLARIS_CPP_POLARIS_ENGINE_ENGINE_H_
 
 #include "cache/cache_manager.h"
+#include "engine/call_result_executor.h"
 #include "engine/circuit_breaker_executor.h"
 #include "engine/health_check_executor.h"
 #include "engine/main_executor.h"
@@ -41,6 +42,8 @@ public:
 
   CircuitBreakerExecutor* GetCircuitBreakerExecutor() { return &circuit_breaker_executor_; }
 
+  CallResultExecutor* GetCallResultExecutor() { return &call_result_executor_; }
+
 private:
   Context* context_;
   MainExecutor main_executor_;
@@ -48,6 +51,7 @@ private:
   MonitorReporter monitor_reporter_;
   CircuitBreakerExecutor circuit_breaker_executor_;
   HealthCheckExecutor health_checker_executor_;
+  CallResultExecutor call_result_executor_;
 };
 
 }  // namespace polaris
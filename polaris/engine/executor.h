@@ -43,7 +43,7 @@ public:
   ReturnCode Start();
 
   // 触发线程停止并等待线程退出
-  ReturnCode StopAndWait();
+  virtual ReturnCode StopAndWait();
 
   Reactor& GetReactor() { return reactor_; }
 
@@ -17,15 +17,128 @@
 #include <vector>
 
 #include "context_internal.h"
+#include "plugin/health_checker/health_checker.h"
 #include "polaris/context.h"
+#include "polaris/model.h"
 #include "reactor/reactor.h"
 #include "reactor/task.h"
 
 namespace polaris {
 
-HealthCheckExecutor::HealthCheckExecutor(Context* context) : Executor(context) {}
+InstanceDetect::InstanceDetect(ServiceDetectPass* pass, Instance* instance)
+    : pass_(pass), instance_(instance), checker_index_(0), is_detect_success_(false),
+      probe_(NULL) {}
+
+InstanceDetect::~InstanceDetect() {
+  if (probe_ != NULL) {  // reactor退出时探测未完成
+    delete probe_;
+    probe_ = NULL;
+  }
+  pass_     = NULL;
+  instance_ = NULL;
+}
+
+void InstanceDetect::DetectNext() {
+  const std::vector<HealthChecker*>& health_checkers =
+      pass_->GetHealthCheckerChain()->GetHealthCheckerList();
+  while (checker_index_ < health_checkers.size()) {
+    HealthChecker* health_checker = health_checkers[checker_index_++];
+    AsyncHealthChecker* async_checker = dynamic_cast<AsyncHealthChecker*>(health_checker);
+    if (async_checker != NULL) {
+      probe_ = new ProbeEvent(pass_->GetReactor(), async_checker, this);
+      probe_->Start(instance_->GetHost(), instance_->GetPort());  // 之后本对象可能已释放
+      return;
+    }
+    DetectResult detect_result;
+    health_checker->DetectInstance(*instance_, detect_result);
+    if (HandleResult(detect_result)) {
+      return;
+    }
+  }
+  pass_->OnInstanceDone(this, instance_, is_detect_success_);
+}
+
+void InstanceDetect::OnDetectDone(const DetectResult& detect_result) {
+  probe_ = NULL;  // 探测对象会自行释放
+  if (!HandleResult(detect_result)) {
+    DetectNext();
+  }
+}
+
+bool InstanceDetect::HandleResult(const DetectResult& detect_result) {
+  HealthCheckerChainImpl* health_checker_chain = pass_->GetHealthCheckerChain();
+  health_checker_chain->LogDetectResult(*instance_, detect_result);
+  if (detect_result.return_code == kReturnOk) {
+    is_detect_success_ = true;
+  } else if (checker_index_ < health_checker_chain->GetHealthCheckerList().size()) {
+    return false;  // 继续使用下一个插件探测
+  }
+  pass_->OnInstanceDone(this, instance_, is_detect_success_);
+  return true;
+}
+
+ServiceDetectPass::ServiceDetectPass(HealthCheckExecutor* executor,
+                                     ServiceContext* service_context, ServiceData* service_data,
+                                     std::vector<Instance*>& detect_instances)
+    : executor_(executor), service_context_(service_context), service_data_(service_data),
+      next_index_(0), in_flight_(0) {
+  health_checker_chain_ =
+      dynamic_cast<HealthCheckerChainImpl*>(service_context_->GetHealthCheckerChain());
+  detect_instances_.swap(detect_instances);
+}
+
+ServiceDetectPass::~ServiceDetectPass() {
+  for (std::set<InstanceDetect*>::iterator it = detecting_set_.begin();
+       it != detecting_set_.end(); ++it) {
+    delete *it;
+  }
+  detecting_set_.clear();
+  service_data_->DecrementRef();
+  service_data_ = NULL;
+  service_context_->DecrementRef();
+  service_context_ = NULL;
+  executor_        = NULL;
+}
+
+bool ServiceDetectPass::CanStartNext() const {
+  return next_index_ < detect_instances_.size() &&
+         in_flight_ < health_checker_chain_->GetServiceInFlight();
+}
+
+void ServiceDetectPass::StartNext() {
+  InstanceDetect* instance_detect = new InstanceDetect(this, detect_instances_[next_index_++]);
+  detecting_set_.insert(instance_detect);
+  in_flight_++;
+  instance_detect->DetectNext();
+}
+
+void ServiceDetectPass::OnInstanceDone(InstanceDetect* instance_detect, Instance* instance,
+                                       bool is_detect_success) {
+  health_checker_chain_->UpdateCircuitBreakerStatus(*service_context_->GetCircuitBreakerChain(),
+                                                    *instance, is_detect_success);
+  detecting_set_.erase(instance_detect);
+  delete instance_detect;
+  in_flight_--;
+  executor_->OnInstanceDone();  // 之后本对象可能已释放
+}
+
+Reactor& ServiceDetectPass::GetReactor() { return executor_->GetReactor(); }
+
+HealthCheckExecutor::HealthCheckExecutor(Context* context)
+    : Executor(context), in_flight_(0),
+      max_in_flight_(HealthCheckerConfig::kMaxInFlightDefault), scheduling_(false) {}
+
+HealthCheckExecutor::~HealthCheckExecutor() {
+  StopAndWait();  // 线程退出后再释放未完成的探测
+  for (std::list<ServiceDetectPass*>::iterator it = detect_pass_list_.begin();
+       it != detect_pass_list_.end(); ++it) {
+    delete *it;
+  }
+  detect_pass_list_.clear();
+}
 
 void HealthCheckExecutor::SetupWork() {
+  max_in_flight_ = context_->GetContextImpl()->GetHealthCheckMaxInFlight();
   reactor_.SubmitTask(new FuncTask<HealthCheckExecutor>(TimingDetect, this));
 }
 
@@ -33,15 +146,72 @@ void HealthCheckExecutor::TimingDetect(HealthCheckExecutor* executor) {
   std::vector<ServiceContext*> all_service_contexts;
   executor->context_->GetContextImpl()->GetAllServiceContext(all_service_contexts);
   for (std::size_t i = 0; i < all_service_contexts.size(); ++i) {
-    HealthCheckerChain* health_checker_chain   = all_service_contexts[i]->GetHealthCheckerChain();
-    CircuitBreakerChain* circuit_breaker_chain = all_service_contexts[i]->GetCircuitBreakerChain();
-    health_checker_chain->DetectInstance(*circuit_breaker_chain);
-    all_service_contexts[i]->DecrementRef();
+    executor->StartDetect(all_service_contexts[i]);
   }
   all_service_contexts.clear();
+  executor->Schedule();
   // 设置定时任务
   executor->reactor_.AddTimingTask(
       new TimingFuncTask<HealthCheckExecutor>(TimingDetect, executor, 1000));
 }
 
+void HealthCheckExecutor::StartDetect(ServiceContext* service_context) {
+  HealthCheckerChain* health_checker_chain   = service_context->GetHealthCheckerChain();
+  CircuitBreakerChain* circuit_breaker_chain = service_context->GetCircuitBreakerChain();
+  HealthCheckerChainImpl* chain_impl = dynamic_cast<HealthCheckerChainImpl*>(health_checker_chain);
+  if (chain_impl == NULL) {  // 自定义探测链只能阻塞探测
+    health_checker_chain->DetectInstance(*circuit_breaker_chain);
+    service_context->DecrementRef();
+    return;
+  }
+  for (std::list<ServiceDetectPass*>::iterator it = detect_pass_list_.begin();
+       it != detect_pass_list_.end(); ++it) {
+    if ((*it)->GetServiceContext() == service_context) {  // 上一轮探测还未结束
+      service_context->DecrementRef();
+      return;
+    }
+  }
+  ServiceData* service_data = NULL;
+  std::vector<Instance*> detect_instances;
+  if (!chain_impl->PrepareDetect(service_data, detect_instances)) {
+    service_context->DecrementRef();
+    return;
+  }
+  detect_pass_list_.push_back(
+      new ServiceDetectPass(this, service_context, service_data, detect_instances));
+}
+
+void HealthCheckExecutor::OnInstanceDone() {
+  in_flight_--;
+  Schedule();
+}
+
+void HealthCheckExecutor::Schedule() {
+  if (scheduling_) {  // 同步完成的探测会重入，由外层循环继续调度
+    return;
+  }
+  scheduling_   = true;
+  bool progress = true;
+  while (progress) {
+    progress = false;
+    // 每个服务每次发起一个探测，避免单个服务占满探测数
+    std::list<ServiceDetectPass*>::iterator it = detect_pass_list_.begin();
+    while (it != detect_pass_list_.end()) {
+      ServiceDetectPass* detect_pass = *it;
+      if (in_flight_ < max_in_flight_ && detect_pass->CanStartNext()) {
+        in_flight_++;
+        detect_pass->StartNext();
+        progress = true;
+      }
+      if (detect_pass->IsFinished()) {
+        delete detect_pass;
+        it = detect_pass_list_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  scheduling_ = false;
+}
+
 }  // namespace polaris
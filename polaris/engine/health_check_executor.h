@@ -14,21 +14,90 @@
 #ifndef POLARIS_CPP_POLARIS_ENGINE_HEALTH_CHECK_EXECUTOR_H_
 #define POLARIS_CPP_POLARIS_ENGINE_HEALTH_CHECK_EXECUTOR_H_
 
+#include <list>
+#include <set>
+#include <vector>
+
 #include "engine/executor.h"
+#include "plugin/health_checker/probe_event.h"
 
 namespace polaris {
 
 class Context;
+class HealthCheckerChainImpl;
+class HealthCheckExecutor;
+class Instance;
+class ServiceContext;
+class ServiceData;
+class ServiceDetectPass;
+
+/// @brief 单个实例的探测，按探测插件顺序依次探测，直到有插件探测成功
+class InstanceDetect : public DetectCallback {
+public:
+  InstanceDetect(ServiceDetectPass* pass, Instance* instance);
+
+  virtual ~InstanceDetect();
+
+  // 使用下一个探测插件探测，不支持非阻塞探测的插件在当前线程阻塞探测
+  void DetectNext();
+
+  virtual void OnDetectDone(const DetectResult& detect_result);
+
+private:
+  // 处理一个插件的探测结果，返回实例探测是否已结束
+  bool HandleResult(const DetectResult& detect_result);
+
+private:
+  ServiceDetectPass* pass_;
+  Instance* instance_;
+  std::size_t checker_index_;
+  bool is_detect_success_;
+  ProbeEvent* probe_;  // 正在进行的非阻塞探测
+};
+
+/// @brief 服务的一轮探测，限制服务同时进行的探测数
+class ServiceDetectPass {
+public:
+  // 接管service_context和service_data的引用
+  ServiceDetectPass(HealthCheckExecutor* executor, ServiceContext* service_context,
+                    ServiceData* service_data, std::vector<Instance*>& detect_instances);
+
+  ~ServiceDetectPass();
+
+  bool CanStartNext() const;
 
-/// @brief 熔断任务执行者
+  void StartNext();
+
+  bool IsFinished() const { return next_index_ >= detect_instances_.size() && in_flight_ == 0; }
+
+  void OnInstanceDone(InstanceDetect* instance_detect, Instance* instance, bool is_detect_success);
+
+  HealthCheckerChainImpl* GetHealthCheckerChain() { return health_checker_chain_; }
+
+  ServiceContext* GetServiceContext() { return service_context_; }
+
+  Reactor& GetReactor();
+
+private:
+  HealthCheckExecutor* executor_;
+  ServiceContext* service_context_;
+  HealthCheckerChainImpl* health_checker_chain_;
+  ServiceData* service_data_;
+  std::vector<Instance*> detect_instances_;
+  std::size_t next_index_;
+  int in_flight_;
+  std::set<InstanceDetect*> detecting_set_;
+};
+
+/// @brief 健康探测任务执行者
 ///
 /// 执行如下任务：
-///   - 执行熔断任务
+///   - 定时检查各服务是否到达探测周期，在reactor中并发执行非阻塞探测
 class HealthCheckExecutor : public Executor {
 public:
   explicit HealthCheckExecutor(Context* context);
 
-  virtual ~HealthCheckExecutor() {}
+  virtual ~HealthCheckExecutor();
 
   // 获取线程名字
   virtual const char* GetName() { return "health_check"; }
@@ -36,6 +105,20 @@ public:
   virtual void SetupWork();
 
   static void TimingDetect(HealthCheckExecutor* executor);
+
+  // 服务发起一轮探测，接管service_context的引用
+  void StartDetect(ServiceContext* service_context);
+
+  void OnInstanceDone();
+
+  // 在限制的探测数内发起探测
+  void Schedule();
+
+private:
+  std::list<ServiceDetectPass*> detect_pass_list_;
+  int in_flight_;
+  int max_in_flight_;
+  bool scheduling_;
 };
 
 }  // namespace polaris
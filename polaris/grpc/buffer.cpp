@@ -13,10 +13,13 @@
 
 #include "grpc/buffer.h"
 
+#include <pthread.h>
+#include <stdlib.h>
 #include <sys/types.h>
 #include <sys/uio.h>
 
 #include <algorithm>
+#include <new>
 
 #include "logger.h"
 
@@ -69,31 +72,118 @@ uint64_t Slice::Append(const void* data, uint64_t size) {
   return copy_size;
 }
 
-Slice* Slice::Create(uint64_t capacity) {
-  uint64_t slice_capacity = SliceSize(capacity);
-  uint8_t* base           = new uint8_t[sizeof(Slice) + slice_capacity];
-  return new Slice(0, 0, slice_capacity, base + sizeof(Slice));
+// Slice按页分配，不超过16页的Slice按2的幂分成5个规格，释放后缓存在线程中复用
+static const uint64_t kSlicePageSize      = 4096;
+static const int kSliceClassCount         = 5;
+static const uint64_t kSliceCacheMaxBytes = 256 * 1024;  // 每个线程每个规格最多缓存的内存
+
+// 线程的Slice缓存，空闲Slice通过数据区域的首个指针串成链表
+struct SliceCache {
+  SliceCache() {
+    memset(free_list_, 0, sizeof(free_list_));
+    memset(free_count_, 0, sizeof(free_count_));
+  }
+
+  Slice* free_list_[kSliceClassCount];
+  uint64_t free_count_[kSliceClassCount];
+};
+
+static __thread SliceCache* thread_slice_cache = NULL;
+static pthread_key_t g_slice_cache_key;
+static pthread_once_t g_slice_cache_key_once = PTHREAD_ONCE_INIT;
+
+static Slice*& NextFreeSlice(Slice* slice) { return *reinterpret_cast<Slice**>(slice->Data()); }
+
+static void DeleteThreadSliceCache(void* ptr) {
+  SliceCache* slice_cache = static_cast<SliceCache*>(ptr);
+  if (thread_slice_cache == slice_cache) {
+    thread_slice_cache = NULL;
+  }
+  for (int i = 0; i < kSliceClassCount; ++i) {
+    while (slice_cache->free_list_[i] != NULL) {
+      Slice* slice               = slice_cache->free_list_[i];
+      slice_cache->free_list_[i] = NextFreeSlice(slice);
+      free(slice);  // Slice析构函数为空，直接释放内存
+    }
+  }
+  delete slice_cache;
+}
+
+static void CreateSliceCacheKey() {
+  int rc = pthread_key_create(&g_slice_cache_key, &DeleteThreadSliceCache);
+  POLARIS_ASSERT(rc == 0);
+}
+
+static SliceCache* GetThreadSliceCache() {
+  if (thread_slice_cache == NULL) {
+    pthread_once(&g_slice_cache_key_once, &CreateSliceCacheKey);
+    thread_slice_cache = new SliceCache();
+    pthread_setspecific(g_slice_cache_key, thread_slice_cache);  // 线程退出时释放
+  }
+  return thread_slice_cache;
+}
+
+// 根据页数计算规格，页数超过最大规格时返回-1
+static int SliceClass(uint64_t num_pages) {
+  int slice_class = 0;
+  while (slice_class < kSliceClassCount && (static_cast<uint64_t>(1) << slice_class) < num_pages) {
+    slice_class++;
+  }
+  return slice_class < kSliceClassCount ? slice_class : -1;
 }
 
+Slice* Slice::Create(uint64_t capacity) { return Allocate(capacity); }
+
 Slice* Slice::Create(const void* data, uint64_t size) {
-  uint64_t slice_capacity = SliceSize(size);
-  uint8_t* base           = new uint8_t[sizeof(Slice) + slice_capacity];
-  Slice* slice            = new Slice(0, 0, slice_capacity, base + sizeof(Slice));
+  Slice* slice = Allocate(size);
   memcpy(slice->base_, data, size);
   slice->reservable_ = size;
   return slice;
 }
 
 void Slice::Release() {
-  uint8_t* base = base_ - sizeof(Slice);
-  delete[] base;
-  delete this;
+  const uint64_t num_pages = (sizeof(Slice) + capacity_) / kSlicePageSize;
+  const int slice_class    = SliceClass(num_pages);
+  if (slice_class >= 0 && (static_cast<uint64_t>(1) << slice_class) == num_pages) {
+    SliceCache* slice_cache = GetThreadSliceCache();
+    if ((slice_cache->free_count_[slice_class] + 1) * num_pages * kSlicePageSize <=
+        kSliceCacheMaxBytes) {
+      data_                                = 0;
+      reservable_                          = 0;
+      NextFreeSlice(this)                  = slice_cache->free_list_[slice_class];
+      slice_cache->free_list_[slice_class] = this;
+      slice_cache->free_count_[slice_class]++;
+      return;
+    }
+  }
+  this->~Slice();
+  free(this);
 }
 
 uint64_t Slice::SliceSize(uint64_t data_size) {
-  static const uint64_t PageSize = 4096;
-  const uint64_t num_pages       = (sizeof(Slice) + data_size + PageSize - 1) / PageSize;
-  return num_pages * PageSize - sizeof(Slice);
+  uint64_t num_pages    = (sizeof(Slice) + data_size + kSlicePageSize - 1) / kSlicePageSize;
+  const int slice_class = SliceClass(num_pages);
+  if (slice_class >= 0) {
+    num_pages = static_cast<uint64_t>(1) << slice_class;
+  }
+  return num_pages * kSlicePageSize - sizeof(Slice);
+}
+
+Slice* Slice::Allocate(uint64_t data_size) {
+  const uint64_t slice_capacity = SliceSize(data_size);
+  const int slice_class         = SliceClass((sizeof(Slice) + slice_capacity) / kSlicePageSize);
+  if (slice_class >= 0) {
+    SliceCache* slice_cache = GetThreadSliceCache();
+    Slice* slice            = slice_cache->free_list_[slice_class];
+    if (slice != NULL) {
+      slice_cache->free_list_[slice_class] = NextFreeSlice(slice);
+      slice_cache->free_count_[slice_class]--;
+      return slice;
+    }
+  }
+  void* mem = malloc(sizeof(Slice) + slice_capacity);
+  POLARIS_ASSERT(mem != NULL);
+  return new (mem) Slice(0, 0, slice_capacity, static_cast<uint8_t*>(mem) + sizeof(Slice));
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -87,12 +87,16 @@ public:
   static Slice* Create(const void* data, uint64_t size);
 
   // 释放Slice，会释放自身内存，所以不需要调用析构函数
+  // 不超过16页的Slice放入当前线程的缓存中，由该线程后续创建Slice时复用
   void Release();
 
 private:
   // 计算用于存放指定长度的数据需要分配的Slice长度
   static uint64_t SliceSize(uint64_t data_size);
 
+  // 分配Slice，Slice对象和数据在同一块内存中，优先从线程缓存中获取
+  static Slice* Allocate(uint64_t data_size);
+
 private:
   uint64_t data_;        // 从Slice开始位置到数据区域的偏移
   uint64_t reservable_;  // 从Slice开始位置到保留区域的偏移
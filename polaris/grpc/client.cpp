@@ -53,7 +53,24 @@ bool GrpcStream::SendMessage(const google::protobuf::Message& request, bool end_
   if (remote_end_) {  // 如果远程已经关闭了则不能再发数据了，返回false给用户，不要再使用该对象
     return false;
   }
-  this->SendMessage(GrpcCodec::SerializeToGrpcFrame(request), end_stream);
+  POLARIS_ASSERT(http2_stream_ != NULL);
+  local_end_ = end_stream;
+  // 序列化到复用的frame_buffer_中，提交时数据移动到发送缓冲区
+  GrpcCodec::SerializeToGrpcFrame(request, frame_buffer_);
+  http2_stream_->SubmitData(frame_buffer_, end_stream);
+  return true;
+}
+
+bool GrpcStream::SendMessages(const std::vector<google::protobuf::Message*>& requests) {
+  POLARIS_ASSERT(local_end_ == false);
+  if (remote_end_) {
+    return false;
+  }
+  POLARIS_ASSERT(http2_stream_ != NULL);
+  for (std::size_t i = 0; i < requests.size(); ++i) {
+    GrpcCodec::SerializeToGrpcFrame(*requests[i], frame_buffer_);  // 多个消息连续写入同一Slice
+  }
+  http2_stream_->SubmitData(frame_buffer_, false);
   return true;
 }
 
@@ -106,26 +123,28 @@ void GrpcStream::OnHeaders(HeaderMap* headers, bool end_stream) {
 }
 
 void GrpcStream::OnData(Buffer& data, bool end_stream) {
-  decoded_messages_.clear();
   if (!grpc_decoder_.Decode(data, decoded_messages_)) {
+    GrpcDecoder::FreeMessages(decoded_messages_);
     http2_client_->ResetAllStream(kGrpcStatusInternal,
                                   "decode http2 data frame to grpc data error");
     return;
   }
 
   for (std::size_t i = 0; i < decoded_messages_.size(); ++i) {
-    LengthPrefixedMessage& frame = decoded_messages_[i];
-    if (frame.length_ > 0 && frame.flags_ != GRPC_FH_DEFAULT) {
+    LengthPrefixedMessage* frame = decoded_messages_[i];
+    if (frame->length_ > 0 && frame->flags_ != GRPC_FH_DEFAULT) {
+      GrpcDecoder::FreeMessages(decoded_messages_);
       http2_client_->ResetAllStream(kGrpcStatusInternal, "decode grpc data header error");
       return;
     }
-    if (!callback_.OnReceiveMessage(frame.data_ ? frame.data_ : new Buffer())) {
+    Buffer* frame_data = frame->ReleaseData();
+    if (!callback_.OnReceiveMessage(frame_data ? frame_data : new Buffer())) {
+      GrpcDecoder::FreeMessages(decoded_messages_);
       http2_client_->ResetAllStream(kGrpcStatusInternal, "decode grpc data to pb message error");
-      frame.data_ = NULL;
       return;
     }
-    frame.data_ = NULL;
   }
+  GrpcDecoder::FreeMessages(decoded_messages_);
   if (end_stream) {
     callback_.OnRemoteClose(kGrpcStatusOk, "end stream with data frame");
     remote_end_ = true;
@@ -94,7 +94,7 @@ public:
   virtual ~StreamCallback() {}
   virtual void OnReceiveMessage(Response *message) = 0;
 
-private:
+protected:
   virtual bool OnReceiveMessage(Buffer *response) {
     Response *message = new Response();
     if (GrpcCodec::ParseBufferToMessage(response, *message)) {
@@ -141,6 +141,8 @@ public:
 
   // 向Stream发送消息，如果是最后一个消息，设置end_stream为false触发本地关闭，关闭后不再调用Stream的接口
   bool SendMessage(const google::protobuf::Message &request, bool end_stream);
+  // 向Stream批量发送消息，多个消息合并后一次提交，减少小帧和写操作
+  bool SendMessages(const std::vector<google::protobuf::Message *> &requests);
   // 直接触发Stream本地关闭，本地流关闭后不再主动调用流上的接口，回调可继续触发
   void SendEndStream();
 
@@ -172,7 +174,8 @@ protected:
   GrpcStreamCallback &callback_;
 
   GrpcDecoder grpc_decoder_;
-  std::vector<LengthPrefixedMessage> decoded_messages_;
+  std::vector<LengthPrefixedMessage*> decoded_messages_;
+  Buffer frame_buffer_;  // 复用的消息序列化缓冲区，提交后数据移动到流的发送缓冲区
 
   bool local_end_;  // 本地流以发送结束标志，结束后不能再发请求，该标记只用于检查
   bool remote_end_;  // 远端流是否结束，结束后，再发请求也不会应答，直接返回
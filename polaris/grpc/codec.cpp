@@ -27,12 +27,17 @@ namespace polaris {
 namespace grpc {
 
 Buffer* GrpcCodec::SerializeToGrpcFrame(const google::protobuf::Message& message) {
+  Buffer* body = new Buffer();
+  SerializeToGrpcFrame(message, *body);
+  return body;
+}
+
+void GrpcCodec::SerializeToGrpcFrame(const google::protobuf::Message& message, Buffer& output) {
   // Reserve enough space for the entire message and the 5 byte header.
-  Buffer* body            = new Buffer();
   const size_t size       = message.ByteSizeLong();
   const size_t alloc_size = size + 5;
   RawSlice iovec;
-  body->Reserve(alloc_size, &iovec, 1);
+  output.Reserve(alloc_size, &iovec, 1);
   POLARIS_ASSERT(iovec.len_ >= alloc_size);
   iovec.len_                  = alloc_size;
   uint8_t* current            = reinterpret_cast<uint8_t*>(iovec.mem_);
@@ -43,8 +48,7 @@ Buffer* GrpcCodec::SerializeToGrpcFrame(const google::protobuf::Message& message
   google::protobuf::io::ArrayOutputStream stream(current, size, -1);
   google::protobuf::io::CodedOutputStream codec_stream(&stream);
   message.SerializeWithCachedSizes(&codec_stream);
-  body->Commit(&iovec, 1);
-  return body;
+  output.Commit(&iovec, 1);
 }
 
 bool GrpcCodec::ParseBufferToMessage(Buffer* buffer, google::protobuf::Message& message) {
@@ -52,15 +56,23 @@ bool GrpcCodec::ParseBufferToMessage(Buffer* buffer, google::protobuf::Message&
   return message.ParseFromZeroCopyStream(&stream);
 }
 
-GrpcDecoder::GrpcDecoder() : state_(kStateFH_FLAG) {}
+GrpcDecoder::GrpcDecoder() : state_(kStateFH_FLAG), decoding_msg_(NULL) {}
 
-void GrpcDecoder::ResetDecodingMsg() {
-  decoding_msg_.flags_  = 0;
-  decoding_msg_.length_ = 0;
-  decoding_msg_.data_   = NULL;
+GrpcDecoder::~GrpcDecoder() {
+  if (decoding_msg_ != NULL) {
+    delete decoding_msg_;
+    decoding_msg_ = NULL;
+  }
 }
 
-bool GrpcDecoder::Decode(Buffer& input, std::vector<LengthPrefixedMessage>& output) {
+void GrpcDecoder::FreeMessages(std::vector<LengthPrefixedMessage*>& messages) {
+  for (std::size_t i = 0; i < messages.size(); ++i) {
+    delete messages[i];
+  }
+  messages.clear();
+}
+
+bool GrpcDecoder::Decode(Buffer& input, std::vector<LengthPrefixedMessage*>& output) {
   uint64_t count   = input.GetRawSlices(NULL, 0);
   RawSlice* slices = new RawSlice[count];
   input.GetRawSlices(slices, count);
@@ -75,58 +87,61 @@ bool GrpcDecoder::Decode(Buffer& input, std::vector<LengthPrefixedMessage>& outp
             delete[] slices;
             return false;
           }
-          decoding_msg_.flags_ = c;
-          state_               = kStateFH_LEN_0;
+          if (decoding_msg_ == NULL) {
+            decoding_msg_ = new LengthPrefixedMessage();
+          }
+          decoding_msg_->flags_ = c;
+          state_                = kStateFH_LEN_0;
           mem++;
           j++;
           break;
         case kStateFH_LEN_0:
-          decoding_msg_.length_ = static_cast<uint32_t>(c) << 24;
-          state_                = kStateFH_LEN_1;
+          decoding_msg_->length_ = static_cast<uint32_t>(c) << 24;
+          state_                 = kStateFH_LEN_1;
           mem++;
           j++;
           break;
         case kStateFH_LEN_1:
-          decoding_msg_.length_ |= static_cast<uint32_t>(c) << 16;
+          decoding_msg_->length_ |= static_cast<uint32_t>(c) << 16;
           state_ = kStateFH_LEN_2;
           mem++;
           j++;
           break;
         case kStateFH_LEN_2:
-          decoding_msg_.length_ |= static_cast<uint32_t>(c) << 8;
+          decoding_msg_->length_ |= static_cast<uint32_t>(c) << 8;
           state_ = kStateFH_LEN_3;
           mem++;
           j++;
           break;
         case kStateFH_LEN_3:
-          decoding_msg_.length_ |= static_cast<uint32_t>(c);
-          if (decoding_msg_.length_ == 0) {
+          decoding_msg_->length_ |= static_cast<uint32_t>(c);
+          if (decoding_msg_->length_ == 0) {
             output.push_back(decoding_msg_);
-            this->ResetDecodingMsg();
-            state_ = kStateFH_FLAG;
+            decoding_msg_ = NULL;
+            state_        = kStateFH_FLAG;
           } else {
-            decoding_msg_.data_ = new Buffer();
-            state_              = kStateDATA;
+            decoding_msg_->data_ = new Buffer();
+            state_               = kStateDATA;
           }
           mem++;
           j++;
           break;
         case kStateDATA:
           uint64_t remain_in_buffer = slice.len_ - j;
-          uint64_t remain_in_frame  = decoding_msg_.length_ - decoding_msg_.data_->Length();
+          uint64_t remain_in_frame  = decoding_msg_->length_ - decoding_msg_->data_->Length();
           if (remain_in_buffer <= remain_in_frame) {
-            decoding_msg_.data_->Add(mem, remain_in_buffer);
+            decoding_msg_->data_->Add(mem, remain_in_buffer);
             mem += remain_in_buffer;
             j += remain_in_buffer;
           } else {
-            decoding_msg_.data_->Add(mem, remain_in_frame);
+            decoding_msg_->data_->Add(mem, remain_in_frame);
             mem += remain_in_frame;
             j += remain_in_frame;
           }
-          if (decoding_msg_.length_ == decoding_msg_.data_->Length()) {
+          if (decoding_msg_->length_ == decoding_msg_->data_->Length()) {
             output.push_back(decoding_msg_);
-            this->ResetDecodingMsg();
-            state_ = kStateFH_FLAG;
+            decoding_msg_ = NULL;
+            state_        = kStateFH_FLAG;
           }
           break;
       }
@@ -22,6 +22,7 @@
 #include <google/protobuf/message.h>
 
 #include "grpc/buffer.h"
+#include "polaris/noncopyable.h"
 
 namespace polaris {
 namespace grpc {
@@ -33,6 +34,9 @@ public:
   // 将PB序列化成Grpc格式，包括1字节压缩标记和4字节长度
   static Buffer* SerializeToGrpcFrame(const google::protobuf::Message& message);
 
+  // 将PB序列化成Grpc格式并追加到output末尾，可复用output剩余的空间
+  static void SerializeToGrpcFrame(const google::protobuf::Message& message, Buffer& output);
+
   // 从Buffer反序列化出PB格式message，并返回序列化结果。不管是否序列化成功，buffer都会被释放
   // buffer中的数据已经去掉了1字节压缩标记和4字节长度
   static bool ParseBufferToMessage(Buffer* buffer, google::protobuf::Message& message);
@@ -42,7 +46,7 @@ const uint8_t GRPC_FH_DEFAULT    = 0x0u;  // 表示消息未压缩
 const uint8_t GRPC_FH_COMPRESSED = 0x1u;  // 表示使用Header中的Message-Encoding值进行压缩
 
 // Length-Prefixed-Message 反序列化出5字节前缀后的数据
-struct LengthPrefixedMessage {
+struct LengthPrefixedMessage : Noncopyable {
   LengthPrefixedMessage() : flags_(0), length_(0), data_(NULL) {}
   ~LengthPrefixedMessage() {
     if (data_ != NULL) {
@@ -51,6 +55,13 @@ struct LengthPrefixedMessage {
     }
   }
 
+  // 转移data_的所有权给调用者
+  Buffer* ReleaseData() {
+    Buffer* data = data_;
+    data_        = NULL;
+    return data;
+  }
+
   uint8_t flags_;    // 压缩标记
   uint32_t length_;  // 长度
   Buffer* data_;     // 反序列完成压缩标记和长度后剩余用于反序列PB的数据
@@ -61,11 +72,16 @@ class GrpcDecoder {
 public:
   GrpcDecoder();
 
+  ~GrpcDecoder();
+
   // 从Buffer中已LengthPrefixedMessage解码Grpc消息
   // 如果压缩标记有问题，则返回false
-  // 对于完整解码的消息，增加到output中
+  // 对于完整解码的消息，增加到output中，由调用者使用FreeMessages释放
   // 对于未完整解码的部分，则保留在decoding_msg_中，调用次方法可继续解码
-  bool Decode(Buffer& input, std::vector<LengthPrefixedMessage>& output);
+  bool Decode(Buffer& input, std::vector<LengthPrefixedMessage*>& output);
+
+  // 释放解码出的消息并清空列表
+  static void FreeMessages(std::vector<LengthPrefixedMessage*>& messages);
 
 private:
   enum State {
@@ -77,10 +93,8 @@ private:
     kStateDATA,      // 等待解码数据内容
   };
 
-  void ResetDecodingMsg();  // 重置decoding_msg_
-
-  State state_;                         // 解码状态
-  LengthPrefixedMessage decoding_msg_;  // 正在解码消息
+  State state_;                          // 解码状态
+  LengthPrefixedMessage* decoding_msg_;  // 正在解码消息
 };
 
 }  // namespace grpc
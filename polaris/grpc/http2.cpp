@@ -273,12 +273,16 @@ int Http2Stream::OnDataSourceSend(const uint8_t* frame_hd, size_t length) {
 }
 
 void Http2Stream::SubmitData(Buffer* data, bool end_stream) {
+  SubmitData(*data, end_stream);
+  delete data;
+}
+
+void Http2Stream::SubmitData(Buffer& data, bool end_stream) {
   GRPC_LOG(LOG_TRACE, "connection[%s] fd[%d] stream[%d] submit data size=%u",
-           client_.current_server_.c_str(), client_.fd_, stream_id_, data->Length());
+           client_.current_server_.c_str(), client_.fd_, stream_id_, data.Length());
   POLARIS_ASSERT(!local_end_stream_);
   local_end_stream_ = end_stream;
-  pending_send_data_->Move(*data, data->Length());
-  delete data;
+  pending_send_data_->Move(data);
   if (data_deferred_) {
     int rc = nghttp2_session_resume_data(client_.session_, stream_id_);
     POLARIS_ASSERT(rc == 0);
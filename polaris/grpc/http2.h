@@ -112,6 +112,7 @@ public:
   void SubmitHeaders(HeaderMap* headers);          // 连接未建立则设置pending状态待发送
   void SendPendingHeader();                        // 用于连接成功后的发送缓存的HEADERS
   void SubmitData(Buffer* data, bool end_stream);  // 保存数据到pending_send_data
+  void SubmitData(Buffer& data, bool end_stream);  // 移动数据到pending_send_data，data可复用
 
   void SaveRecvHeader(HeaderEntry* header_entry);
 
@@ -30,9 +30,11 @@
 #include <v1/routing.pb.h>
 #include <v1/service.pb.h>
 
+#include <algorithm>
 #include <iosfwd>
 #include <map>
 #include <memory>
+#include <new>
 #include <set>
 #include <string>
 #include <utility>
@@ -284,6 +286,25 @@ uint64_t ServiceBase::DecrementAndGetRef() {
 }
 
 ///////////////////////////////////////////////////////////////////////////////
+InstancesSetImpl::~InstancesSetImpl() {
+  delete weighted_random_selector_.Load();
+  for (std::list<std::pair<uint64_t, Selector*> >::iterator it = retired_selectors_.begin();
+       it != retired_selectors_.end(); ++it) {
+    delete it->second;
+  }
+}
+
+void InstancesSetImpl::ReplaceWeightedRandomSelector(Selector* selector, uint64_t min_gc_time) {
+  while (!retired_selectors_.empty() && retired_selectors_.front().first < min_gc_time) {
+    delete retired_selectors_.front().second;
+    retired_selectors_.pop_front();
+  }
+  Selector* old_selector = weighted_random_selector_.Exchange(selector);
+  if (old_selector != NULL) {
+    retired_selectors_.push_back(std::make_pair(Time::GetCurrentTimeMs(), old_selector));
+  }
+}
+
 InstancesSet::InstancesSet(const std::vector<Instance*>& instances) {
   impl_ = new InstancesSetImpl(instances);
 }
@@ -430,6 +451,96 @@ const std::set<std::string>& ServiceRouteRule::GetKeys() const {
 
 ServiceData* ServiceRouteRule::GetServiceData() { return service_data_; }
 
+static const int kRouteObjectCacheSize = 64;
+
+// 线程本地缓存的对象内存，按对象类型分开缓存
+struct RouteObjectFreeList {
+  void* instances_[kRouteObjectCacheSize];
+  int instances_count_;
+  void* route_rules_[kRouteObjectCacheSize];
+  int route_rules_count_;
+};
+
+static __thread RouteObjectFreeList* thread_local_route_objects = NULL;
+static pthread_key_t g_route_objects_key;
+static pthread_once_t g_route_objects_key_once = PTHREAD_ONCE_INIT;
+
+static void DeleteRouteObjectFreeList(void* ptr) {
+  RouteObjectFreeList* free_list = static_cast<RouteObjectFreeList*>(ptr);
+  if (thread_local_route_objects == free_list) {
+    thread_local_route_objects = NULL;
+  }
+  for (int i = 0; i < free_list->instances_count_; ++i) {
+    ::operator delete(free_list->instances_[i]);
+  }
+  for (int i = 0; i < free_list->route_rules_count_; ++i) {
+    ::operator delete(free_list->route_rules_[i]);
+  }
+  delete free_list;
+}
+
+static void CreateRouteObjectsKey() {
+  int rc = pthread_key_create(&g_route_objects_key, &DeleteRouteObjectFreeList);
+  POLARIS_ASSERT(rc == 0);
+}
+
+static RouteObjectFreeList* GetRouteObjectFreeList() {
+  if (thread_local_route_objects == NULL) {
+    pthread_once(&g_route_objects_key_once, &CreateRouteObjectsKey);
+    thread_local_route_objects = new RouteObjectFreeList();
+    pthread_setspecific(g_route_objects_key, thread_local_route_objects);  // 线程退出时释放
+  }
+  return thread_local_route_objects;
+}
+
+static void* AllocateRouteObject(void** blocks, int& count, std::size_t size) {
+  if (count > 0) {
+    return blocks[--count];
+  }
+  return ::operator new(size);
+}
+
+static void DeallocateRouteObject(void** blocks, int& count, void* ptr) {
+  if (count < kRouteObjectCacheSize) {
+    blocks[count++] = ptr;
+  } else {
+    ::operator delete(ptr);
+  }
+}
+
+ServiceInstances* RouteObjectCache::NewServiceInstances(ServiceData* service_data) {
+  RouteObjectFreeList* free_list = GetRouteObjectFreeList();
+  void* ptr = AllocateRouteObject(free_list->instances_, free_list->instances_count_,
+                                  sizeof(ServiceInstances));
+  return new (ptr) ServiceInstances(service_data);
+}
+
+void RouteObjectCache::DeleteServiceInstances(ServiceInstances* service_instances) {
+  if (service_instances == NULL) {
+    return;
+  }
+  service_instances->~ServiceInstances();
+  RouteObjectFreeList* free_list = GetRouteObjectFreeList();
+  DeallocateRouteObject(free_list->instances_, free_list->instances_count_, service_instances);
+}
+
+ServiceRouteRule* RouteObjectCache::NewServiceRouteRule(ServiceData* service_data) {
+  RouteObjectFreeList* free_list = GetRouteObjectFreeList();
+  void* ptr = AllocateRouteObject(free_list->route_rules_, free_list->route_rules_count_,
+                                  sizeof(ServiceRouteRule));
+  return new (ptr) ServiceRouteRule(service_data);
+}
+
+void RouteObjectCache::DeleteServiceRouteRule(ServiceRouteRule* service_route_rule) {
+  if (service_route_rule == NULL) {
+    return;
+  }
+  service_route_rule->~ServiceRouteRule();
+  RouteObjectFreeList* free_list = GetRouteObjectFreeList();
+  DeallocateRouteObject(free_list->route_rules_, free_list->route_rules_count_,
+                        service_route_rule);
+}
+
 void ServiceDataImpl::ParseInstancesData(v1::DiscoverResponse& response) {
   data_.instances_                  = new InstancesData();
   const ::v1::Service& resp_service = response.service();
@@ -526,8 +637,77 @@ void ServiceDataImpl::ParseInstancesData(v1::DiscoverResponse& response) {
     }
   }
   data_.instances_->instances_map_.swap(instanceMap);
-  revision_                    = resp_service.revision().value();
-  data_.instances_->instances_ = new InstancesSet(instances);
+  revision_                              = resp_service.revision().value();
+  data_.instances_->instances_           = new InstancesSet(instances);
+  data_.instances_->available_unchanged_ = false;
+}
+
+// 只比较服务端下发的实例属性，不比较本地计算的数据
+static bool IsSameInstance(Instance& lhs, Instance& rhs) {
+  return lhs.GetPort() == rhs.GetPort() && lhs.GetWeight() == rhs.GetWeight() &&
+         lhs.GetPriority() == rhs.GetPriority() && lhs.isHealthy() == rhs.isHealthy() &&
+         lhs.isIsolate() == rhs.isIsolate() && lhs.GetHash() == rhs.GetHash() &&
+         lhs.GetHost() == rhs.GetHost() && lhs.GetVpcId() == rhs.GetVpcId() &&
+         lhs.GetProtocol() == rhs.GetProtocol() && lhs.GetVersion() == rhs.GetVersion() &&
+         lhs.GetLogicSet() == rhs.GetLogicSet() && lhs.GetRegion() == rhs.GetRegion() &&
+         lhs.GetZone() == rhs.GetZone() && lhs.GetCampus() == rhs.GetCampus() &&
+         lhs.GetMetadata() == rhs.GetMetadata();
+}
+
+void ServiceDataImpl::DiffInstancesData(ServiceDataImpl* old_data) {
+  InstancesData* new_instances = data_.instances_;
+  InstancesData* old_instances = old_data->data_.instances_;
+  std::map<std::string, Instance*> old_instance_map(old_instances->instances_map_);
+  for (std::set<Instance*>::iterator it = old_instances->isolate_instances_.begin();
+       it != old_instances->isolate_instances_.end(); ++it) {
+    old_instance_map[(*it)->GetId()] = *it;
+  }
+  std::vector<Instance*> all_instances;
+  all_instances.reserve(new_instances->instances_map_.size() +
+                        new_instances->isolate_instances_.size());
+  for (std::map<std::string, Instance*>::iterator it = new_instances->instances_map_.begin();
+       it != new_instances->instances_map_.end(); ++it) {
+    all_instances.push_back(it->second);
+  }
+  all_instances.insert(all_instances.end(), new_instances->isolate_instances_.begin(),
+                       new_instances->isolate_instances_.end());
+
+  // 可用实例数相同，且可用实例都未变化时，可用实例集合与上一版本相同。前面的实例为可用实例
+  bool available_unchanged =
+      new_instances->instances_map_.size() == old_instances->instances_map_.size();
+  for (std::size_t i = 0; i < all_instances.size(); ++i) {
+    Instance* instance = all_instances[i];
+    std::map<std::string, Instance*>::iterator old_it = old_instance_map.find(instance->GetId());
+    bool is_available = i < new_instances->instances_map_.size();
+    if (old_it == old_instance_map.end()) {
+      new_instances->added_instances_.push_back(instance);
+      available_unchanged = available_unchanged && !is_available;
+      continue;
+    }
+    // 本地数据只与实例ID相关，ID相同即可复用
+    InstanceSetter instance_setter(*instance);
+    instance_setter.CopyLocalValue(InstanceSetter(*old_it->second));
+    if (!IsSameInstance(*instance, *old_it->second)) {
+      new_instances->changed_instances_.push_back(instance);
+      available_unchanged = available_unchanged && !is_available &&
+                            old_instances->instances_map_.count(instance->GetId()) == 0;
+    }
+    old_instance_map.erase(old_it);
+  }
+  for (std::map<std::string, Instance*>::iterator it = old_instance_map.begin();
+       it != old_instance_map.end(); ++it) {
+    new_instances->deleted_instance_ids_.push_back(it->first);
+    available_unchanged =
+        available_unchanged && old_instances->instances_map_.count(it->first) == 0;
+  }
+  new_instances->available_unchanged_ = available_unchanged;
+  POLARIS_LOG(LOG_DEBUG,
+              "service[%s/%s] instances revision[%s] to [%s] with %zu added, %zu changed, %zu "
+              "deleted",
+              service_key_.namespace_.c_str(), service_key_.name_.c_str(),
+              old_data->revision_.c_str(), revision_.c_str(),
+              new_instances->added_instances_.size(), new_instances->changed_instances_.size(),
+              new_instances->deleted_instance_ids_.size());
 }
 
 uint64_t ServiceDataImpl::HandleHashConflict(const std::map<uint64_t, Instance*>& hashMap,
@@ -646,13 +826,43 @@ void ServiceDataImpl::ParseCircuitBreaker(v1::DiscoverResponse& response) {
   service_key_.namespace_      = service.namespace_().value();
   service_key_.name_           = service.name().value();
   revision_                    = service.revision().value();
-  data_.circuitBreaker_        = response.release_circuitbreaker();
+  data_.circuitBreaker_        = new v1::CircuitBreaker(response.circuitbreaker());
+}
+
+void SharedDiscoverResponse::ToJson(std::string& json_content) const {
+  google::protobuf::util::MessageToJsonString(*response_, &json_content);
+}
+
+SharedDiscoverResponse* ServiceDataImpl::GetPersistContent(std::string& content) {
+  sync::MutexGuard mutex_guard(json_lock_);
+  if (pb_response_ == NULL) {
+    content = json_content_;
+    return NULL;
+  }
+  pb_response_->IncrementRef();
+  return pb_response_;
+}
+
+ServiceData* ServiceDataImpl::CreateFromPb(v1::DiscoverResponse* response,
+                                           ServiceDataStatus data_status, uint64_t cache_version) {
+  ServiceData* service_data =
+      ServiceData::CreateFromPbJson(response, "", data_status, cache_version);
+  if (service_data == NULL) {
+    delete response;
+    return NULL;
+  }
+  service_data->impl_->pb_response_ = new SharedDiscoverResponse(response);
+  return service_data;
 }
 
+static uint64_t g_service_data_id = 0;
+
 ServiceData::ServiceData(ServiceDataType data_type) {
   impl_             = new ServiceDataImpl();
+  impl_->data_id_   = ATOMIC_ADD_THEN_GET(&g_service_data_id, 1);
   impl_->data_type_ = data_type;
   impl_->service_   = NULL;
+  impl_->pb_response_ = NULL;
 }
 
 ServiceData::~ServiceData() {
@@ -666,6 +876,9 @@ ServiceData::~ServiceData() {
     } else if (impl_->data_type_ == kCircuitBreakerConfig) {
       delete impl_->data_.circuitBreaker_;
     }
+    if (impl_->pb_response_ != NULL) {
+      impl_->pb_response_->DecrementRef();
+    }
     delete impl_;
   }
 }
@@ -689,18 +902,17 @@ ServiceData* ServiceData::CreateFromJson(const std::string& content, ServiceData
 
 ServiceData* ServiceData::CreateFromPb(void* content, ServiceDataStatus data_status,
                                        uint64_t cache_version) {
-  // response 由调用者释放
+  // response由调用者释放，复制一份在持久化或打印时才转换成json
   v1::DiscoverResponse* response = reinterpret_cast<v1::DiscoverResponse*>(content);
-  std::string json_content;
-  google::protobuf::util::MessageToJsonString(*response, &json_content);
-  return CreateFromPbJson(content, json_content, data_status, cache_version);
+  return ServiceDataImpl::CreateFromPb(new v1::DiscoverResponse(*response), data_status,
+                                       cache_version);
 }
 
 ServiceData* ServiceData::CreateFromPbJson(void* pb_content, const std::string& json_content,
                                            ServiceDataStatus data_status, uint64_t cache_version) {
   // response 由调用者释放
   v1::DiscoverResponse* response = reinterpret_cast<v1::DiscoverResponse*>(pb_content);
-  ServiceData* service_data      = NULL;
+  ServiceData* service_data = NULL;
   if (response->type() == v1::DiscoverResponse::INSTANCE) {
     service_data = new ServiceData(kServiceDataInstances);
     service_data->impl_->ParseInstancesData(*response);
@@ -718,7 +930,10 @@ ServiceData* ServiceData::CreateFromPbJson(void* pb_content, const std::string&
                 response->ShortDebugString().c_str());
     return NULL;
   }
-  service_data->impl_->json_content_   = json_content;
+  if (!json_content.empty()) {
+    service_data->impl_->json_content_ = json_content;
+    service_data->impl_->json_ready_.Store(true);
+  }
   service_data->impl_->data_status_    = data_status;
   service_data->impl_->cache_version_  = cache_version;
   service_data->impl_->available_time_ = 0;
@@ -739,7 +954,20 @@ ServiceDataStatus ServiceData::GetDataStatus() { return impl_->data_status_; }
 
 Service* ServiceData::GetService() { return impl_->service_; }
 
-const std::string& ServiceData::ToJsonString() { return impl_->json_content_; }
+const std::string& ServiceData::ToJsonString() {
+  if (!impl_->json_ready_.Load()) {
+    sync::MutexGuard mutex_guard(impl_->json_lock_);
+    if (!impl_->json_ready_.Load()) {
+      if (impl_->pb_response_ != NULL) {  // 生成json后不再保留原始数据
+        impl_->pb_response_->ToJson(impl_->json_content_);
+        impl_->pb_response_->DecrementRef();
+        impl_->pb_response_ = NULL;
+      }
+      impl_->json_ready_.Store(true);
+    }
+  }
+  return impl_->json_content_;
+}
 
 ServiceDataImpl* ServiceData::GetServiceDataImpl() { return impl_; }
 
@@ -873,6 +1101,8 @@ ServiceImpl::ServiceImpl(const ServiceKey& service_key, uint32_t service_id)
     : service_key_(service_key), service_id_(service_id), instance_next_id_(0) {
   pthread_rwlock_init(&circuit_breaker_data_lock_, NULL);
   circuit_breaker_data_version_ = 0;
+  instances_data_               = NULL;
+  circuit_breaker_snapshot_.Store(new CircuitBreakerSnapshot());
 
   have_half_open_data_ = false;
 
@@ -884,6 +1114,12 @@ ServiceImpl::ServiceImpl(const ServiceKey& service_key, uint32_t service_id)
 }
 
 ServiceImpl::~ServiceImpl() {
+  delete circuit_breaker_snapshot_.Load();
+  while (!retired_snapshots_.empty()) {
+    delete retired_snapshots_.front();
+    retired_snapshots_.pop_front();
+  }
+  instances_data_ = NULL;
   pthread_rwlock_destroy(&circuit_breaker_data_lock_);
   pthread_rwlock_destroy(&sets_circuit_breaker_data_lock_);
 }
@@ -919,6 +1155,77 @@ void ServiceImpl::UpdateInstanceId(ServiceData* service_data) {
   instance_id_map_.swap(new_instance_id_map);
 }
 
+void ServiceImpl::UpdateCircuitBreakerSnapshot(ServiceData* instances_data) {
+  CircuitBreakerSnapshot* snapshot = new CircuitBreakerSnapshot();
+  pthread_rwlock_rdlock(&circuit_breaker_data_lock_);
+  snapshot->version_           = circuit_breaker_data_version_;
+  snapshot->open_instance_ids_ = open_instances_;
+  pthread_rwlock_unlock(&circuit_breaker_data_lock_);
+  if (instances_data != NULL) {
+    snapshot->service_data_    = instances_data;
+    snapshot->service_data_id_ = instances_data->GetServiceDataImpl()->GetDataId();
+  }
+  if (instances_data != NULL && !snapshot->open_instance_ids_.empty()) {
+    InstancesData* data = instances_data->GetServiceDataImpl()->GetInstancesData();
+    std::map<std::string, Instance*>& instances = data->instances_map_;
+    for (std::set<std::string>::iterator it = snapshot->open_instance_ids_.begin();
+         it != snapshot->open_instance_ids_.end(); ++it) {
+      std::map<std::string, Instance*>::iterator instance_it = instances.find(*it);
+      if (instance_it != instances.end()) {
+        snapshot->open_instances_.insert(instance_it->second);
+      }
+    }
+    snapshot->excluded_instances_ = data->unhealthy_instances_;
+    snapshot->excluded_instances_.insert(snapshot->open_instances_.begin(),
+                                         snapshot->open_instances_.end());
+  }
+
+  CircuitBreakerSnapshot* old_snapshot = circuit_breaker_snapshot_.Exchange(snapshot);
+  old_snapshot->retire_time_           = Time::GetCurrentTimeMs();
+  retired_snapshots_.push_back(old_snapshot);
+}
+
+CircuitBreakerSnapshot* ServiceImpl::GetCircuitBreakerSnapshot(ServiceData* instances_data) {
+  CircuitBreakerSnapshot* snapshot = circuit_breaker_snapshot_.Load();
+  if (instances_data == NULL || snapshot->open_instance_ids_.empty() ||
+      snapshot->IsBoundTo(instances_data)) {
+    return snapshot;
+  }
+  // 读取方持有服务实例数据的引用，且该数据为服务当前数据时，生成与其绑定的快照
+  sync::MutexGuard mutex_guard(snapshot_lock_);
+  if (instances_data == instances_data_) {
+    snapshot = circuit_breaker_snapshot_.Load();
+    if (!snapshot->IsBoundTo(instances_data)) {
+      UpdateCircuitBreakerSnapshot(instances_data);
+      snapshot = circuit_breaker_snapshot_.Load();
+    }
+  }
+  return snapshot;
+}
+
+void ServiceImpl::CheckGc(uint64_t min_gc_time) {
+  sync::MutexGuard mutex_guard(snapshot_lock_);
+  while (!retired_snapshots_.empty() && retired_snapshots_.front()->retire_time_ < min_gc_time) {
+    delete retired_snapshots_.front();
+    retired_snapshots_.pop_front();
+  }
+}
+
+bool CircuitBreakerSnapshot::IsBoundTo(ServiceData* service_data) const {
+  return service_data != NULL && service_data == service_data_ &&
+         service_data->GetServiceDataImpl()->GetDataId() == service_data_id_;
+}
+
+bool CircuitBreakerSnapshot::IsOpen(Instance* instance, ServiceData* service_data) const {
+  if (open_instance_ids_.empty()) {
+    return false;
+  }
+  if (IsBoundTo(service_data)) {
+    return open_instances_.find(instance) != open_instances_.end();
+  }
+  return open_instance_ids_.find(instance->GetId()) != open_instance_ids_.end();
+}
+
 Service::Service(const ServiceKey& service_key, uint32_t service_id) {
   impl_ = new ServiceImpl(service_key, service_id);
 }
@@ -932,12 +1239,21 @@ Service::~Service() {
 
 ServiceKey& Service::GetServiceKey() { return impl_->service_key_; }
 
+ServiceImpl* Service::GetServiceImpl() { return impl_; }
+
 void Service::UpdateData(ServiceData* service_data) {
   if (service_data != NULL) {
     if (service_data->GetDataType() == kServiceDataInstances) {
       impl_->UpdateInstanceId(service_data);
+      sync::MutexGuard mutex_guard(impl_->snapshot_lock_);
+      impl_->instances_data_ = service_data;
+      impl_->UpdateCircuitBreakerSnapshot(service_data);
     }
     service_data->GetServiceDataImpl()->service_ = this;
+  } else {  // 无法区分数据类型，解除快照与服务实例数据的绑定
+    sync::MutexGuard mutex_guard(impl_->snapshot_lock_);
+    impl_->instances_data_ = NULL;
+    impl_->UpdateCircuitBreakerSnapshot(NULL);
   }
 }
 
@@ -977,6 +1293,9 @@ void Service::SetCircuitBreakerData(const CircuitBreakerData& circuit_breaker_da
     impl_->circuit_breaker_data_version_ = circuit_breaker_data.version;
   }
   pthread_rwlock_unlock(&impl_->circuit_breaker_data_lock_);
+  impl_->snapshot_lock_.Lock();
+  impl_->UpdateCircuitBreakerSnapshot(NULL);  // 不持有服务实例数据的引用，由读取方绑定
+  impl_->snapshot_lock_.Unlock();
 
   // 生成半开优先分配数据
   sync::MutexGuard mutex_guard(impl_->half_open_lock_);  // 加锁
@@ -1120,18 +1439,12 @@ RouteInfo::~RouteInfo() {
     delete source_service_info_;
     source_service_info_ = NULL;
   }
-  if (service_instances_ != NULL) {
-    delete service_instances_;
-    service_instances_ = NULL;
-  }
-  if (service_route_rule_ != NULL) {
-    delete service_route_rule_;
-    service_route_rule_ = NULL;
-  }
-  if (source_service_route_rule_ != NULL) {
-    delete source_service_route_rule_;
-    source_service_route_rule_ = NULL;
-  }
+  RouteObjectCache::DeleteServiceInstances(service_instances_);
+  service_instances_ = NULL;
+  RouteObjectCache::DeleteServiceRouteRule(service_route_rule_);
+  service_route_rule_ = NULL;
+  RouteObjectCache::DeleteServiceRouteRule(source_service_route_rule_);
+  source_service_route_rule_ = NULL;
   if (disable_routers_ != NULL) {
     delete disable_routers_;
     disable_routers_ = NULL;
@@ -1146,6 +1459,74 @@ RouteInfo::~RouteInfo() {
   }
 }
 
+// 线程本地的路由执行信息对象内存，以及上次请求使用的被调服务名
+struct ThreadLocalRouteInfoData {
+  ServiceKey service_key_;  // 保留服务名分配的内存
+  void* route_info_buffer_;
+  bool used_;
+};
+
+static __thread ThreadLocalRouteInfoData* thread_local_route_info = NULL;
+static pthread_key_t g_route_info_key;
+static pthread_once_t g_route_info_key_once = PTHREAD_ONCE_INIT;
+
+static void DeleteThreadLocalRouteInfo(void* ptr) {
+  ThreadLocalRouteInfoData* data = static_cast<ThreadLocalRouteInfoData*>(ptr);
+  if (thread_local_route_info == data) {
+    thread_local_route_info = NULL;
+  }
+  ::operator delete(data->route_info_buffer_);
+  delete data;
+}
+
+static void CreateRouteInfoKey() {
+  int rc = pthread_key_create(&g_route_info_key, &DeleteThreadLocalRouteInfo);
+  POLARIS_ASSERT(rc == 0);
+}
+
+// 路由执行信息只提供被调服务的只读接口，通过交换把服务名的内存在请求间传递，不改变服务名的值
+static void SwapServiceKey(RouteInfo* route_info, ServiceKey& service_key) {
+  ServiceKey& route_service_key = const_cast<ServiceKey&>(route_info->GetServiceKey());
+  route_service_key.namespace_.swap(service_key.namespace_);
+  route_service_key.name_.swap(service_key.name_);
+}
+
+ThreadLocalRouteInfo::ThreadLocalRouteInfo(const ServiceKey& service_key,
+                                           ServiceInfo* source_service_info) {
+  if (thread_local_route_info == NULL) {
+    pthread_once(&g_route_info_key_once, &CreateRouteInfoKey);
+    thread_local_route_info                     = new ThreadLocalRouteInfoData();
+    thread_local_route_info->route_info_buffer_ = ::operator new(sizeof(RouteInfo));
+    thread_local_route_info->used_              = false;
+    pthread_setspecific(g_route_info_key, thread_local_route_info);  // 线程退出时释放
+  }
+  if (thread_local_route_info->used_) {  // 同一线程嵌套使用，创建新对象
+    route_info_      = new RouteInfo(service_key, source_service_info);
+    is_thread_local_ = false;
+    return;
+  }
+  ServiceKey& cached_key = thread_local_route_info->service_key_;
+  cached_key.namespace_  = service_key.namespace_;  // 复用上次请求分配的内存
+  cached_key.name_       = service_key.name_;
+  ServiceKey empty_key;
+  route_info_ = new (thread_local_route_info->route_info_buffer_)
+      RouteInfo(empty_key, source_service_info);
+  SwapServiceKey(route_info_, cached_key);
+  thread_local_route_info->used_ = true;
+  is_thread_local_               = true;
+}
+
+ThreadLocalRouteInfo::~ThreadLocalRouteInfo() {
+  if (is_thread_local_) {
+    SwapServiceKey(route_info_, thread_local_route_info->service_key_);
+    route_info_->~RouteInfo();
+    thread_local_route_info->used_ = false;
+  } else {
+    delete route_info_;
+  }
+  route_info_ = NULL;
+}
+
 const ServiceKey& RouteInfo::GetServiceKey() { return service_key_; }
 
 ServiceInfo* RouteInfo::GetSourceServiceInfo() { return source_service_info_; }
@@ -1170,7 +1551,7 @@ void RouteInfo::SetSourceServiceRouteRule(ServiceRouteRule* source_service_route
 
 void RouteInfo::UpdateServiceInstances(ServiceInstances* service_instances) {
   if (service_instances_ != service_instances) {
-    delete service_instances_;
+    RouteObjectCache::DeleteServiceInstances(service_instances_);
     service_instances_ = service_instances;
   }
 }
@@ -1249,10 +1630,8 @@ RouteResult::RouteResult() {
 }
 
 RouteResult::~RouteResult() {
-  if (service_instances_ != NULL) {
-    delete service_instances_;
-    service_instances_ = NULL;
-  }
+  RouteObjectCache::DeleteServiceInstances(service_instances_);
+  service_instances_ = NULL;
   if (redirect_service_key_ != NULL) {
     delete redirect_service_key_;
     redirect_service_key_ = NULL;
@@ -16,9 +16,11 @@
 
 #include <pthread.h>
 
+#include <list>
 #include <map>
 #include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "model/route_rule.h"
@@ -31,6 +33,7 @@
 #include "sync/cond_var.h"
 #include "sync/mutex.h"
 #include "utils/scoped_ptr.h"
+#include "utils/thread_local_arena.h"
 #include "v1/request.pb.h"
 #include "v1/response.pb.h"
 
@@ -125,11 +128,21 @@ public:
                    const std::string& recover_info)
       : instances_(instances), subset_(subset), recover_info_(recover_info) {}
 
+  ~InstancesSetImpl();
+
+  // 替换加权随机选择子，并释放在min_gc_time之前被替换的选择子，需持有选择子创建锁
+  void ReplaceWeightedRandomSelector(Selector* selector, uint64_t min_gc_time);
+
 public:
   sync::Atomic<bool> recover_all_;  // 用来标记这个集合计算的下一个路由是否发生了全死全活
   sync::Atomic<int> count_;  // 记录这个Set被访问的次数
+  // 加权随机负载均衡的选择子，与一致性哈希的选择子分开存放，使用同一把创建锁
+  sync::Atomic<Selector*> weighted_random_selector_;
 
 private:
+  // 被替换的加权随机选择子及其替换时间，读取方可能仍在使用，延迟释放
+  std::list<std::pair<uint64_t, Selector*> > retired_selectors_;
+
   friend class InstancesSet;
   std::vector<Instance*> instances_;
   std::map<std::string, std::string> subset_;  // 所属的subset
@@ -162,9 +175,21 @@ public:
   std::set<Instance*> unhealthy_instances_;
   std::set<Instance*> isolate_instances_;
   InstancesSet* instances_;
+
+  // 与上一版本实例数据的差异，只在有插件关注实例更新时计算
+  std::vector<Instance*> added_instances_;         // 新增的实例
+  std::vector<Instance*> changed_instances_;       // 属性有变化的实例
+  std::vector<std::string> deleted_instance_ids_;  // 被删除的实例ID
+  bool available_unchanged_;  // 可用实例与上一版本完全相同，基于可用实例的结构可直接复用
 };
 
 class ServiceInstancesImpl {
+public:
+  static void* operator new(std::size_t size) { return ThreadLocalArena::Allocate(size); }
+  static void operator delete(void* ptr, std::size_t size) {
+    ThreadLocalArena::Deallocate(ptr, size);
+  }
+
 private:
   friend class ServiceInstances;
   ServiceData* service_data_;
@@ -173,6 +198,38 @@ private:
   InstancesSet* available_instances_;
 };
 
+// 路由执行时创建和释放的ServiceInstances及ServiceRouteRule对象
+//
+// 对象内存按对象大小通过::operator new分配，释放后缓存在线程本地。内存与直接new分配的相同，
+// 因此这里创建的对象也可以直接delete，直接new创建的对象也可以通过这里释放
+class RouteObjectCache {
+public:
+  static ServiceInstances* NewServiceInstances(ServiceData* service_data);
+
+  static void DeleteServiceInstances(ServiceInstances* service_instances);
+
+  static ServiceRouteRule* NewServiceRouteRule(ServiceData* service_data);
+
+  static void DeleteServiceRouteRule(ServiceRouteRule* service_route_rule);
+};
+
+// 同步获取实例时使用的路由执行信息
+//
+// 每个线程复用一个路由执行信息对象的内存，被调服务名的内存也保留给下次请求，
+// 避免每次请求拷贝服务名分配内存。同一线程嵌套使用时创建新对象
+class ThreadLocalRouteInfo : Noncopyable {
+public:
+  ThreadLocalRouteInfo(const ServiceKey& service_key, ServiceInfo* source_service_info);
+
+  ~ThreadLocalRouteInfo();
+
+  RouteInfo& Get() { return *route_info_; }
+
+private:
+  RouteInfo* route_info_;
+  bool is_thread_local_;
+};
+
 struct RouteRuleBound {
   RouteRule route_rule_;
   bool recover_all_;  // 是否全死全活
@@ -197,8 +254,25 @@ inline bool operator<(ServiceKeyWithType const& lhs, ServiceKeyWithType const& r
   }
 }
 
+// 服务端下发的原始数据，由服务数据和持久化任务共享，按需转换成json
+class SharedDiscoverResponse : public ServiceBase {
+public:
+  explicit SharedDiscoverResponse(v1::DiscoverResponse* response) : response_(response) {}
+
+  virtual ~SharedDiscoverResponse() { delete response_; }
+
+  void ToJson(std::string& json_content) const;
+
+private:
+  v1::DiscoverResponse* response_;
+};
+
 class ServiceDataImpl {
 public:
+  // 接管response的所有权创建服务数据，json格式在持久化或打印时才转换
+  static ServiceData* CreateFromPb(v1::DiscoverResponse* response, ServiceDataStatus data_status,
+                                   uint64_t cache_version);
+
   // 解析服务实例数据
   void ParseInstancesData(v1::DiscoverResponse& response);
 
@@ -212,10 +286,21 @@ public:
   // 熔断配置
   void ParseCircuitBreaker(v1::DiscoverResponse& response);
 
+  // 与上一版本的实例数据比较，ID相同的实例复用本地计算的数据。只在有插件关注实例更新时调用
+  void DiffInstancesData(ServiceDataImpl* old_data);
+
+  InstancesData* GetInstancesData() { return data_.instances_; }
+
   RateLimitData* GetRateLimitData() { return data_.rate_limit_; }
 
   v1::CircuitBreaker* GetCircuitBreaker() { return data_.circuitBreaker_; }
 
+  // 进程内唯一的数据ID，数据释放后地址被复用时也不会相同
+  uint64_t GetDataId() const { return data_id_; }
+
+  // 获取持久化数据，json格式未生成时返回增加了引用的原始数据，由持久化线程转换
+  SharedDiscoverResponse* GetPersistContent(std::string& content);
+
   /**
    * @desc 处理哈希冲突
    *
@@ -233,10 +318,14 @@ private:
   ServiceKey service_key_;
   std::string revision_;
   uint64_t cache_version_;
+  uint64_t data_id_;
 
   ServiceDataType data_type_;
   ServiceDataStatus data_status_;
-  std::string json_content_;
+  SharedDiscoverResponse* pb_response_;  // 服务器下发的原始数据，生成json后释放
+  std::string json_content_;             // 从磁盘加载或首次调用ToJsonString时生成
+  sync::Atomic<bool> json_ready_;        // json_content_是否已生成
+  sync::Mutex json_lock_;
   uint64_t available_time_;
 
   union {
@@ -277,6 +366,32 @@ private:
   ServiceData* service_data_;
 };
 
+/// @brief 熔断实例的不可变快照
+///
+/// 熔断数据或服务实例数据变化时生成新快照并原子替换，旧快照延迟到RCU回收时释放。
+/// 读取方在RCU保护区间内直接使用快照，不需要加锁、拷贝和引用计数
+class CircuitBreakerSnapshot {
+public:
+  CircuitBreakerSnapshot()
+      : version_(0), service_data_(NULL), service_data_id_(0), retire_time_(0) {}
+
+  /// @brief 判断快照是否与服务实例数据绑定，调用方需持有服务实例数据的引用
+  /// 同时比较指针和数据ID，避免快照绑定的数据释放后地址被新数据复用
+  bool IsBoundTo(ServiceData* service_data) const;
+
+  /// @brief 判断实例是否熔断
+  /// 实例属于快照绑定的服务数据时按指针查找，否则退化成按实例ID查找
+  bool IsOpen(Instance* instance, ServiceData* service_data) const;
+
+  uint64_t version_;           // 熔断数据版本
+  ServiceData* service_data_;  // 生成快照时的服务实例数据，只用于比较，不可解引用
+  uint64_t service_data_id_;   // 生成快照时的服务实例数据ID
+  std::set<Instance*> open_instances_;      // 属于service_data_的熔断实例
+  std::set<Instance*> excluded_instances_;  // 属于service_data_的不健康实例和熔断实例
+  std::set<std::string> open_instance_ids_;
+  uint64_t retire_time_;  // 被替换的时间，用于延迟回收
+};
+
 class ServiceImpl {
 public:
   ServiceImpl(const ServiceKey& service_key, uint32_t service_id);
@@ -285,6 +400,21 @@ public:
   // 更新服务实例数据的本地ID
   void UpdateInstanceId(ServiceData* service_data);
 
+  // 根据当前熔断数据生成新的熔断快照，服务实例数据不为NULL时与其绑定，需持有snapshot_lock_
+  void UpdateCircuitBreakerSnapshot(ServiceData* instances_data);
+
+  /// @brief 获取熔断实例快照
+  ///
+  /// @note 只能在RCU保护区间内使用，不需要释放
+  /// @param instances_data 调用方持有引用的服务实例数据，快照尽量与其绑定以便按实例指针查找
+  /// @return CircuitBreakerSnapshot* 熔断实例快照，不会为NULL
+  CircuitBreakerSnapshot* GetCircuitBreakerSnapshot(ServiceData* instances_data);
+
+  /// @brief 释放在指定时间之前被替换的熔断实例快照
+  ///
+  /// @param min_gc_time 所有读取方进入RCU保护区间的最小时间
+  void CheckGc(uint64_t min_gc_time);
+
 private:
   friend class Service;
   ServiceKey service_key_;
@@ -298,6 +428,12 @@ private:
   std::map<std::string, int> half_open_instances_;
   std::set<std::string> open_instances_;
 
+  // 熔断实例快照
+  sync::Mutex snapshot_lock_;      // 串行化快照的生成和回收
+  ServiceData* instances_data_;    // 当前服务实例数据，不持有引用，只用于比较
+  sync::Atomic<CircuitBreakerSnapshot*> circuit_breaker_snapshot_;
+  std::list<CircuitBreakerSnapshot*> retired_snapshots_;
+
   // 半开优先分配数据
   sync::Mutex half_open_lock_;
   sync::Atomic<uint64_t> last_half_open_time_;
@@ -32,6 +32,8 @@ enum ApiStatKey {
   kApiStatLimitGetQuota,
   kApiStatLimitUpdateCallResult,
   kApiStatProviderAsyncHeartbeat,
+  kApiStatConsumerBatchGetOne,
+  kApiStatLimitBatchGetQuota,
   kApiStatKeyCount
 };
 
@@ -47,7 +47,9 @@ static const char* g_ApiStatKeyMap[] = {"Consumer::InitService",
                                         "Provider::Heartbeat",
                                         "Limit::GetQuota",
                                         "Limit::UpdateCallResult",
-                                        "Provider::AsyncHeartbeat"};
+                                        "Provider::AsyncHeartbeat",
+                                        "Consumer::BatchGetOneInstance",
+                                        "Limit::BatchGetQuota"};
 
 // 静态断言两处stat key的长度相等
 STATIC_ASSERT(sizeof(g_ApiStatKeyMap) / sizeof(const char*) == kApiStatKeyCount,
@@ -13,31 +13,31 @@
 
 #include "plugin/circuit_breaker/error_count.h"
 
-#include <utility>
+#include <vector>
 
+#include "context_internal.h"
 #include "plugin/circuit_breaker/circuit_breaker.h"
 #include "polaris/config.h"
+#include "polaris/context.h"
 #include "utils/time_clock.h"
-#include "utils/utils.h"
 
 namespace polaris {
 
-ErrorCountCircuitBreaker::ErrorCountCircuitBreaker() {
+ErrorCountCircuitBreaker::ErrorCountCircuitBreaker()
+    : error_count_map_(ValueNoOp<ErrorCountStatus>, ValueDelete<ErrorCountStatus>) {
+  context_                          = NULL;
   continue_error_threshold_         = 0;
   sleep_window_                     = 0;
   request_count_after_half_open_    = 0;
   success_count_half_open_to_close_ = 0;
   error_count_half_open_to_open_    = 0;
   metric_expired_time_              = 0;
-  pthread_rwlock_init(&rwlock_, 0);
 }
 
-ErrorCountCircuitBreaker::~ErrorCountCircuitBreaker() {
-  pthread_rwlock_destroy(&rwlock_);
-  error_count_map_.clear();
-}
+ErrorCountCircuitBreaker::~ErrorCountCircuitBreaker() { context_ = NULL; }
 
-ReturnCode ErrorCountCircuitBreaker::Init(Config* config, Context* /*context*/) {
+ReturnCode ErrorCountCircuitBreaker::Init(Config* config, Context* context) {
+  context_ = context;
   continue_error_threshold_ =
       config->GetIntOrDefault(CircuitBreakerConfig::kContinuousErrorThresholdKey,
                               CircuitBreakerConfig::kContinuousErrorThresholdDefault);
@@ -83,8 +83,7 @@ ReturnCode ErrorCountCircuitBreaker::RealTimeCircuitBreak(
   if (instance_gauge.call_ret_status != kCallRetOk) {
     // 正常状态下
     if (error_count_status.status == kCircuitBreakerClose) {
-      ATOMIC_INC(&error_count_status.error_count);
-      if (error_count_status.error_count >= continue_error_threshold_) {  // 达到熔断条件
+      if (++error_count_status.error_count >= continue_error_threshold_) {  // 达到熔断条件
         if (instances_status->TranslateStatus(instance_gauge.instance_id, kCircuitBreakerClose,
                                               kCircuitBreakerOpen)) {
           error_count_status.status           = kCircuitBreakerOpen;
@@ -92,10 +91,9 @@ ReturnCode ErrorCountCircuitBreaker::RealTimeCircuitBreak(
         }
       }
     } else if (error_count_status.status == kCircuitBreakerHalfOpen) {
-      ATOMIC_INC(&error_count_status.error_count);
       // 半开状态下的探测请求只要有一个错误则立刻熔断
       // 在请求量较少的时候可使半开后快速又进入熔断状态，避免半开探测占比过高
-      if (error_count_status.error_count >= error_count_half_open_to_open_) {
+      if (++error_count_status.error_count >= error_count_half_open_to_open_) {
         if (instances_status->TranslateStatus(instance_gauge.instance_id, kCircuitBreakerHalfOpen,
                                               kCircuitBreakerOpen)) {
           error_count_status.status           = kCircuitBreakerOpen;
@@ -105,8 +103,8 @@ ReturnCode ErrorCountCircuitBreaker::RealTimeCircuitBreak(
     }
   } else {
     if (error_count_status.status == kCircuitBreakerHalfOpen) {
-      ATOMIC_INC(&error_count_status.success_count);
-    } else {
+      error_count_status.success_count++;
+    } else if (error_count_status.error_count != 0) {  // 避免每次成功调用都写共享数据
       error_count_status.error_count = 0;
     }
   }
@@ -116,15 +114,17 @@ ReturnCode ErrorCountCircuitBreaker::RealTimeCircuitBreak(
 ReturnCode ErrorCountCircuitBreaker::TimingCircuitBreak(
     InstancesCircuitBreakerStatus* instances_status) {
   uint64_t current_time = Time::GetCurrentTimeMs();
-  std::map<std::string, ErrorCountStatus>::iterator it;
-  pthread_rwlock_rdlock(&rwlock_);
-  for (it = error_count_map_.begin(); it != error_count_map_.end(); ++it) {
-    ErrorCountStatus& error_count_status = it->second;
+  // 只有本线程会删除状态，遍历时无需加锁
+  std::vector<ErrorCountStatus*> all_status;
+  error_count_map_.GetAllValuesWithRef(all_status);
+  for (std::size_t i = 0; i < all_status.size(); ++i) {
+    ErrorCountStatus& error_count_status = *all_status[i];
+    const std::string& instance_id       = error_count_status.instance_id;
     if (error_count_status.status == kCircuitBreakerOpen) {  // 熔断状态
       // 达到半开条件
       if (instances_status->AutoHalfOpenEnable() &&
           error_count_status.last_update_time + sleep_window_ <= current_time) {
-        if (instances_status->TranslateStatus(it->first, kCircuitBreakerOpen,
+        if (instances_status->TranslateStatus(instance_id, kCircuitBreakerOpen,
                                               kCircuitBreakerHalfOpen)) {
           error_count_status.status           = kCircuitBreakerHalfOpen;
           error_count_status.success_count    = 0;
@@ -134,7 +134,7 @@ ReturnCode ErrorCountCircuitBreaker::TimingCircuitBreak(
       }
     } else if (error_count_status.status == kCircuitBreakerHalfOpen) {              // 半开状态
       if (error_count_status.success_count >= success_count_half_open_to_close_) {  // 达到恢复条件
-        if (instances_status->TranslateStatus(it->first, kCircuitBreakerHalfOpen,
+        if (instances_status->TranslateStatus(instance_id, kCircuitBreakerHalfOpen,
                                               kCircuitBreakerClose)) {
           error_count_status.status           = kCircuitBreakerClose;
           error_count_status.error_count      = 0;
@@ -142,7 +142,7 @@ ReturnCode ErrorCountCircuitBreaker::TimingCircuitBreak(
         }
       } else if (error_count_status.last_access_time + 100 * sleep_window_ <= current_time) {
         // 兜底：如果访问量一定时间达不到要求，则重新熔断
-        if (instances_status->TranslateStatus(it->first, kCircuitBreakerHalfOpen,
+        if (instances_status->TranslateStatus(instance_id, kCircuitBreakerHalfOpen,
                                               kCircuitBreakerOpen)) {
           error_count_status.status           = kCircuitBreakerOpen;
           error_count_status.last_update_time = current_time;
@@ -151,54 +151,46 @@ ReturnCode ErrorCountCircuitBreaker::TimingCircuitBreak(
     }
     // 正常状态不做处理
   }
-  pthread_rwlock_unlock(&rwlock_);
   CheckAndExpiredMetric(instances_status);
   return kReturnOk;
 }
 
 ErrorCountStatus& ErrorCountCircuitBreaker::GetOrCreateErrorCountStatus(
     const std::string& instance_id, uint64_t current_time) {
-  pthread_rwlock_rdlock(&rwlock_);
-  std::map<std::string, ErrorCountStatus>::iterator it = error_count_map_.find(instance_id);
-  if (it != error_count_map_.end()) {
-    it->second.last_access_time = current_time;
-    pthread_rwlock_unlock(&rwlock_);
-    return it->second;
+  ErrorCountStatus* error_count_status = error_count_map_.Get(instance_id, false);
+  if (error_count_status == NULL) {
+    ErrorCountStatus* new_status = new ErrorCountStatus(instance_id, current_time);
+    if ((error_count_status = error_count_map_.PutIfAbsent(instance_id, new_status)) != NULL) {
+      delete new_status;  // 其他线程已创建
+    } else {
+      return *new_status;
+    }
   }
-  pthread_rwlock_unlock(&rwlock_);
-
-  pthread_rwlock_wrlock(&rwlock_);
-  it = error_count_map_.find(instance_id);  // double check
-  if (it != error_count_map_.end()) {
-    it->second.last_access_time = current_time;
-    pthread_rwlock_unlock(&rwlock_);
-    return it->second;
+  if (error_count_status->last_access_time.Load() != current_time) {  // 避免每次调用都写共享数据
+    error_count_status->last_access_time.Store(current_time);
   }
-  ErrorCountStatus& error_count_status = error_count_map_[instance_id];
-  error_count_status.status            = kCircuitBreakerClose;
-  error_count_status.error_count       = 0;
-  error_count_status.success_count     = 0;
-  error_count_status.last_update_time  = 0;
-  error_count_status.last_access_time  = current_time;
-  pthread_rwlock_unlock(&rwlock_);
-  return error_count_status;
+  return *error_count_status;
 }
 
 void ErrorCountCircuitBreaker::CheckAndExpiredMetric(
     InstancesCircuitBreakerStatus* instances_status) {
   uint64_t current_time = Time::GetCurrentTimeMs();
-  std::map<std::string, ErrorCountStatus>::iterator it;
-  pthread_rwlock_wrlock(&rwlock_);
-  for (it = error_count_map_.begin(); it != error_count_map_.end();) {
-    if (it->second.last_access_time + metric_expired_time_ <= current_time) {
-      instances_status->TranslateStatus(it->first, kCircuitBreakerOpen, kCircuitBreakerClose);
-      instances_status->TranslateStatus(it->first, kCircuitBreakerHalfOpen, kCircuitBreakerClose);
-      error_count_map_.erase(it++);
-    } else {
-      ++it;
+  std::vector<ErrorCountStatus*> all_status;
+  error_count_map_.GetAllValuesWithRef(all_status);
+  for (std::size_t i = 0; i < all_status.size(); ++i) {
+    ErrorCountStatus& error_count_status = *all_status[i];
+    if (error_count_status.last_access_time.Load() + metric_expired_time_ <= current_time) {
+      const std::string& instance_id = error_count_status.instance_id;
+      instances_status->TranslateStatus(instance_id, kCircuitBreakerOpen, kCircuitBreakerClose);
+      instances_status->TranslateStatus(instance_id, kCircuitBreakerHalfOpen,
+                                        kCircuitBreakerClose);
+      error_count_map_.Delete(instance_id);
     }
   }
-  pthread_rwlock_unlock(&rwlock_);
+  // 实时统计线程在RCU保护下访问状态，等其退出后再释放
+  uint64_t min_gc_time = context_ != NULL ? context_->GetContextImpl()->RcuMinTime() - 2000
+                                          : current_time - 2000;
+  error_count_map_.CheckGc(min_gc_time);
 }
 
 }  // namespace polaris
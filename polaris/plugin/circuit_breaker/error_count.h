@@ -14,23 +14,29 @@
 #ifndef POLARIS_CPP_POLARIS_PLUGIN_CIRCUIT_BREAKER_ERROR_COUNT_H_
 #define POLARIS_CPP_POLARIS_PLUGIN_CIRCUIT_BREAKER_ERROR_COUNT_H_
 
-#include <pthread.h>
 #include <stdint.h>
 
-#include <map>
 #include <string>
 
+#include "cache/lru_map.h"
+#include "cache/rcu_hash_map.h"
 #include "polaris/defs.h"
 #include "polaris/plugin.h"
+#include "sync/atomic.h"
 
 namespace polaris {
 
 struct ErrorCountStatus {
-  CircuitBreakerStatus status;
-  int error_count;
-  int success_count;
-  uint64_t last_update_time;
-  uint64_t last_access_time;
+  ErrorCountStatus(const std::string& id, uint64_t current_time)
+      : instance_id(id), status(kCircuitBreakerClose), last_update_time(0),
+        last_access_time(current_time) {}
+
+  std::string instance_id;
+  sync::Atomic<CircuitBreakerStatus> status;
+  sync::Atomic<int> error_count;
+  sync::Atomic<int> success_count;
+  sync::Atomic<uint64_t> last_update_time;
+  sync::Atomic<uint64_t> last_access_time;
 };
 
 class ErrorCountCircuitBreaker : public CircuitBreaker {
@@ -54,6 +60,7 @@ public:
   void CheckAndExpiredMetric(InstancesCircuitBreakerStatus* instances_status);
 
 private:
+  Context* context_;
   int continue_error_threshold_;  // 连续错误次数熔断阈值
   uint64_t sleep_window_;  // 熔断后等待多久时间转入半开，半开后等待多久未达到恢复条件则重新熔断
   int request_count_after_half_open_;     // 半开后释放多少个请求
@@ -61,8 +68,8 @@ private:
   int error_count_half_open_to_open_;     // 半开后多少请求失败则立即打开
 
   uint64_t metric_expired_time_;
-  pthread_rwlock_t rwlock_;
-  std::map<std::string, ErrorCountStatus> error_count_map_;
+  // 查询无锁，过期删除的状态延迟释放
+  RcuHashMap<std::string, ErrorCountStatus, MurmurString> error_count_map_;
 };
 
 }  // namespace polaris
@@ -17,15 +17,68 @@
 #include <stddef.h>
 
 #include <utility>
+#include <vector>
 
+#include "context_internal.h"
 #include "plugin/circuit_breaker/circuit_breaker.h"
 #include "polaris/config.h"
+#include "polaris/context.h"
 #include "utils/time_clock.h"
-#include "utils/utils.h"
 
 namespace polaris {
 
-ErrorRateCircuitBreaker::ErrorRateCircuitBreaker() {
+void ErrorRateBucket::Add(uint64_t bucket_time, bool is_error) {
+  bucket_time &= kTimeMask;
+  uint64_t old_value = value_.Load();
+  for (;;) {
+    uint64_t old_time = old_value >> kTimeShift;
+    uint64_t new_value;
+    if (old_time != bucket_time) {  // 上一轮的数据，轮转到新的桶时间重新计数
+      new_value = (bucket_time << kTimeShift) | (1ULL << kCountBits) | (is_error ? 1 : 0);
+    } else {
+      new_value = old_value;
+      if (((old_value >> kCountBits) & kCountMask) < kCountMask) {  // 计数达到上限后不再增加
+        new_value += 1ULL << kCountBits;
+      }
+      if (is_error && (old_value & kCountMask) < kCountMask) {
+        new_value += 1;
+      }
+      if (new_value == old_value) {
+        return;
+      }
+    }
+    if (value_.Cas(old_value, new_value)) {
+      return;
+    }
+    old_value = value_.Load();
+  }
+}
+
+void ErrorRateBucket::Count(uint64_t last_end_bucket_time, int& total_count,
+                            int& error_count) const {
+  uint64_t value = value_.Load();
+  uint64_t diff  = ((value >> kTimeShift) - last_end_bucket_time) & kTimeMask;
+  if (diff == 0 || diff > kTimeMask / 2) {  // 桶时间不晚于last_end_bucket_time
+    return;
+  }
+  total_count += static_cast<int>((value >> kCountBits) & kCountMask);
+  error_count += static_cast<int>(value & kCountMask);
+}
+
+ErrorRateStatus::ErrorRateStatus(const std::string& id, int buckets_num, uint64_t current_time)
+    : instance_id(id), status(kCircuitBreakerClose), last_update_time(0),
+      last_access_time(current_time) {
+  buckets = new ErrorRateBucket[buckets_num];
+}
+
+ErrorRateStatus::~ErrorRateStatus() {
+  delete[] buckets;
+  buckets = NULL;
+}
+
+ErrorRateCircuitBreaker::ErrorRateCircuitBreaker()
+    : error_rate_map_(ValueNoOp<ErrorRateStatus>, ValueDelete<ErrorRateStatus>) {
+  context_                       = NULL;
   request_volume_threshold_      = 0;
   error_rate_threshold_          = 0;
   metric_stat_time_window_       = 0;
@@ -35,20 +88,12 @@ ErrorRateCircuitBreaker::ErrorRateCircuitBreaker() {
   metric_bucket_time_            = 0;
   request_count_after_half_open_ = 0;
   success_count_after_half_open_ = 0;
-  pthread_rwlock_init(&rwlock_, 0);
 }
 
-ErrorRateCircuitBreaker::~ErrorRateCircuitBreaker() {
-  pthread_rwlock_destroy(&rwlock_);
-  std::map<std::string, ErrorRateStatus>::iterator it;
-  for (it = error_rate_map_.begin(); it != error_rate_map_.end(); ++it) {
-    pthread_mutex_destroy(&it->second.lock);
-    delete[] it->second.buckets;
-  }
-  error_rate_map_.clear();
-}
+ErrorRateCircuitBreaker::~ErrorRateCircuitBreaker() { context_ = NULL; }
 
-ReturnCode ErrorRateCircuitBreaker::Init(Config* config, Context* /*context*/) {
+ReturnCode ErrorRateCircuitBreaker::Init(Config* config, Context* context) {
+  context_ = context;
   request_volume_threshold_ =
       config->GetIntOrDefault(CircuitBreakerConfig::kRequestVolumeThresholdKey,
                               CircuitBreakerConfig::kRequestVolumeThresholdDefault);
@@ -112,20 +157,8 @@ ReturnCode ErrorRateCircuitBreaker::RealTimeCircuitBreak(
 
   uint64_t bucket_time = current_time / metric_bucket_time_;
   int bucket_index     = bucket_time % metric_num_buckets_;
-  // 判断是不是还是上一轮的数据，是的话清空掉
-  if (bucket_time != error_rate_status.buckets[bucket_index].bucket_time) {
-    pthread_mutex_lock(&error_rate_status.lock);
-    if (bucket_time != error_rate_status.buckets[bucket_index].bucket_time) {
-      error_rate_status.buckets[bucket_index].total_count = 0;
-      error_rate_status.buckets[bucket_index].error_count = 0;
-      error_rate_status.buckets[bucket_index].bucket_time = bucket_time;
-    }
-    pthread_mutex_unlock(&error_rate_status.lock);
-  }
-  ATOMIC_INC(&error_rate_status.buckets[bucket_index].total_count);
-  if (instance_gauge.call_ret_status != kCallRetOk) {
-    ATOMIC_INC(&error_rate_status.buckets[bucket_index].error_count);
-  }
+  error_rate_status.buckets[bucket_index].Add(bucket_time,
+                                              instance_gauge.call_ret_status != kCallRetOk);
   return kReturnOk;
 }
 
@@ -133,15 +166,17 @@ ReturnCode ErrorRateCircuitBreaker::TimingCircuitBreak(
     InstancesCircuitBreakerStatus* instances_status) {
   uint64_t current_time         = Time::GetCurrentTimeMs();
   uint64_t last_end_bucket_time = current_time / metric_bucket_time_ - metric_num_buckets_;
-  std::map<std::string, ErrorRateStatus>::iterator it;
-  pthread_rwlock_rdlock(&rwlock_);
-  for (it = error_rate_map_.begin(); it != error_rate_map_.end(); ++it) {
-    ErrorRateStatus& error_rate_status = it->second;
+  // 只有本线程会删除状态，遍历时无需加锁
+  std::vector<ErrorRateStatus*> all_status;
+  error_rate_map_.GetAllValuesWithRef(all_status);
+  for (std::size_t i = 0; i < all_status.size(); ++i) {
+    ErrorRateStatus& error_rate_status = *all_status[i];
+    const std::string& instance_id     = error_rate_status.instance_id;
     // 熔断状态
     if (error_rate_status.status == kCircuitBreakerOpen) {
       if (instances_status->AutoHalfOpenEnable() &&
           error_rate_status.last_update_time + sleep_window_ <= current_time &&
-          instances_status->TranslateStatus(it->first, kCircuitBreakerOpen,
+          instances_status->TranslateStatus(instance_id, kCircuitBreakerOpen,
                                             kCircuitBreakerHalfOpen)) {
         error_rate_status.last_update_time = current_time;
         error_rate_status.status           = kCircuitBreakerHalfOpen;
@@ -157,7 +192,8 @@ ReturnCode ErrorRateCircuitBreaker::TimingCircuitBreak(
       // 达到熔断条件：请求数达标且错误率达标，request_volume_threshold_大于0能确保total_req大于0才作为除数
       if (total_req >= request_volume_threshold_ &&
           (static_cast<float>(err_req) / total_req >= error_rate_threshold_) &&
-          instances_status->TranslateStatus(it->first, kCircuitBreakerClose, kCircuitBreakerOpen)) {
+          instances_status->TranslateStatus(instance_id, kCircuitBreakerClose,
+                                            kCircuitBreakerOpen)) {
         error_rate_status.last_update_time = current_time;
         error_rate_status.status           = kCircuitBreakerOpen;
         // 熔断后不会使用数据判断是否进入半开，这里不用清空数据
@@ -168,7 +204,7 @@ ReturnCode ErrorRateCircuitBreaker::TimingCircuitBreak(
     if (error_rate_status.status == kCircuitBreakerHalfOpen) {
       // 达到恢复条件
       if (total_req - err_req >= success_count_after_half_open_) {
-        if (instances_status->TranslateStatus(it->first, kCircuitBreakerHalfOpen,
+        if (instances_status->TranslateStatus(instance_id, kCircuitBreakerHalfOpen,
                                               kCircuitBreakerClose)) {
           error_rate_status.last_update_time = current_time;
           error_rate_status.status           = kCircuitBreakerClose;
@@ -177,7 +213,7 @@ ReturnCode ErrorRateCircuitBreaker::TimingCircuitBreak(
       } else if (err_req > request_count_after_half_open_ - success_count_after_half_open_ ||
                  error_rate_status.last_access_time + 100 * sleep_window_ <= current_time) {
         // 达到重新熔断条件
-        if (instances_status->TranslateStatus(it->first, kCircuitBreakerHalfOpen,
+        if (instances_status->TranslateStatus(instance_id, kCircuitBreakerHalfOpen,
                                               kCircuitBreakerOpen)) {
           error_rate_status.last_update_time = current_time;
           error_rate_status.status           = kCircuitBreakerOpen;
@@ -186,60 +222,47 @@ ReturnCode ErrorRateCircuitBreaker::TimingCircuitBreak(
       }
     }
   }
-  pthread_rwlock_unlock(&rwlock_);
   CheckAndExpiredMetric(instances_status);
   return kReturnOk;
 }
 
-ErrorRateStatus& ErrorRateCircuitBreaker::GetOrCreateErrorRateStatus(const std::string instance_id,
+ErrorRateStatus& ErrorRateCircuitBreaker::GetOrCreateErrorRateStatus(const std::string& instance_id,
                                                                      uint64_t current_time) {
-  pthread_rwlock_rdlock(&rwlock_);
-  std::map<std::string, ErrorRateStatus>::iterator it = error_rate_map_.find(instance_id);
-  if (it != error_rate_map_.end()) {
-    it->second.last_access_time = current_time;
-    pthread_rwlock_unlock(&rwlock_);
-    return it->second;
-  }
-  pthread_rwlock_unlock(&rwlock_);
-
-  pthread_rwlock_wrlock(&rwlock_);
-  it = error_rate_map_.find(instance_id);  // double check
-  if (it != error_rate_map_.end()) {
-    it->second.last_access_time = current_time;
-    pthread_rwlock_unlock(&rwlock_);
-    return it->second;
+  ErrorRateStatus* error_rate_status = error_rate_map_.Get(instance_id, false);
+  if (error_rate_status == NULL) {
+    ErrorRateStatus* new_status =
+        new ErrorRateStatus(instance_id, metric_num_buckets_, current_time);
+    if ((error_rate_status = error_rate_map_.PutIfAbsent(instance_id, new_status)) != NULL) {
+      delete new_status;  // 其他线程已创建
+    } else {
+      return *new_status;
+    }
   }
-  ErrorRateStatus& error_rate_status = error_rate_map_[instance_id];
-  error_rate_status.buckets          = new ErrorRateBucket[metric_num_buckets_];
-  for (int i = 0; i < metric_num_buckets_; i++) {
-    error_rate_status.buckets[i].bucket_time = 0;
+  if (error_rate_status->last_access_time.Load() != current_time) {  // 避免每次调用都写共享数据
+    error_rate_status->last_access_time.Store(current_time);
   }
-  error_rate_status.status           = kCircuitBreakerClose;
-  error_rate_status.last_access_time = current_time;
-  error_rate_status.last_update_time = 0;
-  pthread_mutex_init(&error_rate_status.lock, NULL);
-
-  pthread_rwlock_unlock(&rwlock_);
-  return error_rate_status;
+  return *error_rate_status;
 }
 
 void ErrorRateCircuitBreaker::CheckAndExpiredMetric(
     InstancesCircuitBreakerStatus* instances_status) {
   uint64_t current_time = Time::GetCurrentTimeMs();
-  std::map<std::string, ErrorRateStatus>::iterator it;
-  pthread_rwlock_wrlock(&rwlock_);
-  for (it = error_rate_map_.begin(); it != error_rate_map_.end();) {
-    if (it->second.last_access_time + metric_expired_time_ <= current_time) {
-      pthread_mutex_destroy(&it->second.lock);
-      instances_status->TranslateStatus(it->first, kCircuitBreakerOpen, kCircuitBreakerClose);
-      instances_status->TranslateStatus(it->first, kCircuitBreakerHalfOpen, kCircuitBreakerClose);
-      delete[] it->second.buckets;
-      error_rate_map_.erase(it++);
-    } else {
-      ++it;
+  std::vector<ErrorRateStatus*> all_status;
+  error_rate_map_.GetAllValuesWithRef(all_status);
+  for (std::size_t i = 0; i < all_status.size(); ++i) {
+    ErrorRateStatus& error_rate_status = *all_status[i];
+    if (error_rate_status.last_access_time.Load() + metric_expired_time_ <= current_time) {
+      const std::string& instance_id = error_rate_status.instance_id;
+      instances_status->TranslateStatus(instance_id, kCircuitBreakerOpen, kCircuitBreakerClose);
+      instances_status->TranslateStatus(instance_id, kCircuitBreakerHalfOpen,
+                                        kCircuitBreakerClose);
+      error_rate_map_.Delete(instance_id);
     }
   }
-  pthread_rwlock_unlock(&rwlock_);
+  // 实时统计线程在RCU保护下访问状态，等其退出后再释放
+  uint64_t min_gc_time = context_ != NULL ? context_->GetContextImpl()->RcuMinTime() - 2000
+                                          : current_time - 2000;
+  error_rate_map_.CheckGc(min_gc_time);
 }
 
 }  // namespace polaris
@@ -14,49 +14,70 @@
 #ifndef POLARIS_CPP_POLARIS_PLUGIN_CIRCUIT_BREAKER_ERROR_RATE_H_
 #define POLARIS_CPP_POLARIS_PLUGIN_CIRCUIT_BREAKER_ERROR_RATE_H_
 
-#include <pthread.h>
 #include <stdint.h>
 
-#include <map>
 #include <string>
 
+#include "cache/lru_map.h"
+#include "cache/rcu_hash_map.h"
 #include "polaris/defs.h"
 #include "polaris/plugin.h"
+#include "sync/atomic.h"
 
 namespace polaris {
 
-struct ErrorRateBucket {
-  ErrorRateBucket() : total_count(0), error_count(0), bucket_time(0) {}
-  int total_count;
-  int error_count;
-  uint64_t bucket_time;
+/// @brief 错误率统计桶
+///
+/// 桶时间和计数打包在一个64位整数中：高20位为桶时间的低位，之后22位为总请求数，低22位为错误数
+/// 桶时间变化时通过CAS同时完成轮转和计数，不需要加锁，也不会丢失并发写入的计数
+class ErrorRateBucket {
+public:
+  ErrorRateBucket() {}
+
+  // 在bucket_time对应的桶中计数，桶中是旧数据时重新计数
+  void Add(uint64_t bucket_time, bool is_error);
+
+  // 桶时间晚于last_end_bucket_time时累加桶中的计数
+  void Count(uint64_t last_end_bucket_time, int& total_count, int& error_count) const;
+
+  void Clear() { value_.Store(0); }
+
+  uint64_t GetBucketTime() const { return value_.Load() >> kTimeShift; }
+
+  int GetTotalCount() const { return static_cast<int>((value_.Load() >> kCountBits) & kCountMask); }
+
+  int GetErrorCount() const { return static_cast<int>(value_.Load() & kCountMask); }
+
+private:
+  static const int kCountBits       = 22;
+  static const int kTimeShift       = kCountBits * 2;
+  static const uint64_t kCountMask  = (1ULL << kCountBits) - 1;
+  static const uint64_t kTimeMask   = (1ULL << (64 - kTimeShift)) - 1;
+
+  sync::Atomic<uint64_t> value_;
 };
 
 struct ErrorRateStatus {
-  CircuitBreakerStatus status;
+  ErrorRateStatus(const std::string& id, int buckets_num, uint64_t current_time);
+
+  ~ErrorRateStatus();
+
+  std::string instance_id;
+  sync::Atomic<CircuitBreakerStatus> status;
   ErrorRateBucket* buckets;
-  uint64_t last_update_time;
-  uint64_t last_access_time;
-  pthread_mutex_t lock;
+  sync::Atomic<uint64_t> last_update_time;
+  sync::Atomic<uint64_t> last_access_time;
 
   void ClearBuckets(int buckets_num) {
     for (int i = 0; i < buckets_num; i++) {
-      pthread_mutex_lock(&lock);
-      buckets[i].bucket_time = 0;
-      pthread_mutex_unlock(&lock);
+      buckets[i].Clear();
     }
   }
 
   void BucketsCount(int buckets_num, uint64_t last_end_bucket_time, int& total_req, int& err_req) {
-    pthread_mutex_lock(&lock);
     for (int i = 0; i < buckets_num; i++) {
-      // 跳过上一轮写入的数据
-      if (buckets[i].bucket_time > last_end_bucket_time) {
-        total_req += buckets[i].total_count;
-        err_req += buckets[i].error_count;
-      }
+      buckets[i].Count(last_end_bucket_time, total_req, err_req);  // 跳过上一轮写入的数据
     }
-    pthread_mutex_unlock(&lock);
   }
 };
 
@@ -75,11 +96,13 @@ public:
 
   virtual ReturnCode TimingCircuitBreak(InstancesCircuitBreakerStatus* instances_status);
 
-  ErrorRateStatus& GetOrCreateErrorRateStatus(const std::string instance_id, uint64_t current_time);
+  ErrorRateStatus& GetOrCreateErrorRateStatus(const std::string& instance_id,
+                                              uint64_t current_time);
 
   void CheckAndExpiredMetric(InstancesCircuitBreakerStatus* instances_status);
 
 private:
+  Context* context_;
   int request_volume_threshold_;  // 计算错误率至少需要多少请求
   float error_rate_threshold_;
   uint64_t metric_stat_time_window_;
@@ -90,8 +113,8 @@ private:
   int success_count_after_half_open_;  // 半开后请求成功多少次恢复
 
   uint64_t metric_expired_time_;
-  pthread_rwlock_t rwlock_;
-  std::map<std::string, ErrorRateStatus> error_rate_map_;
+  // 查询无锁，过期删除的状态延迟释放
+  RcuHashMap<std::string, ErrorRateStatus, MurmurString> error_rate_map_;
 };
 
 }  // namespace polaris
@@ -21,6 +21,7 @@
 #include <string>
 #include <vector>
 
+#include "cache/rcu_map.h"
 #include "grpc/client.h"
 #include "model/model_impl.h"
 #include "polaris/defs.h"
@@ -36,8 +37,6 @@ class CircuitBreakSetChainData;
 class CircuitBreakerExecutor;
 class Context;
 struct InstanceGauge;
-template <typename Key, typename Value>
-class RcuMap;
 
 enum StatisticalStatus {
   Success = 0,
@@ -22,6 +22,7 @@
 #include <utility>
 
 #include "logger.h"
+#include "model/model_impl.h"
 #include "plugin/plugin_manager.h"
 #include "polaris/config.h"
 #include "polaris/model.h"
@@ -35,6 +36,7 @@ HealthCheckerChainImpl::HealthCheckerChainImpl(const ServiceKey& service_key,
   service_key_         = service_key;
   local_registry_      = local_registry;
   when_                = "never";
+  service_in_flight_   = HealthCheckerConfig::kServiceInFlightDefault;
   health_check_ttl_ms_ = 0;
   last_detect_time_ms_ = Time::GetCurrentTimeMs();
 }
@@ -58,6 +60,13 @@ ReturnCode HealthCheckerChainImpl::Init(Config* config, Context* context) {
 
   health_check_ttl_ms_ = config->GetMsOrDefault(HealthCheckerConfig::kCheckerIntervalKey,
                                                 HealthCheckerConfig::kDetectorIntervalDefault);
+  service_in_flight_   = config->GetIntOrDefault(HealthCheckerConfig::kServiceInFlightKey,
+                                               HealthCheckerConfig::kServiceInFlightDefault);
+  if (service_in_flight_ <= 0) {
+    POLARIS_LOG(LOG_ERROR, "health checker config %s must be positive",
+                HealthCheckerConfig::kServiceInFlightKey);
+    return kReturnInvalidConfig;
+  }
 
   std::vector<std::string> plugin_name_list = config->GetListOrDefault(
       HealthCheckerConfig::kChainPluginListKey, HealthCheckerConfig::kChainPluginListDefault);
@@ -123,33 +132,57 @@ ReturnCode HealthCheckerChainImpl::Init(Config* config, Context* context) {
 }
 
 ReturnCode HealthCheckerChainImpl::DetectInstance(CircuitBreakerChain& circuit_breaker_chain) {
+  ServiceData* service_data = NULL;
+  std::vector<Instance*> health_check_instances;
+  if (!PrepareDetect(service_data, health_check_instances)) {
+    return kReturnOk;
+  }
+  ServiceInstances service_instances(service_data);
+  for (std::size_t i = 0; i < health_check_instances.size(); ++i) {
+    bool is_detect_success = false;
+    Instance* instance     = health_check_instances[i];
+    for (std::size_t i = 0; i < health_checker_list_.size(); ++i) {
+      HealthChecker*& detector = health_checker_list_[i];
+      DetectResult detector_result;
+      ReturnCode ret = detector->DetectInstance(*instance, detector_result);
+      LogDetectResult(*instance, detector_result);
+      if (ret == kReturnOk) {
+        is_detect_success = true;
+        break;
+      }
+    }
+    UpdateCircuitBreakerStatus(circuit_breaker_chain, *instance, is_detect_success);
+  }
+  return kReturnOk;
+}
+
+bool HealthCheckerChainImpl::PrepareDetect(ServiceData*& service_data,
+                                           std::vector<Instance*>& health_check_instances) {
   POLARIS_LOG(LOG_INFO, "here detectInstance, namespace: %s, name: %s, when: %s",
               service_key_.namespace_.c_str(), service_key_.name_.c_str(), when_.c_str());
   uint64_t now_time_ms = Time::GetCurrentTimeMs();
   if (now_time_ms - last_detect_time_ms_ <= health_check_ttl_ms_) {
-    return kReturnOk;
+    return false;
   }
   last_detect_time_ms_ = now_time_ms;
 
   if (local_registry_ == NULL) {
     POLARIS_LOG(LOG_ERROR, "The health checker local_registry_ of service[%s/%s] is null",
                 service_key_.namespace_.c_str(), service_key_.name_.c_str());
-    return kReturnOk;
+    return false;
   }
 
-  ServiceData* service_data = NULL;
-  std::vector<Instance*> health_check_instances;
+  service_data = NULL;
   if (local_registry_->GetCircuitBreakerInstances(service_key_, service_data,
                                                   health_check_instances) != kReturnOk) {
-    return kReturnOk;
+    return false;
   }
 
-  ServiceInstances service_instances(service_data);
-  std::map<std::string, Instance*>& instance_map = service_instances.GetInstances();
-
   if (when_ == HealthCheckerConfig::kChainWhenAlways) {
     health_check_instances.clear();
     // 健康检查设置为always, 则探测所有非隔离实例
+    std::map<std::string, Instance*>& instance_map =
+        service_data->GetServiceDataImpl()->GetInstancesData()->instances_map_;
     for (std::map<std::string, Instance*>::iterator instance_iter = instance_map.begin();
          instance_iter != instance_map.end(); ++instance_iter) {
       if (!instance_iter->second->isIsolate()) {
@@ -160,53 +193,55 @@ ReturnCode HealthCheckerChainImpl::DetectInstance(CircuitBreakerChain& circuit_b
     // 健康检查设置不为on_recover, 则探测半开实例
     health_check_instances.clear();
   }
+  if (health_check_instances.empty()) {
+    service_data->DecrementRef();
+    service_data = NULL;
+    return false;
+  }
+  return true;
+}
 
-  for (std::size_t i = 0; i < health_check_instances.size(); ++i) {
-    bool is_detect_success = false;
-    Instance* instance     = health_check_instances[i];
-    for (std::size_t i = 0; i < health_checker_list_.size(); ++i) {
-      HealthChecker*& detector = health_checker_list_[i];
-      DetectResult detector_result;
-      if (kReturnOk == detector->DetectInstance(*instance, detector_result)) {
-        POLARIS_LOG(LOG_INFO,
-                    "The detector[%s] of service[%s/%s] getting instance[%s-%s:%d] success[0], "
-                    "elapsing %" PRIu64 " ms",
-                    detector_result.detect_type.c_str(), service_key_.namespace_.c_str(),
-                    service_key_.name_.c_str(), instance->GetId().c_str(),
-                    instance->GetHost().c_str(), instance->GetPort(), detector_result.elapse);
-        is_detect_success = true;
-        break;
-      } else {
-        POLARIS_LOG(LOG_INFO,
-                    "The detector[%s] of service[%s/%s] getting instance[%s-%s:%d] failed[%d],"
-                    " elapsing %" PRIu64 " ms",
-                    detector_result.detect_type.c_str(), service_key_.namespace_.c_str(),
-                    service_key_.name_.c_str(), instance->GetId().c_str(),
-                    instance->GetHost().c_str(), instance->GetPort(), detector_result.return_code,
-                    detector_result.elapse);
-      }
-    }
-    // 探活插件成功，则将熔断实例置为半开状态，其他实例状态不变
-    // 探活插件失败，则将健康实例置为熔断状态，其他实例状态不变
-    if (is_detect_success) {
-      circuit_breaker_chain.TranslateStatus(instance->GetId(), kCircuitBreakerOpen,
-                                            kCircuitBreakerHalfOpen);
-      POLARIS_LOG(LOG_INFO,
-                  "service[%s/%s] getting instance[%s-%s:%d] detectoring success, change to "
-                  "half-open status",
-                  service_key_.namespace_.c_str(), service_key_.name_.c_str(),
-                  instance->GetId().c_str(), instance->GetHost().c_str(), instance->GetPort());
-    } else {
-      circuit_breaker_chain.TranslateStatus(instance->GetId(), kCircuitBreakerClose,
-                                            kCircuitBreakerOpen);
-      POLARIS_LOG(LOG_INFO,
-                  "service[%s/%s] getting instance[%s-%s:%d] detectoring failed, change to "
-                  "open status",
-                  service_key_.namespace_.c_str(), service_key_.name_.c_str(),
-                  instance->GetId().c_str(), instance->GetHost().c_str(), instance->GetPort());
-    }
+void HealthCheckerChainImpl::LogDetectResult(Instance& instance,
+                                             const DetectResult& detect_result) {
+  if (detect_result.return_code == kReturnOk) {
+    POLARIS_LOG(LOG_INFO,
+                "The detector[%s] of service[%s/%s] getting instance[%s-%s:%d] success[0], "
+                "elapsing %" PRIu64 " ms",
+                detect_result.detect_type.c_str(), service_key_.namespace_.c_str(),
+                service_key_.name_.c_str(), instance.GetId().c_str(), instance.GetHost().c_str(),
+                instance.GetPort(), detect_result.elapse);
+  } else {
+    POLARIS_LOG(LOG_INFO,
+                "The detector[%s] of service[%s/%s] getting instance[%s-%s:%d] failed[%d],"
+                " elapsing %" PRIu64 " ms",
+                detect_result.detect_type.c_str(), service_key_.namespace_.c_str(),
+                service_key_.name_.c_str(), instance.GetId().c_str(), instance.GetHost().c_str(),
+                instance.GetPort(), detect_result.return_code, detect_result.elapse);
+  }
+}
+
+void HealthCheckerChainImpl::UpdateCircuitBreakerStatus(CircuitBreakerChain& circuit_breaker_chain,
+                                                        Instance& instance,
+                                                        bool is_detect_success) {
+  // 探活插件成功，则将熔断实例置为半开状态，其他实例状态不变
+  // 探活插件失败，则将健康实例置为熔断状态，其他实例状态不变
+  if (is_detect_success) {
+    circuit_breaker_chain.TranslateStatus(instance.GetId(), kCircuitBreakerOpen,
+                                          kCircuitBreakerHalfOpen);
+    POLARIS_LOG(LOG_INFO,
+                "service[%s/%s] getting instance[%s-%s:%d] detectoring success, change to "
+                "half-open status",
+                service_key_.namespace_.c_str(), service_key_.name_.c_str(),
+                instance.GetId().c_str(), instance.GetHost().c_str(), instance.GetPort());
+  } else {
+    circuit_breaker_chain.TranslateStatus(instance.GetId(), kCircuitBreakerClose,
+                                          kCircuitBreakerOpen);
+    POLARIS_LOG(LOG_INFO,
+                "service[%s/%s] getting instance[%s-%s:%d] detectoring failed, change to "
+                "open status",
+                service_key_.namespace_.c_str(), service_key_.name_.c_str(),
+                instance.GetId().c_str(), instance.GetHost().c_str(), instance.GetPort());
   }
-  return kReturnOk;
 }
 
 std::vector<HealthChecker*> HealthCheckerChainImpl::GetHealthCheckers() {
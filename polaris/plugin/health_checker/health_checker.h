@@ -41,6 +41,11 @@ static const uint64_t kDetectorIntervalDefault = 10 * 1000;  // 探活默认时
 
 static const char kTimeoutKey[]       = "timeout";  // 超时时间毫秒
 static const uint64_t kTimeoutDefault = 500;        // 默认500ms
+
+static const char kMaxInFlightKey[]     = "maxInFlight";  // 所有服务同时进行的探测数上限
+static const int kMaxInFlightDefault    = 256;
+static const char kServiceInFlightKey[] = "serviceInFlight";  // 单个服务同时进行的探测数上限
+static const int kServiceInFlightDefault = 16;
 }  // namespace HealthCheckerConfig
 
 class HealthCheckerChainImpl : public HealthCheckerChain {
@@ -55,11 +60,29 @@ public:
 
   virtual std::vector<HealthChecker*> GetHealthCheckers();
 
+  /// @brief 获取本轮需要探测的实例
+  ///
+  /// @param service_data 返回持有引用的服务数据，探测结束前保证实例有效
+  /// @param detect_instances 需要探测的实例
+  /// @return true 到达探测周期且有需要探测的实例
+  bool PrepareDetect(ServiceData*& service_data, std::vector<Instance*>& detect_instances);
+
+  void LogDetectResult(Instance& instance, const DetectResult& detect_result);
+
+  // 根据实例的探测结果转换熔断状态
+  void UpdateCircuitBreakerStatus(CircuitBreakerChain& circuit_breaker_chain, Instance& instance,
+                                  bool is_detect_success);
+
+  const std::vector<HealthChecker*>& GetHealthCheckerList() { return health_checker_list_; }
+
+  int GetServiceInFlight() const { return service_in_flight_; }
+
 private:
   ServiceKey service_key_;
   uint64_t health_check_ttl_ms_;  // 服务探测周期ms
   uint64_t last_detect_time_ms_;  //  上一次探测时间
   std::string when_;
+  int service_in_flight_;  // 服务同时进行的探测数
   LocalRegistry* local_registry_;
   std::vector<HealthChecker*> health_checker_list_;
 };
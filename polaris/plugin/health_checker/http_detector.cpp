@@ -42,6 +42,10 @@ ReturnCode HttpHealthChecker::Init(Config* config, Context* /*context*/) {
   }
   timeout_ms_ = config->GetMsOrDefault(HealthCheckerConfig::kTimeoutKey,
                                        HealthCheckerConfig::kTimeoutDefault);
+  probe_option_.is_udp_        = false;
+  probe_option_.send_package_  = std::string("GET ") + request_path_ + " HTTP/1.0\r\n\r\n";
+  probe_option_.wait_response_ = true;
+  probe_option_.timeout_ms_    = timeout_ms_;
   return kReturnOk;
 }
 
@@ -53,49 +57,45 @@ ReturnCode HttpHealthChecker::DetectInstance(Instance& instance, DetectResult& d
     detect_result.elapse      = Time::GetCurrentTimeMs() - start_time_ms;
     return kReturnInvalidConfig;
   }
-  std::string host         = instance.GetHost();
-  int port                 = instance.GetPort();
-  std::string http_request = std::string("GET ") + request_path_ + " HTTP/1.0\r\n\r\n";
+  std::string host = instance.GetHost();
+  int port         = instance.GetPort();
   std::string http_response;
-  int retcode = NetClient::TcpSendRecv(host, port, timeout_ms_, http_request, &http_response);
+  int retcode = NetClient::TcpSendRecv(host, port, timeout_ms_, probe_option_.send_package_,
+                                       &http_response);
   if (retcode < 0) {
     detect_result.return_code = kReturnNetworkFailed;
     detect_result.elapse      = Time::GetCurrentTimeMs() - start_time_ms;
     return kReturnNetworkFailed;
   }
+  detect_result.return_code = CheckResponse(http_response);
+  detect_result.elapse      = Time::GetCurrentTimeMs() - start_time_ms;
+  return static_cast<ReturnCode>(detect_result.return_code);
+}
+
+const char* HttpHealthChecker::GetDetectType() { return kPluginHttpHealthChecker; }
+
+ReturnCode HttpHealthChecker::CheckResponse(const std::string& http_response) {
   if (http_response.find("\r\n\r\n") == std::string::npos) {
-    detect_result.return_code = kReturnServerError;
-    detect_result.elapse      = Time::GetCurrentTimeMs() - start_time_ms;
     return kReturnServerError;
   }
   size_t pos = http_response.find("\r\n");
   if (pos == std::string::npos) {
-    detect_result.return_code = kReturnServerError;
-    detect_result.elapse      = Time::GetCurrentTimeMs() - start_time_ms;
     return kReturnServerError;
   }
   std::string status_line = StringUtils::StringTrim(http_response.substr(0, pos));
   pos                     = status_line.find(' ');
   if (pos == std::string::npos) {
-    detect_result.return_code = kReturnServerError;
-    detect_result.elapse      = Time::GetCurrentTimeMs() - start_time_ms;
     return kReturnServerError;
   }
   status_line = StringUtils::StringTrim(status_line.substr(pos));
   pos         = status_line.find(' ');
   if (pos == std::string::npos) {
-    detect_result.return_code = kReturnServerError;
-    detect_result.elapse      = Time::GetCurrentTimeMs() - start_time_ms;
     return kReturnServerError;
   }
   int status_code = atoi(status_line.substr(0, pos).c_str());
   if (status_code < 100 || status_code >= 400) {
-    detect_result.return_code = kReturnServerError;
-    detect_result.elapse      = Time::GetCurrentTimeMs() - start_time_ms;
     return kReturnServerError;
   }
-  detect_result.return_code = kReturnOk;
-  detect_result.elapse      = Time::GetCurrentTimeMs() - start_time_ms;
   return kReturnOk;
 }
 
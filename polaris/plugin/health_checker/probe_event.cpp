@@ -0,0 +1,194 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#include "plugin/health_checker/probe_event.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "reactor/task.h"
+#include "utils/netclient.h"
+#include "utils/time_clock.h"
+
+namespace polaris {
+
+static const std::size_t kProbeMaxResponseSize = 4096;
+
+ProbeEvent::ProbeEvent(Reactor& reactor, AsyncHealthChecker* checker, DetectCallback* callback)
+    : EventBase(-1), reactor_(reactor), checker_(checker), option_(checker->GetProbeOption()),
+      callback_(callback), start_time_ms_(0), timeout_iter_(reactor.TimingTaskEnd()),
+      connected_(false), finished_(false), send_bytes_(0) {}
+
+ProbeEvent::~ProbeEvent() {
+  if (fd_ >= 0) {  // 未完成的探测在reactor退出后释放
+    close(fd_);
+    fd_ = -1;
+  }
+  checker_  = NULL;
+  callback_ = NULL;
+}
+
+void ProbeEvent::Start(const std::string& host, int port) {
+  start_time_ms_ = Time::GetCurrentTimeMs();
+  fd_            = socket(AF_INET, option_.is_udp_ ? SOCK_DGRAM : SOCK_STREAM, 0);
+  if (fd_ < 0) {
+    POLARIS_LOG(LOG_ERROR, "create probe socket to %s:%d failed, errno:%d", host.c_str(), port,
+                errno);
+    return Finish(kReturnNetworkFailed);
+  }
+  NetClient::SetNonBlock(fd_);
+  NetClient::SetCloExec(fd_);
+  if (!option_.is_udp_) {
+    NetClient::SetNoDelay(fd_);
+  }
+  struct sockaddr_in addr;
+  bzero(static_cast<void*>(&addr), sizeof(struct sockaddr_in));
+  addr.sin_family = AF_INET;
+  addr.sin_port   = htons(port);
+  if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+    POLARIS_LOG(LOG_ERROR, "probe with invalid host %s", host.c_str());
+    return Finish(kReturnNetworkFailed);
+  }
+  // UDP也执行connect，这样对端端口不可达时能收到错误
+  if (connect(fd_, (struct sockaddr*)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+    POLARIS_LOG(LOG_ERROR, "probe connect to %s:%d failed, errno:%d", host.c_str(), port, errno);
+    return Finish(kReturnNetworkFailed);
+  }
+  if (!reactor_.AddEventHandler(this)) {
+    fd_ = -1;  // 注册失败时reactor已关闭fd
+    return Finish(kReturnNetworkFailed);
+  }
+  // 连接完成后会触发写事件，在写事件中发送探测包
+  timeout_iter_ = reactor_.AddTimingTask(
+      new TimingFuncTask<ProbeEvent>(OnTimeout, this, option_.timeout_ms_));
+}
+
+void ProbeEvent::ReadHandler() {
+  if (finished_) {
+    return;
+  }
+  if (!connected_) {  // 连接失败时也会触发读事件
+    if (!CheckConnected()) {
+      Finish(kReturnNetworkFailed);
+    }
+    return;
+  }
+  char buffer[1024];
+  ssize_t bytes = 0;
+  while (response_.size() < kProbeMaxResponseSize) {
+    bytes = recv(fd_, buffer, sizeof(buffer), 0);
+    if (bytes <= 0) {
+      break;
+    }
+    response_.append(buffer, bytes);
+  }
+  if (response_.empty()) {
+    if (bytes == 0 || errno != EAGAIN) {  // 对端关闭或出错
+      Finish(kReturnNetworkFailed);
+    }
+    return;
+  }
+  if (option_.wait_response_) {
+    Finish(checker_->CheckResponse(response_));
+  }
+}
+
+void ProbeEvent::WriteHandler() {
+  if (finished_) {
+    return;
+  }
+  if (!connected_) {
+    if (!CheckConnected()) {
+      return Finish(kReturnNetworkFailed);
+    }
+    connected_ = true;
+    if (option_.send_package_.empty()) {  // 只做连接探测
+      return Finish(kReturnOk);
+    }
+  }
+  SendPackage();
+}
+
+void ProbeEvent::CloseHandler() {
+  if (!finished_) {
+    Finish(kReturnNetworkFailed);
+  }
+}
+
+void ProbeEvent::OnTimeout(ProbeEvent* probe) {
+  probe->timeout_iter_ = probe->reactor_.TimingTaskEnd();
+  probe->Finish(kReturnTimeout);
+}
+
+bool ProbeEvent::CheckConnected() {
+  int val       = 0;
+  socklen_t len = sizeof(val);
+  if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, static_cast<void*>(&val), &len) < 0 || val != 0) {
+    return false;
+  }
+  return true;
+}
+
+void ProbeEvent::SendPackage() {
+  const std::string& send_package = option_.send_package_;
+  while (send_bytes_ < send_package.size()) {
+    ssize_t bytes = send(fd_, send_package.data() + send_bytes_, send_package.size() - send_bytes_,
+                         MSG_NOSIGNAL);
+    if (bytes < 0) {
+      if (errno != EAGAIN) {
+        Finish(kReturnNetworkFailed);
+      }
+      return;  // 等待下次写事件继续发送
+    }
+    send_bytes_ += bytes;
+    if (send_bytes_ == send_package.size() && !option_.wait_response_) {
+      return Finish(kReturnOk);
+    }
+  }
+}
+
+void ProbeEvent::Finish(ReturnCode return_code) {
+  if (finished_) {
+    return;
+  }
+  finished_ = true;
+  if (timeout_iter_ != reactor_.TimingTaskEnd()) {
+    reactor_.CancelTimingTask(timeout_iter_);
+    timeout_iter_ = reactor_.TimingTaskEnd();
+  }
+  if (fd_ >= 0) {
+    reactor_.RemoveEventHandler(fd_);
+    if (option_.is_udp_) {
+      close(fd_);
+    } else {
+      NetClient::CloseNoLinger(fd_);
+    }
+    fd_ = -1;
+  }
+  DetectResult detect_result;
+  detect_result.detect_type = checker_->GetDetectType();
+  detect_result.return_code = return_code;
+  detect_result.elapse      = Time::GetCurrentTimeMs() - start_time_ms_;
+  DetectCallback* callback  = callback_;
+  callback_                 = NULL;
+  // 本对象可能正在epoll事件处理中，需要延迟释放
+  reactor_.SubmitTask(new DeferReleaseTask<ProbeEvent>(this));
+  callback->OnDetectDone(detect_result);
+}
+
+}  // namespace polaris
@@ -0,0 +1,101 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#ifndef POLARIS_CPP_POLARIS_PLUGIN_HEALTH_CHECKER_PROBE_EVENT_H_
+#define POLARIS_CPP_POLARIS_PLUGIN_HEALTH_CHECKER_PROBE_EVENT_H_
+
+#include <stdint.h>
+
+#include <string>
+
+#include "polaris/defs.h"
+#include "polaris/plugin.h"
+#include "reactor/event.h"
+#include "reactor/reactor.h"
+
+namespace polaris {
+
+/// @brief 非阻塞探测参数，由探测插件在Init时确定
+struct ProbeOption {
+  ProbeOption() : is_udp_(false), wait_response_(false), timeout_ms_(0) {}
+
+  bool is_udp_;
+  std::string send_package_;  // TCP探测时为空则只做连接探测
+  bool wait_response_;        // 发送后是否需要等待应答
+  uint64_t timeout_ms_;
+};
+
+/// @brief 探测完成回调，在reactor线程中执行
+class DetectCallback {
+public:
+  virtual ~DetectCallback() {}
+
+  virtual void OnDetectDone(const DetectResult& detect_result) = 0;
+};
+
+/// @brief 支持在reactor中非阻塞探测的探测插件需要实现该接口
+class AsyncHealthChecker {
+public:
+  virtual ~AsyncHealthChecker() {}
+
+  virtual const char* GetDetectType() = 0;
+
+  virtual const ProbeOption& GetProbeOption() = 0;
+
+  // 检查收到的应答包是否符合预期
+  virtual ReturnCode CheckResponse(const std::string& response) = 0;
+};
+
+/// @brief 一次非阻塞探测：连接、发送、接收都由reactor的事件驱动
+///
+/// 探测完成后回调callback并提交延迟释放任务自行释放，探测完成前需要保证探测插件对象有效
+class ProbeEvent : public EventBase {
+public:
+  ProbeEvent(Reactor& reactor, AsyncHealthChecker* checker, DetectCallback* callback);
+
+  virtual ~ProbeEvent();
+
+  // 在reactor线程中发起探测，发起失败时会直接回调
+  void Start(const std::string& host, int port);
+
+  virtual void ReadHandler();
+
+  virtual void WriteHandler();
+
+  virtual void CloseHandler();
+
+  static void OnTimeout(ProbeEvent* probe);
+
+private:
+  bool CheckConnected();
+
+  void SendPackage();
+
+  void Finish(ReturnCode return_code);
+
+private:
+  Reactor& reactor_;
+  AsyncHealthChecker* checker_;
+  const ProbeOption& option_;
+  DetectCallback* callback_;
+  uint64_t start_time_ms_;
+  TimingTaskIter timeout_iter_;
+  bool connected_;
+  bool finished_;
+  std::size_t send_bytes_;
+  std::string response_;
+};
+
+}  // namespace polaris
+
+#endif  //  POLARIS_CPP_POLARIS_PLUGIN_HEALTH_CHECKER_PROBE_EVENT_H_
@@ -49,6 +49,10 @@ ReturnCode TcpHealthChecker::Init(Config* config, Context* /*context*/) {
   }
   timeout_ms_ = config->GetMsOrDefault(HealthCheckerConfig::kTimeoutKey,
                                        HealthCheckerConfig::kTimeoutDefault);
+  probe_option_.is_udp_        = false;
+  probe_option_.send_package_  = send_package_;
+  probe_option_.wait_response_ = !send_package_.empty();  // 发送了探测包就需要等待应答
+  probe_option_.timeout_ms_    = timeout_ms_;
   return kReturnOk;
 }
 
@@ -64,14 +68,18 @@ ReturnCode TcpHealthChecker::DetectInstance(Instance& instance, DetectResult& de
     detect_result.elapse      = Time::GetCurrentTimeMs() - start_time_ms;
     return kReturnNetworkFailed;
   }
+  detect_result.return_code = CheckResponse(tcp_response);
+  detect_result.elapse      = Time::GetCurrentTimeMs() - start_time_ms;
+  return static_cast<ReturnCode>(detect_result.return_code);
+}
+
+const char* TcpHealthChecker::GetDetectType() { return kPluginTcpHealthChecker; }
+
+ReturnCode TcpHealthChecker::CheckResponse(const std::string& response) {
   // 需要匹配应答包
-  if (!receive_package_.empty() && receive_package_ != tcp_response) {
-    detect_result.return_code = kReturnServerError;
-    detect_result.elapse      = Time::GetCurrentTimeMs() - start_time_ms;
+  if (!receive_package_.empty() && receive_package_ != response) {
     return kReturnServerError;
   }
-  detect_result.return_code = kReturnOk;
-  detect_result.elapse      = Time::GetCurrentTimeMs() - start_time_ms;
   return kReturnOk;
 }
 
@@ -58,6 +58,10 @@ ReturnCode UdpHealthChecker::Init(Config* config, Context* /*context*/) {
   }
   timeout_ms_ = config->GetMsOrDefault(HealthCheckerConfig::kTimeoutKey,
                                        HealthCheckerConfig::kTimeoutDefault);
+  probe_option_.is_udp_        = true;
+  probe_option_.send_package_  = send_package_;
+  probe_option_.wait_response_ = !receive_package_.empty();  // 未配置应答包则只发不收
+  probe_option_.timeout_ms_    = timeout_ms_;
   return kReturnOk;
 }
 
@@ -83,13 +87,17 @@ ReturnCode UdpHealthChecker::DetectInstance(Instance& instance, DetectResult& de
     detect_result.elapse      = Time::GetCurrentTimeMs() - start_time_ms;
     return kReturnNetworkFailed;
   }
-  if (!receive_package_.empty() && receive_package_ != udp_response) {
-    detect_result.return_code = kReturnServerError;
-    detect_result.elapse      = Time::GetCurrentTimeMs() - start_time_ms;
+  detect_result.return_code = CheckResponse(udp_response);
+  detect_result.elapse      = Time::GetCurrentTimeMs() - start_time_ms;
+  return static_cast<ReturnCode>(detect_result.return_code);
+}
+
+const char* UdpHealthChecker::GetDetectType() { return kPluginUdpHealthChecker; }
+
+ReturnCode UdpHealthChecker::CheckResponse(const std::string& response) {
+  if (!receive_package_.empty() && receive_package_ != response) {
     return kReturnServerError;
   }
-  detect_result.return_code = kReturnOk;
-  detect_result.elapse      = Time::GetCurrentTimeMs() - start_time_ms;
   return kReturnOk;
 }
 
@@ -19,6 +19,7 @@
 #include <string>
 
 #include "polaris/defs.h"
+#include "plugin/health_checker/probe_event.h"
 #include "polaris/plugin.h"
 
 namespace polaris {
@@ -27,7 +28,7 @@ class Config;
 class Context;
 class Instance;
 
-class UdpHealthChecker : public HealthChecker {
+class UdpHealthChecker : public HealthChecker, public AsyncHealthChecker {
 public:
   UdpHealthChecker();
 
@@ -37,10 +38,17 @@ public:
 
   virtual ReturnCode DetectInstance(Instance& instance, DetectResult& detect_result);
 
+  virtual const char* GetDetectType();
+
+  virtual const ProbeOption& GetProbeOption() { return probe_option_; }
+
+  virtual ReturnCode CheckResponse(const std::string& response);
+
 private:
   std::string send_package_;
   std::string receive_package_;
   uint64_t timeout_ms_;
+  ProbeOption probe_option_;
 };
 
 }  // namespace polaris
@@ -25,7 +25,9 @@
 #include <map>
 #endif
 #include <algorithm>
+#include <iterator>
 #include <memory>
+#include <set>
 #include <utility>
 
 #include "logger.h"
@@ -39,12 +41,19 @@ namespace polaris {
 // hash 冲突情况下最多尝试次数
 static const int kMaxRehashIteration = 5;
 
-ContinuumSelector::ContinuumSelector() : hashFunc_(NULL), ringLen_(0) {}
+ContinuumSelector::ContinuumSelector() : hashFunc_(NULL), ringLen_(0), vnodeCnt_(0) {}
 
 ContinuumSelector::~ContinuumSelector() {
   hashFunc_ = NULL;
   ring_.clear();
   ringLen_ = 0;
+  vnodeLimits_.clear();
+}
+
+// 实例的虚拟节点数，与哈希环总长度及实例权重占比相关
+static int CalcVnodeLimit(uint32_t ringLen, uint32_t weight, double totalWeight) {
+  double percent = static_cast<double>(weight) / totalWeight;
+  return static_cast<int>(floor(static_cast<double>(ringLen) * percent)) - 1;
 }
 
 bool ContinuumSelector::Setup(InstancesSet* instance_set, uint32_t vnode_cnt,
@@ -62,6 +71,7 @@ bool ContinuumSelector::Setup(InstancesSet* instance_set, uint32_t vnode_cnt,
   }
   hashFunc_ = hash_func;
   ring_.clear();
+  vnodeLimits_.clear();  // 兼容Go版本的哈希环不支持修改
   ringLen_ = count * vnode_cnt;
   ring_.reserve(ringLen_);
 
@@ -119,9 +129,11 @@ bool ContinuumSelector::FastSetup(InstancesSet* instanceSet, uint32_t vnodeCnt,
     return false;
   }
   hashFunc_ = hashFunc;
+  vnodeCnt_ = vnodeCnt;
   ring_.clear();
   ringLen_ = instances.size() * vnodeCnt;
   ring_.reserve(ringLen_);
+  vnodeLimits_.resize(instances.size());
 
 #if __cplusplus >= 201103L
   std::unordered_map<uint64_t, uint64_t> hashVal2Key;  // 改成 unordered_map -71ms（124ms => 53ms)
@@ -136,7 +148,6 @@ bool ContinuumSelector::FastSetup(InstancesSet* instanceSet, uint32_t vnodeCnt,
     total += instances[i]->GetWeight();
   }
 
-  double percent = 0;
   char buff[128];
   double totalWeight = static_cast<double>(total);
   ContinuumPoint cp(0, 0);
@@ -144,10 +155,11 @@ bool ContinuumSelector::FastSetup(InstancesSet* instanceSet, uint32_t vnodeCnt,
     Instance* inst                   = instances[i];
     InstanceLocalValue* localValue   = inst->GetLocalValue();
     std::vector<uint64_t>& vnodeHash = localValue->AcquireVnodeHash();
-    percent                          = static_cast<double>(inst->GetWeight()) / totalWeight;
-    int limit  = static_cast<int>(floor(static_cast<double>(ringLen_) * percent)) - 1;
-    cp.hashVal = inst->GetHash();
-    cp.index   = i;
+    int limit       = CalcVnodeLimit(ringLen_, inst->GetWeight(), totalWeight);
+    vnodeLimits_[i] = limit;
+    cp.hashVal      = inst->GetHash();
+    cp.index        = i;
+    cp.vnode        = -1;
     ring_.push_back(cp);  // 添加真实节点
 
     int hashCnt = vnodeHash.size();
@@ -159,6 +171,9 @@ bool ContinuumSelector::FastSetup(InstancesSet* instanceSet, uint32_t vnodeCnt,
         if (POLARIS_LIKELY(1 == retry && k < hashCnt)) {  // 不需要计算哈希值
           hashVal = vnodeHash[k];
         } else {
+          if (j <= k) {  // 前面的虚拟节点使用了记录的哈希值，跳过这些哈希值对应的序号
+            j = k + 1;
+          }
           memset(buff, 0, sizeof(buff));
           snprintf(buff, sizeof(buff), "%s:%d", inst->GetId().c_str(), j++);
           hashVal = hashFunc(static_cast<const void*>(buff), strlen(buff), 0);
@@ -167,6 +182,7 @@ bool ContinuumSelector::FastSetup(InstancesSet* instanceSet, uint32_t vnodeCnt,
         if (POLARIS_LIKELY(hashIt == hashVal2Key.end())) {
           hashVal2Key[hashVal] = keyHi | j;
           cp.hashVal           = hashVal;
+          cp.vnode             = k;
           ring_.push_back(cp);
           if (k >= hashCnt) {  // 哈希值不足, 添加进去
             vnodeHash.push_back(hashVal);
@@ -200,6 +216,132 @@ bool ContinuumSelector::FastSetup(InstancesSet* instanceSet, uint32_t vnodeCnt,
   return true;
 }
 
+bool ContinuumSelector::Patch(const ContinuumSelector& old_selector, const InstancesData* old_data,
+                              const InstancesData* new_data) {
+  const std::vector<Instance*>& old_instances = old_data->instances_->GetInstances();
+  const std::vector<Instance*>& instances     = new_data->instances_->GetInstances();
+  if (old_selector.vnodeLimits_.size() != old_instances.size() || instances.empty()) {
+    return false;
+  }
+  hashFunc_ = old_selector.hashFunc_;
+  vnodeCnt_ = old_selector.vnodeCnt_;
+
+  // 实例按ID排序，按ID对齐新旧下标。真实节点哈希值变化的实例当作新实例处理
+  std::vector<int> new_index(old_instances.size(), -1);
+  std::vector<int> old_index(instances.size(), -1);
+  std::size_t old_pos = 0;
+  std::size_t new_pos = 0;
+  while (old_pos < old_instances.size() && new_pos < instances.size()) {
+    int result = old_instances[old_pos]->GetId().compare(instances[new_pos]->GetId());
+    if (result < 0) {
+      old_pos++;
+    } else if (result > 0) {
+      new_pos++;
+    } else {
+      if (old_instances[old_pos]->GetHash() == instances[new_pos]->GetHash()) {
+        new_index[old_pos] = new_pos;
+        old_index[new_pos] = old_pos;
+      }
+      old_pos++;
+      new_pos++;
+    }
+  }
+
+  uint32_t total = 0;
+  for (std::size_t i = 0; i < instances.size(); ++i) {
+    total += instances[i]->GetWeight();
+  }
+  double totalWeight = static_cast<double>(total);
+  uint32_t ringLen   = instances.size() * vnodeCnt_;
+  vnodeLimits_.resize(instances.size());
+  for (std::size_t i = 0; i < instances.size(); ++i) {
+    vnodeLimits_[i] = CalcVnodeLimit(ringLen, instances[i]->GetWeight(), totalWeight);
+  }
+
+  // 保留仍然存在的节点，已删除实例的节点和超出新虚拟节点数的节点直接去掉，保留的节点仍然有序
+  ring_.clear();
+  ring_.reserve(old_selector.ring_.size());
+  for (std::size_t i = 0; i < old_selector.ring_.size(); ++i) {
+    ContinuumPoint cp = old_selector.ring_[i];
+    int index         = new_index[cp.index];
+    if (index >= 0 && cp.vnode < vnodeLimits_[index]) {
+      cp.index = index;
+      ring_.push_back(cp);
+    }
+  }
+
+  std::vector<ContinuumPoint> points;
+  std::set<uint64_t> point_hash;
+  for (std::size_t i = 0; i < instances.size(); ++i) {
+    int begin = 0;
+    if (old_index[i] >= 0) {
+      begin = old_selector.vnodeLimits_[old_index[i]];
+    } else {  // 新实例，添加真实节点
+      points.push_back(ContinuumPoint(instances[i]->GetHash(), i));
+      point_hash.insert(instances[i]->GetHash());
+    }
+    if (begin < vnodeLimits_[i]) {
+      AddVnodes(instances[i], i, begin, vnodeLimits_[i], points, point_hash);
+    }
+  }
+  std::sort(points.begin(), points.end());
+  std::vector<ContinuumPoint> ring;
+  ring.reserve(ring_.size() + points.size());
+  std::merge(ring_.begin(), ring_.end(), points.begin(), points.end(), std::back_inserter(ring));
+  ring_.swap(ring);
+  ringLen_ = ring_.size();
+  POLARIS_LOG(LOG_DEBUG, "patch continuum with %zu points kept and %zu points added",
+              ring_.size() - points.size(), points.size());
+  return true;
+}
+
+void ContinuumSelector::AddVnodes(Instance* inst, int index, int begin, int limit,
+                                  std::vector<ContinuumPoint>& points,
+                                  std::set<uint64_t>& point_hash) {
+  InstanceLocalValue* localValue   = inst->GetLocalValue();
+  std::vector<uint64_t>& vnodeHash = localValue->AcquireVnodeHash();
+  char buff[128];
+  uint64_t hashVal;
+  ContinuumPoint cp(0, index);
+  for (int k = begin, j = begin + 1; k < limit; ++k) {
+    int hashCnt = vnodeHash.size();
+    int retry   = 1;
+    do {
+      if (POLARIS_LIKELY(1 == retry && k < hashCnt)) {  // 不需要计算哈希值
+        hashVal = vnodeHash[k];
+      } else {
+        if (j <= k) {
+          j = k + 1;
+        }
+        memset(buff, 0, sizeof(buff));
+        snprintf(buff, sizeof(buff), "%s:%d", inst->GetId().c_str(), j++);
+        hashVal = hashFunc_(static_cast<const void*>(buff), strlen(buff), 0);
+      }
+      std::vector<ContinuumPoint>::iterator it =
+          std::lower_bound(ring_.begin(), ring_.end(), hashVal);
+      if (POLARIS_LIKELY((it == ring_.end() || it->hashVal != hashVal) &&
+                         point_hash.insert(hashVal).second)) {
+        cp.hashVal = hashVal;
+        cp.vnode   = k;
+        points.push_back(cp);
+        if (k == hashCnt) {  // 哈希值不足, 添加进去
+          vnodeHash.push_back(hashVal);
+        } else if (k < hashCnt && retry > 1) {  // 哈希有冲突, 更新一下
+          vnodeHash[k] = hashVal;
+        }
+        break;
+      }
+      POLARIS_LOG(LOG_WARN, "hash conflict of %s vnode %d", inst->GetId().c_str(), k);
+    } while (++retry <= kMaxRehashIteration);
+    if (retry > kMaxRehashIteration) {
+      POLARIS_LOG(LOG_ERROR, "fail to generate hash @ %s:%u(id=%s limit=%d). reach %d tries",
+                  inst->GetHost().c_str(), inst->GetPort(), inst->GetId().c_str(), k,
+                  kMaxRehashIteration);
+    }
+  }
+  localValue->ReleaseVnodeHash();
+}
+
 int ContinuumSelector::Select(const Criteria& criteria) {
   if (0 == ringLen_) {
     return -1;
@@ -15,6 +15,7 @@
 #define POLARIS_CPP_POLARIS_PLUGIN_LOAD_BALANCER_RINGHASH_CONTINUUM_H_
 
 #include <stdint.h>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -29,8 +30,9 @@ class Instance;
 struct ContinuumPoint {
   uint64_t hashVal;
   int index;
+  int vnode;  // 虚拟节点序号，真实节点为-1
 
-  ContinuumPoint(uint64_t val, int idx) : hashVal(val), index(idx) {}
+  ContinuumPoint(uint64_t val, int idx) : hashVal(val), index(idx), vnode(-1) {}
 
   bool operator<(const ContinuumPoint& rhs) const { return this->hashVal < rhs.hashVal; }
 
@@ -51,6 +53,11 @@ public:
 
   bool FastSetup(InstancesSet* instanceSet, uint32_t vnodeCnt, Hash64Func hashFunc);
 
+  // 根据实例数据的差异修改上一版本的哈希环，只增删虚拟节点数有变化的实例的节点
+  // 上一版本的哈希环不是FastSetup构建的，或者没有可用实例时返回false，需要重新构建
+  bool Patch(const ContinuumSelector& old_selector, const InstancesData* old_data,
+             const InstancesData* new_data);
+
 private:
   uint32_t CalcTotalWeight(const std::vector<Instance*>& vctInstances);
 
@@ -58,10 +65,16 @@ private:
 
   bool ReHash(int iteration, uint64_t& hash_value, std::map<uint64_t, std::string>& hash_value_key);
 
+  // 为实例添加[begin, limit)的虚拟节点，哈希值与已有节点冲突时重新计算
+  void AddVnodes(Instance* inst, int index, int begin, int limit,
+                 std::vector<ContinuumPoint>& points, std::set<uint64_t>& point_hash);
+
 private:
   Hash64Func hashFunc_;               // 哈希函数
   std::vector<ContinuumPoint> ring_;  // 哈希环
   uint32_t ringLen_;                  // 哈希环长度, 用于极端情况加速计算
+  uint32_t vnodeCnt_;                 // 每个实例的平均虚拟节点数
+  std::vector<int> vnodeLimits_;      // 各实例的虚拟节点数，只有FastSetup构建时记录
 };
 
 }  // namespace polaris
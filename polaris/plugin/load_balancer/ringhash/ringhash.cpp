@@ -108,19 +108,26 @@ ReturnCode KetamaLoadBalancer::ChooseInstance(ServiceInstances* service_instance
 
 void KetamaLoadBalancer::OnInstanceUpdate(const InstancesData* old_instances,
                                           InstancesData* new_instances) {
-  std::map<std::string, Instance*>::iterator nIt  = new_instances->instances_map_.begin();
-  std::map<std::string, Instance*>::iterator nEnd = new_instances->instances_map_.end();
-  std::map<std::string, Instance*>::const_iterator oIt;
-  const std::map<std::string, Instance*>& oldInstances  = old_instances->instances_map_;
-  std::map<std::string, Instance*>::const_iterator oEnd = old_instances->instances_map_.end();
-  for (; nIt != nEnd; ++nIt) {
-    oIt = oldInstances.find(nIt->second->GetId());
-    if (oIt != oEnd) {  // 迁移数据
-      InstanceSetter nSetter(*(nIt->second));
-      InstanceSetter oSetter(*(oIt->second));
-      nSetter.CopyLocalValue(oSetter);
+  // 可用实例未变化时直接复制哈希环，否则根据实例差异修改上一版本的哈希环，避免全量重新构建
+  InstancesSet* old_set = old_instances->instances_;
+  old_set->AcquireSelectorCreationLock();
+  ContinuumSelector* old_selector = dynamic_cast<ContinuumSelector*>(old_set->GetSelector());
+  ContinuumSelector* new_selector = NULL;
+  if (old_selector != NULL) {
+    if (new_instances->available_unchanged_) {
+      new_selector = new ContinuumSelector(*old_selector);
+    } else {
+      new_selector = new ContinuumSelector();
+      if (!new_selector->Patch(*old_selector, old_instances, new_instances)) {
+        delete new_selector;  // 无法修改时在选择实例时重新构建
+        new_selector = NULL;
+      }
     }
   }
+  old_set->ReleaseSelectorCreationLock();
+  if (new_selector != NULL) {
+    new_instances->instances_->SetSelector(new_selector);
+  }
 }
 
 }  // namespace polaris
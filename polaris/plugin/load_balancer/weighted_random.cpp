@@ -17,7 +17,6 @@
 #include <stdlib.h>
 #include <time.h>
 
-#include <algorithm>
 #include <iosfwd>
 #include <vector>
 
@@ -25,22 +24,115 @@
 #include "model/model_impl.h"
 #include "polaris/config.h"
 #include "polaris/context.h"
+#include "utils/utils.h"
 
 namespace polaris {
 
+// 别名表阈值的取值范围，与rand_r返回值范围[0, 2^31)一致
+static const uint64_t kAliasThresholdScale = 1ULL << 31;
+
+void AliasSelector::Setup(ServiceInstances* service_instances, InstancesSet* instances_set,
+                          bool enable_dynamic_weight) {
+  // 先记录版本再读取数据，构建期间数据更新时下次选择会重新构建
+  Service* service         = service_instances->GetService();
+  circuit_breaker_version_ = service->GetCircuitBreakerDataVersion();
+  dynamic_weight_version_  = enable_dynamic_weight ? service->GetDynamicWeightDataVersion() : 0;
+  service_instances->GetHalfOpenInstances(half_open_instances_);
+  const std::vector<Instance*>& instances = instances_set->GetInstances();
+  std::vector<int> indexes;
+  std::vector<uint64_t> weights;
+  uint64_t sum_weight = 0;
+  for (std::size_t i = 0; i < instances.size(); ++i) {
+    Instance* item = instances[i];
+    // 判断是否获取动态权重
+    int weight = enable_dynamic_weight ? item->GetDynamicWeight() : item->GetWeight();
+    // 半开实例，修改权重为1，仍然加入分配。这样全部为半开实例时仍然有实例可以分配
+    if (half_open_instances_.find(item) != half_open_instances_.end()) {
+      weight = 1;
+    }
+    if (weight > 0) {
+      indexes.push_back(static_cast<int>(i));
+      weights.push_back(static_cast<uint64_t>(weight));
+      sum_weight += weight;
+    }
+  }
+  std::size_t count = indexes.size();
+  alias_table_.resize(count);
+  if (count == 0) {
+    return;
+  }
+  // 权重放大count倍后与总权重比较，平均值即为总权重，避免浮点误差导致分组错误
+  std::vector<std::size_t> small;
+  std::vector<std::size_t> large;
+  for (std::size_t i = 0; i < count; ++i) {
+    weights[i] *= count;
+    alias_table_[i].index_ = indexes[i];
+    alias_table_[i].alias_ = indexes[i];
+    if (weights[i] < sum_weight) {
+      small.push_back(i);
+    } else {
+      large.push_back(i);
+    }
+  }
+  while (!small.empty() && !large.empty()) {
+    std::size_t less = small.back();
+    small.pop_back();
+    std::size_t more = large.back();
+    large.pop_back();
+    alias_table_[less].threshold_ = static_cast<uint32_t>(
+        static_cast<double>(weights[less]) / sum_weight * kAliasThresholdScale);
+    alias_table_[less].alias_ = indexes[more];
+    weights[more]             = weights[more] + weights[less] - sum_weight;
+    if (weights[more] < sum_weight) {
+      small.push_back(more);
+    } else {
+      large.push_back(more);
+    }
+  }
+  // 剩余的列概率为1，总是选择本列实例
+  for (std::size_t i = 0; i < large.size(); ++i) {
+    alias_table_[large[i]].threshold_ = kAliasThresholdScale;
+  }
+  for (std::size_t i = 0; i < small.size(); ++i) {
+    alias_table_[small[i]].threshold_ = kAliasThresholdScale;
+  }
+}
+
+bool AliasSelector::IsExpired(Service* service, bool enable_dynamic_weight) const {
+  if (service->GetCircuitBreakerDataVersion() != circuit_breaker_version_) {
+    return true;
+  }
+  return enable_dynamic_weight && service->GetDynamicWeightDataVersion() != dynamic_weight_version_;
+}
+
+int AliasSelector::Select(const Criteria& /*criteria*/) {
+  // 获取随机数
+  static __thread bool thread_local_seed_not_init = true;
+  static __thread unsigned int thread_local_seed  = 0;
+  if (thread_local_seed_not_init) {
+    thread_local_seed_not_init = false;
+    thread_local_seed          = time(NULL) ^ pthread_self();
+  }
+  uint32_t column_random = rand_r(&thread_local_seed);
+  return Select(column_random, rand_r(&thread_local_seed));
+}
+
+int AliasSelector::Select(uint32_t column_random, uint32_t threshold_random) const {
+  if (POLARIS_UNLIKELY(alias_table_.empty())) {
+    return -1;
+  }
+  // 乘法移位将[0, 2^31)均匀映射到列下标，避免取模带来的偏差
+  uint64_t column         = (static_cast<uint64_t>(column_random) * alias_table_.size()) >> 31;
+  const AliasEntry& entry = alias_table_[column];
+  return threshold_random < entry.threshold_ ? entry.index_ : entry.alias_;
+}
+
 RandomLoadBalancer::RandomLoadBalancer() {
   enable_dynamic_weight_ = false;
-  data_cache_            = NULL;
   context_               = NULL;
 }
 
-RandomLoadBalancer::~RandomLoadBalancer() {
-  if (data_cache_ != NULL) {
-    data_cache_->SetClearHandler(0);
-    data_cache_->DecrementRef();
-  }
-  context_ = NULL;
-}
+RandomLoadBalancer::~RandomLoadBalancer() { context_ = NULL; }
 
 ReturnCode RandomLoadBalancer::Init(Config* config, Context* context) {
   static const char kEnableDynamicWeightKey[]   = "enableDynamicWeight";
@@ -48,80 +140,51 @@ ReturnCode RandomLoadBalancer::Init(Config* config, Context* context) {
   srand(time(NULL));
   enable_dynamic_weight_ =
       config->GetBoolOrDefault(kEnableDynamicWeightKey, kEnableDynamicWeightDefault);
-  data_cache_ = new ServiceCache<RandomLbCacheKey>();
-  context_    = context;
-  context_->GetContextImpl()->RegisterCache(data_cache_);
+  context_ = context;
   return kReturnOk;
 }
 
+AliasSelector* RandomLoadBalancer::GetSelector(ServiceInstances* service_instances,
+                                               InstancesSet* instances_set) {
+  InstancesSetImpl* instances_set_impl = instances_set->GetInstancesSetImpl();
+  Service* service                     = service_instances->GetService();
+  AliasSelector* selector =
+      static_cast<AliasSelector*>(instances_set_impl->weighted_random_selector_.Load());
+  if (POLARIS_LIKELY(selector != NULL && !selector->IsExpired(service, enable_dynamic_weight_))) {
+    return selector;
+  }
+  instances_set->AcquireSelectorCreationLock();
+  selector = static_cast<AliasSelector*>(instances_set_impl->weighted_random_selector_.Load());
+  if (selector == NULL || selector->IsExpired(service, enable_dynamic_weight_)) {
+    // 熔断或动态权重数据变化后重新构建，旧的选择子可能正在被使用，等RCU回收时间之后释放
+    selector = new AliasSelector();
+    selector->Setup(service_instances, instances_set, enable_dynamic_weight_);
+    instances_set_impl->ReplaceWeightedRandomSelector(selector,
+                                                      context_->GetContextImpl()->RcuMinTime());
+  }
+  instances_set->ReleaseSelectorCreationLock();
+  return selector;
+}
+
 ReturnCode RandomLoadBalancer::ChooseInstance(ServiceInstances* service_instances,
                                               const Criteria& criteria, Instance*& next) {
-  // 获取所有实例
   next                        = NULL;
   InstancesSet* instances_set = service_instances->GetAvailableInstances();
-  RandomLbCacheKey cache_key  = {instances_set};
-  ServiceBase* cache_value    = data_cache_->GetWithRef(cache_key);
-  RandomLbCacheValue* lb_value;
-  if (cache_value != NULL) {
-    lb_value = dynamic_cast<RandomLbCacheValue*>(cache_value);
-    if (lb_value == NULL) {
-      cache_value->DecrementRef();
-      return kReturnInvalidState;
-    }
-  } else {
-    std::vector<Instance*> instances = instances_set->GetInstances();
-    lb_value                         = new RandomLbCacheValue();
-    lb_value->prior_date_            = instances_set;
-    lb_value->prior_date_->IncrementRef();
-    lb_value->sum_weight_ = 0;
-    service_instances->GetHalfOpenInstances(lb_value->half_open_instances_);
-    lb_value->weight_instances_.reserve(instances.size());
-    for (std::size_t i = 0; i < instances.size(); ++i) {
-      Instance*& item = instances[i];
-      // 判断是否获取动态权重
-      int weight = enable_dynamic_weight_ ? item->GetDynamicWeight() : item->GetWeight();
-      // 半开实例，修改权重为1，仍然加入分配。这样全部为半开实例时仍然有实例可以分配
-      if (lb_value->half_open_instances_.find(item) != lb_value->half_open_instances_.end()) {
-        weight = 1;
-      }
-      if (weight > 0) {
-        lb_value->sum_weight_ += weight;
-        WeightInstance weight_instance;
-        weight_instance.weight_   = lb_value->sum_weight_;
-        weight_instance.instance_ = item;
-        lb_value->weight_instances_.push_back(weight_instance);
-      }
-    }
-    data_cache_->PutWithRef(cache_key, lb_value);
-  }
+  AliasSelector* selector     = GetSelector(service_instances, instances_set);
 
   if (!criteria.ignore_half_open_) {
-    service_instances->GetService()->TryChooseHalfOpenInstance(lb_value->half_open_instances_,
+    service_instances->GetService()->TryChooseHalfOpenInstance(selector->GetHalfOpenInstances(),
                                                                next);
     if (next != NULL) {
-      lb_value->DecrementRef();
       return kReturnOk;
     }
   }
 
-  if (lb_value->sum_weight_ <= 0) {
-    lb_value->DecrementRef();
+  int index = selector->Select(criteria);
+  if (index < 0) {
     return kReturnInstanceNotFound;
   }
-
-  // 获取一个随机数
-  static __thread bool thread_local_seed_not_init = true;
-  static __thread unsigned int thread_local_seed  = 0;
-  if (thread_local_seed_not_init) {
-    thread_local_seed_not_init = false;
-    thread_local_seed          = time(NULL) ^ pthread_self();
-  }
-  WeightInstance random_weight = {rand_r(&thread_local_seed) % lb_value->sum_weight_, NULL};
-  std::vector<WeightInstance>::iterator it = std::upper_bound(
-      lb_value->weight_instances_.begin(), lb_value->weight_instances_.end(), random_weight);
-  next = it->instance_;
-
-  lb_value->DecrementRef();
+  next = instances_set->GetInstances()[index];
   return kReturnOk;
 }
 
@@ -15,10 +15,12 @@
 #define POLARIS_CPP_POLARIS_PLUGIN_LOAD_BALANCER_WEIGHTED_RANDOM_H_
 
 #include <stddef.h>
+#include <stdint.h>
+
 #include <set>
 #include <vector>
 
-#include "cache/service_cache.h"
+#include "model/model_impl.h"
 #include "polaris/defs.h"
 #include "polaris/model.h"
 #include "polaris/plugin.h"
@@ -28,33 +30,42 @@ namespace polaris {
 class Config;
 class Context;
 
-struct RandomLbCacheKey {
-  InstancesSet* prior_data_;
-
-  bool operator<(const RandomLbCacheKey& rhs) const { return this->prior_data_ < rhs.prior_data_; }
+// 别名表中的一列
+struct AliasEntry {
+  uint32_t threshold_;  // 随机数小于该值时选择本列实例，否则选择别名实例
+  int index_;           // 本列实例在实例分组中的下标
+  int alias_;           // 别名实例在实例分组中的下标
 };
 
-struct WeightInstance {
-  int weight_;
-  Instance* instance_;
+/// @brief 基于Vose别名方法的加权随机选择子
+///
+/// 构建时间复杂度O(n)，每次选择只需两个随机数和一次数组访问，与实例数无关。
+/// 按实例分组构建并缓存在实例分组上，生命周期与实例分组相同
+class AliasSelector : public Selector {
+public:
+  AliasSelector() : circuit_breaker_version_(0), dynamic_weight_version_(0) {}
 
-  bool operator<(const WeightInstance& rhs) const { return this->weight_ < rhs.weight_; }
-};
+  virtual ~AliasSelector() {}
 
-class RandomLbCacheValue : public CacheValueBase {
-public:
-  virtual ~RandomLbCacheValue() {
-    prior_date_->DecrementRef();
-    prior_date_ = NULL;
-    sum_weight_ = 0;
-    weight_instances_.clear();
-  }
+  // 构建别名表，半开实例权重修改为1，权重为0的实例不参与选择
+  void Setup(ServiceInstances* service_instances, InstancesSet* instances_set,
+             bool enable_dynamic_weight);
 
-public:
-  InstancesSet* prior_date_;
+  // 构建别名表时使用的熔断数据或动态权重数据已更新，需要重新构建
+  bool IsExpired(Service* service, bool enable_dynamic_weight) const;
+
+  virtual int Select(const Criteria& criteria);
+
+  // 使用给定的两个随机数选择实例下标，随机数范围为[0, 2^31)，没有可选择的实例时返回-1
+  int Select(uint32_t column_random, uint32_t threshold_random) const;
+
+  std::set<Instance*>& GetHalfOpenInstances() { return half_open_instances_; }
+
+private:
+  uint64_t circuit_breaker_version_;
+  uint64_t dynamic_weight_version_;
   std::set<Instance*> half_open_instances_;
-  int sum_weight_;
-  std::vector<WeightInstance> weight_instances_;
+  std::vector<AliasEntry> alias_table_;
 };
 
 class RandomLoadBalancer : public LoadBalancer {
@@ -70,10 +81,12 @@ public:
   virtual ReturnCode ChooseInstance(ServiceInstances* instances, const Criteria& criteria,
                                     Instance*& next);
 
+private:
+  AliasSelector* GetSelector(ServiceInstances* service_instances, InstancesSet* instances_set);
+
 private:
   bool enable_dynamic_weight_;
   Context* context_;
-  ServiceCache<RandomLbCacheKey>* data_cache_;
 };
 
 }  // namespace polaris
@@ -136,6 +136,12 @@ void InMemoryRegistry::RunGcTask() {
   service_route_rule_data_.CheckGc(min_gc_time);
   service_rate_limit_data_.CheckGc(min_gc_time);
   service_circuit_breaker_config_data_.CheckGc(min_gc_time);
+  pthread_rwlock_rdlock(&rwlock_);
+  for (std::map<ServiceKey, Service*>::iterator service_it = service_cache_.begin();
+       service_it != service_cache_.end(); ++service_it) {
+    service_it->second->GetServiceImpl()->CheckGc(min_gc_time);
+  }
+  pthread_rwlock_unlock(&rwlock_);
 }
 
 Service* InMemoryRegistry::CreateServiceInLock(const ServiceKey& service_key) {
@@ -170,28 +176,27 @@ void InMemoryRegistry::DeleteServiceInLock(const ServiceKey& service_key) {
   pthread_rwlock_unlock(&rwlock_);
 }
 
-void InMemoryRegistry::CheckExpireServiceData(uint64_t min_access_time,
-                                              RcuMap<ServiceKey, ServiceData>& rcu_cache,
+void InMemoryRegistry::CheckExpireServiceData(uint64_t min_access_time, ServiceDataMap& rcu_cache,
                                               ServiceDataType service_data_type) {
-  std::vector<ServiceKey> expired_services;
+  std::vector<HashedServiceKey> expired_services;
   ContextImpl* context_impl = context_->GetContextImpl();
   rcu_cache.CheckExpired(min_access_time, expired_services);
   ServiceKeyWithType service_key_with_type;
   service_key_with_type.data_type_ = service_data_type;
   for (std::size_t i = 0; i < expired_services.size(); ++i) {
-    service_key_with_type.service_key_ = expired_services[i];
+    const ServiceKey& service_key      = expired_services[i].service_key_;
+    service_key_with_type.service_key_ = service_key;
     pthread_rwlock_wrlock(&notify_rwlock_);
     if (service_data_notify_map_.erase(service_key_with_type) > 0) {  // 有通知对象表示注册过handler
-      context_->GetServerConnector()->DeregisterEventHandler(expired_services[i],
-                                                             service_data_type);
+      context_->GetServerConnector()->DeregisterEventHandler(service_key, service_data_type);
     }
     if (service_data_type == kServiceDataInstances) {  // 清除实例数据时对应的服务级别插件也删除
-      context_impl->DeleteServiceContext(expired_services[i]);
-      DeleteServiceInLock(expired_services[i]);
+      context_impl->DeleteServiceContext(service_key);
+      DeleteServiceInLock(service_key);
     }
     rcu_cache.Delete(expired_services[i]);
-    context_impl->GetServiceRecord()->ServiceDataDelete(expired_services[i], service_data_type);
-    context_impl->GetCacheManager()->GetCachePersist().PersistServiceData(expired_services[i],
+    context_impl->GetServiceRecord()->ServiceDataDelete(service_key, service_data_type);
+    context_impl->GetCacheManager()->GetCachePersist().PersistServiceData(service_key,
                                                                           service_data_type, "");
     pthread_rwlock_unlock(&notify_rwlock_);
   }
@@ -210,14 +215,15 @@ void InMemoryRegistry::RemoveExpireServiceData(uint64_t current_time) {
 ReturnCode InMemoryRegistry::GetServiceDataWithRef(const ServiceKey& service_key,
                                                    ServiceDataType data_type,
                                                    ServiceData*& service_data) {
+  const HashedServiceKey& hashed_key = ThreadLocalHashedServiceKey(service_key);
   if (data_type == kServiceDataInstances) {
-    service_data = service_instances_data_.Get(service_key);
+    service_data = service_instances_data_.Get(hashed_key);
   } else if (data_type == kServiceDataRouteRule) {
-    service_data = service_route_rule_data_.Get(service_key);
+    service_data = service_route_rule_data_.Get(hashed_key);
   } else if (data_type == kServiceDataRateLimit) {
-    service_data = service_rate_limit_data_.Get(service_key);
+    service_data = service_rate_limit_data_.Get(hashed_key);
   } else if (data_type == kCircuitBreakerConfig) {
-    service_data = service_circuit_breaker_config_data_.Get(service_key);
+    service_data = service_circuit_breaker_config_data_.Get(hashed_key);
   }
   if (service_data != NULL) {
     if (service_data->GetDataStatus() < kDataIsSyncing) {
@@ -297,6 +303,8 @@ ReturnCode InMemoryRegistry::UpdateServiceData(const ServiceKey& service_key,
     service->UpdateData(service_data);
   }
   ContextImpl* context_impl = context_->GetContextImpl();
+  HashedServiceKey hashed_key;
+  SetHashedServiceKey(hashed_key, service_key);
   if (data_type == kServiceDataInstances) {
     if (service == NULL) {  // 服务被反注册了
       if (service_data != NULL) {
@@ -304,22 +312,22 @@ ReturnCode InMemoryRegistry::UpdateServiceData(const ServiceKey& service_key,
       }
       return kReturnOk;
     }
-    ServiceData* old_service_data = service_instances_data_.Get(service_key);
+    ServiceData* old_service_data = service_instances_data_.Get(hashed_key);
     if (old_service_data != NULL) {
       PluginManager::Instance().OnPreUpdateServiceData(old_service_data, service_data);
       old_service_data->DecrementRef();
     }
-    service_instances_data_.Update(service_key, service_data);
+    service_instances_data_.Update(hashed_key, service_data);
   } else if (data_type == kServiceDataRouteRule) {
     if (service_data != NULL) {  // 填充环境变量
       const SystemVariables& system_variables = context_impl->GetSystemVariables();
       service_data->GetServiceDataImpl()->FillSystemVariables(system_variables);
     }
-    service_route_rule_data_.Update(service_key, service_data);
+    service_route_rule_data_.Update(hashed_key, service_data);
   } else if (data_type == kServiceDataRateLimit) {
-    service_rate_limit_data_.Update(service_key, service_data);
+    service_rate_limit_data_.Update(hashed_key, service_data);
   } else if (data_type == kCircuitBreakerConfig) {
-    service_circuit_breaker_config_data_.Update(service_key, service_data);
+    service_circuit_breaker_config_data_.Update(hashed_key, service_data);
   } else {
     POLARIS_ASSERT(false);
   }
@@ -336,8 +344,7 @@ ReturnCode InMemoryRegistry::UpdateServiceData(const ServiceKey& service_key,
     context_impl->GetCacheManager()->GetCachePersist().PersistServiceData(service_key, data_type,
                                                                           "");
   } else {
-    context_impl->GetCacheManager()->GetCachePersist().PersistServiceData(
-        service_data->GetServiceKey(), service_data->GetDataType(), service_data->ToJsonString());
+    context_impl->GetCacheManager()->GetCachePersist().PersistServiceData(service_data);
   }
   return kReturnOk;
 }
@@ -402,7 +409,7 @@ ReturnCode InMemoryRegistry::UpdateSetCircuitBreakerData(
 ReturnCode InMemoryRegistry::GetCircuitBreakerInstances(const ServiceKey& service_key,
                                                         ServiceData*& service_data,
                                                         std::vector<Instance*>& open_instances) {
-  service_data = service_instances_data_.Get(service_key, false);
+  service_data = service_instances_data_.Get(ThreadLocalHashedServiceKey(service_key), false);
   if (service_data == NULL) {
     return kReturnServiceNotFound;
   }
@@ -20,7 +20,8 @@
 #include <map>
 #include <set>
 
-#include "cache/rcu_map.h"
+#include "cache/hashed_service_key.h"
+#include "cache/rcu_hash_map.h"
 #include "model/model_impl.h"
 #include "polaris/defs.h"
 #include "polaris/model.h"
@@ -115,7 +116,11 @@ private:
 
   void DeleteServiceInLock(const ServiceKey& service_key);
 
-  void CheckExpireServiceData(uint64_t min_access_time, RcuMap<ServiceKey, ServiceData>& rcu_cache,
+  // 服务数据按驻留的ServiceKey索引，查询时只需计算一次哈希并比较指针
+  typedef RcuHashMap<HashedServiceKey, ServiceData, HashedServiceKeyHash>
+      ServiceDataMap;
+
+  void CheckExpireServiceData(uint64_t min_access_time, ServiceDataMap& rcu_cache,
                               ServiceDataType service_data_type);
 
 private:
@@ -132,10 +137,10 @@ private:
   std::map<ServiceKey, Service*> service_cache_;
 
   // 3. 服务数据：用于存储从服务器加载的服务数据
-  RcuMap<ServiceKey, ServiceData> service_instances_data_;
-  RcuMap<ServiceKey, ServiceData> service_route_rule_data_;
-  RcuMap<ServiceKey, ServiceData> service_rate_limit_data_;
-  RcuMap<ServiceKey, ServiceData> service_circuit_breaker_config_data_;
+  ServiceDataMap service_instances_data_;
+  ServiceDataMap service_route_rule_data_;
+  ServiceDataMap service_rate_limit_data_;
+  ServiceDataMap service_circuit_breaker_config_data_;
 
   uint64_t service_expire_time_;
   uint64_t service_refresh_interval_;
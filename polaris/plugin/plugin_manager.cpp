@@ -205,6 +205,11 @@ void PluginManager::OnPreUpdateServiceData(ServiceData* oldData, ServiceData* ne
   std::vector<InstancePreUpdateHandler> handlers(instancePreUpdateHandlers_.begin(),
                                                  instancePreUpdateHandlers_.end());
   instancePreUpdatelock_.Unlock();
+  if (handlers.empty()) {
+    return;
+  }
+  // 只有负载均衡插件需要复用实例本地数据时才与上一版本比较
+  newData->GetServiceDataImpl()->DiffInstancesData(oldData->GetServiceDataImpl());
   std::vector<InstancePreUpdateHandler>::iterator it = handlers.begin();
   for (; it != handlers.end(); ++it) {
     (*it)(oldData->GetServiceDataImpl()->data_.instances_,
@@ -30,6 +30,7 @@
 #include <string>
 #include <utility>
 #include "api/consumer_api.h"
+#include "cache/lru_map.h"
 #include "context_internal.h"
 #include "logger.h"
 #include "model/model_impl.h"
@@ -90,6 +91,27 @@ ReturnCode ToClientReturnCode(const google::protobuf::UInt32Value& code) {
 }
 
 ///////////////////////////////////////////////////////////////////////////////
+void BuildDiscoverRequest(const ServiceListener& service_listener,
+                          ::v1::DiscoverRequest& request) {
+  const ServiceKey& service_key = service_listener.service_.service_key_;
+  if (!service_key.namespace_.empty()) {
+    request.mutable_service()->mutable_namespace_()->set_value(service_key.namespace_);
+  }
+  request.mutable_service()->mutable_name()->set_value(service_key.name_);
+  request.mutable_service()->mutable_revision()->set_value(service_listener.revision_);
+  if (service_listener.service_.data_type_ == kServiceDataInstances) {
+    request.set_type(v1::DiscoverRequest::INSTANCE);
+  } else if (service_listener.service_.data_type_ == kServiceDataRouteRule) {
+    request.set_type(v1::DiscoverRequest::ROUTING);
+  } else if (service_listener.service_.data_type_ == kServiceDataRateLimit) {
+    request.set_type(v1::DiscoverRequest::RATE_LIMIT);
+  } else if (service_listener.service_.data_type_ == kCircuitBreakerConfig) {
+    request.set_type(v1::DiscoverRequest::CIRCUIT_BREAKER);
+  } else {
+    POLARIS_ASSERT(false);
+  }
+}
+
 DiscoverEventTask::DiscoverEventTask(GrpcServerConnector* connector, const ServiceKey& service_key,
                                      ServiceDataType data_type, uint64_t sync_interval,
                                      ServiceEventHandler* handler) {
@@ -112,12 +134,96 @@ void DiscoverEventTask::Run() {
   handler_ = NULL;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+DiscoverDecodeTask::DiscoverDecodeTask(GrpcServerConnector* connector, uint64_t generation,
+                                       uint64_t seq, grpc::Buffer* buffer)
+    : connector_(connector), generation_(generation), seq_(seq), buffer_(buffer) {}
+
+DiscoverDecodeTask::~DiscoverDecodeTask() {
+  if (buffer_ != NULL) {
+    delete buffer_;
+    buffer_ = NULL;
+  }
+}
+
+void DiscoverDecodeTask::Run() {
+  v1::DiscoverResponse* response = new v1::DiscoverResponse();
+  if (!grpc::GrpcCodec::ParseBufferToMessage(buffer_, *response)) {
+    delete response;
+    response = NULL;
+  }
+  buffer_          = NULL;  // 不管解析是否成功，buffer都已经释放
+  Reactor& reactor = connector_->GetReactor();
+  reactor.SubmitTask(new DiscoverDecodedTask(connector_, generation_, seq_, response));
+  reactor.Notify();
+}
+
+DiscoverDecodedTask::DiscoverDecodedTask(GrpcServerConnector* connector, uint64_t generation,
+                                         uint64_t seq, v1::DiscoverResponse* response)
+    : connector_(connector), generation_(generation), seq_(seq), response_(response) {}
+
+DiscoverDecodedTask::~DiscoverDecodedTask() {
+  if (response_ != NULL) {
+    delete response_;
+    response_ = NULL;
+  }
+}
+
+void DiscoverDecodedTask::Run() {
+  connector_->ProcessDecodedResponse(generation_, seq_, response_);
+  response_ = NULL;
+}
+
+DiscoverHandlerTask::DiscoverHandlerTask(DiscoverHandlerEvent event,
+                                         const ServiceKeyWithType& service,
+                                         ServiceEventHandler* handler)
+    : event_(event), service_(service), handler_(handler), response_(NULL),
+      data_status_(kDataIsSyncing), cache_version_(0) {}
+
+DiscoverHandlerTask::~DiscoverHandlerTask() {
+  if (response_ != NULL) {
+    delete response_;
+    response_ = NULL;
+  }
+  if (event_ == kDiscoverHandlerRelease && handler_ != NULL) {  // 未执行的反注册任务
+    delete handler_;
+    handler_ = NULL;
+  }
+}
+
+void DiscoverHandlerTask::SetResponse(v1::DiscoverResponse* response,
+                                      ServiceDataStatus data_status, uint64_t cache_version) {
+  response_      = response;
+  data_status_   = data_status;
+  cache_version_ = cache_version;
+}
+
+void DiscoverHandlerTask::Run() {
+  const ServiceKey& service_key = service_.service_key_;
+  if (event_ == kDiscoverHandlerUpdate) {
+    // 服务数据接管response，避免在处理线程上复制或序列化下发数据
+    ServiceData* event_data =
+        ServiceDataImpl::CreateFromPb(response_, data_status_, cache_version_);
+    response_ = NULL;
+    handler_->OnEventUpdate(service_key, event_data->GetDataType(), event_data);
+  } else if (event_ == kDiscoverHandlerSync) {
+    handler_->OnEventSync(service_key, service_.data_type_);
+  } else {
+    handler_->OnEventUpdate(service_key, service_.data_type_, NULL);  // 释放缓存数据
+    delete handler_;
+  }
+  handler_ = NULL;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 GrpcServerConnector::GrpcServerConnector()
     : discover_stream_state_(kDiscoverStreamNotInit), context_(NULL), task_thread_id_(0),
       discover_instance_(NULL), grpc_client_(NULL), discover_stream_(NULL),
       stream_response_time_(0), server_switch_interval_(0), server_switch_state_(kServerSwitchInit),
-      message_used_time_(0), request_queue_size_(0), last_cache_version_(0) {}
+      message_used_time_(0), request_queue_size_(0), last_cache_version_(0),
+      decode_generation_(0), next_decode_seq_(0), next_process_seq_(0) {
+  discover_timeout_task_iter_ = reactor_.TimingTaskEnd();
+}
 
 GrpcServerConnector::~GrpcServerConnector() {
   // 关闭线程
@@ -126,6 +232,15 @@ GrpcServerConnector::~GrpcServerConnector() {
     pthread_join(task_thread_id_, NULL);
     task_thread_id_ = 0;
   }
+  // 先停止解码线程再释放handler，未执行的回调任务直接丢弃
+  for (std::size_t i = 0; i < decode_executors_.size(); ++i) {
+    delete decode_executors_[i];
+  }
+  decode_executors_.clear();
+  for (std::map<uint64_t, v1::DiscoverResponse*>::iterator it = decoded_responses_.begin();
+       it != decoded_responses_.end(); ++it) {
+    delete it->second;
+  }
   for (std::map<ServiceKeyWithType, ServiceListener>::iterator it = listener_map_.begin();
        it != listener_map_.end(); ++it) {
     delete it->second.handler_;
@@ -187,6 +302,9 @@ ReturnCode GrpcServerConnector::Init(Config* config, Context* context) {
   static const char kMaxRequestQueueSizeKey[]  = "requestQueueSize";
   static const int kMaxRequestQueueSizeDefault = 1000;
 
+  static const char kDecodeThreadsKey[]  = "discoverDecodeThreads";
+  static const int kDecodeThreadsDefault = 0;
+
   context_ = context;
 
   // 先获取接入点
@@ -224,6 +342,16 @@ ReturnCode GrpcServerConnector::Init(Config* config, Context* context) {
   POLARIS_CHECK(request_queue_size > 0, kReturnInvalidConfig);
   request_queue_size_ = static_cast<std::size_t>(request_queue_size);
 
+  int decode_threads = config->GetIntOrDefault(kDecodeThreadsKey, kDecodeThreadsDefault);
+  POLARIS_CHECK(decode_threads >= 0, kReturnInvalidConfig);
+  for (int i = static_cast<int>(decode_executors_.size()); i < decode_threads; ++i) {
+    DiscoverDecodeExecutor* decode_executor = new DiscoverDecodeExecutor(context_);
+    decode_executors_.push_back(decode_executor);
+    if (decode_executor->Start() != kReturnOk) {
+      return kReturnInvalidState;
+    }
+  }
+
   POLARIS_LOG(LOG_INFO, "seed server list:%s",
               SeedServerConfig::SeedServersToString(server_lists_).c_str());
 
@@ -288,15 +416,13 @@ void GrpcServerConnector::ProcessQueuedListener(DiscoverEventTask* discover_even
     if (service_listener.discover_task_iter_ != reactor_.TimingTaskEnd()) {
       reactor_.CancelTimingTask(service_listener.discover_task_iter_);
     }
-    // 如果已经发送了服务发现请求，则取消设置的超时检查任务
-    if (service_listener.timeout_task_iter_ != reactor_.TimingTaskEnd()) {
-      reactor_.CancelTimingTask(service_listener.timeout_task_iter_);
-    }
+    // 如果已经发送了服务发现请求，则从超时检查中删除
+    RemoveDiscoverTimeout(service_listener);
     pending_for_connected_.erase(&service_listener);  // 有可能在等待连接，尝试取消
-    // 释放缓存数据
-    service_listener.handler_->OnEventUpdate(service_listener.service_.service_key_,
-                                             service_listener.service_.data_type_, NULL);
-    delete service_listener.handler_;
+    discover_batch_.erase(&service_listener);         // 有可能在等待批量发送，尝试取消
+    // 释放缓存数据及handler
+    RunHandlerTask(new DiscoverHandlerTask(kDiscoverHandlerRelease, service_listener.service_,
+                                           service_listener.handler_));
     // 监听map中删除，这样如果服务应答了相关数据找不到监听直接丢弃即可
     listener_map_.erase(service_it);
   } else {
@@ -308,7 +434,7 @@ void GrpcServerConnector::ProcessQueuedListener(DiscoverEventTask* discover_even
     service_listener.cache_version_      = 0;
     service_listener.ret_code_           = 0;
     service_listener.discover_task_iter_ = reactor_.TimingTaskEnd();
-    service_listener.timeout_task_iter_  = reactor_.TimingTaskEnd();
+    service_listener.timeout_time_       = 0;
     service_listener.connector_          = this;
     // 立即执行服务发现任务
     if (!this->SendDiscoverRequest(service_listener)) {
@@ -344,54 +470,107 @@ bool GrpcServerConnector::SendDiscoverRequest(ServiceListener& service_listener)
     }
   }
   // 已经发送过请求正等待超时
-  if (service_listener.timeout_task_iter_ != reactor_.TimingTaskEnd()) {
+  if (service_listener.timeout_time_ != 0) {
     POLARIS_LOG(LOG_WARN, "already discover %s for service[%s/%s]",
                 DataTypeToStr(service_listener.service_.data_type_), service_key.namespace_.c_str(),
                 service_key.name_.c_str());
     return true;
   }
-  // 组装请求
-  ::v1::DiscoverRequest request;
-  if (!service_key.namespace_.empty()) {
-    request.mutable_service()->mutable_namespace_()->set_value(service_key.namespace_);
-  }
-  request.mutable_service()->mutable_name()->set_value(service_key.name_);
-  request.mutable_service()->mutable_revision()->set_value(service_listener.revision_);
-  if (service_listener.service_.data_type_ == kServiceDataInstances) {
-    request.set_type(v1::DiscoverRequest::INSTANCE);
-  } else if (service_listener.service_.data_type_ == kServiceDataRouteRule) {
-    request.set_type(v1::DiscoverRequest::ROUTING);
-  } else if (service_listener.service_.data_type_ == kServiceDataRateLimit) {
-    request.set_type(v1::DiscoverRequest::RATE_LIMIT);
-  } else if (service_listener.service_.data_type_ == kCircuitBreakerConfig) {
-    request.set_type(v1::DiscoverRequest::CIRCUIT_BREAKER);
-  } else {
-    POLARIS_ASSERT(false);
+  // 加入批量发送队列，本轮事件循环结束前统一发送
+  if (discover_batch_.empty()) {
+    reactor_.AddTimingTask(
+        new TimingFuncTask<GrpcServerConnector>(FlushDiscoverRequest, this, 0));
   }
-  discover_stream_->SendMessage(request, false);
-  POLARIS_LOG(LOG_TRACE, "server connector try send discover %s request for service[%s/%s]",
-              DataTypeToStr(service_listener.service_.data_type_), service_key.namespace_.c_str(),
-              service_key.name_.c_str());
-  // 设置超时检查任务
-  service_listener.timeout_task_iter_ = reactor_.AddTimingTask(new TimingFuncTask<ServiceListener>(
-      DiscoverTimoutCheck, &service_listener, message_timeout_.GetTimeout()));
+  discover_batch_.insert(&service_listener);
   return true;
 }
 
-void GrpcServerConnector::DiscoverTimoutCheck(ServiceListener* service_listener) {
+void GrpcServerConnector::FlushDiscoverRequest(GrpcServerConnector* server_connector) {
+  std::set<ServiceListener*>& discover_batch = server_connector->discover_batch_;
+  if (discover_batch.empty()) {  // 切换服务器时已转入pending列表
+    return;
+  }
+  POLARIS_ASSERT(server_connector->discover_stream_ != NULL);
+  std::vector< ::v1::DiscoverRequest> requests(discover_batch.size());
+  std::vector<google::protobuf::Message*> messages;
+  messages.reserve(discover_batch.size());
+  for (std::set<ServiceListener*>::iterator it = discover_batch.begin();
+       it != discover_batch.end(); ++it) {
+    ::v1::DiscoverRequest& request = requests[messages.size()];
+    BuildDiscoverRequest(**it, request);
+    messages.push_back(&request);
+  }
+  server_connector->discover_stream_->SendMessages(messages);
+  POLARIS_LOG(LOG_TRACE, "server connector send %zu discover request in batch", messages.size());
+  // 同一批请求使用相同的超时时间
+  uint64_t timeout_time =
+      Time::GetCurrentTimeMs() + server_connector->message_timeout_.GetTimeout();
+  for (std::set<ServiceListener*>::iterator it = discover_batch.begin();
+       it != discover_batch.end(); ++it) {
+    server_connector->AddDiscoverTimeout(**it, timeout_time);
+  }
+  discover_batch.clear();
+}
+
+void GrpcServerConnector::AddDiscoverTimeout(ServiceListener& service_listener,
+                                             uint64_t timeout_time) {
+  service_listener.timeout_time_ = timeout_time;
+  discover_timeout_map_[timeout_time].insert(&service_listener);
+  if (discover_timeout_task_iter_ != reactor_.TimingTaskEnd()) {
+    if (discover_timeout_task_iter_->GetExpireTime() <= timeout_time) {
+      return;  // 已有更早的超时检查
+    }
+    reactor_.CancelTimingTask(discover_timeout_task_iter_);
+  }
+  uint64_t current_time = Time::GetCurrentTimeMs();
+  discover_timeout_task_iter_ = reactor_.AddTimingTask(new TimingFuncTask<GrpcServerConnector>(
+      DiscoverTimeoutCheck, this, timeout_time > current_time ? timeout_time - current_time : 0));
+}
+
+void GrpcServerConnector::RemoveDiscoverTimeout(ServiceListener& service_listener) {
+  if (service_listener.timeout_time_ == 0) {
+    return;
+  }
+  std::map<uint64_t, std::set<ServiceListener*> >::iterator it =
+      discover_timeout_map_.find(service_listener.timeout_time_);
+  if (it != discover_timeout_map_.end()) {
+    it->second.erase(&service_listener);
+    if (it->second.empty()) {
+      discover_timeout_map_.erase(it);
+    }
+  }
+  service_listener.timeout_time_ = 0;
+  // 没有等待应答的请求时取消超时检查，否则由超时检查任务执行时重新设置
+  if (discover_timeout_map_.empty() && discover_timeout_task_iter_ != reactor_.TimingTaskEnd()) {
+    reactor_.CancelTimingTask(discover_timeout_task_iter_);
+    discover_timeout_task_iter_ = reactor_.TimingTaskEnd();
+  }
+}
+
+void GrpcServerConnector::DiscoverTimeoutCheck(GrpcServerConnector* server_connector) {
+  server_connector->discover_timeout_task_iter_ = server_connector->reactor_.TimingTaskEnd();
+  if (server_connector->discover_timeout_map_.empty()) {
+    return;
+  }
+  std::map<uint64_t, std::set<ServiceListener*> >::iterator it =
+      server_connector->discover_timeout_map_.begin();
+  uint64_t current_time = Time::GetCurrentTimeMs();
+  if (it->first > current_time) {  // 最早的请求已应答，按剩余请求中最早的超时时间检查
+    server_connector->discover_timeout_task_iter_ =
+        server_connector->reactor_.AddTimingTask(new TimingFuncTask<GrpcServerConnector>(
+            DiscoverTimeoutCheck, server_connector, it->first - current_time));
+    return;
+  }
   // 超时的情况下一定是未反注册的，那么这里需要触发切换
-  // 这里一个流上只要有第一个请求超时了，那么触发切换就会取消其他已发送未应答的服务的超时检查任务
-  service_listener->timeout_task_iter_ = service_listener->connector_->reactor_.TimingTaskEnd();
-  const ServiceKey& service_key        = service_listener->service_.service_key_;
+  // 这里一个流上只要有第一个请求超时了，那么触发切换就会将其他已发送未应答的服务加入pending列表
+  const ServiceKey& service_key = (*it->second.begin())->service_.service_key_;
   POLARIS_LOG(LOG_INFO, "server switch because discover [%s/%s] timeout[%" PRIu64 "]",
               service_key.namespace_.c_str(), service_key.name_.c_str(),
-              service_listener->connector_->message_timeout_.GetTimeout());
-  service_listener->connector_->message_timeout_.SetNextRetryTimeout();
-  // 加入pending等待连接成功后发送
-  service_listener->connector_->pending_for_connected_.insert(service_listener);
-  service_listener->connector_->UpdateCallResult(
-      kServerCodeRpcTimeout, service_listener->connector_->message_timeout_.GetTimeout());
-  service_listener->connector_->ServerSwitch();
+              server_connector->message_timeout_.GetTimeout());
+  server_connector->message_timeout_.SetNextRetryTimeout();
+  server_connector->UpdateCallResult(kServerCodeRpcTimeout,
+                                     server_connector->message_timeout_.GetTimeout());
+  server_connector->ServerSwitch();
 }
 
 bool GrpcServerConnector::CompareVersion(ServiceListener& listener,
@@ -438,6 +617,55 @@ void GrpcServerConnector::OnReceiveMessage(v1::DiscoverResponse* response) {
   delete response;
 }
 
+bool GrpcServerConnector::OnReceiveMessage(grpc::Buffer* buffer) {
+  if (decode_executors_.empty()) {
+    return grpc::StreamCallback<v1::DiscoverResponse>::OnReceiveMessage(buffer);
+  }
+  // 轮流交给解码线程解析，解析结果按接收顺序处理
+  uint64_t seq     = next_decode_seq_++;
+  Reactor& reactor = decode_executors_[seq % decode_executors_.size()]->GetReactor();
+  reactor.SubmitTask(new DiscoverDecodeTask(this, decode_generation_, seq, buffer));
+  reactor.Notify();
+  return true;
+}
+
+void GrpcServerConnector::ProcessDecodedResponse(uint64_t generation, uint64_t seq,
+                                                 v1::DiscoverResponse* response) {
+  if (generation != decode_generation_) {  // 切换服务器前旧连接上的应答直接丢弃
+    if (response != NULL) {
+      delete response;
+    }
+    return;
+  }
+  decoded_responses_[seq] = response;
+  while (!decoded_responses_.empty() && decoded_responses_.begin()->first == next_process_seq_) {
+    v1::DiscoverResponse* decoded_response = decoded_responses_.begin()->second;
+    decoded_responses_.erase(decoded_responses_.begin());
+    next_process_seq_++;
+    // 处理过程中可能触发服务器切换，会清空等待处理的应答
+    if (decoded_response != NULL) {
+      OnReceiveMessage(decoded_response);
+    } else {
+      OnRemoteClose(grpc::kGrpcStatusInternal, "decode discover response error");
+    }
+  }
+}
+
+void GrpcServerConnector::RunHandlerTask(DiscoverHandlerTask* handler_task) {
+  const ServiceKey& service_key = handler_task->GetServiceKey();
+  // 埋点服务的数据用于切换服务器，需要立即更新
+  if (decode_executors_.empty() ||
+      service_key == context_->GetContextImpl()->GetDiscoverService().service_) {
+    handler_task->Run();
+    delete handler_task;
+    return;
+  }
+  Reactor& reactor =
+      decode_executors_[MurmurServiceKey(service_key) % decode_executors_.size()]->GetReactor();
+  reactor.SubmitTask(handler_task);
+  reactor.Notify();
+}
+
 ReturnCode GrpcServerConnector::ProcessDiscoverResponse(::v1::DiscoverResponse& response) {
   const ::v1::Service& resp_service = response.service();
   ServiceKeyWithType service_with_type;
@@ -473,12 +701,10 @@ ReturnCode GrpcServerConnector::ProcessDiscoverResponse(::v1::DiscoverResponse&
   uint64_t delay            = 0;
   ServiceListener& listener = service_it->second;
   // 处理超时检查请求
-  if (listener.timeout_task_iter_ != reactor_.TimingTaskEnd()) {
+  if (listener.timeout_time_ != 0) {
     delay = Time::GetCurrentTimeMs() + message_timeout_.GetTimeout();
-    delay =
-        delay > listener.timeout_task_iter_->first ? delay - listener.timeout_task_iter_->first : 0;
-    reactor_.CancelTimingTask(listener.timeout_task_iter_);
-    listener.timeout_task_iter_ = reactor_.TimingTaskEnd();
+    delay = delay > listener.timeout_time_ ? delay - listener.timeout_time_ : 0;
+    RemoveDiscoverTimeout(listener);
   }
 
   ReturnCode ret = ToClientReturnCode(response.code());
@@ -486,11 +712,14 @@ ReturnCode GrpcServerConnector::ProcessDiscoverResponse(::v1::DiscoverResponse&
     this->UpdateCallResult(kServerCodeReturnOk, delay);
     this->UpdateMaxUsedTime(delay);  // 更新最大discover请求耗时
     if (CompareVersion(listener, response)) {
-      ServiceData* event_data = ServiceData::CreateFromPb(
-          reinterpret_cast<void*>(&response), ret == kReturnOk ? kDataIsSyncing : kDataNotFound,
-          listener.cache_version_);
-      // 执行回调
-      listener.handler_->OnEventUpdate(service_key, event_data->GetDataType(), event_data);
+      // 执行回调，应答数据转移给回调任务
+      v1::DiscoverResponse* event_response = new v1::DiscoverResponse();
+      event_response->Swap(&response);
+      DiscoverHandlerTask* handler_task =
+          new DiscoverHandlerTask(kDiscoverHandlerUpdate, listener.service_, listener.handler_);
+      handler_task->SetResponse(event_response, ret == kReturnOk ? kDataIsSyncing : kDataNotFound,
+                                listener.cache_version_);
+      RunHandlerTask(handler_task);
       if (ret == kReturnOk && discover_stream_state_ < kDiscoverStreamGetInstance) {
         const ServiceKey discover_service =
             context_->GetContextImpl()->GetDiscoverService().service_;
@@ -507,7 +736,8 @@ ReturnCode GrpcServerConnector::ProcessDiscoverResponse(::v1::DiscoverResponse&
                     service_key.name_.c_str());
       }
     } else {
-      listener.handler_->OnEventSync(service_key, listener.service_.data_type_);
+      RunHandlerTask(
+          new DiscoverHandlerTask(kDiscoverHandlerSync, listener.service_, listener.handler_));
       if (POLARIS_LOG_ENABLE(kTraceLogLevel)) {
         POLARIS_LOG(LOG_TRACE,
                     "skip update %s for service[%s/%s] because of same revision[%s] and code: %d",
@@ -594,15 +824,33 @@ void GrpcServerConnector::ServerSwitch() {
     reactor_.CancelTimingTask(server_switch_task_iter_);
   }
 
-  // 有超时检查的服务，说明本次未完成服务发现，加入pending列表，从而可在切换成功后立马发送
-  for (std::map<ServiceKeyWithType, ServiceListener>::iterator it = listener_map_.begin();
-       it != listener_map_.end(); ++it) {
-    if (it->second.timeout_task_iter_ != reactor_.TimingTaskEnd()) {
-      reactor_.CancelTimingTask(it->second.timeout_task_iter_);
-      pending_for_connected_.insert(&it->second);
-      it->second.timeout_task_iter_ = reactor_.TimingTaskEnd();
+  // 已发送未应答或等待批量发送的服务，说明本次未完成服务发现
+  // 加入pending列表，从而可在切换成功后立马发送
+  for (std::map<uint64_t, std::set<ServiceListener*> >::iterator it =
+           discover_timeout_map_.begin();
+       it != discover_timeout_map_.end(); ++it) {
+    for (std::set<ServiceListener*>::iterator listener_it = it->second.begin();
+         listener_it != it->second.end(); ++listener_it) {
+      (*listener_it)->timeout_time_ = 0;
+      pending_for_connected_.insert(*listener_it);
     }
   }
+  discover_timeout_map_.clear();
+  if (discover_timeout_task_iter_ != reactor_.TimingTaskEnd()) {
+    reactor_.CancelTimingTask(discover_timeout_task_iter_);
+    discover_timeout_task_iter_ = reactor_.TimingTaskEnd();
+  }
+  pending_for_connected_.insert(discover_batch_.begin(), discover_batch_.end());
+  discover_batch_.clear();
+  // 旧连接上解码中和等待处理的应答都会被丢弃
+  decode_generation_++;
+  next_decode_seq_  = 0;
+  next_process_seq_ = 0;
+  for (std::map<uint64_t, v1::DiscoverResponse*>::iterator it = decoded_responses_.begin();
+       it != decoded_responses_.end(); ++it) {
+    delete it->second;
+  }
+  decoded_responses_.clear();
 
   // 选择一个服务器
   std::string host;
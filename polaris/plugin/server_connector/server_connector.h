@@ -24,6 +24,7 @@
 #include <vector>
 
 #include "config/seed_server.h"
+#include "engine/executor.h"
 #include "grpc/client.h"
 #include "grpc/status.h"
 #include "model/model_impl.h"
@@ -49,7 +50,7 @@ struct ServiceListener {
   uint64_t cache_version_;        // 递增的整型缓存版本号
   uint32_t ret_code_;             // 记录上一次请求的code
   TimingTaskIter discover_task_iter_;  // 记录定时服务发现任务，服务过期时用于删除任务
-  TimingTaskIter timeout_task_iter_;  // 记录服务发现超时检查任务，用于删除
+  uint64_t timeout_time_;  // 已发送请求的超时时间，0表示没有等待应答的请求
   GrpcServerConnector* connector_;
 };
 
@@ -72,6 +73,81 @@ private:
   ServiceEventHandler* handler_;  // null for deregistry
 };
 
+// 服务发现应答的解码线程
+class DiscoverDecodeExecutor : public Executor {
+public:
+  explicit DiscoverDecodeExecutor(Context* context) : Executor(context) {}
+
+  virtual const char* GetName() { return "discover_decode"; }
+
+  virtual void SetupWork() {}
+};
+
+// 在解码线程中解析应答，解析结果提交回连接线程按接收顺序处理
+class DiscoverDecodeTask : public Task {
+public:
+  DiscoverDecodeTask(GrpcServerConnector* connector, uint64_t generation, uint64_t seq,
+                     grpc::Buffer* buffer);
+
+  virtual ~DiscoverDecodeTask();
+
+  virtual void Run();
+
+private:
+  GrpcServerConnector* connector_;
+  uint64_t generation_;
+  uint64_t seq_;
+  grpc::Buffer* buffer_;
+};
+
+// 解析完成的应答，在连接线程中执行
+class DiscoverDecodedTask : public Task {
+public:
+  DiscoverDecodedTask(GrpcServerConnector* connector, uint64_t generation, uint64_t seq,
+                      v1::DiscoverResponse* response);
+
+  virtual ~DiscoverDecodedTask();
+
+  virtual void Run();
+
+private:
+  GrpcServerConnector* connector_;
+  uint64_t generation_;
+  uint64_t seq_;
+  v1::DiscoverResponse* response_;  // 解析失败时为NULL
+};
+
+enum DiscoverHandlerEvent {
+  kDiscoverHandlerUpdate,   // 构造服务数据并触发更新
+  kDiscoverHandlerSync,     // 数据未变化，只触发同步
+  kDiscoverHandlerRelease,  // 反注册，释放服务数据及handler
+};
+
+// 执行服务监听回调，配置了解码线程时同一服务的回调固定在同一解码线程中顺序执行
+class DiscoverHandlerTask : public Task {
+public:
+  DiscoverHandlerTask(DiscoverHandlerEvent event, const ServiceKeyWithType& service,
+                      ServiceEventHandler* handler);
+
+  virtual ~DiscoverHandlerTask();
+
+  // 更新事件需要设置应答，应答由任务释放
+  void SetResponse(v1::DiscoverResponse* response, ServiceDataStatus data_status,
+                   uint64_t cache_version);
+
+  const ServiceKey& GetServiceKey() const { return service_.service_key_; }
+
+  virtual void Run();
+
+private:
+  DiscoverHandlerEvent event_;
+  ServiceKeyWithType service_;
+  ServiceEventHandler* handler_;
+  v1::DiscoverResponse* response_;
+  ServiceDataStatus data_status_;
+  uint64_t cache_version_;
+};
+
 // 标示Discover服务连接的状态
 enum DiscoverStreamState {
   kDiscoverStreamNotInit     = 0,
@@ -122,6 +198,12 @@ public:
   virtual void OnReceiveMessage(v1::DiscoverResponse* response);
   virtual void OnRemoteClose(grpc::GrpcStatusCode status, const std::string& message);
 
+  // 配置了解码线程时，连接线程只做分帧，应答交给解码线程解析
+  virtual bool OnReceiveMessage(grpc::Buffer* buffer);
+
+  // 解码线程解析完成后回调，按接收顺序处理应答
+  void ProcessDecodedResponse(uint64_t generation, uint64_t seq, v1::DiscoverResponse* response);
+
   void UpdateCallResult(PolarisServerCode server_code, uint64_t delay);
 
   virtual ReturnCode RegisterInstance(const InstanceRegisterRequest& req, uint64_t timeout_ms,
@@ -159,14 +241,25 @@ private:
 
   static void TimingDiscover(ServiceListener* service_listener);
 
-  static void DiscoverTimoutCheck(ServiceListener* service_listener);
+  // 检查已发送的服务发现请求是否超时，所有请求共用一个定时任务
+  static void DiscoverTimeoutCheck(GrpcServerConnector* server_connector);
 
+  void AddDiscoverTimeout(ServiceListener& service_listener, uint64_t timeout_time);
+
+  void RemoveDiscoverTimeout(ServiceListener& service_listener);
+
+  // 将请求加入批量发送队列，同一轮事件循环中的请求合并发送
   bool SendDiscoverRequest(ServiceListener& service_listener);
 
+  static void FlushDiscoverRequest(GrpcServerConnector* server_connector);
+
   bool CompareVersion(ServiceListener& listener, const ::v1::DiscoverResponse& response);
 
   ReturnCode ProcessDiscoverResponse(::v1::DiscoverResponse& response);
 
+  // 执行服务监听回调，配置了解码线程时提交到服务对应的解码线程
+  void RunHandlerTask(DiscoverHandlerTask* handler_task);
+
 protected:  // for test
   virtual BlockRequest* CreateBlockRequest(BlockRequestType request_type, uint64_t timeout);
 
@@ -186,6 +279,10 @@ private:
   grpc::GrpcStream* discover_stream_;
   uint64_t stream_response_time_;
   std::set<ServiceListener*> pending_for_connected_;
+  std::set<ServiceListener*> discover_batch_;  // 等待批量发送的服务发现请求
+  // 已发送的请求按超时时间分组，同一批发送的请求超时时间相同
+  std::map<uint64_t, std::set<ServiceListener*> > discover_timeout_map_;
+  TimingTaskIter discover_timeout_task_iter_;
 
   uint64_t server_switch_interval_;
   ServerSwitchState server_switch_state_;  // 维护服务切换状态
@@ -201,6 +298,13 @@ private:
   std::map<ServiceKeyWithType, ServiceListener> listener_map_;
 
   std::map<uint64_t, AsyncRequest*> async_request_map_;
+
+  std::vector<DiscoverDecodeExecutor*> decode_executors_;  // 为空时在连接线程中解码
+  uint64_t decode_generation_;  // 切换服务器时递增，用于丢弃旧连接上的应答
+  uint64_t next_decode_seq_;
+  uint64_t next_process_seq_;
+  // 解析完成等待按顺序处理的应答，解析失败的为NULL
+  std::map<uint64_t, v1::DiscoverResponse*> decoded_responses_;
 };
 
 class DiscoverConnectionCb : public grpc::ConnectCallback {
@@ -59,6 +59,7 @@ ReturnCode CanaryServiceRouter::DoRoute(RouteInfo& route_info, RouteResult* rout
   POLARIS_CHECK_ARGUMENT(service_instances != NULL);
   // 查询服务是否通过元数据配置开启金丝雀路由
   if (!service_instances->IsCanaryEnable()) {
+    RecordRouteResult(NULL, true);
     route_result->SetServiceInstances(service_instances);
     route_info.SetServiceInstances(NULL);
     return kReturnOk;
@@ -89,8 +90,9 @@ ReturnCode CanaryServiceRouter::DoRoute(RouteInfo& route_info, RouteResult* rout
     POLARIS_ASSERT(cache_value != NULL);
   } else {
     InstancesSet* prior_result = cache_key.prior_data_;
-    std::set<Instance*> unhealthy_set;
-    CalculateUnhealthySet(route_info, service_instances, unhealthy_set);
+    std::set<Instance*> scratch;
+    const std::set<Instance*>& unhealthy_set =
+        CalculateUnhealthySet(route_info, service_instances, scratch);
     std::vector<Instance*> result;
     bool recover_all = false;
     if (cache_key.canary_value_.empty()) {
@@ -123,7 +125,7 @@ ReturnCode CanaryServiceRouter::DoRoute(RouteInfo& route_info, RouteResult* rout
     }
     router_cache_->PutWithRef(cache_key, cache_value);
   }
-  cache_value->current_data_->GetInstancesSetImpl()->count_++;
+  RecordRouteResult(cache_value->current_data_, true);
   service_instances->UpdateAvailableInstances(cache_value->current_data_);
   cache_value->DecrementRef();
   route_result->SetServiceInstances(service_instances);
@@ -185,8 +185,9 @@ ReturnCode MetadataServiceRouter::DoRoute(RouteInfo& route_info, RouteResult* ro
   } else {
     InstancesSet* prior_result = cache_key.prior_data_;
     POLARIS_ASSERT(prior_result != NULL);
-    std::set<Instance*> unhealthy_set;
-    CalculateUnhealthySet(route_info, service_instances, unhealthy_set);
+    std::set<Instance*> scratch;
+    const std::set<Instance*>& unhealthy_set =
+        CalculateUnhealthySet(route_info, service_instances, scratch);
 
     std::vector<Instance*> result;
     bool recover_all = CalculateResult(prior_result->GetInstances(), unhealthy_set,
@@ -211,9 +212,7 @@ ReturnCode MetadataServiceRouter::DoRoute(RouteInfo& route_info, RouteResult* ro
       }
     }
   }
-  if (!route_info.GetMetadata().empty()) {
-    cache_value->current_data_->GetInstancesSetImpl()->count_++;
-  }
+  RecordRouteResult(route_info.GetMetadata().empty() ? NULL : cache_value->current_data_, true);
   service_instances->UpdateAvailableInstances(cache_value->current_data_);
   cache_value->DecrementRef();
   route_result->SetServiceInstances(service_instances);
@@ -314,8 +314,9 @@ ReturnCode NearbyServiceRouter::DoRoute(RouteInfo& route_info, RouteResult* rout
     POLARIS_ASSERT(cache_value != NULL);
   } else {
     InstancesSet* prior_result = cache_key.prior_data_;
-    std::set<Instance*> unhealthy_set;
-    CalculateUnhealthySet(route_info, service_instances, unhealthy_set);
+    std::set<Instance*> scratch;
+    const std::set<Instance*>& unhealthy_set =
+        CalculateUnhealthySet(route_info, service_instances, scratch);
     NearbyRouterCluster nearby_cluster(nearby_router_config_);
     model::VersionedLocation location;
     context_impl->GetClientLocation().GetVersionedLocation(location);
@@ -357,9 +358,7 @@ ReturnCode NearbyServiceRouter::DoRoute(RouteInfo& route_info, RouteResult* rout
     }
     router_cache_->PutWithRef(cache_key, cache_value);
   }
-  if (service_instances->IsNearbyEnable()) {
-    cache_value->current_data_->GetInstancesSetImpl()->count_++;
-  }
+  RecordRouteResult(service_instances->IsNearbyEnable() ? cache_value->current_data_ : NULL, true);
   service_instances->UpdateAvailableInstances(cache_value->current_data_);
   cache_value->DecrementRef();
   route_result->SetServiceInstances(service_instances);
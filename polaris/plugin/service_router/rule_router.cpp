@@ -388,9 +388,10 @@ ReturnCode RuleServiceRouter::DoRoute(RouteInfo& route_info, RouteResult* route_
       POLARIS_ASSERT(cache_value != NULL);
     } else {
       ServiceKey service_key = route_info.GetServiceKey();
-      std::set<Instance*> unhealthy_set;
+      std::set<Instance*> scratch;
       // 获取熔断实例和不健康实例
-      CalculateUnhealthySet(route_info, service_instances, unhealthy_set);
+      const std::set<Instance*>& unhealthy_set =
+          CalculateUnhealthySet(route_info, service_instances, scratch);
       InstancesSet* available_set = service_instances->GetAvailableInstances();
       RuleRouterCluster rule_router_cluster;
       bool calculate_result;
@@ -453,9 +454,13 @@ ReturnCode RuleServiceRouter::DoRoute(RouteInfo& route_info, RouteResult* route_
     }
     POLARIS_ASSERT(cache_value->sum_weight_ > 0);
     InstancesSet* instances_result = SelectSet(cache_value->data_, cache_value->sum_weight_);
+    // 有多个分组时按权重随机选择分组，结果不能被路由链缓存
+    RecordRouteResult(instances_result, cache_value->data_.size() == 1);
     service_instances->UpdateAvailableInstances(instances_result);
     route_result->SetSubset(instances_result->GetSubset());
     cache_value->DecrementRef();
+  } else {
+    RecordRouteResult(NULL, true);
   }
   route_result->SetServiceInstances(service_instances);
   route_info.SetServiceInstances(NULL);
@@ -472,7 +477,6 @@ InstancesSet* RuleServiceRouter::SelectSet(std::map<uint32_t, InstancesSet*>& cl
   }
   uint32_t random_weight                         = rand_r(&thread_local_seed) % sum_weight;
   std::map<uint32_t, InstancesSet*>::iterator it = cluster.upper_bound(random_weight);
-  it->second->GetInstancesSetImpl()->count_++;
   return it->second;
 }
 
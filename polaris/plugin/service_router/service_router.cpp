@@ -19,8 +19,12 @@
 
 #include <map>
 #include <memory>
+#include <string>
 #include <utility>
 
+#include "MurmurHash3.h"
+#include "cache/service_cache.h"
+#include "context_internal.h"
 #include "logger.h"
 #include "model/model_impl.h"
 #include "plugin/plugin_manager.h"
@@ -85,7 +89,8 @@ ReturnCode RouteInfoNotify::SetDataToRouteInfo(RouteInfo& route_info) {
                   impl_->data_or_notify_[0].service_data_->GetServiceKey().name_.c_str());
       return kReturnServiceNotFound;
     }
-    route_info.SetServiceInstances(new ServiceInstances(impl_->data_or_notify_[0].service_data_));
+    route_info.SetServiceInstances(
+        RouteObjectCache::NewServiceInstances(impl_->data_or_notify_[0].service_data_));
     impl_->data_or_notify_[0].service_data_ = NULL;
   }
   if (impl_->data_or_notify_[1].service_notify_ != NULL &&
@@ -96,7 +101,8 @@ ReturnCode RouteInfoNotify::SetDataToRouteInfo(RouteInfo& route_info) {
                   impl_->data_or_notify_[1].service_data_->GetServiceKey().name_.c_str());
       return kReturnServiceNotFound;
     }
-    route_info.SetServiceRouteRule(new ServiceRouteRule(impl_->data_or_notify_[1].service_data_));
+    route_info.SetServiceRouteRule(
+        RouteObjectCache::NewServiceRouteRule(impl_->data_or_notify_[1].service_data_));
     impl_->data_or_notify_[1].service_data_ = NULL;
   }
   if (impl_->data_or_notify_[2].service_notify_ != NULL &&
@@ -108,22 +114,29 @@ ReturnCode RouteInfoNotify::SetDataToRouteInfo(RouteInfo& route_info) {
       return kReturnServiceNotFound;
     }
     route_info.SetSourceServiceRouteRule(
-        new ServiceRouteRule(impl_->data_or_notify_[2].service_data_));
+        RouteObjectCache::NewServiceRouteRule(impl_->data_or_notify_[2].service_data_));
     impl_->data_or_notify_[2].service_data_ = NULL;
   }
   return kReturnOk;
 }
 
 ServiceRouterChain::ServiceRouterChain(const ServiceKey& service_key) {
-  impl_                         = new ServiceRouterChainImpl();
-  impl_->service_key_           = service_key;
-  impl_->enable_                = false;
-  impl_->is_rule_router_enable_ = false;
-  impl_->context_               = NULL;
+  impl_                          = new ServiceRouterChainImpl();
+  impl_->service_key_            = service_key;
+  impl_->enable_                 = false;
+  impl_->is_rule_router_enable_  = false;
+  impl_->context_                = NULL;
+  impl_->result_cache_           = NULL;
+  impl_->result_verify_interval_ = 0;
 }
 
 ServiceRouterChain::~ServiceRouterChain() {
   if (impl_ != NULL) {
+    if (impl_->result_cache_ != NULL) {
+      impl_->result_cache_->SetClearHandler(0);
+      impl_->result_cache_->DecrementRef();
+      impl_->result_cache_ = NULL;
+    }
     for (std::size_t i = 0; i < impl_->service_router_list_.size(); i++) {
       delete impl_->service_router_list_[i];
     }
@@ -204,16 +217,144 @@ ReturnCode ServiceRouterChain::Init(Config* config, Context* context) {
     POLARIS_LOG(LOG_INFO, "init service router plugin[%s] for service[%s/%s] success",
                 StringUtils::JoinString(impl_->plugin_name_list_).c_str(),
                 impl_->service_key_.namespace_.c_str(), impl_->service_key_.name_.c_str());
+    // 禁用插件按位记录在缓存key中，插件数超过32个时不开启结果缓存
+    if (config->GetBoolOrDefault(ServiceRouterConfig::kChainResultCacheEnableKey,
+                                 ServiceRouterConfig::kChainResultCacheEnableDefault) &&
+        impl_->service_router_list_.size() <= 32) {
+      impl_->result_cache_ = new ServiceCache<RouteChainCacheKey>();
+      // 缓存命中时不会访问插件的缓存，需要在插件缓存过期前重新执行路由链
+      impl_->result_verify_interval_ = context->GetContextImpl()->GetCacheClearTime() / 2;
+      context->GetContextImpl()->RegisterCache(impl_->result_cache_);
+    }
   }
   return ret;
 }
 
-ReturnCode ServiceRouterChain::DoRoute(RouteInfo& route_info, RouteResult* route_result) {
+// 路由链执行记录，路由链结果缓存未命中时由插件通过RecordRouteResult记录执行结果
+struct RouteChainTrace {
+  RouteChainTrace() : record_count_(0), cacheable_(true) {}
+
+  int record_count_;
+  bool cacheable_;
+  std::vector<InstancesSet*> counted_data_;
+};
+
+static __thread RouteChainTrace* thread_local_route_trace = NULL;
+
+void RecordRouteResult(InstancesSet* result_data, bool cacheable) {
+  if (result_data != NULL) {
+    result_data->GetInstancesSetImpl()->count_++;
+  }
+  RouteChainTrace* route_trace = thread_local_route_trace;
+  if (route_trace != NULL) {
+    route_trace->record_count_++;
+    route_trace->cacheable_ = route_trace->cacheable_ && cacheable;
+    if (result_data != NULL) {
+      route_trace->counted_data_.push_back(result_data);
+    }
+  }
+}
+
+// 将字符串按顺序混入摘要，用于构造路由链结果缓存key
+static uint64_t DigestString(uint64_t digest, const std::string& str) {
+  uint64_t hash[2];
+  ::MurmurHash3_x64_128(str.data(), static_cast<int>(str.size()), static_cast<uint32_t>(digest),
+                        hash);
+  return (digest * 31 + hash[0]) ^ hash[1];
+}
+
+static uint64_t DigestMap(uint64_t digest, const std::map<std::string, std::string>& input) {
+  digest = digest * 31 + input.size();  // 区分相邻的map
+  for (std::map<std::string, std::string>::const_iterator it = input.begin(); it != input.end();
+       ++it) {
+    digest = DigestString(DigestString(digest, it->first), it->second);
+  }
+  return digest;
+}
+
+void ServiceRouterChainImpl::BuildResultCacheKey(RouteInfo& route_info,
+                                                 RouteChainCacheKey& cache_key) {
+  ServiceInstances* service_instances = route_info.GetServiceInstances();
+  Service* service                    = service_instances->GetService();
+  cache_key.prior_data_               = service_instances->GetAvailableInstances();
+  cache_key.route_rule_ = route_info.GetServiceRouteRule() != NULL
+                              ? route_info.GetServiceRouteRule()->GetServiceData()
+                              : NULL;
+  cache_key.source_route_rule_ = route_info.GetSourceServiceRouteRule() != NULL
+                                     ? route_info.GetSourceServiceRouteRule()->GetServiceData()
+                                     : NULL;
+  cache_key.circuit_breaker_version_        = service->GetCircuitBreakerDataVersion();
+  cache_key.subset_circuit_breaker_version_ = service->GetCircuitBreakerSetUnhealthyDataVersion();
+  cache_key.location_version_ = context_->GetContextImpl()->GetClientLocation().GetVersion();
+  cache_key.disable_routers_  = 0;
+  for (std::size_t i = 0; i < plugin_name_list_.size(); ++i) {
+    if (!route_info.IsRouterEnable(plugin_name_list_[i].c_str())) {
+      cache_key.disable_routers_ |= 1U << i;
+    }
+  }
+  cache_key.request_flags_ = route_info.GetRequestFlags();
+
+  uint64_t digest                  = 0;
+  ServiceInfo* source_service_info = route_info.GetSourceServiceInfo();
+  if (source_service_info != NULL) {
+    digest = DigestString(digest, source_service_info->service_key_.namespace_);
+    digest = DigestString(digest, source_service_info->service_key_.name_);
+    digest = DigestMap(digest, source_service_info->metadata_);
+  }
+  digest                   = DigestMap(digest, route_info.GetLabels());
+  digest                   = DigestMap(digest, route_info.GetMetadata());
+  cache_key.input_digest_  = digest;
+  cache_key.failover_type_ = route_info.GetMetadataFailoverType();
+}
+
+bool ServiceRouterChainImpl::MatchCachedInput(RouteChainCacheValue* cache_value,
+                                              RouteInfo& route_info) {
+  ServiceInfo* source_service_info = route_info.GetSourceServiceInfo();
+  if (source_service_info == NULL) {
+    if (cache_value->has_source_service_) {
+      return false;
+    }
+  } else if (!cache_value->has_source_service_ ||
+             !(cache_value->source_service_key_ == source_service_info->service_key_) ||
+             cache_value->source_metadata_ != source_service_info->metadata_) {
+    return false;
+  }
+  return cache_value->labels_ == route_info.GetLabels() &&
+         cache_value->metadata_ == route_info.GetMetadata();
+}
+
+bool ServiceRouterChainImpl::GetCachedResult(const RouteChainCacheKey& cache_key,
+                                             RouteInfo& route_info, RouteResult* route_result) {
+  CacheValueBase* cache_value_base = result_cache_->GetWithRef(cache_key);
+  if (cache_value_base == NULL) {
+    return false;
+  }
+  RouteChainCacheValue* cache_value = dynamic_cast<RouteChainCacheValue*>(cache_value_base);
+  POLARIS_ASSERT(cache_value != NULL);
+  if (Time::GetCurrentTimeMs() >= cache_value->verify_time_ + result_verify_interval_ ||
+      !MatchCachedInput(cache_value, route_info)) {
+    cache_value->DecrementRef();
+    return false;
+  }
+  // 与执行路由链时一样增加各插件结果分组的访问计数，保证路由统计数据不变
+  for (std::size_t i = 0; i < cache_value->counted_data_.size(); ++i) {
+    cache_value->counted_data_[i]->GetInstancesSetImpl()->count_++;
+  }
+  ServiceInstances* service_instances = route_info.GetServiceInstances();
+  service_instances->UpdateAvailableInstances(cache_value->result_data_);
+  route_result->SetSubset(cache_value->subset_);
+  route_result->SetServiceInstances(service_instances);
+  route_info.SetServiceInstances(NULL);
+  cache_value->DecrementRef();
+  return true;
+}
+
+ReturnCode ServiceRouterChainImpl::RunServiceRouters(RouteInfo& route_info,
+                                                     RouteResult* route_result, int& route_count) {
   ReturnCode ret;
-  POLARIS_CHECK_ARGUMENT(route_result != NULL);
   bool need_trans_result = false;
-  for (std::size_t i = 0; i < impl_->service_router_list_.size(); i++) {
-    if (POLARIS_UNLIKELY(!route_info.IsRouterEnable(impl_->plugin_name_list_[i].c_str()))) {
+  for (std::size_t i = 0; i < service_router_list_.size(); i++) {
+    if (POLARIS_UNLIKELY(!route_info.IsRouterEnable(plugin_name_list_[i].c_str()))) {
       continue;
     }
 
@@ -222,10 +363,11 @@ ReturnCode ServiceRouterChain::DoRoute(RouteInfo& route_info, RouteResult* route
       route_info.UpdateServiceInstances(route_result->GetAndClearServiceInstances());
     }
 
-    if ((ret = impl_->service_router_list_[i]->DoRoute(route_info, route_result)) != kReturnOk) {
+    route_count++;
+    if ((ret = service_router_list_[i]->DoRoute(route_info, route_result)) != kReturnOk) {
       POLARIS_LOG(LOG_ERROR, "run service router plugin[%s] for service[%s/%s] return error[%s]",
-                  impl_->plugin_name_list_[i].c_str(), impl_->service_key_.namespace_.c_str(),
-                  impl_->service_key_.name_.c_str(), ReturnCodeToMsg(ret).c_str());
+                  plugin_name_list_[i].c_str(), service_key_.namespace_.c_str(),
+                  service_key_.name_.c_str(), ReturnCodeToMsg(ret).c_str());
       if (ret == kReturnRouteRuleNotMatch) {
         POLARIS_LOG(
             LOG_ERROR, "router not match with instances[%s], route[%s], source route[%s]",
@@ -247,6 +389,68 @@ ReturnCode ServiceRouterChain::DoRoute(RouteInfo& route_info, RouteResult* route
   return kReturnOk;
 }
 
+ReturnCode ServiceRouterChain::DoRoute(RouteInfo& route_info, RouteResult* route_result) {
+  POLARIS_CHECK_ARGUMENT(route_result != NULL);
+  int route_count = 0;
+  ServiceInstances* service_instances = route_info.GetServiceInstances();
+  if (impl_->result_cache_ == NULL || service_instances == NULL ||
+      service_instances->GetService() == NULL) {
+    return impl_->RunServiceRouters(route_info, route_result, route_count);
+  }
+
+  RouteChainCacheKey cache_key;
+  impl_->BuildResultCacheKey(route_info, cache_key);
+  if (impl_->GetCachedResult(cache_key, route_info, route_result)) {
+    impl_->result_cache_hit_++;
+    return kReturnOk;
+  }
+  impl_->result_cache_miss_++;
+
+  RouteChainTrace route_trace;
+  thread_local_route_trace = &route_trace;
+  ReturnCode ret           = impl_->RunServiceRouters(route_info, route_result, route_count);
+  thread_local_route_trace = NULL;
+  // 只缓存所有执行的插件都记录了可缓存结果的路由结果
+  service_instances = route_result->GetServiceInstances();
+  if (ret != kReturnOk || route_result->isRedirect() || service_instances == NULL ||
+      route_count == 0 || route_trace.record_count_ != route_count || !route_trace.cacheable_) {
+    return ret;
+  }
+  RouteChainCacheValue* cache_value = new RouteChainCacheValue();
+  cache_value->instances_data_      = service_instances->GetServiceData();
+  cache_value->instances_data_->IncrementRef();
+  cache_value->route_rule_ = cache_key.route_rule_;
+  if (cache_value->route_rule_ != NULL) {
+    cache_value->route_rule_->IncrementRef();
+  }
+  cache_value->source_route_rule_ = cache_key.source_route_rule_;
+  if (cache_value->source_route_rule_ != NULL) {
+    cache_value->source_route_rule_->IncrementRef();
+  }
+  cache_value->prior_data_ = cache_key.prior_data_;
+  cache_value->prior_data_->IncrementRef();
+  cache_value->result_data_ = service_instances->GetAvailableInstances();
+  cache_value->result_data_->IncrementRef();
+  cache_value->counted_data_.swap(route_trace.counted_data_);
+  for (std::size_t i = 0; i < cache_value->counted_data_.size(); ++i) {
+    cache_value->counted_data_[i]->IncrementRef();
+  }
+  cache_value->subset_      = route_result->GetSubset();
+  cache_value->verify_time_ = Time::GetCurrentTimeMs();
+
+  ServiceInfo* source_service_info = route_info.GetSourceServiceInfo();
+  if (source_service_info != NULL) {
+    cache_value->has_source_service_ = true;
+    cache_value->source_service_key_ = source_service_info->service_key_;
+    cache_value->source_metadata_    = source_service_info->metadata_;
+  }
+  cache_value->labels_   = route_info.GetLabels();
+  cache_value->metadata_ = route_info.GetMetadata();
+  impl_->result_cache_->PutWithRef(cache_key, cache_value);
+  cache_value->DecrementRef();
+  return kReturnOk;
+}
+
 void ServiceRouterChain::CollectStat(ServiceKey& service_key,
                                      std::map<std::string, RouterStatData*>& stat_data) {
   service_key = impl_->service_key_;
@@ -257,6 +461,19 @@ void ServiceRouterChain::CollectStat(ServiceKey& service_key,
       stat_data[impl_->plugin_name_list_[i]] = data;
     }
   }
+  int hit_count  = impl_->result_cache_hit_.Exchange(0);
+  int miss_count = impl_->result_cache_miss_.Exchange(0);
+  if (hit_count > 0 || miss_count > 0) {
+    RouterStatData* data = new RouterStatData();
+    data->record_.set_plugin_name(ServiceRouterConfig::kChainResultCacheStatName);
+    v1::RouteResult* result = data->record_.add_results();
+    result->set_ret_code("CacheHit");
+    result->set_period_times(hit_count);
+    result = data->record_.add_results();
+    result->set_ret_code("CacheMiss");
+    result->set_period_times(miss_count);
+    stat_data[ServiceRouterConfig::kChainResultCacheStatName] = data;
+  }
 }
 
 RouteInfoNotify* ServiceRouterChain::PrepareRouteInfoWithNotify(RouteInfo& route_info) {
@@ -269,7 +486,7 @@ RouteInfoNotify* ServiceRouterChain::PrepareRouteInfoWithNotify(RouteInfo& route
   ReturnCode ret =
       local_registry->GetServiceDataWithRef(service_key, kServiceDataInstances, service_data);
   if (ret == kReturnOk && service_data->GetDataStatus() != kDataNotFound) {
-    route_info.SetServiceInstances(new ServiceInstances(service_data));
+    route_info.SetServiceInstances(RouteObjectCache::NewServiceInstances(service_data));
   } else {
     route_info_notify_impl = new RouteInfoNotifyImpl();
     local_registry->LoadServiceDataWithNotify(
@@ -282,7 +499,7 @@ RouteInfoNotify* ServiceRouterChain::PrepareRouteInfoWithNotify(RouteInfo& route
     service_data = NULL;
     ret = local_registry->GetServiceDataWithRef(service_key, kServiceDataRouteRule, service_data);
     if (ret == kReturnOk && service_data->GetDataStatus() != kDataNotFound) {
-      route_info.SetServiceRouteRule(new ServiceRouteRule(service_data));
+      route_info.SetServiceRouteRule(RouteObjectCache::NewServiceRouteRule(service_data));
     } else {
       if (route_info_notify_impl == NULL) {
         route_info_notify_impl = new RouteInfoNotifyImpl();
@@ -299,7 +516,7 @@ RouteInfoNotify* ServiceRouterChain::PrepareRouteInfoWithNotify(RouteInfo& route
       ret          = local_registry->GetServiceDataWithRef(source_service_info->service_key_,
                                                   kServiceDataRouteRule, service_data);
       if (ret == kReturnOk && service_data->GetDataStatus() != kDataNotFound) {
-        route_info.SetSourceServiceRouteRule(new ServiceRouteRule(service_data));
+        route_info.SetSourceServiceRouteRule(RouteObjectCache::NewServiceRouteRule(service_data));
       } else {
         if (route_info_notify_impl == NULL) {
           route_info_notify_impl = new RouteInfoNotifyImpl();
@@ -321,48 +538,61 @@ ReturnCode ServiceRouterChain::PrepareRouteInfo(RouteInfo& route_info, uint64_t
   if (route_info_notify == NULL) {
     return kReturnOk;
   }
-  bool use_disk_data = false;
-  if (!route_info_notify->IsDataReady(use_disk_data)) {
-    timespec ts    = Time::CurrentTimeAddWith(timeout);
-    ReturnCode ret = route_info_notify->WaitData(ts);
-    if (ret == kReturnTimeout) {
-      use_disk_data = true;
-      if (!route_info_notify->IsDataReady(use_disk_data)) {
-        delete route_info_notify;
-        route_info_notify = NULL;
-        return kReturnTimeout;
-      }
-    }
-  }
-  ReturnCode ret_code = route_info_notify->SetDataToRouteInfo(route_info);
+  timespec deadline   = Time::CurrentTimeAddWith(timeout);
+  ReturnCode ret_code = WaitRouteInfoReady(route_info_notify, deadline, route_info);
   delete route_info_notify;
   route_info_notify = NULL;
   return ret_code;
 }
 
-void CalculateUnhealthySet(RouteInfo& route_info, ServiceInstances* service_instances,
-                           std::set<Instance*>& unhealthy_set) {
-  if (!route_info.IsIncludeUnhealthyInstances()) {
-    unhealthy_set = service_instances->GetUnhealthyInstances();
+ReturnCode WaitRouteInfoReady(RouteInfoNotify* route_info_notify, timespec& deadline,
+                              RouteInfo& route_info) {
+  bool use_disk_data = false;
+  if (!route_info_notify->IsDataReady(use_disk_data) &&
+      route_info_notify->WaitData(deadline) == kReturnTimeout) {
+    use_disk_data = true;
+    if (!route_info_notify->IsDataReady(use_disk_data)) {
+      return kReturnTimeout;
+    }
+  }
+  return route_info_notify->SetDataToRouteInfo(route_info);
+}
+
+const std::set<Instance*>& CalculateUnhealthySet(RouteInfo& route_info,
+                                                 ServiceInstances* service_instances,
+                                                 std::set<Instance*>& scratch) {
+  bool exclude_unhealthy = !route_info.IsIncludeUnhealthyInstances();
+  if (route_info.IsIncludeCircuitBreakerInstances()) {
+    return exclude_unhealthy ? service_instances->GetUnhealthyInstances() : scratch;
+  }
+  if (service_instances->GetService() == NULL) {
+    POLARIS_LOG(LOG_ERROR, "Service member of %s:%s is null",
+                route_info.GetServiceKey().namespace_.c_str(),
+                route_info.GetServiceKey().name_.c_str());
+    return exclude_unhealthy ? service_instances->GetUnhealthyInstances() : scratch;
+  }
+  ServiceData* service_data = service_instances->GetServiceData();
+  CircuitBreakerSnapshot* snapshot =
+      service_instances->GetService()->GetServiceImpl()->GetCircuitBreakerSnapshot(service_data);
+  if (snapshot->open_instance_ids_.empty()) {
+    return exclude_unhealthy ? service_instances->GetUnhealthyInstances() : scratch;
+  }
+  if (snapshot->IsBoundTo(service_data)) {
+    return exclude_unhealthy ? snapshot->excluded_instances_ : snapshot->open_instances_;
+  }
+  // 快照与路由使用的服务数据版本不一致，按实例ID查找
+  if (exclude_unhealthy) {
+    scratch = service_instances->GetUnhealthyInstances();
   }
   std::map<std::string, Instance*>& instances = service_instances->GetInstances();
-  if (!route_info.IsIncludeCircuitBreakerInstances()) {
-    if (service_instances->GetService() == NULL) {
-      POLARIS_LOG(LOG_ERROR, "Service member of %s:%s is null",
-                  route_info.GetServiceKey().namespace_.c_str(),
-                  route_info.GetServiceKey().name_.c_str());
-      return;
-    }
-    std::set<std::string> circuit_breaker_set =
-        service_instances->GetService()->GetCircuitBreakerOpenInstances();
-    for (std::set<std::string>::iterator it = circuit_breaker_set.begin();
-         it != circuit_breaker_set.end(); ++it) {
-      std::map<std::string, Instance*>::iterator instance_it = instances.find(*it);
-      if (instance_it != instances.end()) {
-        unhealthy_set.insert(instance_it->second);
-      }
+  for (std::set<std::string>::iterator it = snapshot->open_instance_ids_.begin();
+       it != snapshot->open_instance_ids_.end(); ++it) {
+    std::map<std::string, Instance*>::iterator instance_it = instances.find(*it);
+    if (instance_it != instances.end()) {
+      scratch.insert(instance_it->second);
     }
   }
+  return scratch;
 }
 
 }  // namespace polaris
@@ -16,6 +16,7 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <time.h>
 
 #include <set>
 #include <string>
@@ -25,6 +26,7 @@
 #include "polaris/defs.h"
 #include "polaris/model.h"
 #include "polaris/plugin.h"
+#include "sync/atomic.h"
 #include "v1/request.pb.h"
 
 namespace polaris {
@@ -39,6 +41,10 @@ static const char kChainPluginListDefault[] = "ruleBasedRouter, nearbyBasedRoute
 static const char kRecoverAllEnableKey[]   = "enableRecoverAll";
 static const bool kRecoverAllEnableDefault = true;
 
+static const char kChainResultCacheEnableKey[]   = "enableResultCache";
+static const bool kChainResultCacheEnableDefault = false;
+static const char kChainResultCacheStatName[]    = "routerChainResultCache";  // 缓存命中统计名
+
 static const char kPercentOfMinInstancesKey[]    = "percentOfMinInstances";
 static const float kPercentOfMinInstancesDefault = 0.0;
 
@@ -74,20 +80,67 @@ private:
   ServiceDataOrNotify data_or_notify_[kDataOrNotifySize];
 };
 
+struct RouteChainCacheKey;
+class RouteChainCacheValue;
+class RouteInfoNotify;
+
+template <typename K>
+class ServiceCache;
+
 // 服务路由执行链实现
 class ServiceRouterChainImpl {
 private:
   friend class ServiceRouterChain;
+
+  // 依次执行路由链上的插件，route_count返回实际执行的插件数
+  ReturnCode RunServiceRouters(RouteInfo& route_info, RouteResult* route_result,
+                               int& route_count);
+
+  // 根据路由链所有插件的输入构造结果缓存key
+  void BuildResultCacheKey(RouteInfo& route_info, RouteChainCacheKey& cache_key);
+
+  // 缓存值中保存的原始输入与本次路由的输入相同
+  static bool MatchCachedInput(RouteChainCacheValue* cache_value, RouteInfo& route_info);
+
+  // 查询缓存的路由结果，命中时设置路由结果并返回true
+  bool GetCachedResult(const RouteChainCacheKey& cache_key, RouteInfo& route_info,
+                       RouteResult* route_result);
+
   Context* context_;
   ServiceKey service_key_;
   bool enable_;
   bool is_rule_router_enable_;
   std::vector<ServiceRouter*> service_router_list_;
   std::vector<std::string> plugin_name_list_;
+  ServiceCache<RouteChainCacheKey>* result_cache_;  // 路由链结果缓存，未开启时为NULL
+  uint64_t result_verify_interval_;                 // 缓存结果重新执行路由链校验的间隔
+  sync::Atomic<int> result_cache_hit_;
+  sync::Atomic<int> result_cache_miss_;
 };
 
-void CalculateUnhealthySet(RouteInfo& route_info, ServiceInstances* service_instances,
-                           std::set<Instance*>& unhealthy_set);
+/// @brief 等待路由数据就绪并设置到路由信息中，超时后尝试使用磁盘加载的数据
+///
+/// @param route_info_notify 准备路由数据时返回的通知对象，由调用方释放
+/// @param deadline 等待的截止时间
+/// @return ReturnCode kReturnOk：数据已设置到路由信息中，kReturnTimeout：超时且没有磁盘数据
+ReturnCode WaitRouteInfoReady(RouteInfoNotify* route_info_notify, timespec& deadline,
+                              RouteInfo& route_info);
+
+/// @brief 计算路由时需要过滤的不健康实例和熔断实例
+///
+/// 优先返回服务数据和熔断快照中预先计算好的集合，只有熔断快照与服务数据不一致时才构造到scratch中
+/// @return 需要过滤的实例集合，在RCU保护区间内有效
+const std::set<Instance*>& CalculateUnhealthySet(RouteInfo& route_info,
+                                                 ServiceInstances* service_instances,
+                                                 std::set<Instance*>& scratch);
+
+/// @brief 路由插件执行成功后记录本次路由结果
+///
+/// 增加插件选出的实例分组的访问计数。在路由链中执行时还会记录到路由链结果缓存，
+/// 只有链上执行的插件全部记录了可缓存的结果，路由链结果才会被缓存
+/// @param result_data 插件选出并需要统计访问次数的实例分组，插件未过滤实例时传入NULL
+/// @param cacheable 相同输入下插件是否总是返回相同的结果
+void RecordRouteResult(InstancesSet* result_data, bool cacheable);
 
 }  // namespace polaris
 
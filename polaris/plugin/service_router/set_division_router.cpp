@@ -151,6 +151,7 @@ ReturnCode SetDivisionServiceRouter::DoRoute(RouteInfo& route_info, RouteResult*
   POLARIS_CHECK_ARGUMENT(service_instances != NULL);
 
   if (NULL == route_info.GetSourceServiceInfo()) {
+    RecordRouteResult(NULL, true);
     route_result->SetServiceInstances(service_instances);
     route_info.SetServiceInstances(NULL);
     return kReturnOk;
@@ -162,6 +163,7 @@ ReturnCode SetDivisionServiceRouter::DoRoute(RouteInfo& route_info, RouteResult*
   std::map<std::string, std::string>::iterator source_meta_iter =
       source_metadata.find(constants::kRouterRequestSetNameKey);
   if (source_meta_iter == source_metadata.end() || source_meta_iter->second.empty()) {
+    RecordRouteResult(NULL, true);
     route_result->SetServiceInstances(service_instances);
     route_info.SetServiceInstances(NULL);
     return kReturnOk;
@@ -211,8 +213,9 @@ ReturnCode SetDivisionServiceRouter::DoRoute(RouteInfo& route_info, RouteResult*
       const std::vector<Instance*>& instances = avail_instances->GetInstances();
       CalculateMatchResult(cache_key.caller_set_name, instances, result);
       // 从选出的列表中进一步选出active的节点，如果没有active的节点，将返回inactive的
-      std::set<Instance*> unhealthy_set;
-      CalculateUnhealthySet(route_info, service_instances, unhealthy_set);
+      std::set<Instance*> scratch;
+      const std::set<Instance*>& unhealthy_set =
+          CalculateUnhealthySet(route_info, service_instances, scratch);
 
       std::vector<Instance*> healthy_result;
       GetHealthyInstances(result, unhealthy_set, healthy_result);
@@ -243,6 +246,7 @@ ReturnCode SetDivisionServiceRouter::DoRoute(RouteInfo& route_info, RouteResult*
   // 未启用set，则直接将路由结果往后透传返回
   if (enable_set_force == false && cache_value->enable_set == false) {
     cache_value->DecrementRef();
+    RecordRouteResult(NULL, true);
     route_result->SetServiceInstances(service_instances);
     route_info.SetServiceInstances(NULL);
     return kReturnOk;
@@ -252,7 +256,7 @@ ReturnCode SetDivisionServiceRouter::DoRoute(RouteInfo& route_info, RouteResult*
   route_info.SetRouterFlag(GetIncompatibleServiceRouter(), false);
 
   // 更新route_result
-  cache_value->current_data_->GetInstancesSetImpl()->count_++;
+  RecordRouteResult(cache_value->current_data_, true);
   service_instances->UpdateAvailableInstances(cache_value->current_data_);
   cache_value->DecrementRef();
   route_result->SetServiceInstances(service_instances);
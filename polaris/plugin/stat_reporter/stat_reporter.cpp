@@ -16,9 +16,9 @@
 #include <sstream>
 #include <utility>
 
+#include "cache/lru_map.h"
 #include "logger.h"
 #include "polaris/config.h"
-#include "utils/time_clock.h"
 
 namespace polaris {
 
@@ -38,9 +38,123 @@ static const char kReportIntervalKey[]       = "reportInterval";
 static const uint64_t kReportIntervalDefault = 60 * 1000;
 }  // namespace StatReporterConfig
 
+CallStatIndex::CallStatIndex() : size_(0) {}
+
+CallStatIndex::~CallStatIndex() {
+  for (uint32_t i = 0; i < size_; ++i) {
+    delete keys_[i].Load();
+  }
+  for (std::size_t i = 0; i < retired_keys_.size(); ++i) {
+    delete retired_keys_[i];
+  }
+}
+
+const CallStatKey* CallStatIndex::Find(const InstanceGauge& instance_gauge, uint32_t hash,
+                                       uint32_t& slot) const {
+  for (slot = hash & (kSlotCount - 1);; slot = (slot + 1) & (kSlotCount - 1)) {
+    const CallStatKey* key = slots_[slot].Load();
+    if (key == NULL) {
+      return NULL;
+    }
+    if (key->hash_ == hash && key->instance_id_ == instance_gauge.instance_id &&
+        key->service_key_.name_ == instance_gauge.service_name &&
+        key->service_key_.namespace_ == instance_gauge.service_namespace) {
+      return key;
+    }
+  }
+}
+
+uint32_t CallStatIndex::GetIndex(const InstanceGauge& instance_gauge) {
+  uint32_t hash = MurmurString(instance_gauge.instance_id);  // 实例ID全局唯一，只对ID计算哈希
+  uint32_t slot;
+  const CallStatKey* key = Find(instance_gauge, hash, slot);
+  if (key != NULL) {
+    return key->index_;
+  }
+  sync::MutexGuard mutex_guard(lock_);
+  if ((key = Find(instance_gauge, hash, slot)) != NULL) {
+    return key->index_;
+  }
+  uint32_t index;
+  if (!free_indexes_.empty()) {
+    index = free_indexes_.back();
+    free_indexes_.pop_back();
+  } else if (size_ < kCallStatMaxInstances) {
+    index = size_++;
+  } else {
+    return kCallStatMaxInstances;
+  }
+  CallStatKey* new_key             = new CallStatKey();
+  new_key->service_key_.namespace_ = instance_gauge.service_namespace;
+  new_key->service_key_.name_      = instance_gauge.service_name;
+  new_key->instance_id_            = instance_gauge.instance_id;
+  new_key->hash_                   = hash;
+  new_key->index_                  = index;
+  new_key->period_                 = period_.Load();
+  keys_[index].Store(new_key);  // 先发布下标再发布到哈希槽
+  slots_[slot].Store(new_key);
+  return index;
+}
+
+void CallStatIndex::RemoveSlot(const CallStatKey* key) {
+  uint32_t hole = key->hash_ & (kSlotCount - 1);
+  while (slots_[hole].Load() != key) {
+    hole = (hole + 1) & (kSlotCount - 1);
+  }
+  // 无锁查找在移动过程中可能找不到key，会加锁后重新查找
+  for (uint32_t slot = (hole + 1) & (kSlotCount - 1);; slot = (slot + 1) & (kSlotCount - 1)) {
+    CallStatKey* next_key = slots_[slot].Load();
+    if (next_key == NULL) {
+      break;
+    }
+    uint32_t home = next_key->hash_ & (kSlotCount - 1);
+    if (((slot - home) & (kSlotCount - 1)) >= ((slot - hole) & (kSlotCount - 1))) {
+      slots_[hole].Store(next_key);  // 空位在key的探测路径上，前移到空位
+      hole = slot;
+    }
+  }
+  slots_[hole].Store(NULL);
+}
+
+void CallStatIndex::EndPeriod(const std::vector<bool>& active_indexes,
+                              uint32_t min_report_period) {
+  sync::MutexGuard mutex_guard(lock_);
+  uint32_t period = period_.Load();
+  // 释放后开始上报的线程不会再访问，残留的统计也已在本周期收集时丢弃，可以复用
+  std::size_t retired_count = 0;
+  for (std::size_t i = 0; i < retired_keys_.size(); ++i) {
+    CallStatKey* key = retired_keys_[i];
+    if (key->period_ < min_report_period) {
+      free_indexes_.push_back(key->index_);
+      delete key;
+    } else {
+      retired_keys_[retired_count++] = key;
+    }
+  }
+  retired_keys_.resize(retired_count);
+  for (uint32_t i = 0; i < size_; ++i) {
+    CallStatKey* key = keys_[i].Load();
+    if (key == NULL || active_indexes[i] || key->period_ == period) {
+      continue;  // 本周期分配的下标至少保留一个完整周期
+    }
+    RemoveSlot(key);
+    keys_[i].Store(NULL);
+    key->period_ = period;
+    retired_keys_.push_back(key);
+  }
+  period_.Store(period + 1);
+}
+
+TlsInstanceStat::TlsInstanceStat() {}
+
+TlsInstanceStat::~TlsInstanceStat() {
+  for (uint32_t i = 0; i < kCallStatMaxInstances / kCallStatBlockSize; ++i) {
+    delete blocks_[i].Load();
+  }
+}
+
 MonitorStatReporter::MonitorStatReporter() {
   context_         = NULL;
-  perpare_time_    = 0;
   report_interval_ = 0;
   tls_key_         = 0;
   int rc           = pthread_key_create(&tls_key_, &OnThreadExit);
@@ -52,12 +166,8 @@ MonitorStatReporter::~MonitorStatReporter() {
   pthread_key_delete(tls_key_);
   for (std::set<TlsInstanceStat*>::iterator it = tls_stat_set_.begin(); it != tls_stat_set_.end();
        ++it) {
-    delete (*it)->stat_map_;
     delete (*it);
   }
-  for (std::size_t i = 0; i < perpare_data_.size(); ++i) {
-    delete perpare_data_[i];
-  }
 }
 
 ReturnCode MonitorStatReporter::Init(Config* config, Context* context) {
@@ -70,20 +180,70 @@ ReturnCode MonitorStatReporter::Init(Config* config, Context* context) {
 
 ReturnCode MonitorStatReporter::ReportStat(const InstanceGauge& instance_gauge) {
   TlsInstanceStat* thread_stat = static_cast<TlsInstanceStat*>(pthread_getspecific(tls_key_));
-  if (thread_stat != NULL) {
-    thread_stat->access_time_ = Time::GetCurrentTimeMs();
-    __sync_synchronize();
-  } else {
+  if (thread_stat == NULL) {
     thread_stat = CreateTlsStat();
   }
-  ServiceStat* stat_map       = thread_stat->stat_map_;
-  InstanceStat& instance_stat = (*stat_map)[instance_gauge.instance_id];
-  if (instance_stat.service_key_ == NULL) {
-    instance_stat.service_key_             = new ServiceKey();
-    instance_stat.service_key_->namespace_ = instance_gauge.service_namespace;
-    instance_stat.service_key_->name_      = instance_gauge.service_name;
+  // 上报期间标记开始上报的周期，此后释放的下标和key在上报结束前不会回收
+  uint32_t period = call_stat_index_.GetPeriod();
+  thread_stat->report_period_.Store(period + 1);
+  bool result = ReportTlsStat(thread_stat, period, instance_gauge);
+  thread_stat->report_period_.Store(0);
+  if (!result) {  // 实例数或返回码数超过上限
+    ReportOverflowStat(instance_gauge);
   }
-  InstanceCodeStat& code_stat = instance_stat.ret_code_stat_[instance_gauge.call_ret_code];
+  return kReturnOk;
+}
+
+bool MonitorStatReporter::ReportTlsStat(TlsInstanceStat* thread_stat, uint32_t period,
+                                        const InstanceGauge& instance_gauge) {
+  uint32_t index = call_stat_index_.GetIndex(instance_gauge);
+  if (index >= kCallStatMaxInstances) {
+    return false;
+  }
+  sync::Atomic<CallStatBlock*>& block_ref = thread_stat->blocks_[index / kCallStatBlockSize];
+  CallStatBlock* block                    = block_ref.Load();
+  if (block == NULL) {  // 只有本线程会分配，无需CAS
+    block = new CallStatBlock();
+    block_ref.Store(block);
+  }
+  InstanceCallStat& instance_stat = block->instance_stats_[index % kCallStatBlockSize];
+  if (instance_stat.period_ != period) {  // 新的上报周期，释放已被收集清零的返回码
+    instance_stat.period_ = period;
+    for (int i = 0; i < kCallStatCodeSlots; ++i) {
+      CallCodeStat& code_stat = instance_stat.code_stats_[i];
+      if (code_stat.success_count_.Load() == 0 && code_stat.error_count_.Load() == 0) {
+        code_stat.used_.Store(false);
+      }
+    }
+  }
+  int ret_code = instance_gauge.call_ret_code;
+  for (int i = 0; i < kCallStatCodeSlots; ++i) {
+    CallCodeStat& code_stat = instance_stat.code_stats_[(ret_code + i) & (kCallStatCodeSlots - 1)];
+    if (!code_stat.used_.Load()) {
+      code_stat.ret_code_ = ret_code;
+      code_stat.used_.Store(true);  // 先设置返回码再发布
+    } else if (code_stat.ret_code_ != ret_code) {
+      continue;
+    }
+    if (instance_gauge.call_ret_status == kCallRetOk) {
+      code_stat.success_count_++;
+      code_stat.success_delay_ += instance_gauge.call_daley;
+    } else {
+      code_stat.error_count_++;
+      code_stat.error_delay_ += instance_gauge.call_daley;
+    }
+    return true;
+  }
+  return false;  // 返回码表已满
+}
+
+void MonitorStatReporter::ReportOverflowStat(const InstanceGauge& instance_gauge) {
+  ServiceKey service_key;
+  service_key.namespace_ = instance_gauge.service_namespace;
+  service_key.name_      = instance_gauge.service_name;
+  sync::MutexGuard mutex_guard(lock_);
+  InstanceCodeStat& code_stat = overflow_stat_[service_key][instance_gauge.instance_id]
+                                    .ret_code_stat_[instance_gauge.call_ret_code];
   if (instance_gauge.call_ret_status == kCallRetOk) {
     code_stat.success_count_++;
     code_stat.success_delay_ += instance_gauge.call_daley;
@@ -91,16 +251,79 @@ ReturnCode MonitorStatReporter::ReportStat(const InstanceGauge& instance_gauge)
     code_stat.error_count_++;
     code_stat.error_delay_ += instance_gauge.call_daley;
   }
-  __sync_synchronize();
-  thread_stat->access_time_ = Time::kMaxTime;
-  return kReturnOk;
+}
+
+void MonitorStatReporter::CollectTlsStat(TlsInstanceStat* thread_stat,
+                                         std::map<ServiceKey, ServiceStat>& report_data,
+                                         std::vector<bool>& active_indexes) {
+  for (uint32_t block_index = 0; block_index < kCallStatMaxInstances / kCallStatBlockSize;
+       ++block_index) {
+    CallStatBlock* block = thread_stat->blocks_[block_index].Load();
+    if (block == NULL) {
+      continue;
+    }
+    for (uint32_t i = 0; i < kCallStatBlockSize; ++i) {
+      uint32_t index                       = block_index * kCallStatBlockSize + i;
+      InstanceCallStat& instance_call_stat = block->instance_stats_[i];
+      InstanceStat* instance_stat          = NULL;
+      for (int j = 0; j < kCallStatCodeSlots; ++j) {
+        CallCodeStat& call_code_stat = instance_call_stat.code_stats_[j];
+        if (!call_code_stat.used_.Load()) {
+          continue;
+        }
+        uint32_t success_count = call_code_stat.success_count_.Exchange(0);
+        uint32_t error_count   = call_code_stat.error_count_.Exchange(0);
+        if (success_count == 0 && error_count == 0) {
+          continue;
+        }
+        uint64_t success_delay = call_code_stat.success_delay_.Exchange(0);
+        uint64_t error_delay   = call_code_stat.error_delay_.Exchange(0);
+        active_indexes[index]  = true;
+        if (instance_stat == NULL) {
+          const CallStatKey* key = call_stat_index_.GetKey(index);
+          if (key == NULL) {  // 下标已释放，丢弃释放前获取下标的线程残留的统计
+            continue;
+          }
+          instance_stat = &report_data[key->service_key_][key->instance_id_];
+        }
+        InstanceCodeStat& code_stat = instance_stat->ret_code_stat_[call_code_stat.ret_code_];
+        code_stat.success_count_ += success_count;
+        code_stat.success_delay_ += success_delay;
+        code_stat.error_count_ += error_count;
+        code_stat.error_delay_ += error_delay;
+      }
+    }
+  }
 }
 
 void MonitorStatReporter::CollectData(std::map<ServiceKey, ServiceStat>& report_data) {
-  for (std::size_t i = 0; i < perpare_data_.size(); ++i) {
-    ServiceStat& tls_data = *(perpare_data_[i]);
-    for (ServiceStat::iterator it = tls_data.begin(); it != tls_data.end(); ++it) {
-      ServiceStat& service_stat   = report_data[*(it->second.service_key_)];
+  sync::MutexGuard mutex_guard(lock_);
+  // 正在上报的线程可能仍在使用其开始上报前释放的下标和key
+  uint32_t min_report_period = call_stat_index_.GetPeriod();
+  for (std::set<TlsInstanceStat*>::iterator it = tls_stat_set_.begin(); it != tls_stat_set_.end();
+       ++it) {
+    uint32_t report_period = (*it)->report_period_.Load();
+    if (report_period != 0 && report_period - 1 < min_report_period) {
+      min_report_period = report_period - 1;
+    }
+  }
+  std::vector<bool> active_indexes(kCallStatMaxInstances, false);
+  for (std::set<TlsInstanceStat*>::iterator it = tls_stat_set_.begin();
+       it != tls_stat_set_.end();) {
+    bool active = (*it)->active_.Load();  // 先读取状态，线程退出后的最后一次读取包含全部数据
+    CollectTlsStat(*it, report_data, active_indexes);
+    if (active) {
+      ++it;
+    } else {  // 线程已经退出，则删除线程局部数据
+      delete (*it);
+      tls_stat_set_.erase(it++);
+    }
+  }
+  for (std::map<ServiceKey, ServiceStat>::iterator service_it = overflow_stat_.begin();
+       service_it != overflow_stat_.end(); ++service_it) {
+    ServiceStat& service_stat = report_data[service_it->first];
+    for (ServiceStat::iterator it = service_it->second.begin(); it != service_it->second.end();
+         ++it) {
       InstanceStat& instance_stat = service_stat[it->first];
       for (std::map<int, InstanceCodeStat>::iterator code_it = it->second.ret_code_stat_.begin();
            code_it != it->second.ret_code_stat_.end(); ++code_it) {
@@ -111,50 +334,17 @@ void MonitorStatReporter::CollectData(std::map<ServiceKey, ServiceStat>& report_
         code_stat.error_delay_ += code_it->second.error_delay_;
       }
     }
-    delete perpare_data_[i];
-  }
-  perpare_time_ = 0;
-  perpare_data_.clear();
-}
-
-bool MonitorStatReporter::PerpareReport() {
-  if (perpare_time_ == 0) {
-    lock_.Lock();
-    for (std::set<TlsInstanceStat*>::iterator it = tls_stat_set_.begin();
-         it != tls_stat_set_.end();) {
-      perpare_data_.push_back((*it)->stat_map_);
-      if ((*it)->active_) {  // 线程还活跃，则新建一个空map
-        ServiceStat* new_stat_map = new ServiceStat();
-        __sync_synchronize();  // 防止优化成直接赋值给stat_map  保证赋值的时候map已经构建完成
-        (*it)->stat_map_ = new_stat_map;
-        ++it;
-      } else {  // 线程已经退出，则删除线程局部数据
-        delete (*it);
-        tls_stat_set_.erase(it++);
-      }
-    }
-    lock_.Unlock();
-    // 先交换map，再获取时间。只有等待其他线程的时间都比这里的时间大，说明再也拿不到旧map
-    perpare_time_ = Time::GetCurrentTimeMs();
   }
-  bool perpared = true;
-  lock_.Lock();
-  for (std::set<TlsInstanceStat*>::iterator it = tls_stat_set_.begin(); it != tls_stat_set_.end();
-       ++it) {
-    if ((*it)->access_time_ <= perpare_time_) {
-      perpared = false;
-      break;
-    }
-  }
-  lock_.Unlock();
-  return perpared;
+  overflow_stat_.clear();
+  // 收集完成后才开始新周期，线程才会释放返回码
+  call_stat_index_.EndPeriod(active_indexes, min_report_period);
 }
 
+bool MonitorStatReporter::PerpareReport() { return true; }
+
 TlsInstanceStat* MonitorStatReporter::CreateTlsStat() {
   TlsInstanceStat* thread_stat = new TlsInstanceStat();
-  thread_stat->access_time_    = Time::GetCurrentTimeMs();
-  thread_stat->stat_map_       = new std::map<std::string, InstanceStat>();
-  thread_stat->active_         = true;
+  thread_stat->active_.Store(true);
   pthread_setspecific(tls_key_, thread_stat);
   lock_.Lock();
   tls_stat_set_.insert(thread_stat);
@@ -166,8 +356,7 @@ void MonitorStatReporter::OnThreadExit(void* ptr) {
   if (ptr != NULL) {
     TlsInstanceStat* thread_stat = static_cast<TlsInstanceStat*>(ptr);
     // 线程退出的时候设置线程局部数据active为false
-    thread_stat->active_ = false;
-    __sync_synchronize();
+    thread_stat->active_.Store(false);
   }
 }
 
@@ -25,12 +25,14 @@
 
 #include "polaris/defs.h"
 #include "polaris/plugin.h"
+#include "sync/atomic.h"
 #include "sync/mutex.h"
 
 namespace polaris {
 
 class Config;
 class Context;
+
 struct InstanceCodeStat {
   InstanceCodeStat() : success_count_(0), error_count_(0), success_delay_(0), error_delay_(0) {}
   uint32_t success_count_;
@@ -59,10 +61,89 @@ struct InstanceStat {
 // 服务统计：每个服务实例统计自己的数据
 typedef std::map<std::string, InstanceStat> ServiceStat;
 
+static const uint32_t kCallStatMaxInstances = 8192;  // 超过上限的实例走加锁的慢路径统计
+static const uint32_t kCallStatBlockSize    = 32;    // 线程统计数组按块分配
+static const int kCallStatCodeSlots         = 8;     // 每个实例的返回码表大小
+
+// 实例统计的key，首次上报时分配稠密下标，一个上报周期内没有调用时释放
+struct CallStatKey {
+  ServiceKey service_key_;
+  std::string instance_id_;
+  uint32_t hash_;  // 实例ID的哈希值
+  uint32_t index_;
+  uint32_t period_;  // 分配或释放时的上报周期
+};
+
+/// @brief 实例到稠密下标的映射，查询无锁，分配和释放下标时加锁
+class CallStatIndex {
+public:
+  CallStatIndex();
+
+  ~CallStatIndex();
+
+  // 返回实例的稠密下标，实例数达到上限时返回kCallStatMaxInstances
+  uint32_t GetIndex(const InstanceGauge& instance_gauge);
+
+  // 返回下标对应的key，下标已释放时返回NULL
+  const CallStatKey* GetKey(uint32_t index) const { return keys_[index].Load(); }
+
+  uint32_t GetPeriod() const { return period_.Load(); }
+
+  // 上报线程收集数据后调用，释放本周期没有调用的下标
+  // 释放的下标和key在正在上报的线程开始上报的最小周期min_report_period之后才回收复用
+  void EndPeriod(const std::vector<bool>& active_indexes, uint32_t min_report_period);
+
+private:
+  // 查找实例的key，未找到时slot返回可插入的位置
+  const CallStatKey* Find(const InstanceGauge& instance_gauge, uint32_t hash,
+                          uint32_t& slot) const;
+
+  // 从哈希槽中删除key，探测链上后续的key前移，查找时无需处理删除标记
+  void RemoveSlot(const CallStatKey* key);
+
+private:
+  static const uint32_t kSlotCount = kCallStatMaxInstances * 2;  // 开放寻址，负载不超过1/2
+
+  sync::Atomic<CallStatKey*> slots_[kSlotCount];
+  sync::Atomic<CallStatKey*> keys_[kCallStatMaxInstances];  // 按下标存放
+  uint32_t size_;
+  std::vector<uint32_t> free_indexes_;      // 可复用的下标
+  std::vector<CallStatKey*> retired_keys_;  // 已释放的key，无锁查找可能仍在访问，延迟回收
+  sync::Atomic<uint32_t> period_;           // 上报周期，每次收集数据后加1
+  sync::Mutex lock_;
+};
+
+// 单个返回码的统计，只由所属线程累加，上报线程读取后清零
+struct CallCodeStat {
+  sync::Atomic<bool> used_;  // 占用后返回码不再修改
+  int ret_code_;
+  sync::Atomic<uint32_t> success_count_;
+  sync::Atomic<uint32_t> error_count_;
+  sync::Atomic<uint64_t> success_delay_;
+  sync::Atomic<uint64_t> error_delay_;
+};
+
+// 实例的返回码统计表，按返回码开放寻址
+struct InstanceCallStat {
+  uint32_t period_;  // 所属线程最后访问时的上报周期，周期变化时释放上周期未使用的返回码
+  CallCodeStat code_stats_[kCallStatCodeSlots];
+};
+
+struct CallStatBlock {
+  InstanceCallStat instance_stats_[kCallStatBlockSize];
+};
+
 struct TlsInstanceStat {
-  ServiceStat* stat_map_;
-  uint64_t access_time_;
-  bool active_;
+  TlsInstanceStat();
+
+  ~TlsInstanceStat();
+
+  sync::Atomic<uint32_t> report_period_;  // 正在上报时为开始上报的周期加1，否则为0
+  sync::Atomic<bool> active_;
+  // 线程统计独占缓存行，避免伪共享
+  char padding_[64 - sizeof(sync::Atomic<uint32_t>) - sizeof(sync::Atomic<bool>)];
+  // 按实例下标索引的统计数组，所属线程首次访问时分配
+  sync::Atomic<CallStatBlock*> blocks_[kCallStatMaxInstances / kCallStatBlockSize];
 };
 
 class MonitorStatReporter : public StatReporter {
@@ -75,8 +156,7 @@ public:
 
   virtual ReturnCode ReportStat(const InstanceGauge& instance_gauge);
 
-  // 上报线程调用此方法，创建空的ServiceStat与线程使用中的进行交换
-  // 返回是否交换完毕
+  // 上报线程调用此方法准备上报，线程统计直接读取后清零无需等待交换，总是返回true
   bool PerpareReport();
 
   // 上报线程调用PerpareReport成功后，调用此方法获取所有线程的数据
@@ -86,18 +166,28 @@ private:
   // 新线程创建线程局部存储
   TlsInstanceStat* CreateTlsStat();
 
+  // 无锁统计到线程局部数据，实例数或返回码数超过上限时返回false
+  bool ReportTlsStat(TlsInstanceStat* thread_stat, uint32_t period,
+                     const InstanceGauge& instance_gauge);
+
+  // 实例数或返回码数超过上限时加锁统计
+  void ReportOverflowStat(const InstanceGauge& instance_gauge);
+
+  void CollectTlsStat(TlsInstanceStat* thread_stat, std::map<ServiceKey, ServiceStat>& report_data,
+                      std::vector<bool>& active_indexes);
+
   static void OnThreadExit(void* ptr);
 
 private:
   Context* context_;
   uint64_t report_interval_;
 
+  CallStatIndex call_stat_index_;
+
   sync::Mutex lock_;
   pthread_key_t tls_key_;
   std::set<TlsInstanceStat*> tls_stat_set_;
-
-  uint64_t perpare_time_;
-  std::vector<ServiceStat*> perpare_data_;  // 从线程中获取的准备上报的数据
+  std::map<ServiceKey, ServiceStat> overflow_stat_;
 };
 
 }  // namespace polaris
@@ -81,6 +81,8 @@ bool RateLimitRule::Init(const v1::Rule& rule) {
     action_type_ = kRateLimitActionReject;
   } else if (StringUtils::IgnoreCaseCmp(rule.action().value(), "unirate")) {
     action_type_ = kRateLimitActionUnirate;
+  } else if (StringUtils::IgnoreCaseCmp(rule.action().value(), "sliding_window")) {
+    action_type_ = kRateLimitActionSlidingWindow;
   } else {  // 其他类型暂未支持
     return false;
   }
@@ -198,7 +200,14 @@ bool RateLimitRule::IsMatch(const std::map<std::string, std::string>& subset,
 }
 
 std::string RateLimitRule::GetActionString() {
-  return action_type_ == kRateLimitActionReject ? "reject" : "unirate";
+  switch (action_type_) {
+    case kRateLimitActionUnirate:
+      return "unirate";
+    case kRateLimitActionSlidingWindow:
+      return "sliding_window";
+    default:
+      return "reject";
+  }
 }
 
 std::string RateLimitRule::MatchMapToStr(const std::map<std::string, MatchString>& match) {
@@ -279,7 +288,7 @@ void RateLimitRule::GetWindowKey(const std::map<std::string, std::string>& subse
   for (it = subset_.begin(); it != subset_.end(); ++it) {
     if (it->second.IsRegex()) {
       match_it = subset.find(it->first);
-      window_key.regex_subset_ += (separator + match_it->second);
+      window_key.regex_subset_.append(separator).append(match_it->second);
       separator = "|";
     }
   }
@@ -287,7 +296,7 @@ void RateLimitRule::GetWindowKey(const std::map<std::string, std::string>& subse
   for (it = labels_.begin(); it != labels_.end(); ++it) {
     if (it->second.IsRegex()) {
       match_it = labels.find(it->first);
-      window_key.regex_labels_ += (separator + match_it->second);
+      window_key.regex_labels_.append(separator).append(match_it->second);
       separator = "|";
     }
   }
@@ -52,6 +52,7 @@ struct RateLimitReport {
 enum RateLimitActionType {
   kRateLimitActionReject,
   kRateLimitActionUnirate,
+  kRateLimitActionSlidingWindow,  // 按滑动窗口计数拒绝
 };
 
 struct RateLimitWindowKey {
@@ -106,6 +107,8 @@ public:
 
   const std::map<std::string, MatchString>& GetLables() const { return labels_; }
 
+  const std::map<std::string, MatchString>& GetSubset() const { return subset_; }
+
   void GetWindowKey(const std::map<std::string, std::string>& subset,
                     const std::map<std::string, std::string>& labels,
                     RateLimitWindowKey& window_key);
@@ -13,85 +13,226 @@
 
 #include "quota/model/rate_limit_rule_index.h"
 
+#include <pthread.h>
+
+#include "logger.h"
+
 namespace polaris {
 
-void RateLimitRuleSubIndex::AddRule(
-    RateLimitRule* rule, const std::map<std::string, MatchString>::const_iterator& label_it,
-    const std::map<std::string, MatchString>::const_iterator& label_end) {
-  std::map<std::string, MatchString>::const_iterator next_label_it = label_it;
-  const std::string& label_value                                   = label_it->second.GetString();
-  while (++next_label_it != label_end) {
-    if (next_label_it->second.IsExactText()) {
-      sub_index_[label_value][next_label_it->first].AddRule(rule, next_label_it, label_end);
+RateLimitKeyIndex::RateLimitKeyIndex(const std::string& key) : key_(key), regex_set_(NULL) {}
+
+RateLimitKeyIndex::~RateLimitKeyIndex() {
+  if (regex_set_ != NULL) {
+    delete regex_set_;
+    regex_set_ = NULL;
+  }
+}
+
+void RateLimitKeyIndex::AddCondition(const MatchString& match_string, int rule_index) {
+  if (match_string.IsParameter()) {
+    parameter_rules_.push_back(rule_index);
+  } else if (match_string.IsRegex()) {
+    std::map<std::string, int>::iterator it = regex_ids_.find(match_string.GetString());
+    if (it == regex_ids_.end()) {  // 相同的正则只编译一次
+      it = regex_ids_.insert(std::make_pair(match_string.GetString(), regex_rules_.size())).first;
+      regex_matches_.push_back(&match_string);
+      regex_rules_.push_back(std::vector<int>());
+    }
+    regex_rules_[it->second].push_back(rule_index);
+  } else {
+    exact_rules_[match_string.GetString()].push_back(rule_index);
+  }
+}
+
+void RateLimitKeyIndex::Compile() {
+  if (regex_matches_.empty()) {
+    return;
+  }
+  re2::RE2::Options options;
+  options.set_log_errors(false);
+  regex_set_ = new re2::RE2::Set(options, re2::RE2::UNANCHORED);
+  for (std::size_t i = 0; i < regex_matches_.size(); ++i) {
+    std::string error;
+    if (regex_set_->Add(regex_matches_[i]->GetString(), &error) != static_cast<int>(i)) {
+      POLARIS_LOG(LOG_WARN, "add regex [%s] of label key [%s] to set error: %s",
+                  regex_matches_[i]->GetString().c_str(), key_.c_str(), error.c_str());
+      delete regex_set_;
+      regex_set_ = NULL;
       return;
     }
   }
-  value_index_[label_value] = rule;
+  if (!regex_set_->Compile()) {
+    POLARIS_LOG(LOG_WARN, "compile regex set of label key [%s] failed", key_.c_str());
+    delete regex_set_;
+    regex_set_ = NULL;
+  }
 }
 
-RateLimitRule* RateLimitRuleSubIndex::Search(
-    const std::string& value, const std::map<std::string, std::string>& subset,
-    const std::map<std::string, std::string>& labels) const {
-  // 先查找具有更多精确匹配label的索引
-  std::map<std::string, std::map<std::string, RateLimitRuleSubIndex> >::const_iterator sub_it;
-  std::map<std::string, RateLimitRuleSubIndex>::const_iterator key_it;
-  if ((sub_it = sub_index_.find(value)) != sub_index_.end()) {
-    for (key_it = sub_it->second.begin(); key_it != sub_it->second.end(); ++key_it) {
-      std::map<std::string, std::string>::const_iterator label_it = labels.find(key_it->first);
-      if (label_it != labels.end()) {
-        RateLimitRule* rule = key_it->second.Search(label_it->second, subset, labels);
-        if (rule != NULL) {
-          return rule;
-        }
+void RateLimitKeyIndex::Match(const std::string& value,
+                              std::vector<const std::vector<int>*>& matched,
+                              std::vector<int>& regex_ids) const {
+  std::map<std::string, std::vector<int> >::const_iterator exact_it = exact_rules_.find(value);
+  if (exact_it != exact_rules_.end()) {
+    matched.push_back(&exact_it->second);
+  }
+  if (regex_set_ != NULL) {
+    regex_ids.clear();
+    if (regex_set_->Match(value, &regex_ids)) {
+      for (std::size_t i = 0; i < regex_ids.size(); ++i) {
+        matched.push_back(&regex_rules_[regex_ids[i]]);
       }
     }
-  }
-  // 在查找没有更多精确匹配的索引
-  std::map<std::string, RateLimitRule*>::const_iterator value_it = value_index_.find(value);
-  if (value_it != value_index_.end()) {
-    if (value_it->second->IsMatch(subset, labels)) {
-      return value_it->second;
+  } else {  // 合并编译失败时逐个匹配
+    for (std::size_t i = 0; i < regex_matches_.size(); ++i) {
+      if (regex_matches_[i]->Match(value)) {
+        matched.push_back(&regex_rules_[i]);
+      }
     }
   }
-  return NULL;
+  if (!parameter_rules_.empty()) {
+    matched.push_back(&parameter_rules_);
+  }
 }
 
-void RateLimitRuleIndex::AddRule(RateLimitRule* rule) {
-  const std::map<std::string, MatchString>& labels      = rule->GetLables();
-  std::map<std::string, MatchString>::const_iterator it = labels.begin();
-  while (it != labels.end() && !it->second.IsExactText()) {
-    it++;
+///////////////////////////////////////////////////////////////////////////////
+
+// 规则匹配使用的临时数据，每个线程复用一份，避免每次匹配分配内存
+struct RuleMatchScratch {
+  std::vector<uint16_t> hits_;
+  std::vector<const std::vector<int>*> matched_;
+  std::vector<int> regex_ids_;
+};
+
+static __thread RuleMatchScratch* thread_local_match_scratch = NULL;
+static pthread_key_t g_match_scratch_key;
+static pthread_once_t g_match_scratch_once = PTHREAD_ONCE_INIT;
+
+static void DeleteThreadLocalMatchScratch(void* ptr) {
+  if (thread_local_match_scratch == ptr) {
+    thread_local_match_scratch = NULL;
   }
-  if (it != labels.end()) {
-    sub_index_[it->first].AddRule(rule, it, labels.end());
-  } else {
+  delete static_cast<RuleMatchScratch*>(ptr);
+}
+
+static void CreateMatchScratchKey() {
+  int rc = pthread_key_create(&g_match_scratch_key, &DeleteThreadLocalMatchScratch);
+  POLARIS_ASSERT(rc == 0);
+}
+
+static RuleMatchScratch& GetThreadLocalMatchScratch() {
+  if (thread_local_match_scratch == NULL) {
+    pthread_once(&g_match_scratch_once, &CreateMatchScratchKey);
+    thread_local_match_scratch = new RuleMatchScratch();
+    pthread_setspecific(g_match_scratch_key, thread_local_match_scratch);  // 线程退出时释放
+  }
+  return *thread_local_match_scratch;
+}
+
+RateLimitRuleIndex::RateLimitRuleIndex() : unconditional_index_(0) {}
+
+RateLimitRuleIndex::~RateLimitRuleIndex() {
+  for (std::size_t i = 0; i < label_indexes_.size(); ++i) {
+    delete label_indexes_[i];
+  }
+  for (std::size_t i = 0; i < subset_indexes_.size(); ++i) {
+    delete subset_indexes_[i];
+  }
+}
+
+void RateLimitRuleIndex::Build(const std::vector<RateLimitRule*>& rules) {
+  std::map<std::string, RateLimitKeyIndex*> label_indexes;
+  std::map<std::string, RateLimitKeyIndex*> subset_indexes;
+  for (std::size_t i = 0; i < rules.size(); ++i) {
+    RateLimitRule* rule = rules[i];
+    if (rule->IsDisbale()) {
+      continue;
+    }
+    int rule_index = static_cast<int>(rules_.size());
     rules_.push_back(rule);
+    condition_counts_.push_back(rule->GetLables().size() + rule->GetSubset().size());
+    AddConditions(rule->GetLables(), rule_index, label_indexes);
+    AddConditions(rule->GetSubset(), rule_index, subset_indexes);
+  }
+  unconditional_index_ = rules_.size();
+  for (std::size_t i = 0; i < condition_counts_.size(); ++i) {
+    if (condition_counts_[i] == 0) {
+      unconditional_index_ = i;
+      break;
+    }
+  }
+  CompileKeyIndexes(label_indexes, label_indexes_);
+  CompileKeyIndexes(subset_indexes, subset_indexes_);
+}
+
+void RateLimitRuleIndex::AddConditions(const std::map<std::string, MatchString>& conditions,
+                                       int rule_index,
+                                       std::map<std::string, RateLimitKeyIndex*>& key_indexes) {
+  for (std::map<std::string, MatchString>::const_iterator it = conditions.begin();
+       it != conditions.end(); ++it) {
+    RateLimitKeyIndex*& key_index = key_indexes[it->first];
+    if (key_index == NULL) {
+      key_index = new RateLimitKeyIndex(it->first);
+    }
+    key_index->AddCondition(it->second, rule_index);
+  }
+}
+
+void RateLimitRuleIndex::CompileKeyIndexes(std::map<std::string, RateLimitKeyIndex*>& key_indexes,
+                                           std::vector<RateLimitKeyIndex*>& sorted_indexes) {
+  sorted_indexes.reserve(key_indexes.size());
+  for (std::map<std::string, RateLimitKeyIndex*>::iterator it = key_indexes.begin();
+       it != key_indexes.end(); ++it) {
+    it->second->Compile();
+    sorted_indexes.push_back(it->second);
   }
 }
 
 RateLimitRule* RateLimitRuleIndex::MatchRule(
     const std::map<std::string, std::string>& subset,
     const std::map<std::string, std::string>& labels) const {
-  // 优先匹配有精确label的规则
-  std::map<std::string, RateLimitRuleSubIndex>::const_iterator sub_it;
-  std::map<std::string, std::string>::const_iterator label_it;
-  for (sub_it = sub_index_.begin(); sub_it != sub_index_.end(); ++sub_it) {
-    label_it = labels.find(sub_it->first);
-    if (label_it != labels.end()) {
-      RateLimitRule* rule = sub_it->second.Search(label_it->second, subset, labels);
-      if (rule != NULL) {
-        return rule;
-      }
-    }
+  std::size_t best_index = unconditional_index_;
+  if (best_index > 0) {
+    RuleMatchScratch& scratch = GetThreadLocalMatchScratch();
+    scratch.hits_.assign(best_index, 0);  // 复用上次匹配分配的内存
+    MatchKeys(label_indexes_, labels, scratch, best_index);
+    MatchKeys(subset_indexes_, subset, scratch, best_index);
   }
-  // 匹配没有精确label的规则
-  for (std::size_t i = 0; i < rules_.size(); ++i) {
-    RateLimitRule* const& rule = rules_[i];
-    if (rule->IsMatch(subset, labels)) {
-      return rule;
+  return best_index < rules_.size() ? rules_[best_index] : NULL;
+}
+
+void RateLimitRuleIndex::MatchKeys(const std::vector<RateLimitKeyIndex*>& key_indexes,
+                                   const std::map<std::string, std::string>& values,
+                                   RuleMatchScratch& scratch, std::size_t& best_index) const {
+  std::vector<uint16_t>& hits                                 = scratch.hits_;
+  std::vector<const std::vector<int>*>& matched               = scratch.matched_;
+  std::size_t index                                           = 0;
+  std::map<std::string, std::string>::const_iterator value_it = values.begin();
+  while (index < key_indexes.size() && value_it != values.end()) {
+    int result = key_indexes[index]->GetKey().compare(value_it->first);
+    if (result < 0) {
+      index++;
+    } else if (result > 0) {
+      value_it++;
+    } else {
+      matched.clear();
+      key_indexes[index]->Match(value_it->second, matched, scratch.regex_ids_);
+      for (std::size_t i = 0; i < matched.size(); ++i) {
+        const std::vector<int>& rule_indexes = *matched[i];
+        // 规则序号递增，只需统计排在当前最佳结果之前的规则
+        for (std::size_t j = 0; j < rule_indexes.size(); ++j) {
+          std::size_t rule_index = rule_indexes[j];
+          if (rule_index >= best_index) {
+            break;
+          }
+          if (++hits[rule_index] == condition_counts_[rule_index]) {
+            best_index = rule_index;
+          }
+        }
+      }
+      index++;
+      value_it++;
     }
   }
-  return NULL;
 }
 
 }  // namespace polaris
@@ -14,49 +14,87 @@
 #ifndef POLARIS_CPP_POLARIS_QUOTA_MODEL_RATE_LIMIT_RULE_INDEX_H_
 #define POLARIS_CPP_POLARIS_QUOTA_MODEL_RATE_LIMIT_RULE_INDEX_H_
 
+#include <re2/set.h>
+#include <stdint.h>
+
 #include <map>
 #include <string>
 #include <vector>
 
+#include "polaris/noncopyable.h"
 #include "quota/model/rate_limit_rule.h"
 
 namespace polaris {
 
-// 针对label的key和value构建的索引
-class RateLimitRuleSubIndex {
+struct RuleMatchScratch;
+
+// 同一个key下所有规则的匹配条件
+class RateLimitKeyIndex : Noncopyable {
 public:
-  // 插入规则
-  void AddRule(RateLimitRule* rule,
-               const std::map<std::string, MatchString>::const_iterator& label_it,
-               const std::map<std::string, MatchString>::const_iterator& label_end);
+  explicit RateLimitKeyIndex(const std::string& key);
+
+  ~RateLimitKeyIndex();
+
+  // 添加规则的匹配条件
+  void AddCondition(const MatchString& match_string, int rule_index);
 
-  // 用当前索引查询rule
-  RateLimitRule* Search(const std::string& value, const std::map<std::string, std::string>& subset,
-                        const std::map<std::string, std::string>& labels) const;
+  // 将所有正则合并编译成一个RE2::Set
+  void Compile();
+
+  // 查找value满足的匹配条件，返回满足条件的规则序号列表，regex_ids为正则匹配使用的临时数据
+  void Match(const std::string& value, std::vector<const std::vector<int>*>& matched,
+             std::vector<int>& regex_ids) const;
+
+  const std::string& GetKey() const { return key_; }
 
 private:
-  // value -> rule 最后一个label的value的索引
-  std::map<std::string, RateLimitRule*> value_index_;
+  std::string key_;
+  std::map<std::string, std::vector<int> > exact_rules_;  // 精确匹配：value -> 规则序号
+
+  std::map<std::string, int> regex_ids_;           // 正则表达式 -> 正则序号
+  std::vector<const MatchString*> regex_matches_;  // 正则序号 -> 正则，RE2::Set编译失败时使用
+  std::vector<std::vector<int> > regex_rules_;     // 正则序号 -> 规则序号
+  re2::RE2::Set* regex_set_;                       // 所有正则合并成的集合
 
-  // value -> <key, sub_index>  非最后一个label的value，指向下一个label的key
-  std::map<std::string, std::map<std::string, RateLimitRuleSubIndex> > sub_index_;
+  std::vector<int> parameter_rules_;  // 参数类型只要求key存在，value在创建窗口时匹配
 };
 
 // 限流规则索引
-class RateLimitRuleIndex {
+//
+// 将同一版本的所有规则编译成按key排序的匹配表，查询时对请求的labels和subset各遍历一次，
+// 累计每条规则满足的匹配条件数，条件全部满足且排序最靠前的规则即为匹配结果
+class RateLimitRuleIndex : Noncopyable {
 public:
-  // 插入规则索引
-  void AddRule(RateLimitRule* rule);
+  RateLimitRuleIndex();
+
+  ~RateLimitRuleIndex();
+
+  // 构建索引，规则须已按优先级排序
+  void Build(const std::vector<RateLimitRule*>& rules);
 
   // 查找rule
   RateLimitRule* MatchRule(const std::map<std::string, std::string>& subset,
                            const std::map<std::string, std::string>& labels) const;
 
 private:
-  std::vector<RateLimitRule*> rules_;  // 没有精确匹配label
+  static void AddConditions(const std::map<std::string, MatchString>& conditions, int rule_index,
+                            std::map<std::string, RateLimitKeyIndex*>& key_indexes);
+
+  static void CompileKeyIndexes(std::map<std::string, RateLimitKeyIndex*>& key_indexes,
+                                std::vector<RateLimitKeyIndex*>& sorted_indexes);
+
+  // 按key归并遍历请求数据和索引，统计各规则满足的条件数
+  void MatchKeys(const std::vector<RateLimitKeyIndex*>& key_indexes,
+                 const std::map<std::string, std::string>& values, RuleMatchScratch& scratch,
+                 std::size_t& best_index) const;
+
+private:
+  std::vector<RateLimitRule*> rules_;       // 启用的规则，按优先级排序
+  std::vector<uint16_t> condition_counts_;  // 每条规则的匹配条件数
+  std::size_t unconditional_index_;         // 没有匹配条件的规则中排序最靠前的规则序号
 
-  // <key, index> 第一个精确匹配的label的key的索引
-  std::map<std::string, RateLimitRuleSubIndex> sub_index_;
+  std::vector<RateLimitKeyIndex*> label_indexes_;   // 按key排序
+  std::vector<RateLimitKeyIndex*> subset_indexes_;  // 按key排序
 };
 
 }  // namespace polaris
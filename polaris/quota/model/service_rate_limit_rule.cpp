@@ -17,10 +17,17 @@
 
 #include "model/model_impl.h"
 #include "polaris/model.h"
+#include "utils/thread_local_arena.h"
 
 namespace polaris {
 
+RateLimitData::RateLimitData() : rule_index_(NULL) {}
+
 RateLimitData::~RateLimitData() {
+  if (rule_index_ != NULL) {
+    delete rule_index_;
+    rule_index_ = NULL;
+  }
   for (std::size_t i = 0; i < rules_.size(); ++i) {
     delete rules_[i];
   }
@@ -53,15 +60,15 @@ void RateLimitData::SortByPriority() {
 }
 
 void RateLimitData::SetupIndexMap() {
-  for (std::size_t i = 0; i < rules_.size(); ++i) {
-    RateLimitRule* rule = rules_[i];
-    rule_index_[rule->GetPriority()].AddRule(rule);
+  if (rule_index_ == NULL) {
+    rule_index_ = new RateLimitRuleIndex();
+    rule_index_->Build(rules_);
   }
 }
 
 RateLimitRule* RateLimitData::MatchRule(const std::map<std::string, std::string>& subset,
                                         const std::map<std::string, std::string>& labels) const {
-  if (rule_index_.empty()) {  // 没有索引时，线性查找
+  if (rule_index_ == NULL) {  // 没有索引时，线性查找
     for (std::size_t i = 0; i < rules_.size(); ++i) {
       RateLimitRule* const& rule = rules_[i];
       if (rule->IsMatch(subset, labels)) {
@@ -70,15 +77,7 @@ RateLimitRule* RateLimitData::MatchRule(const std::map<std::string, std::string>
     }
     return NULL;
   }
-  // 使用索引查询
-  for (std::map<int, RateLimitRuleIndex>::const_iterator it = rule_index_.begin();
-       it != rule_index_.end(); ++it) {
-    RateLimitRule* rule = it->second.MatchRule(subset, labels);
-    if (rule != NULL) {
-      return rule;
-    }
-  }
-  return NULL;
+  return rule_index_->MatchRule(subset, labels);  // 与线性查找一样返回排序最靠前的匹配规则
 }
 
 ServiceRateLimitRule::ServiceRateLimitRule(ServiceData* service_data)
@@ -108,4 +107,12 @@ ServiceData* ServiceRateLimitRule::GetServiceDataWithRef() {
   return service_data_;
 }
 
+void* ServiceRateLimitRule::operator new(std::size_t size) {
+  return ThreadLocalArena::Allocate(size);
+}
+
+void ServiceRateLimitRule::operator delete(void* ptr, std::size_t size) {
+  ThreadLocalArena::Deallocate(ptr, size);
+}
+
 }  // namespace polaris
@@ -14,6 +14,7 @@
 #ifndef POLARIS_CPP_POLARIS_QUOTA_MODEL_SERVICE_RATE_LIMIT_RULE_H_
 #define POLARIS_CPP_POLARIS_QUOTA_MODEL_SERVICE_RATE_LIMIT_RULE_H_
 
+#include <cstddef>
 #include <map>
 #include <set>
 #include <string>
@@ -27,13 +28,15 @@ namespace polaris {
 // 限流配额数据，由PB解析后存储在ServiceData对象中
 class RateLimitData {
 public:
+  RateLimitData();
+
   ~RateLimitData();
 
   void AddRule(RateLimitRule* rule);
 
   void SortByPriority();  // 按优先级排序，相同优先级按ID排序
 
-  void SetupIndexMap();  // 构建索引用于加快匹配
+  void SetupIndexMap();  // 将所有规则编译成索引用于加快匹配
 
   RateLimitRule* MatchRule(const std::map<std::string, std::string>& subset,
                            const std::map<std::string, std::string>& labels) const;
@@ -44,7 +47,7 @@ public:
 
 private:
   std::vector<RateLimitRule*> rules_;
-  std::map<int, RateLimitRuleIndex> rule_index_;
+  RateLimitRuleIndex* rule_index_;
   std::set<std::string> label_keys_;
 };
 
@@ -63,6 +66,10 @@ public:
 
   const std::set<std::string>& GetLabelKeys() const;
 
+  // 每次获取配额都会创建和释放该对象，从线程本地内存池分配内存
+  static void* operator new(std::size_t size);
+  static void operator delete(void* ptr, std::size_t size);
+
 private:
   ServiceData* service_data_;
 };
@@ -17,6 +17,8 @@
 #include <math.h>
 #include <stddef.h>
 
+#include <algorithm>
+#include <map>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -24,16 +26,37 @@
 #include "logger.h"
 #include "polaris/limit.h"
 #include "quota/model/rate_limit_rule.h"
-#include "quota_model.h"
 #include "utils/time_clock.h"
 
 namespace polaris {
 
+static const uint64_t kStripeLeaseMask   = 0xFFFFFFFFULL;
+static const int64_t kStripeBatchDivisor = 64;  // 所有分段预取的令牌总数不超过本地配额的1/64
+static const int64_t kStripeBatchMax     = 1024;
+static const int64_t kStripeLeaseMax     = 2 * kStripeBatchMax;  // 单个分段最多持有的令牌数
+
+static __thread int thread_token_stripe = -1;
+static sync::Atomic<int> g_token_stripe_seq;
+
+// 线程首次使用时按顺序分配分段下标，不同线程尽量分布到不同分段
+static int GetThreadTokenStripe() {
+  if (thread_token_stripe < 0) {
+    thread_token_stripe = (g_token_stripe_seq++) & 0x7FFFFFFF;
+  }
+  return thread_token_stripe;
+}
+
+static uint64_t StripeLeaseTag(uint64_t bucket_time) {
+  return (bucket_time & kStripeLeaseMask) << 32;
+}
+
 TokenBucket::TokenBucket()
-    : global_max_amount_(0), local_max_amount_(0), bucket_time_(0), bucket_stat_(0),
-      pending_bucket_time_(0), pending_bucket_stat_(0), last_use_up_time_(0) {}
+    : duration_(0), global_max_amount_(0), local_max_amount_(0), bucket_time_(0), bucket_stat_(0),
+      pending_bucket_time_(0), pending_bucket_stat_(0), last_use_up_time_(0), stripes_(NULL),
+      stripe_mask_(0), stripe_batch_(0), stripe_leased_(0) {}
 
 TokenBucket::TokenBucket(const TokenBucket& other) {
+  duration_            = other.duration_;
   global_max_amount_   = other.global_max_amount_.Load();
   local_max_amount_    = other.local_max_amount_;
   bucket_time_         = other.bucket_time_.Load();
@@ -41,10 +64,28 @@ TokenBucket::TokenBucket(const TokenBucket& other) {
   pending_bucket_time_ = other.pending_bucket_time_;
   pending_bucket_stat_ = other.pending_bucket_stat_;
   last_use_up_time_    = other.last_use_up_time_;
+  stripes_             = NULL;
+  stripe_mask_         = other.stripe_mask_;
+  stripe_batch_        = other.stripe_batch_;
+  stripe_leased_       = other.stripe_leased_.Load();
+  if (other.stripes_ != NULL) {
+    stripes_ = new TokenStripe[stripe_mask_ + 1];
+    for (int i = 0; i <= stripe_mask_; ++i) {
+      stripes_[i].lease_ = other.stripes_[i].lease_.Load();
+    }
+  }
+}
+
+TokenBucket::~TokenBucket() {
+  if (stripes_ != NULL) {
+    delete[] stripes_;
+    stripes_ = NULL;
+  }
 }
 
 void TokenBucket::Init(const RateLimitAmount& amount, uint64_t current_time,
-                       int64_t local_max_amount) {
+                       int64_t local_max_amount, int stripe_count) {
+  duration_            = amount.valid_duration_;
   global_max_amount_   = amount.max_amount_;
   local_max_amount_    = local_max_amount;
   bucket_time_         = current_time / amount.valid_duration_;
@@ -54,6 +95,20 @@ void TokenBucket::Init(const RateLimitAmount& amount, uint64_t current_time,
   // 初始化远程配额为本地配额
   remote_quota_.remote_token_total_ = local_max_amount_;
   remote_quota_.remote_token_left_  = local_max_amount_;
+
+  if (stripes_ != NULL) {
+    delete[] stripes_;
+    stripes_ = NULL;
+  }
+  stripe_mask_   = 0;
+  stripe_batch_  = 0;
+  stripe_leased_ = 0;
+  if (stripe_count > 0) {
+    POLARIS_ASSERT((stripe_count & (stripe_count - 1)) == 0);
+    stripes_     = new TokenStripe[stripe_count];
+    stripe_mask_ = stripe_count - 1;
+    ResetStripes();
+  }
 }
 
 bool TokenBucket::GetToken(int64_t acquire_amount, uint64_t expect_bucket_time,
@@ -62,6 +117,7 @@ bool TokenBucket::GetToken(int64_t acquire_amount, uint64_t expect_bucket_time,
   if (expect_bucket_time != current_bucket_time &&     // 说明需要重置bucket计数
       bucket_time_.Cas(current_bucket_time, expect_bucket_time)) {
     bucket_stat_         = 0;
+    stripe_leased_       = 0;  // 分段中旧周期的令牌按时间标记失效
     pending_bucket_time_ = current_bucket_time;
     pending_bucket_stat_ = 0;
 
@@ -70,6 +126,9 @@ bool TokenBucket::GetToken(int64_t acquire_amount, uint64_t expect_bucket_time,
     remote_quota_.remote_token_left_  = local_max_amount_;
     remote_quota_.quota_need_sync_    = 0;
   }
+  if (!use_remote_quota && acquire_amount <= stripe_batch_) {
+    return GetStripedToken(acquire_amount, expect_bucket_time, left_quota);
+  }
   int64_t quota_used = (bucket_stat_ += acquire_amount);  // 先增加配额到本地统计
   if (use_remote_quota) {
     left_quota = (remote_quota_.remote_token_left_ -= acquire_amount);
@@ -87,6 +146,118 @@ bool TokenBucket::GetToken(int64_t acquire_amount, uint64_t expect_bucket_time,
   return true;
 }
 
+bool TokenBucket::GetStripedToken(int64_t acquire_amount, uint64_t expect_bucket_time,
+                                  int64_t& left_quota) {
+  TokenStripe& stripe = stripes_[GetThreadTokenStripe() & stripe_mask_];
+  uint64_t lease_tag  = StripeLeaseTag(expect_bucket_time);
+  uint64_t lease      = stripe.lease_.Load();
+  // 先从本线程分段中已预取的令牌划扣
+  while ((lease & ~kStripeLeaseMask) == lease_tag &&
+         static_cast<int64_t>(lease & kStripeLeaseMask) >= acquire_amount) {
+    if (stripe.lease_.Cas(lease, lease - acquire_amount)) {
+      stripe_leased_ -= acquire_amount;
+      left_quota = local_max_amount_ - GetUsedQuota();
+      left_quota = left_quota > 0 ? left_quota : 0;
+      return true;
+    }
+    lease = stripe.lease_.Load();
+  }
+  // 分段中令牌不足，从周期计数中批量预取，周期计数包含了所有分段中预取未使用的令牌
+  int64_t batch      = stripe_batch_;
+  int64_t quota_used = (bucket_stat_ += batch);
+  int64_t leased     = batch;
+  if (quota_used > local_max_amount_) {  // 剩余配额不足一批时只预取剩余部分
+    int64_t quota_left = local_max_amount_ - (quota_used - batch);
+    leased             = quota_left > 0 ? quota_left : 0;
+    if (leased < acquire_amount) {
+      leased = 0;
+    }
+    bucket_stat_ -= batch - leased;
+  }
+  if (leased > 0) {
+    PutStripedToken(stripe, lease_tag, leased - acquire_amount);
+    left_quota = local_max_amount_ - GetUsedQuota();
+    left_quota = left_quota > 0 ? left_quota : 0;
+    return true;
+  }
+  // 周期配额已全部预取到各分段，从其他分段划扣，保证配额用完前不会提前限流
+  if (StealStripedToken(acquire_amount, lease_tag)) {
+    left_quota = 0;
+    return true;
+  }
+  // 与非分段模式一致，失败时计数已增加，由调用方通过ReturnToken归还
+  left_quota = local_max_amount_ - (bucket_stat_ += acquire_amount);
+  return false;
+}
+
+bool TokenBucket::StealStripedToken(int64_t acquire_amount, uint64_t lease_tag) {
+  for (int i = 0; i <= stripe_mask_; ++i) {
+    TokenStripe& stripe = stripes_[i];
+    uint64_t lease      = stripe.lease_.Load();
+    while ((lease & ~kStripeLeaseMask) == lease_tag &&
+           static_cast<int64_t>(lease & kStripeLeaseMask) >= acquire_amount) {
+      if (stripe.lease_.Cas(lease, lease - acquire_amount)) {
+        stripe_leased_ -= acquire_amount;
+        return true;
+      }
+      lease = stripe.lease_.Load();
+    }
+  }
+  return false;
+}
+
+void TokenBucket::PutStripedToken(TokenStripe& stripe, uint64_t lease_tag, int64_t amount) {
+  if (amount <= 0) {
+    return;
+  }
+  uint64_t lease = stripe.lease_.Load();
+  for (;;) {
+    int64_t stripe_left = 0;
+    if ((lease & ~kStripeLeaseMask) == lease_tag) {
+      stripe_left = static_cast<int64_t>(lease & kStripeLeaseMask);
+    } else if (StripeLeaseTag(bucket_time_.Load()) != lease_tag) {
+      return;  // 预取期间已切换到新的周期，预取的令牌属于旧周期，直接丢弃
+    }
+    if (stripe_left + amount > kStripeLeaseMax) {  // 分段持有令牌过多，归还到周期计数
+      bucket_stat_ -= amount;
+      return;
+    }
+    if (stripe.lease_.Cas(lease, lease_tag | static_cast<uint64_t>(stripe_left + amount))) {
+      stripe_leased_ += amount;
+      return;
+    }
+    lease = stripe.lease_.Load();
+  }
+}
+
+void TokenBucket::ResetStripes() {
+  if (stripes_ == NULL) {
+    return;
+  }
+  int64_t batch = local_max_amount_ / ((stripe_mask_ + 1) * kStripeBatchDivisor);
+  batch         = batch < kStripeBatchMax ? batch : kStripeBatchMax;
+  stripe_batch_ = batch >= 2 ? batch : 0;  // 配额过小时分段会影响精度，直接划扣周期计数
+
+  uint64_t lease_tag = StripeLeaseTag(bucket_time_.Load());
+  for (int i = 0; i <= stripe_mask_; ++i) {
+    uint64_t lease = stripes_[i].lease_.Exchange(0);
+    if ((lease & ~kStripeLeaseMask) == lease_tag) {
+      bucket_stat_ -= static_cast<int64_t>(lease & kStripeLeaseMask);
+      stripe_leased_ -= static_cast<int64_t>(lease & kStripeLeaseMask);
+    }
+  }
+}
+
+int64_t TokenBucket::GetUsedQuota() const {
+  // 令牌在分段和周期计数间转移时两个计数不是同时更新，预取数可能短暂偏大或为负
+  int64_t quota_used = bucket_stat_.Load();
+  int64_t leased     = stripe_leased_.Load();
+  if (leased <= 0) {
+    return quota_used;
+  }
+  return quota_used > leased ? quota_used - leased : 0;
+}
+
 void TokenBucket::ReturnToken(int64_t acquire_amount, bool use_remote_quota) {
   bucket_stat_ -= acquire_amount;
   if (use_remote_quota) {
@@ -94,6 +265,14 @@ void TokenBucket::ReturnToken(int64_t acquire_amount, bool use_remote_quota) {
   }
 }
 
+int64_t TokenBucket::GetLeftQuota(uint64_t expect_bucket_time, bool use_remote_quota) const {
+  if (bucket_time_.Load() != expect_bucket_time) {
+    return local_max_amount_;  // 分配时会重置bucket
+  }
+  return use_remote_quota ? remote_quota_.remote_token_left_.Load()
+                          : local_max_amount_ - GetUsedQuota();
+}
+
 uint64_t TokenBucket::RefreshToken(int64_t remote_left, int64_t ack_quota,
                                    uint64_t current_bucket_time, bool remote_quota_expired,
                                    uint64_t time_in_bucket) {
@@ -180,73 +359,122 @@ void TokenBucket::PreparePendingQuota(uint64_t pending_bucket_time, QuotaUsage&
   }
 }
 
+void TokenBucket::UpdateLocalMaxAmount(int64_t local_max_amount) {
+  local_max_amount_ = local_max_amount;
+  ResetStripes();
+}
+
 void TokenBucket::UpdateLimitAmount(const RateLimitAmount& limit_amount, int64_t local_max_amount) {
   global_max_amount_ = limit_amount.max_amount_;
   local_max_amount_  = local_max_amount;
+  ResetStripes();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-RemoteAwareQpsBucket::RemoteAwareQpsBucket(RateLimitRule* rule) {
+RemoteAwareQpsBucket::RemoteAwareQpsBucket(RateLimitRule* rule, int stripe_count) {
   rate_limit_type_ = rule->GetRateLimitType();
   failover_type_   = rule->GetFailoverType();
 
   uint64_t current_time                       = Time::GetCurrentTimeMs();
   const std::vector<RateLimitAmount>& amounts = rule->GetRateLimitAmount();
+  std::vector<uint64_t> durations;
+  for (std::size_t i = 0; i < amounts.size(); ++i) {
+    durations.push_back(amounts[i].valid_duration_);
+  }
+  std::sort(durations.begin(), durations.end());
+  durations.erase(std::unique(durations.begin(), durations.end()), durations.end());
+  POLARIS_ASSERT(!durations.empty());
+  // 分配配额时按周期从小到大依次划扣，连续存放减少遍历时的缓存缺失
+  token_buckets_.resize(durations.size());
   for (std::size_t i = 0; i < amounts.size(); ++i) {
-    TokenBucket& bucket = token_buckets_[amounts[i].valid_duration_];
-    bucket.Init(amounts[i], current_time, amounts[i].max_amount_);
+    std::size_t index = std::lower_bound(durations.begin(), durations.end(),
+                                         amounts[i].valid_duration_) -
+                        durations.begin();
+    token_buckets_[index].Init(amounts[i], current_time, amounts[i].max_amount_, stripe_count);
   }
-  POLARIS_ASSERT(!token_buckets_.empty());
-  remote_timeout_duration_ = token_buckets_.begin()->first;  // 最小限流周期，远程配额超时
+  remote_timeout_duration_ = durations[0];  // 最小限流周期，远程配额超时
   last_remote_sync_time_.Store(current_time);
 }
 
-QuotaResponse* RemoteAwareQpsBucket::Allocate(int64_t acquire_amount, uint64_t current_server_time,
-                                              LimitAllocateResult* limit_result) {
+static bool TokenBucketDurationLess(const TokenBucket& bucket, uint64_t duration) {
+  return bucket.GetDuration() < duration;
+}
+
+TokenBucket* RemoteAwareQpsBucket::FindBucket(uint64_t duration) {
+  // 令牌桶按周期从小到大存放，二分查找
+  std::vector<TokenBucket>::iterator it = std::lower_bound(
+      token_buckets_.begin(), token_buckets_.end(), duration, TokenBucketDurationLess);
+  if (it != token_buckets_.end() && it->GetDuration() == duration) {
+    return &(*it);
+  }
+  return NULL;
+}
+
+QuotaResultCode RemoteAwareQpsBucket::Allocate(int64_t acquire_amount,
+                                               uint64_t current_server_time, QuotaResultInfo& info,
+                                               LimitAllocateResult* limit_result) {
   limit_result->max_amount_       = 0;
   limit_result->violate_duration_ = 0;
+  limit_result->violate_index_    = 0;
+  limit_result->server_time_      = current_server_time;
+  limit_result->token_acquired_   = false;
 
   uint64_t last_remote_sync_time = last_remote_sync_time_.Load();
   // 全局模式且上报未超时的情况下使用远程配额
   bool remote_not_timeout = current_server_time < last_remote_sync_time + remote_timeout_duration_;
   bool use_remote_quota   = rate_limit_type_ == v1::Rule::GLOBAL && remote_not_timeout;
-  limit_result->is_degrade_ = !remote_not_timeout;
+  limit_result->is_degrade_       = !remote_not_timeout;
+  limit_result->use_remote_quota_ = use_remote_quota;
 
-  QuotaResultInfo info;
   info.is_degrade_ = limit_result->is_degrade_;
   // 尝试对所有限流配额进行划扣
-  std::map<uint64_t, TokenBucket>::iterator violate_bucket_it = token_buckets_.end();
-  for (std::map<uint64_t, TokenBucket>::iterator bucket_it = token_buckets_.begin();
-       bucket_it != token_buckets_.end(); ++bucket_it) {
-    uint64_t expect_bucket_time = current_server_time / bucket_it->first;  // 期望的bucket时间
-    if (!bucket_it->second.GetToken(acquire_amount, expect_bucket_time, use_remote_quota,
-                                    info.left_quota_)) {
-      violate_bucket_it               = bucket_it;
-      limit_result->violate_duration_ = bucket_it->first;
-      limit_result->max_amount_       = bucket_it->second.GetGlobalMaxAmount();
+  std::size_t bucket_count  = token_buckets_.size();
+  std::size_t violate_index = bucket_count;
+  for (std::size_t i = 0; i < bucket_count; ++i) {
+    TokenBucket& bucket         = token_buckets_[i];
+    uint64_t duration           = bucket.GetDuration();
+    uint64_t expect_bucket_time = current_server_time / duration;  // 期望的bucket时间
+    if (!bucket.GetToken(acquire_amount, expect_bucket_time, use_remote_quota, info.left_quota_)) {
+      violate_index                   = i;
+      limit_result->violate_duration_ = duration;
+      limit_result->violate_index_    = i;
+      limit_result->max_amount_       = bucket.GetGlobalMaxAmount();
       // 设置提示信息
       info.left_quota_ = 0;
-      info.all_quota_  = bucket_it->second.GetGlobalMaxAmount();
-      info.duration_   = bucket_it->first;
+      info.all_quota_  = bucket.GetGlobalMaxAmount();
+      info.duration_   = duration;
       break;
     }
   }
-  if (violate_bucket_it == token_buckets_.end()) {  // 配额分配成功
-    info.all_quota_ = token_buckets_.rbegin()->second.GetGlobalMaxAmount();
-    info.duration_  = token_buckets_.rbegin()->first;
-    return QuotaResponseImpl::CreateResponse(kQuotaResultOk, info);
+  if (violate_index == bucket_count) {  // 配额分配成功
+    info.all_quota_               = token_buckets_[bucket_count - 1].GetGlobalMaxAmount();
+    info.duration_                = token_buckets_[bucket_count - 1].GetDuration();
+    limit_result->token_acquired_ = true;
+    return kQuotaResultOk;
   }
   // 配额分配失败
-  violate_bucket_it++;
-  for (std::map<uint64_t, TokenBucket>::iterator bucket_it = token_buckets_.begin();
-       bucket_it != violate_bucket_it; ++bucket_it) {
-    bucket_it->second.ReturnToken(acquire_amount, use_remote_quota);
+  for (std::size_t i = 0; i <= violate_index; ++i) {
+    token_buckets_[i].ReturnToken(acquire_amount, use_remote_quota);
   }
   if (!use_remote_quota && failover_type_ == v1::Rule::FAILOVER_PASS) {
-    return QuotaResponseImpl::CreateResponse(kQuotaResultOk, info);
+    return kQuotaResultOk;
   } else {
-    return QuotaResponseImpl::CreateResponse(kQuotaResultLimited, info);
+    return kQuotaResultLimited;
+  }
+}
+
+void RemoteAwareQpsBucket::Release(int64_t acquire_amount,
+                                   const LimitAllocateResult& limit_result) {
+  if (!limit_result.token_acquired_) {
+    return;
+  }
+  for (std::size_t i = 0; i < token_buckets_.size(); ++i) {
+    TokenBucket& bucket = token_buckets_[i];
+    // 分配后bucket已切换到新周期时，旧周期的计数已重置，无需归还
+    if (bucket.GetBucketTime() == limit_result.server_time_ / bucket.GetDuration()) {
+      bucket.ReturnToken(acquire_amount, limit_result.use_remote_quota_);
+    }
   }
 }
 
@@ -255,27 +483,26 @@ uint64_t RemoteAwareQpsBucket::SetRemoteQuota(const RemoteQuotaResult& remote_qu
   uint64_t remote_data_time = remote_quota_result.remote_usage_.create_server_time_;
 
   QuotaUsageInfo* local_usage = remote_quota_result.local_usage_;
-  std::map<uint64_t, TokenBucket>::iterator bucket_it;
   const std::map<uint64_t, QuotaUsage>& remote_usage =
       remote_quota_result.remote_usage_.quota_usage_;
   uint64_t next_report_time = Time::kMaxTime;
   for (std::map<uint64_t, QuotaUsage>::const_iterator it = remote_usage.begin();
        it != remote_usage.end(); ++it) {
-    bucket_it = token_buckets_.find(it->first);
-    if (bucket_it == token_buckets_.end()) {
+    TokenBucket* token_bucket = FindBucket(it->first);
+    if (token_bucket == NULL) {
       continue;
     }
-    TokenBucket& bucket          = bucket_it->second;
+    TokenBucket& bucket          = *token_bucket;
     uint64_t current_bucket_time = current_time / it->first;
     int64_t remote_quota         = it->second.quota_allocated_;
     if (remote_data_time / it->first != current_bucket_time) {
-      remote_quota = bucket_it->second.GetGlobalMaxAmount();
+      remote_quota = bucket.GetGlobalMaxAmount();
     }
     int64_t local_used = 0;
     // 非首次且上报前等待确认的数据仍然属于当前计数周期
     if (local_usage != NULL &&
         remote_quota_result.local_usage_->create_server_time_ / it->first == current_bucket_time) {
-      local_used = local_usage->quota_usage_[bucket_it->first].quota_allocated_;
+      local_used = local_usage->quota_usage_[it->first].quota_allocated_;
     }
     uint64_t time_in_bucket = current_time % it->first;
     uint64_t report_time =
@@ -301,12 +528,11 @@ uint64_t RemoteAwareQpsBucket::SetRemoteQuota(const RemoteQuotaResult& remote_qu
 QuotaUsageInfo* RemoteAwareQpsBucket::GetQuotaUsage(uint64_t current_server_time) {
   QuotaUsageInfo* result      = new QuotaUsageInfo();
   result->create_server_time_ = current_server_time;
-  for (std::map<uint64_t, TokenBucket>::iterator bucket_it = token_buckets_.begin();
-       bucket_it != token_buckets_.end(); ++bucket_it) {
+  for (std::size_t i = 0; i < token_buckets_.size(); ++i) {
+    TokenBucket& bucket = token_buckets_[i];
     QuotaUsage quota_usage;
-    bucket_it->second.PreparePendingQuota(result->create_server_time_ / bucket_it->first,
-                                          quota_usage);
-    result->quota_usage_[bucket_it->first] = quota_usage;
+    bucket.PreparePendingQuota(result->create_server_time_ / bucket.GetDuration(), quota_usage);
+    result->quota_usage_[bucket.GetDuration()] = quota_usage;
     POLARIS_LOG(LOG_TRACE, "qps bucket usage %" PRId64 " limit %" PRId64 "",
                 quota_usage.quota_allocated_, quota_usage.quota_rejected_);
   }
@@ -314,12 +540,11 @@ QuotaUsageInfo* RemoteAwareQpsBucket::GetQuotaUsage(uint64_t current_server_time
 }
 
 void RemoteAwareQpsBucket::UpdateLimitAmount(const std::vector<RateLimitAmount>& amounts) {
-  std::map<uint64_t, TokenBucket>::iterator bucket_it;
   for (std::size_t i = 0; i < amounts.size(); ++i) {
     const RateLimitAmount& limit_amount = amounts[i];
-    bucket_it                           = token_buckets_.find(limit_amount.valid_duration_);
-    POLARIS_ASSERT(bucket_it != token_buckets_.end());
-    bucket_it->second.UpdateLimitAmount(limit_amount, limit_amount.max_amount_);
+    TokenBucket* bucket                 = FindBucket(limit_amount.valid_duration_);
+    POLARIS_ASSERT(bucket != NULL);
+    bucket->UpdateLimitAmount(limit_amount, limit_amount.max_amount_);
   }
 }
 
@@ -17,7 +17,6 @@
 #include <stdint.h>
 #include <v1/ratelimit.pb.h>
 
-#include <map>
 #include <vector>
 
 #include "quota/rate_limit_window.h"
@@ -25,7 +24,6 @@
 
 namespace polaris {
 
-class QuotaResponse;
 class RateLimitRule;
 struct RateLimitAmount;
 
@@ -36,6 +34,12 @@ struct RemoteQuotaInfo {
   sync::Atomic<uint64_t> limit_request_;      // 当前bucket需要同步的限流数
 };
 
+// 令牌分段，线程从周期计数中批量预取令牌后在各自分段内划扣，减少对周期计数的争用
+struct TokenStripe {
+  sync::Atomic<uint64_t> lease_;  // 高32位为预取时的bucket时间，低32位为分段内剩余令牌数
+  char padding_[64 - sizeof(sync::Atomic<uint64_t>)];  // 每个分段独占缓存行，避免伪共享
+};
+
 // 规则里限流周期内的限流数据
 class TokenBucket {
 public:
@@ -43,8 +47,11 @@ public:
 
   TokenBucket(const TokenBucket& other);
 
-  // 根据规则配置初始化
-  void Init(const RateLimitAmount& amount, uint64_t current_time, int64_t local_max_amount);
+  ~TokenBucket();
+
+  // 根据规则配置初始化，stripe_count大于0时本地配额按分段划扣，必须为2的幂
+  void Init(const RateLimitAmount& amount, uint64_t current_time, int64_t local_max_amount,
+            int stripe_count = 0);
 
   // 分配Token，并返回是否需要立即上报
   bool GetToken(int64_t acquire_amount, uint64_t expect_bucket_time, bool use_remote_quota,
@@ -53,6 +60,9 @@ public:
   // 分配失败时归还token
   void ReturnToken(int64_t acquire_amount, bool use_remote_quota);
 
+  // 查询当前剩余配额，bucket时间过期时返回重置后的本地配额，不分配token
+  int64_t GetLeftQuota(uint64_t expect_bucket_time, bool use_remote_quota) const;
+
   // 更新从远程同步的配额信息
   uint64_t RefreshToken(int64_t remote_left, int64_t ack_quota, uint64_t current_bucket_time,
                         bool remote_quota_expired, uint64_t current_time);
@@ -63,14 +73,40 @@ public:
   // 规则中配置的每个周期分配配额总量
   int64_t GetGlobalMaxAmount() const { return global_max_amount_; }
 
-  void UpdateLocalMaxAmount(int64_t local_max_amount) { local_max_amount_ = local_max_amount; }
+  // 远程配额不可用时本地可分配的配额数
+  int64_t GetLocalMaxAmount() const { return local_max_amount_; }
+
+  void UpdateLocalMaxAmount(int64_t local_max_amount);
 
   // 更新配额限额
   void UpdateLimitAmount(const RateLimitAmount& limit_amount, int64_t local_max_amount);
 
   uint64_t LastUseUpTime() const { return last_use_up_time_; }
 
+  uint64_t GetDuration() const { return duration_; }
+
+  uint64_t GetBucketTime() const { return bucket_time_.Load(); }
+
 private:
+  TokenBucket& operator=(const TokenBucket&);
+
+  // 分段模式下分配本地配额
+  bool GetStripedToken(int64_t acquire_amount, uint64_t expect_bucket_time, int64_t& left_quota);
+
+  // 周期计数不足时从其他线程的分段中划扣
+  bool StealStripedToken(int64_t acquire_amount, uint64_t lease_tag);
+
+  // 将预取剩余的令牌放回分段
+  void PutStripedToken(TokenStripe& stripe, uint64_t lease_tag, int64_t amount);
+
+  // 周期内实际使用的本地配额，不包含分段中预取未使用的令牌
+  int64_t GetUsedQuota() const;
+
+  // 本地配额变更后重新计算单次预取的令牌数，并将各分段中预取的令牌归还到周期计数
+  void ResetStripes();
+
+private:
+  uint64_t duration_;                        // 限流周期
   sync::Atomic<int64_t> global_max_amount_;  // 规则中配置的周期分配配额总量
   int64_t local_max_amount_;  // 离线分配时配额数，local模式等于global_max_amount_
                               // global模式等于global_max_amount_/实例数
@@ -80,18 +116,25 @@ private:
   int64_t pending_bucket_stat_;         // 正在上报未应答的配额bucket计数
   RemoteQuotaInfo remote_quota_;        // 远程配额信息
   uint64_t last_use_up_time_;           // 上个周期使用完配额的时间
+
+  TokenStripe* stripes_;  // 令牌分段，NULL表示所有线程直接划扣周期计数
+  int stripe_mask_;
+  int64_t stripe_batch_;  // 分段单次从周期计数中预取的令牌数，小于2时不使用分段
+  sync::Atomic<int64_t> stripe_leased_;  // 各分段中预取未使用的令牌数，已包含在周期计数中
 };
 
 // 记录本地配额使用信息和服务器同步的配额信息
 class RemoteAwareQpsBucket : public RemoteAwareBucket {
 public:
-  explicit RemoteAwareQpsBucket(RateLimitRule* rule);
+  // stripe_count大于0时本地配额按分段划扣
+  explicit RemoteAwareQpsBucket(RateLimitRule* rule, int stripe_count = 0);
 
   // 分配配额
-  virtual QuotaResponse* Allocate(int64_t acquire_amount, uint64_t current_server_time,
-                                  LimitAllocateResult* limit_result);
+  virtual QuotaResultCode Allocate(int64_t acquire_amount, uint64_t current_server_time,
+                                   QuotaResultInfo& info, LimitAllocateResult* limit_result);
 
-  virtual void Release() {}  // 回收配额
+  // 回收配额，令牌所属周期已结束时不归还
+  virtual void Release(int64_t acquire_amount, const LimitAllocateResult& limit_result);
 
   virtual uint64_t SetRemoteQuota(const RemoteQuotaResult& remote_quota_result);  // 设置远程配额
 
@@ -100,13 +143,16 @@ public:
   // 更新配额信息
   virtual void UpdateLimitAmount(const std::vector<RateLimitAmount>& amounts);
 
-private:
+protected:
+  TokenBucket* FindBucket(uint64_t duration);
+
+protected:
   v1::Rule::Type rate_limit_type_;
   v1::Rule::FailoverType failover_type_;
   uint64_t remote_timeout_duration_;  // 最小周期，上报应答超过1个最小周期未返回，则认为超时
 
-  std::map<uint64_t, TokenBucket> token_buckets_;  // 限流数据，按限流周期索引
-  sync::Atomic<uint64_t> last_remote_sync_time_;   // 上一次同步远程配额时间
+  std::vector<TokenBucket> token_buckets_;        // 限流数据，按限流周期从小到大连续存放
+  sync::Atomic<uint64_t> last_remote_sync_time_;  // 上一次同步远程配额时间
 };
 
 }  // namespace polaris
@@ -0,0 +1,153 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#include "quota/quota_bucket_sliding_window.h"
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "polaris/limit.h"
+#include "quota/model/rate_limit_rule.h"
+
+namespace polaris {
+
+static const int kUsageBits        = 40;
+static const uint64_t kUsageMask   = (1ULL << kUsageBits) - 1;
+static const uint64_t kTimeTagMask = (1ULL << (64 - kUsageBits)) - 1;
+
+static uint64_t UsageTimeTag(uint64_t bucket_time) {
+  return (bucket_time & kTimeTagMask) << kUsageBits;
+}
+
+void SlidingWindowCounter::RecordUsage(uint64_t bucket_time, int64_t used) {
+  if (used <= 0) {
+    return;
+  }
+  uint64_t usage               = static_cast<uint64_t>(used);
+  usage                        = usage < kUsageMask ? usage : kUsageMask;
+  uint64_t tag                 = UsageTimeTag(bucket_time);
+  sync::Atomic<uint64_t>& slot = slots_[bucket_time & 1];
+  uint64_t current             = slot.Load();
+  // 槽中为两个周期前的数据时直接覆盖，否则只在使用量更大时更新
+  while ((current & ~kUsageMask) != tag || (current & kUsageMask) < usage) {
+    if (slot.Cas(current, tag | usage)) {
+      return;
+    }
+    current = slot.Load();
+  }
+}
+
+int64_t SlidingWindowCounter::WeightedPreviousUsage(uint64_t current_time,
+                                                    uint64_t duration) const {
+  uint64_t bucket_time = current_time / duration;
+  if (bucket_time == 0) {
+    return 0;
+  }
+  uint64_t slot = slots_[(bucket_time - 1) & 1].Load();
+  if ((slot & ~kUsageMask) != UsageTimeTag(bucket_time - 1)) {
+    return 0;  // 上个周期没有使用配额
+  }
+  uint64_t used   = slot & kUsageMask;
+  uint64_t remain = duration - current_time % duration;  // 上个周期仍在滑动窗口内的时长
+  // 拆分计算避免乘法溢出
+  return static_cast<int64_t>(used / duration * remain + used % duration * remain / duration);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+RemoteAwareSlidingWindowBucket::RemoteAwareSlidingWindowBucket(RateLimitRule* rule)
+    : RemoteAwareQpsBucket(rule) {  // 分段划扣得到的剩余配额不精确，不使用分段
+  counters_ = new SlidingWindowCounter[token_buckets_.size()];
+}
+
+RemoteAwareSlidingWindowBucket::~RemoteAwareSlidingWindowBucket() {
+  if (counters_ != NULL) {
+    delete[] counters_;
+    counters_ = NULL;
+  }
+}
+
+QuotaResultCode RemoteAwareSlidingWindowBucket::Allocate(int64_t acquire_amount,
+                                                         uint64_t current_server_time,
+                                                         QuotaResultInfo& info,
+                                                         LimitAllocateResult* limit_result) {
+  limit_result->max_amount_       = 0;
+  limit_result->violate_duration_ = 0;
+  limit_result->violate_index_    = 0;
+  limit_result->server_time_      = current_server_time;
+  limit_result->token_acquired_   = false;
+
+  uint64_t last_remote_sync_time = last_remote_sync_time_.Load();
+  // 全局模式且上报未超时的情况下使用远程配额
+  bool remote_not_timeout = current_server_time < last_remote_sync_time + remote_timeout_duration_;
+  bool use_remote_quota   = rate_limit_type_ == v1::Rule::GLOBAL && remote_not_timeout;
+  limit_result->is_degrade_       = !remote_not_timeout;
+  limit_result->use_remote_quota_ = use_remote_quota;
+
+  info.is_degrade_ = limit_result->is_degrade_;
+  std::size_t bucket_count  = token_buckets_.size();
+  std::size_t violate_index = bucket_count;
+  std::size_t return_count  = 0;  // 限流时需要归还token的bucket数
+  int64_t left_quota        = 0;
+  for (std::size_t i = 0; i < bucket_count; ++i) {
+    TokenBucket& bucket         = token_buckets_[i];
+    uint64_t duration           = bucket.GetDuration();
+    uint64_t expect_bucket_time = current_server_time / duration;
+    int64_t previous_used = counters_[i].WeightedPreviousUsage(current_server_time, duration);
+    // 先检查扣除上个周期加权使用量后的剩余配额，不足时不划扣，避免上报未使用的配额
+    // 检查与划扣不是原子操作，并发时以划扣后返回的剩余配额为准，不足时归还令牌
+    if (bucket.GetLeftQuota(expect_bucket_time, use_remote_quota) - acquire_amount <
+        previous_used) {
+      violate_index = i;
+      return_count  = i;
+    } else if (!bucket.GetToken(acquire_amount, expect_bucket_time, use_remote_quota,
+                                left_quota) ||
+               left_quota < previous_used) {
+      violate_index = i;
+      return_count  = i + 1;
+    } else {
+      // 远程配额为集群剩余配额，降级时为本地剩余配额，使用量按对应的配额总量计算
+      int64_t max_amount =
+          use_remote_quota ? bucket.GetGlobalMaxAmount() : bucket.GetLocalMaxAmount();
+      counters_[i].RecordUsage(expect_bucket_time, max_amount - left_quota);
+      info.left_quota_ = left_quota > previous_used ? left_quota - previous_used : 0;
+      continue;
+    }
+    limit_result->violate_duration_ = duration;
+    limit_result->violate_index_    = i;
+    limit_result->max_amount_       = bucket.GetGlobalMaxAmount();
+    // 设置提示信息
+    info.left_quota_ = 0;
+    info.all_quota_  = bucket.GetGlobalMaxAmount();
+    info.duration_   = duration;
+    break;
+  }
+  if (violate_index == bucket_count) {  // 配额分配成功
+    info.all_quota_               = token_buckets_[bucket_count - 1].GetGlobalMaxAmount();
+    info.duration_                = token_buckets_[bucket_count - 1].GetDuration();
+    limit_result->token_acquired_ = true;
+    return kQuotaResultOk;
+  }
+  // 配额分配失败
+  for (std::size_t i = 0; i < return_count; ++i) {
+    token_buckets_[i].ReturnToken(acquire_amount, use_remote_quota);
+  }
+  if (!use_remote_quota && failover_type_ == v1::Rule::FAILOVER_PASS) {
+    return kQuotaResultOk;
+  } else {
+    return kQuotaResultLimited;
+  }
+}
+
+}  // namespace polaris
@@ -0,0 +1,60 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#ifndef POLARIS_CPP_POLARIS_QUOTA_QUOTA_BUCKET_SLIDING_WINDOW_H_
+#define POLARIS_CPP_POLARIS_QUOTA_QUOTA_BUCKET_SLIDING_WINDOW_H_
+
+#include <stdint.h>
+
+#include "quota/quota_bucket_qps.h"
+#include "sync/atomic.h"
+
+namespace polaris {
+
+class RateLimitRule;
+
+// 记录相邻两个周期的配额使用量，用于计算上个周期在滑动窗口内的加权使用量
+class SlidingWindowCounter {
+public:
+  SlidingWindowCounter() {}
+
+  // 记录周期内观察到的配额使用量，同一周期只保留最大值
+  void RecordUsage(uint64_t bucket_time, int64_t used);
+
+  // 上个周期的使用量按其仍在滑动窗口内的时间比例加权
+  int64_t WeightedPreviousUsage(uint64_t current_time, uint64_t duration) const;
+
+private:
+  // 按bucket时间奇偶存放，高24位为bucket时间标记，低40位为使用量
+  sync::Atomic<uint64_t> slots_[2];
+};
+
+// 滑动窗口计数配额桶，当前周期剩余配额需扣除上个周期的加权使用量，避免周期切换时的突发流量
+// 当前周期计数和远程配额同步复用QPS令牌桶，全局模式下周期使用量为远程配额反映的集群使用量
+class RemoteAwareSlidingWindowBucket : public RemoteAwareQpsBucket {
+public:
+  explicit RemoteAwareSlidingWindowBucket(RateLimitRule* rule);
+
+  virtual ~RemoteAwareSlidingWindowBucket();
+
+  // 分配配额
+  virtual QuotaResultCode Allocate(int64_t acquire_amount, uint64_t current_server_time,
+                                   QuotaResultInfo& info, LimitAllocateResult* limit_result);
+
+private:
+  SlidingWindowCounter* counters_;  // 与令牌桶一一对应的周期使用量
+};
+
+}  // namespace polaris
+
+#endif  //  POLARIS_CPP_POLARIS_QUOTA_QUOTA_BUCKET_SLIDING_WINDOW_H_
@@ -14,8 +14,10 @@
 #include "quota/quota_manager.h"
 
 #include <features.h>
+#include <pthread.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <unistd.h>
 #include <v1/request.pb.h>
 
 #include "context_internal.h"
@@ -28,6 +30,7 @@
 #include "polaris/model.h"
 #include "polaris/plugin.h"
 #include "quota/model/rate_limit_rule.h"
+#include "quota/quota_model.h"
 #include "quota/rate_limit_connector.h"
 #include "quota/rate_limit_window.h"
 #include "reactor/task.h"
@@ -47,9 +50,39 @@ uint32_t RateLimitWindowKeyHash(const RateLimitWindowKey& key) {
   return s;
 }
 
+// 每个线程复用一个窗口key对象，查找窗口时规则ID和正则匹配值复用上次请求分配的内存
+static __thread RateLimitWindowKey* thread_local_window_key = NULL;
+static pthread_key_t g_window_key_key;
+static pthread_once_t g_window_key_once = PTHREAD_ONCE_INIT;
+
+static void DeleteThreadLocalWindowKey(void* ptr) {
+  if (thread_local_window_key == ptr) {
+    thread_local_window_key = NULL;
+  }
+  delete static_cast<RateLimitWindowKey*>(ptr);
+}
+
+static void CreateWindowKeyKey() {
+  int rc = pthread_key_create(&g_window_key_key, &DeleteThreadLocalWindowKey);
+  POLARIS_ASSERT(rc == 0);
+}
+
+static RateLimitWindowKey& GetThreadLocalWindowKey() {
+  if (thread_local_window_key == NULL) {
+    pthread_once(&g_window_key_once, &CreateWindowKeyKey);
+    thread_local_window_key = new RateLimitWindowKey();
+    pthread_setspecific(g_window_key_key, thread_local_window_key);  // 线程退出时释放
+  } else {
+    thread_local_window_key->regex_labels_.clear();
+    thread_local_window_key->regex_subset_.clear();
+  }
+  return *thread_local_window_key;
+}
+
 QuotaManager::QuotaManager()
     : context_(NULL), rate_limit_mode_(kRateLimitDisable), task_thread_id_(0),
-      rate_limit_connector_(NULL), metric_connector_(NULL), rate_limit_window_lru_(NULL) {}
+      rate_limit_connector_(NULL), metric_connector_(NULL), rate_limit_window_lru_(NULL),
+      token_stripe_count_(0) {}
 
 QuotaManager::~QuotaManager() {
   reactor_.Stop();
@@ -105,10 +138,40 @@ ReturnCode QuotaManager::Init(Context* context, Config* config) {
 
   static const char kRateLimitLruSizeKey[]   = "lruSize";
   static const bool kRateLimitLruSizeDefault = 0;
+  static const char kRateLimitLruModeKey[]   = "lruMode";
+  static const char kRateLimitLruModeMutex[] = "mutex";    // 读写加锁的精确LRU
+  static const char kRateLimitLruModeSample[] = "sample";  // 读无锁的采样LRU
   int lru_size = config->GetIntOrDefault(kRateLimitLruSizeKey, kRateLimitLruSizeDefault);
   if (lru_size > 0) {
-    rate_limit_window_lru_ =
-        new LruHashMap<RateLimitWindowKey, RateLimitWindow>(lru_size, RateLimitWindowKeyHash);
+    std::string lru_mode = config->GetStringOrDefault(kRateLimitLruModeKey, kRateLimitLruModeMutex);
+    if (lru_mode == kRateLimitLruModeMutex) {
+      rate_limit_window_lru_ =
+          new LruHashMap<RateLimitWindowKey, RateLimitWindow>(lru_size, RateLimitWindowKeyHash);
+    } else if (lru_mode == kRateLimitLruModeSample) {
+      rate_limit_window_cache_.SetCapacity(lru_size);
+    } else {
+      POLARIS_LOG(LOG_ERROR, "rate limit lru mode must be [%s, %s]", kRateLimitLruModeMutex,
+                  kRateLimitLruModeSample);
+      return kReturnInvalidConfig;
+    }
+  }
+
+  static const char kRateLimitTokenBucketModeKey[]     = "tokenBucketMode";
+  static const char kRateLimitTokenBucketModeShared[]  = "shared";   // 所有线程划扣同一计数
+  static const char kRateLimitTokenBucketModeStriped[] = "striped";  // 按线程分段划扣本地配额
+  static const int kRateLimitMaxTokenStripes           = 64;
+  std::string token_bucket_mode =
+      config->GetStringOrDefault(kRateLimitTokenBucketModeKey, kRateLimitTokenBucketModeShared);
+  if (token_bucket_mode == kRateLimitTokenBucketModeStriped) {
+    long cpu_count      = sysconf(_SC_NPROCESSORS_ONLN);
+    token_stripe_count_ = 2;  // 分段数取不小于CPU数的2的幂
+    while (token_stripe_count_ < cpu_count && token_stripe_count_ < kRateLimitMaxTokenStripes) {
+      token_stripe_count_ *= 2;
+    }
+  } else if (token_bucket_mode != kRateLimitTokenBucketModeShared) {
+    POLARIS_LOG(LOG_ERROR, "rate limit token bucket mode must be [%s, %s]",
+                kRateLimitTokenBucketModeShared, kRateLimitTokenBucketModeStriped);
+    return kReturnInvalidConfig;
   }
 
   metric_connector_ = new MetricConnector(reactor_, context_);
@@ -209,15 +272,21 @@ void QuotaManager::ClearExpiredWindow(QuotaManager* quota_manager) {
 ReturnCode QuotaManager::GetQuota(const QuotaRequest& quota_request, const QuotaInfo& quota_info,
                                   QuotaResponse*& quota_response) {
   ApiStat api_stat(context_, kApiStatLimitGetQuota);
-  ReturnCode ret_code = GetQuotaResponse(quota_request, quota_info, quota_response);
+  QuotaResponseImpl* response_impl = new QuotaResponseImpl();
+  ReturnCode ret_code              = GetQuotaResponse(quota_request, quota_info, *response_impl);
+  if (ret_code == kReturnOk) {
+    quota_response = new QuotaResponse(response_impl);
+  } else {
+    delete response_impl;
+  }
   RECORD_THEN_RETURN(ret_code);
 }
 
 ReturnCode QuotaManager::GetQuotaResponse(const QuotaRequest& quota_request,
                                           const QuotaInfo& quota_info,
-                                          QuotaResponse*& quota_response) {
+                                          QuotaResponseImpl& quota_response) {
   if (rate_limit_mode_ == kRateLimitDisable) {  // 未开启流控
-    quota_response = QuotaResponseImpl::CreateResponse(kQuotaResultOk);
+    quota_response.Reset(kQuotaResultOk);
     return kReturnOk;
   }
   QuotaRequestAccessor request(quota_request);
@@ -226,7 +295,7 @@ ReturnCode QuotaManager::GetQuotaResponse(const QuotaRequest& quota_request,
   ReturnCode ret_code                = GetRateLimitWindow(request, quota_info, rate_limit_window);
   if (ret_code != kReturnOk) {
     if (ret_code == kReturnResourceNotFound) {  // 没有匹配到限流规则，则不进行限流
-      quota_response = QuotaResponseImpl::CreateResponse(kQuotaResultOk);
+      quota_response.Reset(kQuotaResultOk);
       return kReturnOk;
     }
     return ret_code;
@@ -240,7 +309,7 @@ ReturnCode QuotaManager::GetQuotaResponse(const QuotaRequest& quota_request,
   uint64_t timeout = begin_time + request.GetTimeout() - end_time;
   // 等待状态变成已初始化
   if ((ret_code = rate_limit_window->WaitRemoteInit(timeout)) == kReturnOk) {
-    quota_response = rate_limit_window->AllocateQuota(request.GetAcquireAmount());
+    rate_limit_window->AllocateQuota(request.GetAcquireAmount(), quota_response);
   } else {
     POLARIS_LOG(LOG_ERROR, "wait rate limit window init with error:%s",
                 ReturnCodeToMsg(ret_code).c_str());
@@ -249,6 +318,115 @@ ReturnCode QuotaManager::GetQuotaResponse(const QuotaRequest& quota_request,
   return ret_code;
 }
 
+// 批量分配时命中的限流窗口，同一窗口的请求合并为一次分配
+struct BatchQuotaWindow {
+  RateLimitWindow* window_;
+  int64_t acquire_amount_;
+  LimitAllocateResult limit_result_;
+};
+
+ReturnCode QuotaManager::BatchGetQuotaResponse(const std::vector<QuotaRequest*>& quota_requests,
+                                               const std::vector<const QuotaInfo*>& quota_infos,
+                                               std::vector<QuotaResultCode>& quota_results,
+                                               uint64_t& wait_time) {
+  quota_results.assign(quota_requests.size(), kQuotaResultOk);
+  wait_time = 0;
+  if (rate_limit_mode_ == kRateLimitDisable) {  // 未开启流控
+    return kReturnOk;
+  }
+  static const std::size_t kNoWindow  = static_cast<std::size_t>(-1);
+  static const std::size_t kLocalSize = 8;  // 请求数较少时直接在栈上记录命中的窗口
+  BatchQuotaWindow local_windows[kLocalSize];
+  std::size_t local_indexes[kLocalSize];
+  std::vector<BatchQuotaWindow> more_windows;
+  std::vector<std::size_t> more_indexes;
+  BatchQuotaWindow* windows   = local_windows;
+  std::size_t* window_indexes = local_indexes;
+  if (quota_requests.size() > kLocalSize) {
+    more_windows.resize(quota_requests.size());
+    more_indexes.resize(quota_requests.size());
+    windows        = &more_windows[0];
+    window_indexes = &more_indexes[0];
+  }
+  std::size_t window_count = 0;
+  uint64_t begin_time = Time::GetCurrentTimeMs();
+  ReturnCode ret_code = kReturnOk;
+  for (std::size_t i = 0; i < quota_requests.size() && ret_code == kReturnOk; ++i) {
+    QuotaRequestAccessor request(*quota_requests[i]);
+    RateLimitWindow* rate_limit_window = NULL;
+    window_indexes[i]                  = kNoWindow;
+    ret_code = GetRateLimitWindow(request, *quota_infos[i], rate_limit_window);
+    if (ret_code != kReturnOk) {
+      if (ret_code == kReturnResourceNotFound) {  // 没有匹配到限流规则，则不进行限流
+        ret_code = kReturnOk;
+      }
+      continue;
+    }
+    // 匀速排队已排队的时间无法归还，不能满足全部成功才占用配额的语义
+    if (rate_limit_window->GetRateLimitRule()->GetActionType() == kRateLimitActionUnirate) {
+      POLARIS_LOG(LOG_ERROR, "batch get quota not support unirate rule of service[%s/%s]",
+                  request.GetService().namespace_.c_str(), request.GetService().name_.c_str());
+      rate_limit_window->DecrementRef();
+      ret_code = kReturnInvalidArgument;
+      continue;
+    }
+    std::size_t index = 0;
+    while (index < window_count && windows[index].window_ != rate_limit_window) {
+      index++;
+    }
+    window_indexes[i] = index;
+    if (index < window_count) {  // 与前面的请求命中同一窗口
+      windows[index].acquire_amount_ += request.GetAcquireAmount();
+      rate_limit_window->DecrementRef();
+      continue;
+    }
+    BatchQuotaWindow batch_window;
+    batch_window.window_         = rate_limit_window;
+    batch_window.acquire_amount_ = request.GetAcquireAmount();
+    windows[window_count++] = batch_window;
+    uint64_t end_time = Time::GetCurrentTimeMs();
+    if (end_time >= begin_time + request.GetTimeout()) {
+      ret_code = kReturnTimeout;
+    } else if ((ret_code = rate_limit_window->WaitRemoteInit(
+                    begin_time + request.GetTimeout() - end_time)) != kReturnOk) {
+      POLARIS_LOG(LOG_ERROR, "wait rate limit window init with error:%s",
+                  ReturnCodeToMsg(ret_code).c_str());
+    }
+  }
+
+  if (ret_code == kReturnOk) {
+    // 按顺序分配，某个窗口被限流时撤销前面窗口已分配的配额
+    std::size_t limited_index = window_count;
+    QuotaResponseImpl quota_response;
+    for (std::size_t i = 0; i < window_count; ++i) {
+      BatchQuotaWindow& batch_window = windows[i];
+      batch_window.window_->AllocateQuota(batch_window.acquire_amount_, quota_response,
+                                          batch_window.limit_result_);
+      if (quota_response.result_code_ != kQuotaResultOk) {
+        limited_index = i;
+        break;
+      }
+      if (quota_response.wait_time_ > wait_time) {
+        wait_time = quota_response.wait_time_;
+      }
+    }
+    if (limited_index < window_count) {
+      for (std::size_t i = 0; i < limited_index; ++i) {
+        windows[i].window_->ReturnQuota(windows[i].acquire_amount_, windows[i].limit_result_);
+      }
+      wait_time = 0;
+      for (std::size_t i = 0; i < quota_results.size(); ++i) {
+        quota_results[i] =
+            window_indexes[i] == limited_index ? kQuotaResultLimited : kQuotaResultWait;
+      }
+    }
+  }
+  for (std::size_t i = 0; i < window_count; ++i) {
+    windows[i].window_->DecrementRef();
+  }
+  return ret_code;
+}
+
 ReturnCode QuotaManager::PrepareQuotaInfo(const QuotaRequest& quota_request,
                                           QuotaInfo* quota_info) {
   QuotaRequestAccessor request(quota_request);
@@ -307,7 +485,7 @@ ReturnCode QuotaManager::GetRateLimitWindow(QuotaRequestAccessor& quota_request,
   if (rate_limit_rule == NULL) {
     return kReturnResourceNotFound;
   }
-  RateLimitWindowKey window_key;
+  RateLimitWindowKey& window_key = GetThreadLocalWindowKey();
   rate_limit_rule->GetWindowKey(request.GetSubset(), request.GetLabels(), window_key);
 
   // 通过ID查找window
@@ -348,8 +526,8 @@ ReturnCode QuotaManager::GetRateLimitWindow(QuotaRequestAccessor& quota_request,
   ReturnCode ret_code;
   std::string metric_id = rate_limit_rule->GetMetricId(window_key);
   if ((ret_code = cached_window->Init(quota_info.GetSericeRateLimitRule()->GetServiceDataWithRef(),
-                                      rate_limit_rule, metric_id, rate_limit_connector_)) !=
-      kReturnOk) {
+                                      rate_limit_rule, metric_id, rate_limit_connector_,
+                                      token_stripe_count_)) != kReturnOk) {
     cached_window->DecrementRef();
     return ret_code;
   }
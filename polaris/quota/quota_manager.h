@@ -19,9 +19,10 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "cache/lru_map.h"
-#include "cache/rcu_map.h"
+#include "cache/rcu_hash_map.h"
 #include "polaris/context.h"
 #include "quota/model/service_rate_limit_rule.h"
 #include "quota/quota_model.h"
@@ -40,6 +41,8 @@ enum RateLimitMode {
   kRateLimitGlobal  = 2   // 使用分布式限流
 };
 
+uint32_t RateLimitWindowKeyHash(const RateLimitWindowKey& key);
+
 // 配额管理，一个Context初始化一个本对象
 class QuotaManager {
 public:
@@ -68,8 +71,15 @@ public:
 
   void CollectRecord(google::protobuf::RepeatedField<v1::RateLimitRecord>& report_data);
 
+  // 分配配额，结果写入调用方提供的应答中
   ReturnCode GetQuotaResponse(const QuotaRequest& quota_request, const QuotaInfo& quota_info,
-                              QuotaResponse*& quota_response);
+                              QuotaResponseImpl& quota_response);
+
+  // 批量分配配额，命中同一窗口的请求合并分配，任一窗口被限流时撤销其他窗口已分配的配额
+  ReturnCode BatchGetQuotaResponse(const std::vector<QuotaRequest*>& quota_requests,
+                                   const std::vector<const QuotaInfo*>& quota_infos,
+                                   std::vector<QuotaResultCode>& quota_results,
+                                   uint64_t& wait_time);
 
 private:
   // 通过请求获取获取限流窗口
@@ -94,8 +104,9 @@ private:
   MetricConnector* metric_connector_;
 
   sync::Mutex window_init_lock_;  // 多个线程只需要一个线程去初始化即可
-  RcuMap<RateLimitWindowKey, RateLimitWindow> rate_limit_window_cache_;
+  RcuHashMap<RateLimitWindowKey, RateLimitWindow, RateLimitWindowKeyHash> rate_limit_window_cache_;
   LruHashMap<RateLimitWindowKey, RateLimitWindow>* rate_limit_window_lru_;
+  int token_stripe_count_;  // 令牌桶本地配额分段数，0表示不分段
 };
 
 }  // namespace polaris
@@ -46,6 +46,8 @@ void QuotaRequest::SetAcquireAmount(int amount) { impl_->acquire_amount_ = amoun
 
 void QuotaRequest::SetTimeout(uint64_t timeout) { impl_->timeout_ = timeout; }
 
+QuotaResponse::QuotaResponse() : impl_(new QuotaResponseImpl()) {}
+
 QuotaResponse::QuotaResponse(QuotaResponseImpl* impl) : impl_(impl) {}
 
 QuotaResponse::~QuotaResponse() {
@@ -61,23 +63,13 @@ uint64_t QuotaResponse::GetWaitTime() const { return impl_->wait_time_; }
 
 const QuotaResultInfo& QuotaResponse::GetQuotaResultInfo() const { return impl_->info_; }
 
-QuotaResponse* QuotaResponseImpl::CreateResponse(QuotaResultCode result_code, uint64_t wait_time) {
-  QuotaResponseImpl* impl = new QuotaResponseImpl();
-  impl->result_code_      = result_code;
-  impl->wait_time_        = wait_time;
-  impl->info_.all_quota_  = 0;
-  impl->info_.duration_   = 0;
-  impl->info_.left_quota_ = 0;
-  return new QuotaResponse(impl);
-}
-
-QuotaResponse* QuotaResponseImpl::CreateResponse(QuotaResultCode result_code,
-                                                 const QuotaResultInfo& info) {
-  QuotaResponseImpl* impl = new QuotaResponseImpl();
-  impl->result_code_      = result_code;
-  impl->wait_time_        = 0;
-  impl->info_             = info;
-  return new QuotaResponse(impl);
+void QuotaResponseImpl::Reset(QuotaResultCode result_code) {
+  result_code_      = result_code;
+  wait_time_        = 0;
+  info_.left_quota_ = 0;
+  info_.all_quota_  = 0;
+  info_.duration_   = 0;
+  info_.is_degrade_ = false;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -58,15 +58,17 @@ private:
   const QuotaRequest& request_;
 };
 
+// 配额分配结果，分配过程中作为值类型直接填充，不单独创建对象
 class QuotaResponseImpl {
 public:
+  QuotaResponseImpl() { Reset(kQuotaResultOk); }
+
+  // 重置为指定结果，清空等待时间和配额信息
+  void Reset(QuotaResultCode result_code);
+
   QuotaResultCode result_code_;  // 配额分配结果
   uint64_t wait_time_;           // 等待时间，单位ms
   QuotaResultInfo info_;         // 当前配额的信息
-
-  static QuotaResponse* CreateResponse(QuotaResultCode result_code, uint64_t wait_time = 0);
-
-  static QuotaResponse* CreateResponse(QuotaResultCode result_code, const QuotaResultInfo& info);
 };
 
 // 用于获取配额分配所需的服务数据：服务实例信息和服务限流规则
@@ -20,6 +20,7 @@
 #include <v1/request.pb.h>
 #include <v2/ratelimit_v2.pb.h>
 
+#include <algorithm>
 #include <utility>
 
 #include "api/consumer_api.h"
@@ -36,6 +37,9 @@
 
 namespace polaris {
 
+static const std::size_t kMaxReportBatchSize = 256;  // 单个上报消息最多合并的窗口数
+static const uint64_t kReportBatchDelay      = 5;    // 上报等待合并发送的时间
+
 WindowSyncTask::WindowSyncTask(RateLimitWindow* window, RateLimitConnector* connector,
                                uint64_t timeout)
     : TimingTask(timeout), window_(window), connector_(connector) {
@@ -77,6 +81,10 @@ RateLimitConnection::RateLimitConnection(RateLimitConnector& connector,
 
   sync_time_task_ = reactor_.TimingTaskEnd();
   time_diff_      = 0;
+
+  report_flush_task_   = reactor_.TimingTaskEnd();
+  report_seq_          = 0;
+  report_timeout_task_ = reactor_.TimingTaskEnd();
 }
 
 RateLimitConnection::~RateLimitConnection() {
@@ -107,11 +115,18 @@ void RateLimitConnection::ClearTaskAndWindow() {
     it->first->DecrementRef();
   }
   init_task_map_.clear();
+  if (report_flush_task_ != timeout_end) {
+    reactor_.CancelTimingTask(report_flush_task_);
+    report_flush_task_ = timeout_end;
+  }
+  if (report_timeout_task_ != timeout_end) {
+    reactor_.CancelTimingTask(report_timeout_task_);
+    report_timeout_task_ = timeout_end;
+  }
+  pending_reports_.clear();
+  report_batches_.clear();
   for (std::map<RateLimitWindow*, WindowReportInfo>::iterator it = report_task_map_.begin();
        it != report_task_map_.end(); ++it) {
-    if (it->second.task_iter_ != timeout_end) {
-      reactor_.CancelTimingTask(it->second.task_iter_);
-    }
     it->first->DecrementRef();
   }
   report_task_map_.clear();
@@ -178,8 +193,9 @@ void RateLimitConnection::OnSuccess(metric::v2::TimeAdjustResponse* response) {
     delete response;
     return;
   }
-  uint64_t delay = Time::GetCurrentTimeMs() + request_timeout_;
-  delay          = delay > sync_time_task_->first ? delay - sync_time_task_->first : 0;
+  uint64_t delay       = Time::GetCurrentTimeMs() + request_timeout_;
+  uint64_t expire_time = sync_time_task_->GetExpireTime();
+  delay                = delay > expire_time ? delay - expire_time : 0;
   reactor_.CancelTimingTask(sync_time_task_);  // 取消超时检查
   if (response->servertimestamp() > 0) {       // 调整时间差
     int64_t server_time   = response->servertimestamp() + delay / 2;
@@ -266,7 +282,8 @@ void RateLimitConnection::RemoveWindow(RateLimitWindow* window) {
     for (std::size_t i = 0; i < it->second.counter_keys_.size(); ++i) {
       counter_key_map_.erase(it->second.counter_keys_[i]);
     }
-    report_task_map_.erase(it);
+    FinishReport(it->second);
+    report_task_map_.erase(it);  // 等待合并发送的上报在发送时跳过
     window->DecrementRef();
   } else if (init_task_map_.count(window) > 0) {
     init_task_map_.erase(window);
@@ -296,18 +313,116 @@ void RateLimitConnection::SendInit(RateLimitWindow* window) {
 }
 
 void RateLimitConnection::SendReprot(RateLimitWindow* window) {
+  WindowReportInfo& report_info = report_task_map_[window];
+  if (report_info.pending_) {
+    return;
+  }
+  // 加入待发送列表，短暂等待其他窗口的上报后合并到一个消息中发送
+  report_info.pending_ = true;
+  pending_reports_.push_back(window);
+  if (pending_reports_.size() >= kMaxReportBatchSize) {
+    if (report_flush_task_ != reactor_.TimingTaskEnd()) {
+      reactor_.CancelTimingTask(report_flush_task_);
+      report_flush_task_ = reactor_.TimingTaskEnd();
+    }
+    SendReportBatch();
+  } else if (report_flush_task_ == reactor_.TimingTaskEnd()) {
+    report_flush_task_ = reactor_.AddTimingTask(
+        new TimingFuncTask<RateLimitConnection>(FlushReport, this, kReportBatchDelay));
+  }
+}
+
+void RateLimitConnection::FlushReport(RateLimitConnection* connection) {
+  connection->report_flush_task_ = connection->reactor_.TimingTaskEnd();
+  connection->SendReportBatch();
+}
+
+void RateLimitConnection::SendReportBatch() {
   metric::v2::RateLimitRequest request;
   request.set_cmd(metric::v2::ACQUIRE);
   metric::v2::RateLimitReportRequest* report_request = request.mutable_ratelimitreportrequest();
-  window->GetReprotRequest(report_request);
+  std::vector<RateLimitWindow*> batch_windows;
+  uint64_t batch_seq = report_seq_ + 1;
+  for (std::size_t i = 0; i < pending_reports_.size(); ++i) {
+    RateLimitWindow* window                                   = pending_reports_[i];
+    std::map<RateLimitWindow*, WindowReportInfo>::iterator it = report_task_map_.find(window);
+    if (it == report_task_map_.end() || !it->second.pending_) {
+      continue;  // 等待合并期间窗口已经移除
+    }
+    it->second.pending_ = false;
+    FinishReport(it->second);  // 上一次上报未收到应答
+    window->GetReprotRequest(report_request);
+    it->second.report_seq_ = batch_seq;
+    batch_windows.push_back(window);
+  }
+  pending_reports_.clear();
+  if (batch_windows.empty()) {
+    return;
+  }
   report_request->set_clientkey(client_key_);
   if (POLARIS_LOG_ENABLE(kTraceLogLevel)) {
     POLARIS_LOG(LOG_TRACE, "window report with request: %s", request.ShortDebugString().c_str());
   }
   stream_->SendMessage(request, false);
-  // 设置超时检查
-  report_task_map_[window].task_iter_ = reactor_.AddTimingTask(
-      new WindowSyncTimeoutCheck(window, this, kWindowSyncReportTask, request_timeout_));
+  // 记录批次，所有批次共享一个超时检查任务
+  report_seq_ = batch_seq;
+  report_batches_.push_back(WindowReportBatch());
+  WindowReportBatch& batch = report_batches_.back();
+  batch.seq_               = batch_seq;
+  batch.deadline_          = Time::GetCurrentTimeMs() + request_timeout_;
+  batch.waiting_count_     = batch_windows.size();
+  batch.windows_.swap(batch_windows);
+  if (report_timeout_task_ == reactor_.TimingTaskEnd()) {
+    report_timeout_task_ = reactor_.AddTimingTask(
+        new TimingFuncTask<RateLimitConnection>(ReportTimeoutCheck, this, request_timeout_));
+  }
+}
+
+uint64_t RateLimitConnection::FinishReport(WindowReportInfo& report_info) {
+  uint64_t deadline = 0;
+  if (report_info.report_seq_ != 0 && !report_batches_.empty() &&
+      report_info.report_seq_ >= report_batches_.front().seq_) {  // 超时的批次已经移除
+    std::size_t index        = report_info.report_seq_ - report_batches_.front().seq_;
+    WindowReportBatch& batch = report_batches_[index];
+    batch.waiting_count_--;
+    deadline = batch.deadline_;
+  }
+  report_info.report_seq_ = 0;
+  while (!report_batches_.empty() && report_batches_.front().waiting_count_ == 0) {
+    report_batches_.pop_front();
+  }
+  return deadline;
+}
+
+void RateLimitConnection::ReportTimeoutCheck(RateLimitConnection* connection) {
+  connection->report_timeout_task_ = connection->reactor_.TimingTaskEnd();
+  std::deque<WindowReportBatch>& batches = connection->report_batches_;
+
+  uint64_t current_time     = Time::GetCurrentTimeMs();
+  std::size_t timeout_count = 0;
+  while (!batches.empty() && batches.front().deadline_ <= current_time) {
+    WindowReportBatch& batch = batches.front();
+    for (std::size_t i = 0; i < batch.windows_.size(); ++i) {
+      std::map<RateLimitWindow*, WindowReportInfo>::iterator it =
+          connection->report_task_map_.find(batch.windows_[i]);
+      if (it != connection->report_task_map_.end() && it->second.report_seq_ == batch.seq_) {
+        connection->ReinitWindow(batch.windows_[i], kWindowSyncReportTask);
+        timeout_count++;
+      }
+    }
+    batches.pop_front();
+  }
+  if (timeout_count > 0) {
+    connection->OnRequestTimeout();
+    if (connection->is_closing_) {
+      return;
+    }
+  }
+  if (!batches.empty()) {
+    connection->report_timeout_task_ =
+        connection->reactor_.AddTimingTask(new TimingFuncTask<RateLimitConnection>(
+            ReportTimeoutCheck, connection, batches.front().deadline_ - current_time));
+  }
 }
 
 void RateLimitConnection::OnInitResponse(const metric::v2::RateLimitInitResponse& response) {
@@ -324,8 +439,8 @@ void RateLimitConnection::OnInitResponse(const metric::v2::RateLimitInitResponse
     RateLimitWindow* window                                      = target_it->second;
     std::map<RateLimitWindow*, TimingTaskIter>::iterator task_it = init_task_map_.find(window);
     if (task_it != init_task_map_.end() && task_it->second != reactor_.TimingTaskEnd()) {
-      if (delay > task_it->second->first) {
-        delay = delay - task_it->second->first;
+      if (delay > task_it->second->GetExpireTime()) {
+        delay = delay - task_it->second->GetExpireTime();
       } else {
         delay = 0;
       }
@@ -334,12 +449,11 @@ void RateLimitConnection::OnInitResponse(const metric::v2::RateLimitInitResponse
       init_task_map_.erase(task_it);
 
       client_key_                   = response.clientkey();
-      WindowReportInfo& report_info = report_task_map_[window];
-      for (int i = 0; i < response.counters_size(); ++i) {  // 处理索引
+      WindowReportInfo& report_info = report_task_map_[window];  // 从init迁移到同步任务
+      for (int i = 0; i < response.counters_size(); ++i) {       // 处理索引
         counter_key_map_[response.counters(i).counterkey()] = window;
         report_info.counter_keys_.push_back(response.counters(i).counterkey());
       }
-      report_task_map_[window].task_iter_ = reactor_.TimingTaskEnd();  // 从init迁移到同步任务
       limit_target_map_.erase(target_key);
       window->OnInitResponse(response, time_diff_);
 
@@ -357,58 +471,78 @@ void RateLimitConnection::OnInitResponse(const metric::v2::RateLimitInitResponse
 }
 
 void RateLimitConnection::OnReportResponse(const metric::v2::RateLimitReportResponse& response) {
-  uint64_t delay = Time::GetCurrentTimeMs() + request_timeout_;
   if (response.quotalefts().empty()) {
     POLARIS_LOG(LOG_TRACE, "report with empty quota left response: %s",
                 response.ShortDebugString().c_str());
     return;
   }
-  int counter_key = response.quotalefts().begin()->counterkey();
-  std::map<uint32_t, RateLimitWindow*>::iterator counter_it = counter_key_map_.find(counter_key);
-  if (counter_it == counter_key_map_.end()) {
-    POLARIS_LOG(LOG_TRACE, "report with counter key[%d] not exists, response: %s", counter_key,
-                response.ShortDebugString().c_str());
-    return;
-  }
-  RateLimitWindow* window                                        = counter_it->second;
-  std::map<RateLimitWindow*, WindowReportInfo>::iterator task_it = report_task_map_.find(window);
-  if (task_it != report_task_map_.end()) {
-    if (task_it->second.task_iter_ != reactor_.TimingTaskEnd()) {
-      if (delay > task_it->second.task_iter_->first) {
-        delay = delay - task_it->second.task_iter_->first;
-      } else {
-        delay = 0;
+  // 合并上报的应答包含多个窗口的剩余配额，按窗口归类后分别处理
+  report_lefts_.clear();
+  for (int i = 0; i < response.quotalefts_size(); ++i) {
+    uint32_t counter_key = response.quotalefts(i).counterkey();
+    std::map<uint32_t, RateLimitWindow*>::iterator counter_it = counter_key_map_.find(counter_key);
+    if (counter_it == counter_key_map_.end()) {
+      POLARIS_LOG(LOG_TRACE, "report with counter key[%u] not exists", counter_key);
+      continue;
+    }
+    report_lefts_.push_back(std::make_pair(counter_it->second, i));
+  }
+  std::sort(report_lefts_.begin(), report_lefts_.end());
+  uint64_t current_time   = Time::GetCurrentTimeMs();
+  bool call_result_update = false;
+  std::size_t begin       = 0;
+  while (begin < report_lefts_.size()) {
+    RateLimitWindow* window = report_lefts_[begin].first;
+    uint32_t counter_key    = response.quotalefts(report_lefts_[begin].second).counterkey();
+    window_lefts_.clear();
+    for (; begin < report_lefts_.size() && report_lefts_[begin].first == window; ++begin) {
+      window_lefts_.push_back(&response.quotalefts(report_lefts_[begin].second));
+    }
+    std::map<RateLimitWindow*, WindowReportInfo>::iterator task_it = report_task_map_.find(window);
+    if (task_it == report_task_map_.end()) {  // 请求已经超时了
+      POLARIS_LOG(LOG_WARN, "window for counter key[%u] not exits", counter_key);
+      continue;
+    }
+    if (task_it->second.report_seq_ != 0) {
+      uint64_t deadline = FinishReport(task_it->second);
+      uint64_t delay    = current_time + request_timeout_;
+      delay             = delay > deadline ? delay - deadline : 0;
+      if (!call_result_update) {  // 一个应答只更新一次调用结果
+        connector_.UpdateCallResult(cluster_, instance_, delay, kServerCodeReturnOk);
+        call_result_update = true;
       }
-      reactor_.CancelTimingTask(task_it->second.task_iter_);  // 取消超时检查
-      task_it->second.task_iter_ = reactor_.TimingTaskEnd();
-      connector_.UpdateCallResult(cluster_, instance_, delay, kServerCodeReturnOk);
-      uint64_t report_time = window->OnReportResponse(response, time_diff_);
-      report_time          = report_time > delay ? report_time - delay : 0;
+      uint64_t report_time =
+          window->OnReportResponse(response.timestamp(), window_lefts_, time_diff_);
+      report_time = report_time > delay ? report_time - delay : 0;
       reactor_.AddTimingTask(new WindowSyncTask(window, &connector_, report_time));
     } else {  // 服务器主动推送的消息
       if (POLARIS_LOG_ENABLE(kTraceLogLevel)) {
         POLARIS_LOG(LOG_TRACE, "push response: %s", response.ShortDebugString().c_str());
       }
-      window->OnReportResponse(response, time_diff_);
+      window->OnReportResponse(response.timestamp(), window_lefts_, time_diff_);
     }
-    return;
   }
-  // 请求已经超时了
-  POLARIS_LOG(LOG_WARN, "window for counter key[%d] not exits", counter_key);
 }
 
 void RateLimitConnection::OnResponseTimeout(RateLimitWindow* window, WindowSyncTaskType task_type) {
+  ReinitWindow(window, task_type);
+  OnRequestTimeout();
+}
+
+void RateLimitConnection::ReinitWindow(RateLimitWindow* window, WindowSyncTaskType task_type) {
   if (task_type == kWindowSyncInitTask) {
     POLARIS_LOG(LOG_WARN, "init response for window %s with timeout",
                 window->GetMetricId().c_str());
-    init_task_map_[window] = reactor_.TimingTaskEnd();
   } else {
     POLARIS_LOG(LOG_WARN, "report response for window %s with timeout",
                 window->GetMetricId().c_str());
     report_task_map_.erase(window);  // 移动到init task重新触发init
-    init_task_map_[window] = reactor_.TimingTaskEnd();
   }
+  init_task_map_[window] = reactor_.TimingTaskEnd();
   reactor_.SubmitTask(new WindowSyncTask(window, &connector_));
+}
+
+void RateLimitConnection::OnRequestTimeout() {
   connector_.UpdateCallResult(cluster_, instance_, request_timeout_, kServerCodeRpcTimeout);
   // 连接上的请求全部超时，切换连接
   if (last_response_time_ + request_timeout_ < Time::GetCurrentTimeMs()) {
@@ -441,9 +575,7 @@ void RateLimitConnection::CloseForError() {
     }
     for (std::map<RateLimitWindow*, WindowReportInfo>::iterator it = report_task_map_.begin();
          it != report_task_map_.end(); ++it) {
-      if (it->second.task_iter_ != timeout_end) {
-        reactor_.CancelTimingTask(it->second.task_iter_);
-        it->second.task_iter_ = timeout_end;
+      if (it->second.report_seq_ != 0 || it->second.pending_) {  // 批次由ClearTaskAndWindow清理
         reactor_.AddTimingTask(new WindowSyncTask(it->first, &connector_, 200));
       }
     }
@@ -17,8 +17,11 @@
 #include <stdint.h>
 #include <v2/ratelimit_v2.pb.h>
 
+#include <deque>
 #include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "grpc/client.h"
 #include "grpc/status.h"
@@ -54,7 +57,7 @@ private:
   RateLimitConnector* connector_;
 };
 
-// 同步任务超时检查
+// 初始化任务超时检查，上报任务由连接按批次统一检查超时
 class WindowSyncTimeoutCheck : public TimingTask {
 public:
   WindowSyncTimeoutCheck(RateLimitWindow* window, RateLimitConnection* connection,
@@ -79,10 +82,21 @@ struct LimitTargetKey {
 bool operator<(const LimitTargetKey& lhs, const LimitTargetKey& rhs);
 
 struct WindowReportInfo {
-  TimingTaskIter task_iter_;
+  WindowReportInfo() : report_seq_(0), pending_(false) {}
+
+  uint64_t report_seq_;  // 等待应答的上报批次序号，0表示没有等待应答的上报
+  bool pending_;         // 是否在等待合并发送
   std::vector<uint32_t> counter_keys_;
 };
 
+// 合并发送的一批上报，所有窗口收到应答后释放
+struct WindowReportBatch {
+  uint64_t seq_;
+  uint64_t deadline_;          // 应答超时时间
+  std::size_t waiting_count_;  // 还未收到应答的窗口数
+  std::vector<RateLimitWindow*> windows_;
+};
+
 // 通过一致性hash方式选择的限流Server并建立连接，并管理连接上的请求
 class RateLimitConnection : public grpc::RequestCallback<metric::v2::TimeAdjustResponse>,
                             public grpc::StreamCallback<metric::v2::RateLimitResponse> {
@@ -114,6 +128,11 @@ public:
   void OnReportResponse(const metric::v2::RateLimitReportResponse& response);
   void OnResponseTimeout(RateLimitWindow* window, WindowSyncTaskType task_type);
 
+  // 发送等待合并的上报
+  static void FlushReport(RateLimitConnection* connection);
+  // 检查已发送上报批次的应答超时
+  static void ReportTimeoutCheck(RateLimitConnection* connection);
+
   // 检查连接是否空闲
   bool IsIdle(uint64_t idle_check_time) const { return last_used_time_ < idle_check_time; }
 
@@ -130,6 +149,16 @@ private:
 
   void SendReprot(RateLimitWindow* window);
 
+  void SendReportBatch();
+
+  // 上报应答已收到或不再需要，从所在批次中移除，返回批次的超时时间
+  uint64_t FinishReport(WindowReportInfo& report_info);
+
+  // 请求超时后将窗口重新加入init流程
+  void ReinitWindow(RateLimitWindow* window, WindowSyncTaskType task_type);
+
+  void OnRequestTimeout();
+
 private:
   RateLimitConnector& connector_;
   Reactor& reactor_;
@@ -151,6 +180,15 @@ private:
   std::map<RateLimitWindow*, TimingTaskIter> init_task_map_;
   std::map<uint32_t, RateLimitWindow*> counter_key_map_;  // 同步结果映射到window索引
   std::map<RateLimitWindow*, WindowReportInfo> report_task_map_;
+
+  std::vector<RateLimitWindow*> pending_reports_;  // 等待合并发送的上报窗口
+  TimingTaskIter report_flush_task_;
+  uint64_t report_seq_;
+  std::deque<WindowReportBatch> report_batches_;  // 按发送顺序记录等待应答的上报批次
+  TimingTaskIter report_timeout_task_;            // 所有上报批次共享的超时检查
+  // 复用的临时数据，用于将上报应答按窗口归类
+  std::vector<std::pair<RateLimitWindow*, int> > report_lefts_;
+  std::vector<const metric::v2::QuotaLeft*> window_lefts_;
 };
 
 // 同步时间定时任务/超时检查任务
@@ -20,6 +20,7 @@
 #include <v1/ratelimit.pb.h>
 #include <v1/request.pb.h>
 
+#include <algorithm>
 #include <memory>
 #include <utility>
 
@@ -28,6 +29,7 @@
 #include "polaris/log.h"
 #include "quota/adjuster/quota_adjuster.h"
 #include "quota/quota_bucket_qps.h"
+#include "quota/quota_bucket_sliding_window.h"
 #include "quota/quota_model.h"
 #include "quota/rate_limit_connector.h"
 #include "quota/service_rate_limiter.h"
@@ -44,7 +46,8 @@ RateLimitWindow::RateLimitWindow(Reactor& reactor, MetricConnector* metric_conne
     : reactor_(reactor), metric_connector_(metric_connector), rule_(NULL),
       service_rate_limit_data_(NULL), cache_key_(key), allocating_bucket_(NULL),
       traffic_shaping_bucket_(NULL), last_use_time_(Time::GetCurrentTimeMs()), expire_time_(0),
-      is_deleted_(false), quota_adjuster_(NULL), usage_info_(NULL) {}
+      is_deleted_(false), quota_adjuster_(NULL), limit_records_(NULL), limit_record_size_(0),
+      usage_info_(NULL) {}
 
 RateLimitWindow::~RateLimitWindow() {
   rule_ = NULL;
@@ -64,10 +67,9 @@ RateLimitWindow::~RateLimitWindow() {
     quota_adjuster_->MakeDeleted();
     quota_adjuster_ = NULL;
   }
-  for (std::map<uint64_t, LimitRecordCount>::iterator it = limit_record_count_.begin();
-       it != limit_record_count_.end(); ++it) {
-    delete it->second.pass_count_;
-    delete it->second.limit_count_;
+  if (limit_records_ != NULL) {
+    delete[] limit_records_;
+    limit_records_ = NULL;
   }
   if (usage_info_ != NULL) {
     delete usage_info_;
@@ -76,7 +78,8 @@ RateLimitWindow::~RateLimitWindow() {
 }
 
 ReturnCode RateLimitWindow::Init(ServiceData* service_rate_limit_data, RateLimitRule* rule,
-                                 const std::string& metric_id, RateLimitConnector* connector) {
+                                 const std::string& metric_id, RateLimitConnector* connector,
+                                 int token_stripe_count) {
   static const uint64_t kExpireFactor = 3;  // 淘汰因子，过期时间=MaxDuration * ExpireFactor
   static const uint64_t kMinExpireDuration = 60 * 1000;  // 最短淘汰时间，1min
 
@@ -103,16 +106,27 @@ ReturnCode RateLimitWindow::Init(ServiceData* service_rate_limit_data, RateLimit
 
   // 初始化配额窗口
   if (rule_->GetResourceType() == v1::Rule::QPS) {
-    allocating_bucket_ = new RemoteAwareQpsBucket(rule_);
+    if (rule_->GetActionType() == kRateLimitActionSlidingWindow) {
+      allocating_bucket_ = new RemoteAwareSlidingWindowBucket(rule_);
+    } else {
+      allocating_bucket_ = new RemoteAwareQpsBucket(rule_, token_stripe_count);
+    }
   } else {  // 暂时不支持其他类型
     POLARIS_ASSERT(false);
   }
+  // 与分配令牌桶一样按周期从小到大去重排列，分配时通过序号直接定位
   const std::vector<RateLimitAmount>& amounts = rule->GetRateLimitAmount();
+  std::vector<uint64_t> durations;
   for (std::size_t i = 0; i < amounts.size(); ++i) {
-    LimitRecordCount& record_count = limit_record_count_[amounts[i].valid_duration_];
-    record_count.max_amount_       = 0;
-    record_count.pass_count_       = new sync::Atomic<uint32_t>();
-    record_count.limit_count_      = new sync::Atomic<uint32_t>();
+    durations.push_back(amounts[i].valid_duration_);
+  }
+  std::sort(durations.begin(), durations.end());
+  durations.erase(std::unique(durations.begin(), durations.end()), durations.end());
+  limit_record_size_ = durations.size();
+  limit_records_     = new LimitRecordCount[limit_record_size_];
+  for (std::size_t i = 0; i < limit_record_size_; ++i) {
+    limit_records_[i].duration_   = durations[i];
+    limit_records_[i].max_amount_ = 0;
   }
   quota_adjuster_ = QuotaAdjuster::Create(kQuotaAdjusterClimb, this);
   if (rule_->GetRateLimitType() == v1::Rule::LOCAL) {  // 本地模式不需要与Server通信直接
@@ -140,31 +154,48 @@ bool RateLimitWindow::CheckRateLimitRuleRevision(const std::string& rule_revisio
   return !is_deleted_ && rule_->GetRevision() == rule_revision;
 }
 
-QuotaResponse* RateLimitWindow::AllocateQuota(int64_t acquire_amount) {
-  last_use_time_ = Time::GetCurrentTimeMs();
-  QuotaResponse* quota_response;
-  QuotaResult* result = traffic_shaping_bucket_->GetQuota(acquire_amount);
-  if (result->result_code_ == kQuotaResultLimited) {  // 整形窗口限流
-    quota_response = QuotaResponseImpl::CreateResponse(kQuotaResultLimited);
+void RateLimitWindow::AllocateQuota(int64_t acquire_amount, QuotaResponseImpl& response) {
+  LimitAllocateResult limit_result;
+  AllocateQuota(acquire_amount, response, limit_result);
+}
+
+void RateLimitWindow::AllocateQuota(int64_t acquire_amount, QuotaResponseImpl& response,
+                                    LimitAllocateResult& limit_result) {
+  last_use_time_     = Time::GetCurrentTimeMs();
+  QuotaResult result = traffic_shaping_bucket_->GetQuota(acquire_amount);
+  if (result.result_code_ == kQuotaResultLimited) {  // 整形窗口限流
+    response.Reset(kQuotaResultLimited);
+    limit_result.token_acquired_ = false;
     traffic_shaping_record_++;  // 记录被流量整型限流
+    return;
+  }
+  response.result_code_ = allocating_bucket_->Allocate(acquire_amount, this->GetServerTime(),
+                                                       response.info_, &limit_result);
+  is_degrade_           = limit_result.is_degrade_;
+  if (response.result_code_ == kQuotaResultOk) {
+    response.wait_time_ = result.queue_time_;  // 匀速排队时需要等待的时间
+    for (std::size_t i = 0; i < limit_record_size_; ++i) {
+      limit_records_[i].pass_count_ += acquire_amount;  // 记录通过的配额
+    }
   } else {
-    LimitAllocateResult limit_result;
-    quota_response =
-        allocating_bucket_->Allocate(acquire_amount, this->GetServerTime(), &limit_result);
-    is_degrade_ = limit_result.is_degrade_;
-    if (quota_response->GetResultCode() == kQuotaResultOk) {
-      for (std::map<uint64_t, LimitRecordCount>::iterator it = limit_record_count_.begin();
-           it != limit_record_count_.end(); ++it) {
-        (*it->second.pass_count_) += acquire_amount;  // 记录通过的配额
-      }
-    } else {
-      LimitRecordCount& record_count = limit_record_count_[limit_result.violate_duration_];
-      record_count.max_amount_       = limit_result.max_amount_;
-      (*record_count.limit_count_) += acquire_amount;  // 记录被配额限制
+    response.wait_time_            = 0;
+    LimitRecordCount& record_count = limit_records_[limit_result.violate_index_];
+    record_count.max_amount_       = limit_result.max_amount_;
+    record_count.limit_count_ += acquire_amount;  // 记录被配额限制
+  }
+}
+
+void RateLimitWindow::ReturnQuota(int64_t acquire_amount, const LimitAllocateResult& limit_result) {
+  allocating_bucket_->Release(acquire_amount, limit_result);
+  uint32_t amount = static_cast<uint32_t>(acquire_amount);
+  for (std::size_t i = 0; i < limit_record_size_; ++i) {
+    sync::Atomic<uint32_t>& pass_count = limit_records_[i].pass_count_;
+    uint32_t current_count             = pass_count.Load();
+    // 通过数可能已被上报清零，扣减时不能小于0
+    while (!pass_count.Cas(current_count, current_count > amount ? current_count - amount : 0)) {
+      current_count = pass_count.Load();
     }
   }
-  delete result;
-  return quota_response;
 }
 
 void RateLimitWindow::GetInitRequest(metric::v2::RateLimitInitRequest* request) {
@@ -222,24 +253,22 @@ void RateLimitWindow::GetReprotRequest(metric::v2::RateLimitReportRequest* reque
     sum->set_limited(quota_usage.quota_rejected_);
     sum->set_counterkey(duration_counter_key_[amounts[i].valid_duration_ / 1000]);
   }
-  if (POLARIS_LOG_ENABLE(kTraceLogLevel)) {
-    POLARIS_LOG(LOG_TRACE, "window report with request: %s", request->ShortDebugString().c_str());
-  }
 }
 
-uint64_t RateLimitWindow::OnReportResponse(const metric::v2::RateLimitReportResponse& response,
-                                           int64_t time_diff) {
+uint64_t RateLimitWindow::OnReportResponse(
+    int64_t server_timestamp, const std::vector<const metric::v2::QuotaLeft*>& quota_lefts,
+    int64_t time_diff) {
   UpdateServiceTimeDiff(time_diff);
   RemoteQuotaResult result;
   result.local_usage_        = usage_info_;
   result.curret_server_time_ = this->GetServerTime();
-  if (response.timestamp() > 0) {
-    result.remote_usage_.create_server_time_ = static_cast<uint64_t>(response.timestamp());
+  if (server_timestamp > 0) {
+    result.remote_usage_.create_server_time_ = static_cast<uint64_t>(server_timestamp);
   } else {
     result.remote_usage_.create_server_time_ = result.curret_server_time_;
   }
-  for (int i = 0; i < response.quotalefts_size(); ++i) {
-    const metric::v2::QuotaLeft& left = response.quotalefts(i);
+  for (std::size_t i = 0; i < quota_lefts.size(); ++i) {
+    const metric::v2::QuotaLeft& left = *quota_lefts[i];
     uint32_t duration                 = counter_key_duration_[left.counterkey()];
     result.remote_usage_.quota_usage_[duration * 1000].quota_allocated_ = left.left();
   }
@@ -252,6 +281,16 @@ uint64_t RateLimitWindow::OnReportResponse(const metric::v2::RateLimitReportResp
   return next_report_time < report_interval ? next_report_time : report_interval;
 }
 
+LimitRecordCount* RateLimitWindow::FindLimitRecord(uint64_t duration) {
+  for (std::size_t i = 0; i < limit_record_size_; ++i) {
+    if (limit_records_[i].duration_ == duration) {
+      return &limit_records_[i];
+    }
+  }
+  POLARIS_ASSERT(false);  // 初始化时已经为所有周期创建记录
+  return NULL;
+}
+
 bool RateLimitWindow::IsExpired() {
   return last_use_time_ + expire_time_ < Time::GetCurrentTimeMs();
 }
@@ -279,9 +318,9 @@ bool RateLimitWindow::CollectRecord(v1::RateLimitRecord& rate_limit_record) {
   }
   const std::vector<RateLimitAmount>& amounts = rule_->GetRateLimitAmount();
   for (std::size_t i = 0; i < amounts.size(); ++i) {
-    LimitRecordCount& record_count = limit_record_count_[amounts[i].valid_duration_];
-    uint32_t pass_count            = record_count.pass_count_->Exchange(0);
-    uint32_t limit_count           = record_count.limit_count_->Exchange(0);
+    LimitRecordCount& record_count = *FindLimitRecord(amounts[i].valid_duration_);
+    uint32_t pass_count            = record_count.pass_count_.Exchange(0);
+    uint32_t limit_count           = record_count.limit_count_.Exchange(0);
     if (pass_count != 0 || limit_count != 0) {
       v1::LimitStat* limit_stat = rate_limit_record.mutable_limit_stats()->Add();
       limit_stat->set_reason("amount:" + StringUtils::TypeToStr(record_count.max_amount_) + "/" +
@@ -25,6 +25,7 @@
 #include <v2/ratelimit_v2.pb.h>
 
 #include "grpc/client.h"
+#include "polaris/limit.h"
 #include "polaris/model.h"
 #include "quota/model/rate_limit_rule.h"
 #include "reactor/task.h"
@@ -37,7 +38,7 @@ class LimitCallResult;
 class MetricConnector;
 class QuotaAdjuster;
 class QuotaBucket;
-class QuotaResponse;
+class QuotaResponseImpl;
 class RateLimitConnector;
 class Reactor;
 
@@ -59,30 +60,35 @@ struct RemoteQuotaResult {
   QuotaUsageInfo remote_usage_;  // 远程配额汇总结果
 };
 
+// 按限流周期记录的通过和限流次数，窗口初始化时按周期从小到大创建
 struct LimitRecordCount {
-  uint32_t max_amount_;                  // 配额
-  sync::Atomic<uint32_t>* pass_count_;   // 通过次数
-  sync::Atomic<uint32_t>* limit_count_;  // 限流次数
+  uint64_t duration_;                   // 限流周期
+  uint32_t max_amount_;                 // 配额
+  sync::Atomic<uint32_t> pass_count_;   // 通过次数
+  sync::Atomic<uint32_t> limit_count_;  // 限流次数
 };
 
 struct LimitAllocateResult {
   uint32_t max_amount_;
   uint64_t violate_duration_;
+  std::size_t violate_index_;  // 违反的配额在所有周期中从小到大的序号
   bool is_degrade_;
+  uint64_t server_time_;   // 分配时的服务器时间，回收时用于确认令牌所属周期
+  bool use_remote_quota_;  // 分配时是否使用远程配额划扣
+  bool token_acquired_;    // 是否占用了令牌，被限流或故障放通时令牌已归还
 };
 
 // 远程配额分配令牌桶基类
-class QuotaResponse;
 class RemoteAwareBucket {
 public:
   virtual ~RemoteAwareBucket() {}
 
-  // 执行配额分配操作，返回配额分配结果，并返回是否需要立即上报和限流是违反的配额配置duration
-  virtual QuotaResponse* Allocate(int64_t acquire_amount, uint64_t current_server_time,
-                                  LimitAllocateResult* limit_result) = 0;
+  // 执行配额分配操作，返回配额分配结果并将配额信息写入info，同时返回限流时违反的配额配置duration
+  virtual QuotaResultCode Allocate(int64_t acquire_amount, uint64_t current_server_time,
+                                   QuotaResultInfo& info, LimitAllocateResult* limit_result) = 0;
 
-  // 执行配额回收操作
-  virtual void Release() = 0;
+  // 执行配额回收操作，归还Allocate成功时占用的令牌
+  virtual void Release(int64_t acquire_amount, const LimitAllocateResult& limit_result) = 0;
 
   // 设置通过限流服务器获取的远程配额
   virtual uint64_t SetRemoteQuota(const RemoteQuotaResult& remote_quota_result) = 0;
@@ -99,14 +105,24 @@ public:
   RateLimitWindow(Reactor& reactor, MetricConnector* metric_connector,
                   const RateLimitWindowKey& key);
 
+  // token_stripe_count大于0时令牌桶的本地配额按分段划扣
   ReturnCode Init(ServiceData* service_rate_limit_data, RateLimitRule* rule,
-                  const std::string& metric_id, RateLimitConnector* connector);
+                  const std::string& metric_id, RateLimitConnector* connector,
+                  int token_stripe_count = 0);
 
   ReturnCode WaitRemoteInit(uint64_t timeout);
 
   bool CheckRateLimitRuleRevision(const std::string& rule_revision);
 
-  QuotaResponse* AllocateQuota(int64_t acquire_amount);
+  // 分配配额，结果写入调用方提供的应答中，分配过程不申请内存
+  void AllocateQuota(int64_t acquire_amount, QuotaResponseImpl& response);
+
+  // 分配配额并返回分配详情，用于批量分配失败时通过ReturnQuota撤销
+  void AllocateQuota(int64_t acquire_amount, QuotaResponseImpl& response,
+                     LimitAllocateResult& limit_result);
+
+  // 撤销分配成功的配额，匀速排队已占用的排队时间不归还
+  void ReturnQuota(int64_t acquire_amount, const LimitAllocateResult& limit_result);
 
   const std::string& GetMetricId() { return metric_id_; }
 
@@ -116,9 +132,11 @@ public:
   void GetInitRequest(metric::v2::RateLimitInitRequest* request);
   void OnInitResponse(const metric::v2::RateLimitInitResponse& response, int64_t time_diff);
 
-  // 上报返回的应答回调
+  // 上报返回的应答回调，合并上报时只处理应答中属于本窗口的剩余配额
   void GetReprotRequest(metric::v2::RateLimitReportRequest* request);
-  uint64_t OnReportResponse(const metric::v2::RateLimitReportResponse& response, int64_t time_diff);
+  uint64_t OnReportResponse(int64_t server_timestamp,
+                            const std::vector<const metric::v2::QuotaLeft*>& quota_lefts,
+                            int64_t time_diff);
 
   bool IsExpired();  // 是否过期
 
@@ -152,6 +170,8 @@ private:
 
   void UpdateServiceTimeDiff(int64_t time_diff);
 
+  LimitRecordCount* FindLimitRecord(uint64_t duration);
+
 private:
   Reactor& reactor_;
   MetricConnector* metric_connector_;
@@ -174,7 +194,8 @@ private:
 
   sync::Atomic<uint32_t> traffic_shaping_record_;
   sync::Atomic<bool> is_degrade_;
-  std::map<uint64_t, LimitRecordCount> limit_record_count_;
+  LimitRecordCount* limit_records_;  // 各周期的通过和限流次数，与分配令牌桶顺序一致
+  std::size_t limit_record_size_;
 
   QuotaUsageInfo* usage_info_;
   std::string connection_id_;  // 同步时客户端使用的连接id
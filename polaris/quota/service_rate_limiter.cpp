@@ -27,6 +27,7 @@ namespace polaris {
 ServiceRateLimiter* ServiceRateLimiter::Create(RateLimitActionType action_type) {
   switch (action_type) {
     case kRateLimitActionReject:
+    case kRateLimitActionSlidingWindow:  // 滑动窗口在分配配额时限流，不需要整形
       return new RejectServiceRateLimiter();
     case kRateLimitActionUnirate:
       return new UnirateServiceRateLimiter();
@@ -39,8 +40,8 @@ ServiceRateLimiter* ServiceRateLimiter::Create(RateLimitActionType action_type)
 ///////////////////////////////////////////////////////////////////////////////
 // 直接拒绝
 
-QuotaResult* RejectQuotaBucket::GetQuota(int64_t /*acquire_amount*/) {
-  return new QuotaResult(kQuotaResultOk, 0);
+QuotaResult RejectQuotaBucket::GetQuota(int64_t /*acquire_amount*/) {
+  return QuotaResult(kQuotaResultOk, 0);
 }
 
 ReturnCode RejectServiceRateLimiter::InitQuotaBucket(RateLimitRule* /*rate_limit_rule*/,
@@ -60,7 +61,7 @@ UnirateQuotaBucket::~UnirateQuotaBucket() { rule_ = NULL; }
 
 ReturnCode UnirateQuotaBucket::Init(RateLimitRule* rate_limit_rule) {
   rule_                 = rate_limit_rule;
-  max_queuing_duration_ = 1000;  // TODO 支持配置，当前默认1s
+  max_queuing_duration_ = 1000 * Time::kMillionBase;  // TODO 支持配置，当前默认1s
 
   // 选出允许qps最低的amount和duration组合，作为effective_amount和effective_duration
   // 在匀速排队限流器里面，就是每个请求都要间隔同样的时间，
@@ -69,15 +70,15 @@ ReturnCode UnirateQuotaBucket::Init(RateLimitRule* rate_limit_rule) {
   const std::vector<RateLimitAmount>& amounts = rule_->GetRateLimitAmount();
   POLARIS_ASSERT(amounts.size() > 0);
   std::size_t max_rate_index = 0;
-  float max_rate             = -1;
+  uint64_t max_rate          = 0;
   uint64_t max_duration      = 0;
   for (std::size_t i = 0; i < amounts.size(); ++i) {
     if (amounts[i].max_amount_ == 0) {
       reject_all_ = true;
       return kReturnOk;
     }
-    float new_rate = static_cast<float>(amounts[i].valid_duration_) / amounts[i].max_amount_;
-    if (new_rate > max_rate) {
+    uint64_t new_rate = amounts[i].valid_duration_ * Time::kMillionBase / amounts[i].max_amount_;
+    if (new_rate >= max_rate) {
       max_rate       = new_rate;
       max_rate_index = i;
     }
@@ -87,29 +88,34 @@ ReturnCode UnirateQuotaBucket::Init(RateLimitRule* rate_limit_rule) {
   }
   effective_amount_   = amounts[max_rate_index].max_amount_;
   effective_duration_ = amounts[max_rate_index].valid_duration_;
-  effective_rate_     = static_cast<uint64_t>(max_rate);
-  last_grant_time_    = Time::GetCurrentTimeMs() - max_duration;
+  effective_rate_     = max_rate;
+  last_grant_time_    = Time::GetCurrentTimeNs() - max_duration * Time::kMillionBase;
   return kReturnOk;
 }
 
-QuotaResult* UnirateQuotaBucket::GetQuota(int64_t acquire_amount) {
+QuotaResult UnirateQuotaBucket::GetQuota(int64_t acquire_amount) {
   if (reject_all_) {
-    return new QuotaResult(kQuotaResultOk, 0);
+    return QuotaResult(kQuotaResultOk, 0);
   }
-  // TODO 多线程支持，原子读写 + CAS实现
-  uint64_t current_time = Time::GetCurrentTimeMs();
-  uint64_t expect_time  = last_grant_time_ + effective_rate_ * acquire_amount;
-  if (expect_time < current_time) {
-    last_grant_time_ = current_time;
-    return new QuotaResult(kQuotaResultOk, 0);
-  }
-  uint64_t next_grand_time = last_grant_time_ + effective_rate_ * acquire_amount;
-  uint64_t wait_time       = next_grand_time > current_time ? next_grand_time - current_time : 0;
-  if (wait_time > max_queuing_duration_) {  // 超过最大等待时间，直接拒绝
-    return new QuotaResult(kQuotaResultLimited, 0);
+  uint64_t current_time    = Time::GetCurrentTimeNs();
+  uint64_t acquire_time    = effective_rate_ * acquire_amount;
+  uint64_t last_grant_time = last_grant_time_.Load();
+  for (;;) {
+    // 上次分配后间隔足够则立即分配，否则排队到上次分配时间加上间隔
+    uint64_t grant_time = last_grant_time + acquire_time;
+    if (grant_time < current_time) {
+      grant_time = current_time;
+    }
+    uint64_t wait_time = grant_time - current_time;
+    if (wait_time > max_queuing_duration_) {  // 超过最大等待时间，直接拒绝
+      return QuotaResult(kQuotaResultLimited, 0);
+    }
+    if (last_grant_time_.Cas(last_grant_time, grant_time)) {  // 失败说明其他线程已分配，重试
+      // 排队时间向上取整到毫秒，保证按返回时间等待后不会早于分配时间
+      return QuotaResult(kQuotaResultOk, (wait_time + Time::kMillionBase - 1) / Time::kMillionBase);
+    }
+    last_grant_time = last_grant_time_.Load();
   }
-  last_grant_time_ = next_grand_time;
-  return new QuotaResult(kQuotaResultOk, wait_time);
 }
 
 ReturnCode UnirateServiceRateLimiter::InitQuotaBucket(RateLimitRule* rate_limit_rule,
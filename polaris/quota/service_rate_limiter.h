@@ -38,7 +38,7 @@ public:
   virtual ~QuotaBucket() {}
 
   //在令牌桶/漏桶中进行单个配额的划扣，并返回本次分配的结果
-  virtual QuotaResult* GetQuota(int64_t acquire_amount) = 0;
+  virtual QuotaResult GetQuota(int64_t acquire_amount) = 0;
 
   //释放配额（仅对于并发数限流有用）
   virtual void Release() = 0;
@@ -64,7 +64,7 @@ public:
   RejectQuotaBucket() {}
   virtual ~RejectQuotaBucket() {}
 
-  virtual QuotaResult* GetQuota(int64_t acquire_amount);
+  virtual QuotaResult GetQuota(int64_t acquire_amount);
 
   virtual void Release() {}
 };
@@ -79,6 +79,8 @@ public:
 
 ///////////////////////////////////////////////////////////////////////////////
 // Unirate模式 匀速排队
+// 使用虚拟调度算法(GCRA)：每个配额按固定间隔分配，通过CAS推进上次分配时间，多线程无锁
+// 内部时间精度为纳秒，支持每秒超过1000个配额的匀速排队
 class UnirateQuotaBucket : public QuotaBucket {
 public:
   UnirateQuotaBucket();
@@ -86,17 +88,17 @@ public:
 
   ReturnCode Init(RateLimitRule* rate_limit_rule);
 
-  virtual QuotaResult* GetQuota(int64_t acquire_amount);
+  virtual QuotaResult GetQuota(int64_t acquire_amount);
 
   virtual void Release() {}
 
 private:
   RateLimitRule* rule_;                     // 限流规则
-  uint64_t max_queuing_duration_;           // 最长排队时间
+  uint64_t max_queuing_duration_;           // 最长排队时间，单位ns
   uint32_t effective_amount_;               // 等效配额
   uint64_t effective_duration_;             // 等效时间窗
-  sync::Atomic<uint64_t> effective_rate_;   // 为一个实例生成一个配额的平均时间
-  sync::Atomic<uint64_t> last_grant_time_;  // 上次分配配额时间
+  uint64_t effective_rate_;                 // 生成一个配额的平均时间，单位ns
+  sync::Atomic<uint64_t> last_grant_time_;  // 上次分配配额的时间，单位ns
   bool reject_all_;                         //是不是有amount为0
 };
 
@@ -20,8 +20,6 @@
 #include <unistd.h>
 #include <iosfwd>
 
-#include <utility>
-
 #include "logger.h"
 #include "reactor/event.h"
 #include "reactor/notify.h"
@@ -32,7 +30,7 @@ namespace polaris {
 static const int kEpollEventSize           = 1024;
 static const uint64_t kEpollTimeoutDefault = 10;
 
-Reactor::Reactor() {
+Reactor::Reactor() : timing_wheel_(Time::GetCurrentTimeMs()) {
   epoll_fd_     = epoll_create(kEpollEventSize);
   epoll_events_ = new epoll_event[kEpollEventSize];
   POLARIS_ASSERT(epoll_fd_ >= 0 && "reactor create epoll failed!");
@@ -47,9 +45,7 @@ Reactor::~Reactor() {
 
   // 这里必须先删除timeout，因为有些定时任务会用于检查请求超时
   // 超时后删除请求对象，请求对象提交异步删除链接到pending_tasks中
-  for (TimingTaskIter it = timing_tasks_.begin(); it != timing_tasks_.end(); ++it) {
-    delete it->second;
-  }
+  timing_wheel_.Clear();
   for (std::size_t i = 0; i < pending_tasks_.size(); ++i) {
     delete pending_tasks_[i];
   }
@@ -87,14 +83,15 @@ void Reactor::RemoveEventHandler(int fd) {
 TimingTaskIter Reactor::AddTimingTask(TimingTask* timing_task) {
   POLARIS_ASSERT(executor_tid_ == 0 || executor_tid_ == pthread_self());
   uint64_t expiration = Time::GetCurrentTimeMs() + timing_task->GetInterval();
-  return timing_tasks_.insert(std::make_pair(expiration, timing_task));
+  timing_wheel_.AddTask(timing_task, expiration);
+  return timing_task;
 }
 
 void Reactor::CancelTimingTask(TimingTaskIter iter) {
   POLARIS_ASSERT(executor_tid_ == 0 || executor_tid_ == pthread_self());
   if (status_ == kReactorRun) {  // 只在运行的情况下取消任务
-    delete iter->second;
-    timing_tasks_.erase(iter);
+    timing_wheel_.RemoveTask(iter);
+    delete iter;
   }
 }
 
@@ -127,19 +124,13 @@ void Reactor::RunPendingTask() {
 }
 
 void Reactor::RunTimingTask() {
-  while (!timing_tasks_.empty()) {
-    TimingTaskIter it = timing_tasks_.begin();
-    if (it->first > Time::GetCurrentTimeMs()) {
-      return;  // 剩余任务都没有到执行时间
-    }
-
-    TimingTask* timing_task = it->second;
-    timing_tasks_.erase(it);
+  TimingTask* timing_task;
+  while ((timing_task = timing_wheel_.PopExpiredTask(Time::GetCurrentTimeMs())) != NULL) {
     timing_task->Run();
 
     uint64_t next_run_time = timing_task->NextRunTime();
     if (next_run_time > 0) {
-      timing_tasks_.insert(std::make_pair(next_run_time, timing_task));
+      timing_wheel_.AddTask(timing_task, next_run_time);
     } else {
       delete timing_task;  // 不用在执行
     }
@@ -147,17 +138,8 @@ void Reactor::RunTimingTask() {
 }
 
 uint64_t Reactor::CalculateEpollWaitTime() {
-  if (timing_tasks_.empty()) {
-    return kEpollTimeoutDefault;
-  }
-  // 查找最新需要执行的任务时间来决定epoll等待的时间
-  uint64_t expire_time  = timing_tasks_.begin()->first;
-  uint64_t current_time = Time::GetCurrentTimeMs();
-  if (expire_time > current_time) {
-    uint64_t diff = expire_time - current_time;
-    return diff < kEpollTimeoutDefault ? diff : kEpollTimeoutDefault;
-  }
-  return 0;
+  // 根据最近需要执行的任务时间来决定epoll等待的时间
+  return timing_wheel_.CalculateWaitTime(Time::GetCurrentTimeMs(), kEpollTimeoutDefault);
 }
 
 void Reactor::RunEpollTask(uint64_t timeout) {
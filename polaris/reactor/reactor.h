@@ -22,6 +22,7 @@
 
 #include "reactor/notify.h"
 #include "reactor/task.h"
+#include "reactor/timing_wheel.h"
 #include "sync/atomic.h"
 #include "sync/mutex.h"
 
@@ -47,7 +48,7 @@ public:
   // 线程不安全的方式增加定时任务和取消定时任务
   TimingTaskIter AddTimingTask(TimingTask* timing_task);
   void CancelTimingTask(TimingTaskIter iter);
-  TimingTaskIter TimingTaskEnd() { return timing_tasks_.end(); }
+  TimingTaskIter TimingTaskEnd() { return NULL; }
 
   // 以下三个方法线程安全
   void SubmitTask(Task* task);           // 用于其他线程提交任务
@@ -76,7 +77,7 @@ private:
   sync::Mutex queue_mutex_;           // 立刻执行的任务由别的线程提交，必须加锁
   std::vector<Task*> pending_tasks_;  // 立刻执行的任务
 
-  std::multimap<uint64_t, TimingTask*> timing_tasks_;  // 定时执行的任务
+  TimingWheel timing_wheel_;  // 定时执行的任务
 };
 
 }  // namespace polaris
@@ -14,10 +14,9 @@
 #ifndef POLARIS_CPP_POLARIS_REACTOR_TASK_H_
 #define POLARIS_CPP_POLARIS_REACTOR_TASK_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
-#include <map>
-
 namespace polaris {
 
 // 任务接口
@@ -57,16 +56,26 @@ public:
 // 定时执行任务接口
 class TimingTask : public Task {
 public:
-  explicit TimingTask(uint64_t interval) : interval_(interval) {}
+  explicit TimingTask(uint64_t interval)
+      : interval_(interval), expire_time_(0), prev_(NULL), next_(NULL) {}
 
   uint64_t GetInterval() const { return interval_; }
 
+  // 任务的到期时间，添加到Reactor后有效
+  uint64_t GetExpireTime() const { return expire_time_; }
+
   // 下一次执行的时间
   // 返回0的话则释放任务，不再执行
   virtual uint64_t NextRunTime() { return 0; }
 
 protected:
   const uint64_t interval_;
+
+private:
+  friend class TimingWheel;
+  uint64_t expire_time_;
+  TimingTask* prev_;  // 时间轮槽位中的双向链表
+  TimingTask* next_;
 };
 
 // 将函数封装成定时任务
@@ -115,7 +124,8 @@ private:
   T* object_;
 };
 
-typedef std::multimap<uint64_t, TimingTask*>::iterator TimingTaskIter;
+// 定时任务句柄，用于取消任务，任务执行或取消后失效
+typedef TimingTask* TimingTaskIter;
 
 }  // namespace polaris
 
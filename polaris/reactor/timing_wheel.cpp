@@ -0,0 +1,186 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#include "reactor/timing_wheel.h"
+
+#include <string.h>
+
+namespace polaris {
+
+// 时间轮能直接表示的最大时间跨度
+static const uint64_t kMaxTickSpan = (static_cast<uint64_t>(1) << 32) - 1;
+
+TimingWheel::TimingWheel(uint64_t current_time) : current_tick_(current_time), task_count_(0) {
+  InitSlot(&expired_);
+  for (int level = 0; level < kLevelCount; ++level) {
+    for (int index = 0; index < kSlotCount; ++index) {
+      InitSlot(&slots_[level][index]);
+    }
+  }
+  memset(bitmap_, 0, sizeof(bitmap_));
+}
+
+TimingWheel::~TimingWheel() { Clear(); }
+
+void TimingWheel::AddTask(TimingTask* task, uint64_t expire_time) {
+  if (task_count_ == 0 && expire_time < current_tick_) {
+    current_tick_ = expire_time;  // 时间轮为空时重新对齐，兼容时间回退的情况
+  }
+  task->expire_time_ = expire_time;
+  task_count_++;
+  if (expire_time < current_tick_) {
+    LinkTail(&expired_, task);
+    return;
+  }
+  uint64_t span = expire_time - current_tick_;
+  if (span > kMaxTickSpan) {
+    span = kMaxTickSpan;  // 超过最大范围，先放到最上层，分配到下层时再重新计算
+  }
+  uint64_t slot_time = current_tick_ + span;
+  int level          = 0;
+  while (level + 1 < kLevelCount && (span >> (kLevelBits * (level + 1))) != 0) {
+    level++;
+  }
+  int index = static_cast<int>(slot_time >> (kLevelBits * level)) & kSlotMask;
+  LinkTail(&slots_[level][index], task);
+  if (level == 0) {
+    bitmap_[index / 64] |= static_cast<uint64_t>(1) << (index % 64);
+  }
+}
+
+void TimingWheel::RemoveTask(TimingTask* task) {
+  Unlink(task);
+  task_count_--;
+}
+
+TimingTask* TimingWheel::PopExpiredTask(uint64_t current_time) {
+  while (expired_.next_ == &expired_) {
+    if (task_count_ == 0) {
+      current_tick_ = current_time + 1;
+      return NULL;
+    }
+    if (current_tick_ > current_time) {
+      return NULL;
+    }
+    uint64_t tick = current_tick_;
+    Cascade(tick);
+    int index = static_cast<int>(tick) & kSlotMask;
+    SpliceTail(&expired_, &slots_[0][index]);
+    bitmap_[index / 64] &= ~(static_cast<uint64_t>(1) << (index % 64));
+    // 跳过第0层的空槽位，最多跳到下一圈的开始，此时需要从上层分配任务
+    uint64_t next_tick = tick - index + FindSlot(index + 1);
+    current_tick_      = next_tick <= current_time ? next_tick : current_time + 1;
+  }
+  TimingTask* task = expired_.next_;
+  Unlink(task);
+  task_count_--;
+  return task;
+}
+
+uint64_t TimingWheel::CalculateWaitTime(uint64_t current_time, uint64_t max_wait) const {
+  if (expired_.next_ != &expired_) {
+    return 0;
+  }
+  if (task_count_ == 0) {
+    return max_wait;
+  }
+  // 第0层开始新的一圈时需要先从上层分配任务，下一个任务可能就在这一刻到期
+  int index          = static_cast<int>(current_tick_) & kSlotMask;
+  uint64_t next_tick = index == 0 ? current_tick_ : current_tick_ - index + FindSlot(index);
+  if (next_tick <= current_time) {
+    return 0;
+  }
+  uint64_t wait_time = next_tick - current_time;
+  return wait_time < max_wait ? wait_time : max_wait;
+}
+
+void TimingWheel::Clear() {
+  SlotHead tasks;
+  InitSlot(&tasks);
+  SpliceTail(&tasks, &expired_);
+  for (int level = 0; level < kLevelCount; ++level) {
+    for (int index = 0; index < kSlotCount; ++index) {
+      SpliceTail(&tasks, &slots_[level][index]);
+    }
+  }
+  memset(bitmap_, 0, sizeof(bitmap_));
+  task_count_ = 0;
+  while (tasks.next_ != &tasks) {
+    TimingTask* task = tasks.next_;
+    Unlink(task);
+    delete task;
+  }
+}
+
+void TimingWheel::InitSlot(TimingTask* head) {
+  head->prev_ = head;
+  head->next_ = head;
+}
+
+void TimingWheel::LinkTail(TimingTask* head, TimingTask* task) {
+  task->prev_        = head->prev_;
+  task->next_        = head;
+  head->prev_->next_ = task;
+  head->prev_        = task;
+}
+
+void TimingWheel::Unlink(TimingTask* task) {
+  task->prev_->next_ = task->next_;
+  task->next_->prev_ = task->prev_;
+  task->prev_        = NULL;
+  task->next_        = NULL;
+}
+
+void TimingWheel::SpliceTail(TimingTask* head, TimingTask* list) {
+  if (list->next_ == list) {
+    return;
+  }
+  list->next_->prev_ = head->prev_;
+  head->prev_->next_ = list->next_;
+  list->prev_->next_ = head;
+  head->prev_        = list->prev_;
+  InitSlot(list);
+}
+
+void TimingWheel::Cascade(uint64_t tick) {
+  // 从上往下分配，上层分配下来的任务可能落在下层本次需要分配的槽位中
+  for (int level = kLevelCount - 1; level > 0; --level) {
+    uint64_t level_mask = (static_cast<uint64_t>(1) << (kLevelBits * level)) - 1;
+    if ((tick & level_mask) != 0) {
+      continue;
+    }
+    int index = static_cast<int>(tick >> (kLevelBits * level)) & kSlotMask;
+    SlotHead tasks;
+    InitSlot(&tasks);
+    SpliceTail(&tasks, &slots_[level][index]);
+    while (tasks.next_ != &tasks) {
+      TimingTask* task = tasks.next_;
+      Unlink(task);
+      task_count_--;
+      AddTask(task, task->expire_time_);
+    }
+  }
+}
+
+int TimingWheel::FindSlot(int from) const {
+  while (from < kSlotCount) {
+    uint64_t bits = bitmap_[from / 64] >> (from % 64);
+    if (bits != 0) {
+      return from + __builtin_ctzll(bits);
+    }
+    from = (from / 64 + 1) * 64;
+  }
+  return kSlotCount;
+}
+
+}  // namespace polaris
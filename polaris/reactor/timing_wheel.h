@@ -0,0 +1,80 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#ifndef POLARIS_CPP_POLARIS_REACTOR_TIMING_WHEEL_H_
+#define POLARIS_CPP_POLARIS_REACTOR_TIMING_WHEEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "reactor/task.h"
+
+namespace polaris {
+
+// 分层时间轮，以毫秒为精度管理定时任务，添加和取消任务的复杂度都是O(1)
+// 共4层，每层256个槽位：第0层每个槽位对应1ms，上层每个槽位对应下层转一圈的时间
+// 时间推进到上层槽位时，将其中的任务重新分配到下层；超过最大范围的任务先放到最上层
+class TimingWheel {
+public:
+  explicit TimingWheel(uint64_t current_time);
+  ~TimingWheel();  // 释放所有未执行的任务
+
+  // 添加任务，到期时间早于当前时间的任务会在下次取到期任务时返回
+  void AddTask(TimingTask* task, uint64_t expire_time);
+
+  // 从时间轮中摘除任务，不释放任务
+  void RemoveTask(TimingTask* task);
+
+  // 取出一个到期时间不晚于current_time的任务，没有到期任务时返回NULL
+  TimingTask* PopExpiredTask(uint64_t current_time);
+
+  // 计算距离下一个任务到期的等待时间，最多返回max_wait
+  uint64_t CalculateWaitTime(uint64_t current_time, uint64_t max_wait) const;
+
+  void Clear();  // 释放所有任务
+
+  size_t Size() const { return task_count_; }
+
+private:
+  // 槽位链表头，不会被执行
+  class SlotHead : public TimingTask {
+  public:
+    SlotHead() : TimingTask(0) {}
+    virtual void Run() {}
+  };
+
+  static void InitSlot(TimingTask* head);
+  static void LinkTail(TimingTask* head, TimingTask* task);
+  static void Unlink(TimingTask* task);
+  static void SpliceTail(TimingTask* head, TimingTask* list);  // 将list中的任务全部移到head尾部
+
+  void Cascade(uint64_t tick);  // 时间推进到tick时，将上层对应槽位中的任务分配到下层
+
+  int FindSlot(int from) const;  // 查找第0层从from开始的第一个非空槽位，没有则返回kSlotCount
+
+  static const int kLevelBits  = 8;
+  static const int kSlotCount  = 1 << kLevelBits;
+  static const int kSlotMask   = kSlotCount - 1;
+  static const int kLevelCount = 4;
+  static const int kBitmapSize = kSlotCount / 64;
+
+  uint64_t current_tick_;  // 下一个待处理的时间，之前的时间都已经处理
+  size_t task_count_;
+  SlotHead expired_;  // 已到期等待执行的任务
+  SlotHead slots_[kLevelCount][kSlotCount];
+  uint64_t bitmap_[kBitmapSize];  // 第0层非空槽位标记，取消任务可能残留空槽位的标记
+};
+
+}  // namespace polaris
+
+#endif  //  POLARIS_CPP_POLARIS_REACTOR_TIMING_WHEEL_H_
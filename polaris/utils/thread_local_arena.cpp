@@ -0,0 +1,109 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#include "utils/thread_local_arena.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#include <new>
+
+#include "logger.h"
+
+namespace polaris {
+
+static const std::size_t kArenaAlignment    = 16;
+static const std::size_t kArenaMaxBlockSize = 256;
+static const int kArenaSizeClassCount       = kArenaMaxBlockSize / kArenaAlignment;
+static const int kArenaMaxFreeBlocks        = 64;  // 每级最多缓存的内存块数
+
+struct ArenaBlock {
+  ArenaBlock* next_;
+};
+
+struct ArenaFreeLists {
+  ArenaBlock* head_[kArenaSizeClassCount];
+  int count_[kArenaSizeClassCount];
+};
+
+static __thread ArenaFreeLists* thread_local_free_lists = NULL;
+static pthread_key_t g_arena_key;
+static pthread_once_t g_arena_key_once = PTHREAD_ONCE_INIT;
+
+static void ReleaseFreeLists(void* ptr) {
+  ArenaFreeLists* free_lists = static_cast<ArenaFreeLists*>(ptr);
+  for (int i = 0; i < kArenaSizeClassCount; ++i) {
+    while (free_lists->head_[i] != NULL) {
+      ArenaBlock* block    = free_lists->head_[i];
+      free_lists->head_[i] = block->next_;
+      ::operator delete(block);
+    }
+  }
+  if (thread_local_free_lists == free_lists) {
+    thread_local_free_lists = NULL;
+  }
+  delete free_lists;
+}
+
+static void CreateArenaKey() {
+  int rc = pthread_key_create(&g_arena_key, &ReleaseFreeLists);
+  POLARIS_ASSERT(rc == 0);
+}
+
+static ArenaFreeLists* GetFreeLists() {
+  if (thread_local_free_lists == NULL) {
+    pthread_once(&g_arena_key_once, &CreateArenaKey);
+    ArenaFreeLists* free_lists = new ArenaFreeLists();
+    memset(free_lists, 0, sizeof(ArenaFreeLists));
+    pthread_setspecific(g_arena_key, free_lists);  // 线程退出时释放缓存的内存块
+    thread_local_free_lists = free_lists;
+  }
+  return thread_local_free_lists;
+}
+
+void* ThreadLocalArena::Allocate(std::size_t size) {
+  if (size == 0 || size > kArenaMaxBlockSize) {
+    return ::operator new(size);
+  }
+  int index                  = (size - 1) / kArenaAlignment;
+  ArenaFreeLists* free_lists = GetFreeLists();
+  ArenaBlock* block          = free_lists->head_[index];
+  if (block != NULL) {
+    free_lists->head_[index] = block->next_;
+    free_lists->count_[index]--;
+    return block;
+  }
+  return ::operator new((index + 1) * kArenaAlignment);
+}
+
+void ThreadLocalArena::Deallocate(void* ptr, std::size_t size) {
+  if (ptr == NULL) {
+    return;
+  }
+  if (size == 0 || size > kArenaMaxBlockSize) {
+    ::operator delete(ptr);
+    return;
+  }
+  int index                  = (size - 1) / kArenaAlignment;
+  ArenaFreeLists* free_lists = GetFreeLists();
+  if (free_lists->count_[index] >= kArenaMaxFreeBlocks) {
+    ::operator delete(ptr);
+    return;
+  }
+  ArenaBlock* block        = static_cast<ArenaBlock*>(ptr);
+  block->next_             = free_lists->head_[index];
+  free_lists->head_[index] = block;
+  free_lists->count_[index]++;
+}
+
+}  // namespace polaris
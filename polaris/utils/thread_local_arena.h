@@ -0,0 +1,34 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#ifndef POLARIS_CPP_POLARIS_UTILS_THREAD_LOCAL_ARENA_H_
+#define POLARIS_CPP_POLARIS_UTILS_THREAD_LOCAL_ARENA_H_
+
+#include <cstddef>
+
+namespace polaris {
+
+// 线程本地小对象内存池
+//
+// 释放的内存块按16字节分级缓存在释放线程中，同一线程再次分配同级大小的内存时直接复用，
+// 用于路由热路径上每次请求都会创建和销毁的小对象。每级缓存的内存块数有上限，线程退出时释放
+class ThreadLocalArena {
+public:
+  static void* Allocate(std::size_t size);
+
+  static void Deallocate(void* ptr, std::size_t size);
+};
+
+}  // namespace polaris
+
+#endif  //  POLARIS_CPP_POLARIS_UTILS_THREAD_LOCAL_ARENA_H_
@@ -106,6 +106,16 @@ void* clock_thread_update_time(void* /*arg*/) {
   return NULL;
 }
 
+uint64_t Time::GetCurrentTimeNs() {
+  timespec ts;
+  if (current_time_impl == custom_clock_current_time) {
+    clock_real_time(ts);
+  } else {
+    current_time_impl(ts);
+  }
+  return ts.tv_sec * Time::kBillionBase + ts.tv_nsec;
+}
+
 void Time::TrySetUpClock() {
 #if !defined(POLARIS_DISABLE_TIME_TICKER)  // 不使用自定义时钟
   pthread_mutex_lock(&g_custom_clock_lock);
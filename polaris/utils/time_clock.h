@@ -40,6 +40,12 @@ public:
   /// @return uint64_t
   static uint64_t GetCurrentTimeUs();
 
+  /// @brief 获取当前纳秒级时间
+  ///
+  /// 自定义时钟只有毫秒精度，启用自定义时钟时直接通过系统调用获取
+  /// @return uint64_t
+  static uint64_t GetCurrentTimeNs();
+
   /// @brief 获取某个时间减去当前时间的差值
   ///
   /// @param ts 要计算的时间
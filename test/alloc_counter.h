@@ -0,0 +1,67 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use
+//  this file
+//  except in compliance with the License. You may obtain a copy of the License
+//  at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the
+//  specific
+//  language governing permissions and limitations under the License.
+//
+
+#ifndef POLARIS_CPP_TEST_ALLOC_COUNTER_H_
+#define POLARIS_CPP_TEST_ALLOC_COUNTER_H_
+
+#include <stdlib.h>
+
+#include <new>
+
+// 替换全局operator new，统计开启计数的线程中的分配次数
+// 全局operator new只能定义一次，每个测试程序只能有一个源文件包含本文件
+
+static __thread bool g_count_alloc = false;
+static __thread int g_alloc_count  = 0;
+
+void* operator new(std::size_t size) {
+  if (g_count_alloc) {
+    g_alloc_count++;
+  }
+  void* ptr = malloc(size == 0 ? 1 : size);
+  if (ptr == NULL) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+
+void* operator new[](std::size_t size) { return operator new(size); }
+
+void operator delete[](void* ptr) noexcept { free(ptr); }
+
+namespace polaris {
+
+class AllocCounter {
+public:
+  // 开始统计当前线程的分配次数
+  static void Start() {
+    g_alloc_count = 0;
+    g_count_alloc = true;
+  }
+
+  // 停止统计并返回开始统计以来的分配次数
+  static int Stop() {
+    g_count_alloc = false;
+    return g_alloc_count;
+  }
+};
+
+}  // namespace polaris
+
+#endif  //  POLARIS_CPP_TEST_ALLOC_COUNTER_H_
@@ -0,0 +1,112 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "alloc_counter.h"
+#include "context_internal.h"
+#include "mock/fake_server_response.h"
+#include "polaris/consumer.h"
+#include "test_utils.h"
+
+namespace polaris {
+
+class ConsumerApiAllocTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    TestUtils::CreateTempDir(persist_dir_);
+    std::string err_msg, content =
+                             "global:\n"
+                             "  serverConnector:\n"
+                             "    addresses: ['Fake:42']\n"
+                             "consumer:\n"
+                             "  localCache:\n"
+                             "    persistDir: " +
+                             persist_dir_;
+    Config* config = Config::CreateFromString(content, err_msg);
+    ASSERT_TRUE(config != NULL && err_msg.empty());
+    context_ = Context::Create(config);
+    delete config;
+    ASSERT_TRUE(context_ != NULL);
+    ASSERT_TRUE((consumer_api_ = ConsumerApi::Create(context_)) != NULL);
+    service_key_.namespace_ = "cpp_test_namespace";
+    service_key_.name_      = "cpp_test_service_name_longer_than_sso";
+    ASSERT_EQ(FakeServer::InitService(context_->GetLocalRegistry(), service_key_, 10, false),
+              kReturnOk);
+  }
+
+  virtual void TearDown() {
+    AllocCounter::Stop();
+    if (consumer_api_ != NULL) {
+      delete consumer_api_;
+      consumer_api_ = NULL;
+    }
+    if (context_ != NULL) {
+      delete context_;
+      context_ = NULL;
+    }
+    TestUtils::RemoveDir(persist_dir_);
+  }
+
+protected:
+  std::string persist_dir_;
+  Context* context_;
+  ConsumerApi* consumer_api_;
+  ServiceKey service_key_;
+};
+
+TEST_F(ConsumerApiAllocTest, GetOneInstanceWithoutAlloc) {
+  GetOneInstanceRequest request(service_key_);
+  Instance instance;
+  // 预热：首次调用会创建服务上下文、路由结果缓存和线程本地对象
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_EQ(consumer_api_->GetOneInstance(request, instance), kReturnOk);
+  }
+  AllocCounter::Start();
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(consumer_api_->GetOneInstance(request, instance), kReturnOk);
+  }
+  ASSERT_EQ(AllocCounter::Stop(), 0);
+  ASSERT_FALSE(instance.GetId().empty());
+}
+
+TEST_F(ConsumerApiAllocTest, GetOneInstanceWithReusedResponse) {
+  GetOneInstanceRequest request(service_key_);
+  InstancesResponse response;
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_EQ(consumer_api_->GetOneInstance(request, response), kReturnOk);
+  }
+  AllocCounter::Start();
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(consumer_api_->GetOneInstance(request, response), kReturnOk);
+  }
+  ASSERT_EQ(AllocCounter::Stop(), 0);
+  ASSERT_EQ(response.GetInstances().size(), 1);
+  ASSERT_EQ(response.GetServiceName(), service_key_.name_);
+  ASSERT_EQ(response.GetServiceNamespace(), service_key_.namespace_);
+
+  // 应答对象复用时结果与每次创建应答对象的结果一致
+  request.SetBackupInstanceNum(2);
+  ASSERT_EQ(consumer_api_->GetOneInstance(request, response), kReturnOk);
+  InstancesResponse* new_response = NULL;
+  ASSERT_EQ(consumer_api_->GetOneInstance(request, new_response), kReturnOk);
+  ASSERT_TRUE(new_response != NULL);
+  ASSERT_EQ(response.GetInstances().size(), new_response->GetInstances().size());
+  ASSERT_EQ(response.GetRevision(), new_response->GetRevision());
+  ASSERT_EQ(response.GetMetadata(), new_response->GetMetadata());
+  delete new_response;
+}
+
+}  // namespace polaris
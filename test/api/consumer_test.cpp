@@ -19,6 +19,7 @@
 #include <gtest/gtest.h>
 #include <pthread.h>
 #include <stdint.h>
+#include <unistd.h>
 
 #include "context_internal.h"
 #include "mock/fake_server_response.h"
@@ -202,6 +203,7 @@ protected:
     service_key_.namespace_ = "cpp_test_namespace";
     instance_num_           = 10;
     instance_healthy_       = true;
+    fire_delay_             = false;
 
     v1::CircuitBreaker *cb = circuit_breaker_pb_response_.mutable_circuitbreaker();
     cb->mutable_name()->set_value("xxx");
@@ -248,6 +250,11 @@ protected:
   }
 
 public:
+  static void *DelayEventUpdate(void *args) {
+    usleep(200 * 1000);
+    return AsyncEventUpdate(args);
+  }
+
   void MockFireEventHandler(const ServiceKey &service_key, ServiceDataType data_type,
                             uint64_t /*sync_interval*/, ServiceEventHandler *handler) {
     ServiceData *service_data;
@@ -267,7 +274,7 @@ public:
     event_data->service_data_    = service_data;
     event_data->handler_         = handler;
     pthread_t tid;
-    pthread_create(&tid, NULL, AsyncEventUpdate, event_data);
+    pthread_create(&tid, NULL, fire_delay_ ? DelayEventUpdate : AsyncEventUpdate, event_data);
     handler_list_.push_back(handler);
     event_thread_list_.push_back(tid);
   }
@@ -281,6 +288,7 @@ protected:
   ServiceKey service_key_;
   int instance_num_;
   bool instance_healthy_;
+  bool fire_delay_;  // 是否延迟下发数据更新
   std::string persist_dir_;
   std::vector<pthread_t> event_thread_list_;
 };
@@ -313,6 +321,76 @@ TEST_F(ConsumerApiMockServerConnectorTest, TestGetOneInstanceRequest) {
   delete response;
 }
 
+TEST_F(ConsumerApiMockServerConnectorTest, TestBatchGetOneInstance) {
+  std::vector<GetOneInstanceRequest *> requests;
+  std::vector<Instance> instances;
+  std::vector<ReturnCode> ret_codes;
+  ASSERT_EQ(consumer_api_->BatchGetOneInstance(requests, instances, ret_codes),
+            kReturnInvalidArgument);
+
+  InitServiceData();
+  EXPECT_CALL(*server_connector_, RegisterEventHandler(::testing::Eq(service_key_), ::testing::_,
+                                                       ::testing::_, ::testing::_))
+      .Times(::testing::Exactly(2))
+      .WillRepeatedly(::testing::DoAll(
+          ::testing::Invoke(this, &ConsumerApiMockServerConnectorTest::MockFireEventHandler),
+          ::testing::Return(kReturnOk)));
+
+  ServiceKey empty_service_key;
+  GetOneInstanceRequest request(service_key_);
+  GetOneInstanceRequest same_service_request(service_key_);
+  GetOneInstanceRequest empty_service_name_request(empty_service_key);
+  requests.push_back(&request);
+  requests.push_back(&empty_service_name_request);
+  requests.push_back(&same_service_request);
+  // 部分请求失败时返回第一个失败的返回码，其他请求依然正常获取实例
+  ASSERT_EQ(consumer_api_->BatchGetOneInstance(requests, instances, ret_codes),
+            kReturnInvalidArgument);
+  ASSERT_EQ(instances.size(), requests.size());
+  ASSERT_EQ(ret_codes.size(), requests.size());
+  ASSERT_EQ(ret_codes[0], kReturnOk);
+  ASSERT_TRUE(!instances[0].GetId().empty());
+  ASSERT_EQ(ret_codes[1], kReturnInvalidArgument);
+  ASSERT_TRUE(instances[1].GetId().empty());
+  ASSERT_EQ(ret_codes[2], kReturnOk);
+  ASSERT_TRUE(!instances[2].GetId().empty());
+
+  requests.erase(requests.begin() + 1);
+  ASSERT_EQ(consumer_api_->BatchGetOneInstance(requests, instances, ret_codes), kReturnOk);
+  ASSERT_EQ(instances.size(), 2);
+  for (std::size_t i = 0; i < instances.size(); ++i) {
+    ASSERT_EQ(ret_codes[i], kReturnOk);
+    ASSERT_TRUE(!instances[i].GetId().empty());
+  }
+}
+
+TEST_F(ConsumerApiMockServerConnectorTest, TestBatchGetOneInstanceRequestTimeout) {
+  InitServiceData();
+  fire_delay_ = true;
+  EXPECT_CALL(*server_connector_, RegisterEventHandler(::testing::Eq(service_key_), ::testing::_,
+                                                       ::testing::_, ::testing::_))
+      .Times(::testing::Exactly(2))
+      .WillRepeatedly(::testing::DoAll(
+          ::testing::Invoke(this, &ConsumerApiMockServerConnectorTest::MockFireEventHandler),
+          ::testing::Return(kReturnOk)));
+
+  GetOneInstanceRequest short_timeout_request(service_key_);
+  short_timeout_request.SetTimeout(50);
+  GetOneInstanceRequest long_timeout_request(service_key_);
+  long_timeout_request.SetTimeout(2000);
+  std::vector<GetOneInstanceRequest *> requests;
+  requests.push_back(&short_timeout_request);
+  requests.push_back(&long_timeout_request);
+  std::vector<Instance> instances;
+  std::vector<ReturnCode> ret_codes;
+  // 同组请求等待到数据就绪，数据就绪晚于自身超时时间的请求返回超时
+  ASSERT_EQ(consumer_api_->BatchGetOneInstance(requests, instances, ret_codes), kReturnTimeout);
+  ASSERT_EQ(ret_codes[0], kReturnTimeout);
+  ASSERT_TRUE(instances[0].GetId().empty());
+  ASSERT_EQ(ret_codes[1], kReturnOk);
+  ASSERT_TRUE(!instances[1].GetId().empty());
+}
+
 TEST_F(ConsumerApiMockServerConnectorTest, TestGetOneInstanceTimeout) {
   EXPECT_CALL(*server_connector_, RegisterEventHandler(::testing::Eq(service_key_), ::testing::_,
                                                        ::testing::_, ::testing::_))
@@ -663,6 +741,7 @@ protected:
     service_key_.namespace_ = "cpp_test_namespace";
     instance_num_           = 10;
     instance_healthy_       = true;
+    fire_delay_             = false;
   }
 
   virtual std::string GetConfig() {
@@ -0,0 +1,129 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+
+#include "alloc_counter.h"
+#include "context_internal.h"
+#include "mock/fake_server_response.h"
+#include "polaris/limit.h"
+#include "test_utils.h"
+
+namespace polaris {
+
+class LimitApiAllocTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    TestUtils::CreateTempDir(persist_dir_);
+    std::string err_msg, content =
+                             "global:\n"
+                             "  serverConnector:\n"
+                             "    addresses: ['Fake:42']\n"
+                             "consumer:\n"
+                             "  localCache:\n"
+                             "    persistDir: " +
+                             persist_dir_ +
+                             "\n"
+                             "rateLimiter:\n"
+                             "  mode: local";
+    Config* config = Config::CreateFromString(content, err_msg);
+    ASSERT_TRUE(config != NULL && err_msg.empty());
+    context_ = Context::Create(config, kLimitContext);
+    delete config;
+    ASSERT_TRUE(context_ != NULL);
+    ASSERT_TRUE((limit_api_ = LimitApi::Create(context_)) != NULL);
+    service_key_.namespace_ = "cpp_test_namespace";
+    service_key_.name_      = "cpp_test_service_name_longer_than_sso";
+    ASSERT_EQ(InitRateLimitRule(1000000), kReturnOk);
+
+    request_.SetServiceNamespace(service_key_.namespace_);
+    request_.SetServiceName(service_key_.name_);
+    std::map<std::string, std::string> labels;
+    labels["label"] = "value_longer_than_sso_for_regex_key";
+    request_.SetLabels(labels);
+    std::map<std::string, std::string> subset;
+    subset["subset"] = "value";
+    request_.SetSubset(subset);
+  }
+
+  virtual void TearDown() {
+    AllocCounter::Stop();
+    if (limit_api_ != NULL) {
+      delete limit_api_;  // 限流模式的Context由LimitApi释放
+      limit_api_ = NULL;
+    }
+    context_ = NULL;
+    TestUtils::RemoveDir(persist_dir_);
+  }
+
+  ReturnCode InitRateLimitRule(int qps) {
+    LocalRegistry* local_registry  = context_->GetLocalRegistry();
+    ServiceDataNotify* data_notify = NULL;
+    ServiceData* service_data      = NULL;
+    ReturnCode ret_code = local_registry->LoadServiceDataWithNotify(
+        service_key_, kServiceDataRateLimit, service_data, data_notify);
+    if (ret_code != kReturnOk) {
+      return ret_code;
+    }
+    v1::DiscoverResponse response;
+    FakeServer::CreateServiceRateLimit(response, service_key_, qps);
+    service_data = ServiceData::CreateFromPb(&response, kDataIsSyncing);
+    return local_registry->UpdateServiceData(service_key_, kServiceDataRateLimit, service_data);
+  }
+
+protected:
+  std::string persist_dir_;
+  Context* context_;
+  LimitApi* limit_api_;
+  ServiceKey service_key_;
+  QuotaRequest request_;
+};
+
+TEST_F(LimitApiAllocTest, GetQuotaWithReusedResponse) {
+  QuotaResponse response;
+  // 预热：首次调用会创建限流窗口和线程本地对象
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_EQ(limit_api_->GetQuota(request_, response), kReturnOk);
+  }
+  AllocCounter::Start();
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(limit_api_->GetQuota(request_, response), kReturnOk);
+  }
+  ASSERT_EQ(AllocCounter::Stop(), 0);
+  ASSERT_EQ(response.GetResultCode(), kQuotaResultOk);
+  ASSERT_EQ(response.GetQuotaResultInfo().all_quota_, 1000000);
+  ASSERT_EQ(response.GetQuotaResultInfo().duration_, 1000);
+}
+
+TEST_F(LimitApiAllocTest, GetQuotaResultWithoutAlloc) {
+  QuotaResultCode result_code;
+  QuotaResultInfo result_info;
+  uint64_t wait_time;
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_EQ(limit_api_->GetQuota(request_, result_code), kReturnOk);
+  }
+  AllocCounter::Start();
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(limit_api_->GetQuota(request_, result_code), kReturnOk);
+    ASSERT_EQ(limit_api_->GetQuota(request_, result_code, result_info), kReturnOk);
+    ASSERT_EQ(limit_api_->GetQuota(request_, result_code, wait_time), kReturnOk);
+  }
+  ASSERT_EQ(AllocCounter::Stop(), 0);
+  ASSERT_EQ(result_code, kQuotaResultOk);
+  ASSERT_EQ(wait_time, 0);
+}
+
+}  // namespace polaris
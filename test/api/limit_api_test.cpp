@@ -267,4 +267,30 @@ TEST_F(LimitApiTest, GetQuota) {
   delete limit_api;
 }
 
+TEST_F(LimitApiTest, BatchGetQuota) {
+  CreateConfig();
+  LimitApi *limit_api = LimitApi::CreateFromConfig(config_);
+  ASSERT_TRUE(limit_api != NULL);
+  std::vector<QuotaRequest *> requests;
+  std::vector<QuotaResultCode> results;
+  uint64_t wait_time = 0;
+  ASSERT_EQ(limit_api->BatchGetQuota(requests, results, wait_time), kReturnInvalidArgument);
+
+  QuotaRequest first_request;
+  first_request.SetServiceNamespace("test");
+  first_request.SetServiceName("test.limit.service");
+  first_request.SetTimeout(100);
+  QuotaRequest second_request;
+  requests.push_back(&first_request);
+  requests.push_back(&second_request);
+  ASSERT_EQ(limit_api->BatchGetQuota(requests, results, wait_time), kReturnInvalidArgument);
+
+  requests[1] = NULL;
+  ASSERT_EQ(limit_api->BatchGetQuota(requests, results, wait_time), kReturnInvalidArgument);
+
+  requests[1] = &first_request;
+  ASSERT_EQ(limit_api->BatchGetQuota(requests, results, wait_time), kReturnTimeout);
+  delete limit_api;
+}
+
 }  // namespace polaris
@@ -0,0 +1,109 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use
+//  this file
+//  except in compliance with the License. You may obtain a copy of the License
+//  at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the
+//  specific
+//  language governing permissions and limitations under the License.
+//
+
+#include <benchmark/benchmark.h>
+
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "plugin/circuit_breaker/error_count.h"
+#include "plugin/circuit_breaker/error_rate.h"
+#include "polaris/config.h"
+#include "utils/string_utils.h"
+
+namespace polaris {
+
+// 不改变状态，只测试插件内部统计的开销
+class BenchmarkCircuitBreakerStatus : public InstancesCircuitBreakerStatus {
+public:
+  virtual bool TranslateStatus(const std::string & /*instance_id*/,
+                               CircuitBreakerStatus /*from*/, CircuitBreakerStatus /*to*/) {
+    return false;
+  }
+
+  virtual bool AutoHalfOpenEnable() { return true; }
+};
+
+// 多线程上报调用结果到熔断插件，第一个参数为实例数
+class BM_CircuitBreaker : public benchmark::Fixture {
+public:
+  void SetUp(const ::benchmark::State &state) {
+    if (state.thread_index != 0) {
+      return;
+    }
+    config_ = Config::CreateEmptyConfig();
+    error_rate_circuit_breaker_.Init(config_, NULL);
+    error_count_circuit_breaker_.Init(config_, NULL);
+    gauges_.clear();
+    for (int i = 0; i < state.range(0); ++i) {
+      InstanceGauge instance_gauge;
+      instance_gauge.service_namespace = "Production";
+      instance_gauge.service_name      = "benchmark.service";
+      instance_gauge.instance_id       = "instance_" + StringUtils::TypeToStr(i);
+      instance_gauge.call_daley        = 10;
+      gauges_.push_back(instance_gauge);
+    }
+  }
+
+  void TearDown(const ::benchmark::State &state) {
+    if (state.thread_index != 0) {
+      return;
+    }
+    delete config_;
+    config_ = NULL;
+  }
+
+  void RunCircuitBreak(benchmark::State &state, CircuitBreaker *circuit_breaker) {
+    unsigned int seed                 = state.thread_index;
+    std::vector<InstanceGauge> gauges = gauges_;  // 每个线程修改自己的副本
+    std::size_t size                  = gauges.size();
+    while (state.KeepRunning()) {
+      InstanceGauge &instance_gauge  = gauges[rand_r(&seed) % size];
+      instance_gauge.call_ret_status = rand_r(&seed) % 4 == 0 ? kCallRetError : kCallRetOk;
+      circuit_breaker->RealTimeCircuitBreak(instance_gauge, &instances_status_);
+    }
+    state.SetItemsProcessed(state.iterations());
+  }
+
+  Config *config_;
+  std::vector<InstanceGauge> gauges_;
+  BenchmarkCircuitBreakerStatus instances_status_;
+  ErrorRateCircuitBreaker error_rate_circuit_breaker_;
+  ErrorCountCircuitBreaker error_count_circuit_breaker_;
+};
+
+BENCHMARK_DEFINE_F(BM_CircuitBreaker, ErrorRate)
+(benchmark::State &state) { RunCircuitBreak(state, &error_rate_circuit_breaker_); }
+
+BENCHMARK_REGISTER_F(BM_CircuitBreaker, ErrorRate)
+    ->RangeMultiplier(10)
+    ->Range(10, 1000)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+BENCHMARK_DEFINE_F(BM_CircuitBreaker, ErrorCount)
+(benchmark::State &state) { RunCircuitBreak(state, &error_count_circuit_breaker_); }
+
+BENCHMARK_REGISTER_F(BM_CircuitBreaker, ErrorCount)
+    ->RangeMultiplier(10)
+    ->Range(10, 1000)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+}  // namespace polaris
@@ -19,6 +19,7 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "context_internal.h"
 #include "mock/fake_server_response.h"
@@ -131,6 +132,39 @@ BENCHMARK_REGISTER_F(BM_ConsumerApi, FastGetOneInstance)
     ->MinTime(10)
     ->UseRealTime();
 
+BENCHMARK_DEFINE_F(BM_ConsumerApi, GetOneInstanceResponse)
+(benchmark::State &state) {
+  if (state.thread_index == 0) {
+    InitServices(context_->GetLocalRegistry(), state);
+  }
+  ReturnCode ret_code;
+  ServiceKey service_key = {"benchmark_namespace", "benchmark_service_0"};
+  polaris::GetOneInstanceRequest request(service_key);
+  polaris::InstancesResponse reused_response;
+  polaris::InstancesResponse *response = NULL;
+  while (state.KeepRunning()) {
+    if (state.range(2) != 0) {  // 复用调用方持有的应答对象
+      ret_code = consumer_->GetOneInstance(request, reused_response);
+    } else if ((ret_code = consumer_->GetOneInstance(request, response)) == kReturnOk) {
+      delete response;
+    }
+    if (ret_code != kReturnOk) {
+      std::string err_msg = "get one instance failed:" + polaris::ReturnCodeToMsg(ret_code);
+      state.SkipWithError(err_msg.c_str());
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(BM_ConsumerApi, GetOneInstanceResponse)
+    ->Args({1, 100, 0})
+    ->Args({1, 100, 1})
+    ->ThreadRange(1, 8)
+    ->Unit(benchmark::kMicrosecond)
+    ->MinTime(2)
+    ->UseRealTime();
+
 BENCHMARK_DEFINE_F(BM_ConsumerApi, GetOneInstance)(benchmark::State &state) {
   if (state.thread_index == 0) {
     InitServices(context_->GetLocalRegistry(), state);
@@ -171,4 +205,43 @@ BENCHMARK_REGISTER_F(BM_ConsumerApi, GetOneInstance)
     ->MinTime(2)
     ->UseRealTime();
 
+
+BENCHMARK_DEFINE_F(BM_ConsumerApi, BatchGetOneInstance)(benchmark::State &state) {
+  if (state.thread_index == 0) {
+    InitServices(context_->GetLocalRegistry(), state);
+    Location location = {"华南", "深圳", "南山"};
+    context_->GetContextImpl()->GetClientLocation().Update(location);
+  }
+  // 每次批量请求所有服务各获取一个实例
+  std::vector<polaris::GetOneInstanceRequest *> requests;
+  for (int64_t i = 0; i < state.range(0); i++) {
+    ServiceKey service_key = {"benchmark_namespace",
+                              "benchmark_service_" + StringUtils::TypeToStr<int>(i)};
+    requests.push_back(new polaris::GetOneInstanceRequest(service_key));
+  }
+  ReturnCode ret_code;
+  std::vector<polaris::Instance> instances;
+  std::vector<ReturnCode> ret_codes;
+  while (state.KeepRunning()) {
+    if ((ret_code = consumer_->BatchGetOneInstance(requests, instances, ret_codes)) != kReturnOk) {
+      std::string err_msg = "batch get one instance failed:" + polaris::ReturnCodeToMsg(ret_code);
+      state.SkipWithError(err_msg.c_str());
+      break;
+    }
+  }
+  for (std::size_t i = 0; i < requests.size(); ++i) {
+    delete requests[i];
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_REGISTER_F(BM_ConsumerApi, BatchGetOneInstance)
+    ->ArgPair(10, 100)
+    ->ArgPair(50, 100)
+    ->ArgPair(100, 100)
+    ->ThreadRange(1, 8)
+    ->Unit(benchmark::kMicrosecond)
+    ->MinTime(2)
+    ->UseRealTime();
+
 }  // namespace polaris
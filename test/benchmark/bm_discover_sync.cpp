@@ -0,0 +1,109 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use
+//  this file
+//  except in compliance with the License. You may obtain a copy of the License
+//  at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the
+//  specific
+//  language governing permissions and limitations under the License.
+//
+
+#include <benchmark/benchmark.h>
+
+#include <unistd.h>
+
+#include <string>
+
+#include "benchmark/context_fixture.h"
+#include "mock/fake_discover_server.h"
+#include "plugin/server_connector/server_connector.h"
+#include "sync/atomic.h"
+#include "utils/string_utils.h"
+
+namespace polaris {
+
+class SyncCountEventHandler : public ServiceEventHandler {
+public:
+  explicit SyncCountEventHandler(sync::Atomic<int> &update_count) : update_count_(update_count) {}
+
+  virtual void OnEventUpdate(const ServiceKey & /*service_key*/, ServiceDataType /*data_type*/,
+                             void *data) {
+    if (data != NULL) {
+      reinterpret_cast<ServiceData *>(data)->DecrementRef();
+      update_count_++;
+    }
+  }
+
+  virtual void OnEventSync(const ServiceKey & /*service_key*/, ServiceDataType /*data_type*/) {}
+
+private:
+  sync::Atomic<int> &update_count_;
+};
+
+// 从建立连接到所有服务完成首次同步的耗时，参数为服务数
+class BM_DiscoverSync : public ContextFixture {
+public:
+  BM_DiscoverSync() { context_mode_ = kShareContextWithoutEngine; }
+
+  virtual void SetUp(::benchmark::State &state) {
+    ContextFixture::SetUp(state);
+    if (!discover_server_.Start()) {
+      state.SkipWithError("start fake discover server failed");
+    }
+  }
+
+  virtual void TearDown(::benchmark::State &state) {
+    discover_server_.Stop();
+    ContextFixture::TearDown(state);
+  }
+
+protected:
+  FakeDiscoverServer discover_server_;
+};
+
+BENCHMARK_DEFINE_F(BM_DiscoverSync, ConnectToSynced)
+(benchmark::State &state) {
+  std::string err_msg, content = "addresses: [127.0.0.1:" +
+                                 StringUtils::TypeToStr(discover_server_.GetPort()) + "]";
+  Config *config      = Config::CreateFromString(content, err_msg);
+  int service_count   = state.range(0);
+  int start_frames    = discover_server_.GetDataFrameCount();
+  while (state.KeepRunning()) {
+    state.PauseTiming();
+    GrpcServerConnector *connector = new GrpcServerConnector();
+    sync::Atomic<int> update_count;
+    for (int i = 0; i < service_count; ++i) {
+      ServiceKey service_key = {"benchmark", "service_" + StringUtils::TypeToStr(i)};
+      connector->RegisterEventHandler(service_key, kServiceDataInstances, 60 * 1000,
+                                      new SyncCountEventHandler(update_count));
+    }
+    state.ResumeTiming();
+    connector->Init(config, context_);
+    while (update_count < service_count) {
+      usleep(100);
+    }
+    state.PauseTiming();
+    delete connector;
+    state.ResumeTiming();
+  }
+  delete config;
+  state.counters["DataFrames"] = benchmark::Counter(
+      discover_server_.GetDataFrameCount() - start_frames, benchmark::Counter::kAvgIterations);
+  state.SetItemsProcessed(state.iterations() * service_count);
+}
+
+BENCHMARK_REGISTER_F(BM_DiscoverSync, ConnectToSynced)
+    ->Arg(100)
+    ->Arg(1000)
+    ->Arg(5000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+}  // namespace polaris
@@ -0,0 +1,104 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include "grpc/buffer.h"
+#include "grpc/codec.h"
+#include "utils/string_utils.h"
+#include "v1/response.pb.h"
+#include "v1/service.pb.h"
+
+namespace polaris {
+namespace grpc {
+
+// 构造心跳大小的请求，用于测试小消息的编解码
+static void BuildInstance(v1::Instance& instance) {
+  instance.mutable_service()->set_value("benchmark_service");
+  instance.mutable_namespace_()->set_value("Test");
+  instance.mutable_host()->set_value("127.0.0.1");
+  instance.mutable_port()->set_value(8080);
+  instance.mutable_service_token()->set_value("service_token_for_benchmark");
+}
+
+// 每个消息单独创建Buffer序列化，模拟上报类请求的发送
+static void BM_EncodeFrame(benchmark::State& state) {
+  v1::Instance instance;
+  BuildInstance(instance);
+  Buffer send_buffer;
+  while (state.KeepRunning()) {
+    Buffer* frame = GrpcCodec::SerializeToGrpcFrame(instance);
+    send_buffer.Move(*frame);
+    delete frame;
+    send_buffer.Drain(send_buffer.Length());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EncodeFrame)->ThreadRange(1, 8)->UseRealTime();
+
+// 序列化到复用的Buffer，模拟流上连续发送请求
+static void BM_EncodeFrameReuseBuffer(benchmark::State& state) {
+  v1::Instance instance;
+  BuildInstance(instance);
+  Buffer frame_buffer;
+  Buffer send_buffer;
+  while (state.KeepRunning()) {
+    GrpcCodec::SerializeToGrpcFrame(instance, frame_buffer);
+    send_buffer.Move(frame_buffer);
+    send_buffer.Drain(send_buffer.Length());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EncodeFrameReuseBuffer)->ThreadRange(1, 8)->UseRealTime();
+
+// 从接收缓冲区中解码出range(0)个服务发现应答并反序列化
+static void BM_DecodeFrame(benchmark::State& state) {
+  v1::DiscoverResponse response;
+  response.set_type(v1::DiscoverResponse::INSTANCE);
+  response.mutable_service()->mutable_namespace_()->set_value("Test");
+  for (int i = 0; i < 10; ++i) {
+    v1::Instance* instance = response.add_instances();
+    BuildInstance(*instance);
+    instance->mutable_port()->set_value(8000 + i);
+  }
+  const int kMessageCount = state.range(0);
+  Buffer frames;
+  for (int i = 0; i < kMessageCount; ++i) {
+    response.mutable_service()->mutable_name()->set_value("service" + StringUtils::TypeToStr(i));
+    GrpcCodec::SerializeToGrpcFrame(response, frames);
+  }
+  std::vector<RawSlice> slices(frames.GetRawSlices(NULL, 0));
+  frames.GetRawSlices(&slices[0], slices.size());
+  GrpcDecoder decoder;
+  std::vector<LengthPrefixedMessage*> output;
+  while (state.KeepRunning()) {
+    Buffer input;
+    for (std::size_t i = 0; i < slices.size(); ++i) {
+      input.Add(slices[i].mem_, slices[i].len_);  // 模拟从连接读取数据
+    }
+    decoder.Decode(input, output);
+    for (std::size_t i = 0; i < output.size(); ++i) {
+      v1::DiscoverResponse decode_response;
+      GrpcCodec::ParseBufferToMessage(output[i]->ReleaseData(), decode_response);
+    }
+    GrpcDecoder::FreeMessages(output);
+  }
+  state.SetItemsProcessed(state.iterations() * kMessageCount);
+}
+BENCHMARK(BM_DecodeFrame)->Arg(1)->Arg(100)->ThreadRange(1, 8)->UseRealTime();
+
+}  // namespace grpc
+}  // namespace polaris
@@ -0,0 +1,225 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use
+//  this file
+//  except in compliance with the License. You may obtain a copy of the License
+//  at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the
+//  specific
+//  language governing permissions and limitations under the License.
+//
+
+#include <benchmark/benchmark.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "plugin/health_checker/probe_event.h"
+#include "plugin/health_checker/tcp_detector.h"
+#include "polaris/config.h"
+#include "polaris/model.h"
+#include "reactor/reactor.h"
+#include "utils/netclient.h"
+
+namespace polaris {
+
+// 监听多个端口的本地服务，收到数据后应答OK并关闭连接
+class MultiPortServer {
+public:
+  explicit MultiPortServer(int port_count) : stop_(false), tid_(0) {
+    epoll_fd_ = epoll_create(1024);
+    for (int i = 0; i < port_count; ++i) {
+      int fd = NetClient::CreateTcpSocket(true);
+      sockaddr_in addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family      = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      addr.sin_port        = 0;
+      socklen_t len        = sizeof(addr);
+      if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(fd, 1024) < 0 ||
+          getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len) < 0) {
+        close(fd);
+        continue;
+      }
+      listen_fds_.insert(fd);
+      ports_.push_back(ntohs(addr.sin_port));
+      AddFd(fd);
+    }
+    pthread_create(&tid_, NULL, Run, this);
+  }
+
+  ~MultiPortServer() {
+    stop_ = true;
+    pthread_join(tid_, NULL);
+    for (std::set<int>::iterator it = listen_fds_.begin(); it != listen_fds_.end(); ++it) {
+      close(*it);
+    }
+    close(epoll_fd_);
+  }
+
+  const std::vector<int> &GetPorts() const { return ports_; }
+
+private:
+  void AddFd(int fd) {
+    epoll_event event;
+    event.data.fd = fd;
+    event.events  = EPOLLIN;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+  }
+
+  static void *Run(void *arg) {
+    MultiPortServer *server = static_cast<MultiPortServer *>(arg);
+    epoll_event events[256];
+    char buffer[512];
+    while (!server->stop_) {
+      int count = epoll_wait(server->epoll_fd_, events, 256, 10);
+      for (int i = 0; i < count; ++i) {
+        int fd = events[i].data.fd;
+        if (server->listen_fds_.count(fd) > 0) {
+          int conn_fd;
+          while ((conn_fd = accept(fd, NULL, NULL)) >= 0) {
+            NetClient::SetNonBlock(conn_fd);
+            server->AddFd(conn_fd);
+          }
+          continue;
+        }
+        if (recv(fd, buffer, sizeof(buffer), 0) > 0) {
+          send(fd, "OK", 2, MSG_NOSIGNAL);
+        }
+        epoll_ctl(server->epoll_fd_, EPOLL_CTL_DEL, fd, NULL);
+        close(fd);
+      }
+    }
+    return NULL;
+  }
+
+private:
+  volatile bool stop_;
+  pthread_t tid_;
+  int epoll_fd_;
+  std::set<int> listen_fds_;
+  std::vector<int> ports_;
+};
+
+class CountDetectCallback : public DetectCallback {
+public:
+  CountDetectCallback() : done_count_(0), success_count_(0) {}
+
+  virtual void OnDetectDone(const DetectResult &detect_result) {
+    done_count_++;
+    if (detect_result.return_code == kReturnOk) {
+      success_count_++;
+    }
+  }
+
+  int done_count_;
+  int success_count_;
+};
+
+class BM_HealthCheck : public benchmark::Fixture {
+public:
+  void SetUp(const ::benchmark::State &state) {
+    server_ = new MultiPortServer(state.range(0));
+    std::string err_msg, content =
+                             "send:\n  0x12345678\n"
+                             "receive:\n  0x4f4b\n"  // 0x4f4b为OK的二进制表示
+                             "timeout:\n  1000";
+    Config *config = Config::CreateFromString(content, err_msg);
+    tcp_checker_.Init(config, NULL);
+    delete config;
+    const std::vector<int> &ports = server_->GetPorts();
+    for (std::size_t i = 0; i < ports.size(); ++i) {
+      instances_.push_back(new Instance("instance", "127.0.0.1", ports[i], 100));
+    }
+  }
+
+  void TearDown(const ::benchmark::State & /*state*/) {
+    for (std::size_t i = 0; i < instances_.size(); ++i) {
+      delete instances_[i];
+    }
+    instances_.clear();
+    delete server_;
+  }
+
+protected:
+  MultiPortServer *server_;
+  TcpHealthChecker tcp_checker_;
+  std::vector<Instance *> instances_;
+};
+
+// 逐个实例阻塞探测
+BENCHMARK_DEFINE_F(BM_HealthCheck, BlockingDetect)
+(benchmark::State &state) {
+  int success_count = 0;
+  while (state.KeepRunning()) {
+    for (std::size_t i = 0; i < instances_.size(); ++i) {
+      DetectResult detect_result;
+      if (tcp_checker_.DetectInstance(*instances_[i], detect_result) == kReturnOk) {
+        success_count++;
+      }
+    }
+  }
+  if (success_count != static_cast<int>(state.iterations() * instances_.size())) {
+    state.SkipWithError("detect failed");
+  }
+  state.SetItemsProcessed(state.iterations() * instances_.size());
+}
+
+BENCHMARK_REGISTER_F(BM_HealthCheck, BlockingDetect)
+    ->Arg(64)
+    ->Arg(256)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// 在reactor中并发探测，第二个参数为同时进行的探测数上限
+BENCHMARK_DEFINE_F(BM_HealthCheck, ReactorDetect)
+(benchmark::State &state) {
+  Reactor reactor;
+  int max_in_flight = state.range(1);
+  int success_count = 0;
+  while (state.KeepRunning()) {
+    CountDetectCallback callback;
+    int total       = static_cast<int>(instances_.size());
+    int start_count = 0;
+    while (callback.done_count_ < total) {
+      while (start_count < total && start_count - callback.done_count_ < max_in_flight) {
+        Instance *instance = instances_[start_count++];
+        ProbeEvent *probe  = new ProbeEvent(reactor, &tcp_checker_, &callback);
+        probe->Start(instance->GetHost(), instance->GetPort());
+      }
+      reactor.RunOnce();
+    }
+    reactor.RunOnce();  // 释放探测对象
+    success_count += callback.success_count_;
+  }
+  reactor.Stop();
+  if (success_count != static_cast<int>(state.iterations() * instances_.size())) {
+    state.SkipWithError("detect failed");
+  }
+  state.SetItemsProcessed(state.iterations() * instances_.size());
+}
+
+BENCHMARK_REGISTER_F(BM_HealthCheck, ReactorDetect)
+    ->Args({64, 16})
+    ->Args({64, 64})
+    ->Args({256, 16})
+    ->Args({256, 256})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+}  // namespace polaris
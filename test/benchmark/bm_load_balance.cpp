@@ -17,6 +17,9 @@
 
 #include <benchmark/benchmark.h>
 
+#include <algorithm>
+#include <vector>
+
 #include "plugin/load_balancer/hash/hash_manager.h"
 #include "plugin/load_balancer/maglev/maglev.h"
 #include "plugin/load_balancer/maglev/maglev_entry_selector.h"
@@ -25,11 +28,13 @@
 #include "plugin/load_balancer/weighted_random.h"
 #include "polaris/context.h"
 #include "utils/string_utils.h"
+#include "utils/utils.h"
 #include "v1/response.pb.h"
 
 namespace polaris {
 
-static ServiceData *CreateService(int instance_num, const ServiceKey &service_key) {
+static ServiceData *CreateService(int instance_num, const ServiceKey &service_key,
+                                  bool random_weight = false) {
   v1::DiscoverResponse response;
   response.set_type(v1::DiscoverResponse::INSTANCE);
   v1::Service *service = response.mutable_service();
@@ -43,7 +48,7 @@ static ServiceData *CreateService(int instance_num, const ServiceKey &service_ke
     instance->mutable_service()->set_value(service_key.name_);
     instance->mutable_host()->set_value("host" + StringUtils::TypeToStr<int>(i));
     instance->mutable_port()->set_value(i);
-    instance->mutable_weight()->set_value(100);
+    instance->mutable_weight()->set_value(random_weight ? 1 + rand() % 200 : 100);
   }
   return ServiceData::CreateFromPb(&response, kDataInitFromDisk);
 }
@@ -128,6 +133,86 @@ BENCHMARK_REGISTER_F(BM_LoadBalance, RandomLB)
     ->MinTime(2)
     ->UseRealTime();
 
+// 对比前缀和二分查找与别名表两种加权随机选择方式，实例权重随机
+class BM_WeightedRandomSelect : public benchmark::Fixture {
+public:
+  struct CumulativeWeight {
+    int weight_;
+    int index_;
+
+    bool operator<(const CumulativeWeight &rhs) const { return this->weight_ < rhs.weight_; }
+  };
+
+  void SetUp(const ::benchmark::State &state) {
+    if (state.thread_index != 0) {
+      return;
+    }
+    ServiceKey service_key    = {"benchmark_namespace", "benchmark_service"};
+    ServiceData *service_data = CreateService(state.range(0), service_key, true);
+    service_instances_        = new ServiceInstances(service_data);
+    service_                  = new Service(service_key, 0);
+    service_->UpdateData(service_data);
+    InstancesSet *instances_set              = service_instances_->GetAvailableInstances();
+    const std::vector<Instance *> &instances = instances_set->GetInstances();
+    sum_weight_                              = 0;
+    cumulative_weights_.clear();
+    for (std::size_t i = 0; i < instances.size(); ++i) {
+      sum_weight_ += instances[i]->GetWeight();
+      CumulativeWeight cumulative_weight = {sum_weight_, static_cast<int>(i)};
+      cumulative_weights_.push_back(cumulative_weight);
+    }
+    selector_ = new AliasSelector();
+    selector_->Setup(service_instances_, instances_set, false);
+  }
+
+  void TearDown(const ::benchmark::State &state) {
+    if (state.thread_index != 0) {
+      return;
+    }
+    delete selector_;
+    delete service_instances_;
+    delete service_;
+  }
+
+  Service *service_;
+  ServiceInstances *service_instances_;
+  int sum_weight_;
+  std::vector<CumulativeWeight> cumulative_weights_;
+  AliasSelector *selector_;
+};
+
+BENCHMARK_DEFINE_F(BM_WeightedRandomSelect, CumulativeWeight)(benchmark::State &state) {
+  unsigned int seed = time(NULL) ^ state.thread_index;
+  while (state.KeepRunning()) {
+    CumulativeWeight random_weight = {rand_r(&seed) % sum_weight_, 0};
+    benchmark::DoNotOptimize(std::upper_bound(cumulative_weights_.begin(),
+                                              cumulative_weights_.end(), random_weight)
+                                 ->index_);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(BM_WeightedRandomSelect, CumulativeWeight)
+    ->ThreadRange(1, 8)
+    ->RangeMultiplier(10)
+    ->Range(10, 10000)
+    ->UseRealTime();
+
+BENCHMARK_DEFINE_F(BM_WeightedRandomSelect, AliasTable)(benchmark::State &state) {
+  unsigned int seed = time(NULL) ^ state.thread_index;
+  while (state.KeepRunning()) {
+    uint32_t column_random = rand_r(&seed);
+    benchmark::DoNotOptimize(selector_->Select(column_random, rand_r(&seed)));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(BM_WeightedRandomSelect, AliasTable)
+    ->ThreadRange(1, 8)
+    ->RangeMultiplier(10)
+    ->Range(10, 10000)
+    ->UseRealTime();
+
 class BM_LBSimple : public benchmark::Fixture {
 public:
   void SetUp(const ::benchmark::State &state) {
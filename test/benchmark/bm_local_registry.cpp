@@ -142,7 +142,7 @@ BENCHMARK_DEFINE_F(BM_LocalRegistry, GetServiceData)(benchmark::State &state) {
 BENCHMARK_REGISTER_F(BM_LocalRegistry, GetServiceData)
     ->ThreadRange(1, 8)
     ->RangeMultiplier(10)
-    ->Range(1, 10)
+    ->Range(1, 1000)
     ->UseRealTime();
 
 }  // namespace polaris
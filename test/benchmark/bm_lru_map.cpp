@@ -21,6 +21,7 @@
 #include <string>
 
 #include "cache/lru_map.h"
+#include "cache/rcu_hash_map.h"
 #include "utils/scoped_ptr.h"
 
 namespace polaris {
@@ -60,7 +61,54 @@ BENCHMARK_DEFINE_F(BM_LruMap, TestUpdate)
 }
 
 BENCHMARK_REGISTER_F(BM_LruMap, TestUpdate)
-    ->ThreadRange(1, 8)
+    ->ThreadRange(1, 64)
+    ->Unit(benchmark::kMicrosecond)
+    ->MinTime(1)
+    ->UseRealTime();
+
+// 读无锁的采样LRU，与上面加锁的LruHashMap使用相同的读写比例
+class BM_SampledLruMap : public benchmark::Fixture {
+public:
+  void SetUp(const ::benchmark::State &state) {
+    if (state.thread_index == 0) {
+      capacity_ = 8096;
+      lru_map_.Set(new RcuHashMap<int, int, MurmurInt32>(ValueNoOp, ValueDelete));
+      lru_map_->SetCapacity(capacity_);
+    }
+  }
+
+  void TearDown(const ::benchmark::State &state) {
+    if (state.thread_index == 0) {
+      return;
+    }
+  }
+
+  int capacity_;
+  ScopedPtr<RcuHashMap<int, int, MurmurInt32> > lru_map_;
+};
+
+BENCHMARK_DEFINE_F(BM_SampledLruMap, TestUpdate)
+(benchmark::State &state) {
+  unsigned int seed = state.thread_index;
+  uint64_t count    = 0;
+  while (state.KeepRunning()) {
+    int key = rand_r(&seed) % 4000;
+    int op  = rand_r(&seed) % 10;
+    if (op == 0) {
+      int *value = new int(key);
+      lru_map_->Update(key, value);
+    } else {
+      lru_map_->Get(key);
+    }
+    if (state.thread_index == 0 && ++count % 1024 == 0) {  // 释放一秒前淘汰的数据
+      lru_map_->CheckGc(Time::GetCurrentTimeMs() - 1000);
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(BM_SampledLruMap, TestUpdate)
+    ->ThreadRange(1, 64)
     ->Unit(benchmark::kMicrosecond)
     ->MinTime(1)
     ->UseRealTime();
@@ -20,12 +20,20 @@
 #include <iostream>
 
 #include "polaris/limit.h"
+#include "quota/quota_bucket_qps.h"
+#include "quota/quota_bucket_sliding_window.h"
+#include "quota/service_rate_limiter.h"
 #include "utils/string_utils.h"
+#include "utils/time_clock.h"
 
 // 本文件用于限流API的性能测试，包括以下方面的测试：
 //   - LimitApi获取配额接口QPS测试
+//   - 多个标签逐个获取配额与批量获取配额的性能对比
 //   - 程序调用LimitAPI获取配额QPS损失
 //   - 规则数量对获取配额QPS的影响
+//   - 正则规则数量对获取配额QPS的影响
+//   - 令牌桶共享计数和分段计数模式下线程数对划扣配额QPS的影响
+//   - 匀速排队模式下高QPS规则多线程获取配额的性能
 
 namespace polaris {
 
@@ -71,7 +79,8 @@ public:
     return ContextFixture::LoadData(response);
   }
 
-  ReturnCode InitServiceData(const ServiceKey &service_key, int uin_count) {
+  ReturnCode InitServiceData(const ServiceKey &service_key, int uin_count,
+                             v1::MatchString::MatchStringType match_type = v1::MatchString::EXACT) {
     v1::DiscoverResponse response;
     response.mutable_code()->set_value(v1::ExecuteSuccess);
     response.set_type(v1::DiscoverResponse::RATE_LIMIT);
@@ -88,8 +97,12 @@ public:
       rule->mutable_service()->set_value(service_key.name_);
       rule->set_type(v1::Rule::LOCAL);
       v1::MatchString match_string;
-      match_string.set_type(v1::MatchString::EXACT);
-      match_string.mutable_value()->set_value(StringUtils::TypeToStr(123456789 + i));
+      match_string.set_type(match_type);
+      if (match_type == v1::MatchString::REGEX) {
+        match_string.mutable_value()->set_value("^" + StringUtils::TypeToStr(123456789 + i) + "$");
+      } else {
+        match_string.mutable_value()->set_value(StringUtils::TypeToStr(123456789 + i));
+      }
       (*rule->mutable_labels())["uin"] = match_string;
       v1::Amount *amount               = rule->add_amounts();
       amount->mutable_maxamount()->set_value(100000);
@@ -147,6 +160,67 @@ BENCHMARK_REGISTER_F(BM_RateLimit, GetQuotaQps)
     ->MinTime(10)
     ->UseRealTime();
 
+// 测试一次请求检查多个标签的限流时，逐个获取配额和批量获取配额的性能
+BENCHMARK_DEFINE_F(BM_RateLimit, GetQuotaMultiLabel)(benchmark::State &state) {
+  ReturnCode ret_code;
+  if (state.thread_index == 0) {
+    if ((ret_code = InitServiceData(service_key_)) != kReturnOk) {
+      std::string err_msg = "init service failed:" + ReturnCodeToMsg(ret_code);
+      state.SkipWithError(err_msg.c_str());
+    }
+  }
+  const int kLabelCount = state.range(0);
+  std::vector<QuotaRequest> requests(kLabelCount);
+  std::vector<QuotaRequest *> request_list;
+  std::map<std::string, std::string> subset;
+  subset.insert(std::make_pair("subset", "value"));
+  for (int i = 0; i < kLabelCount; ++i) {  // 正则规则下每个标签值对应一个限流窗口
+    requests[i].SetServiceNamespace(service_key_.namespace_);
+    requests[i].SetServiceName(service_key_.name_);
+    std::map<std::string, std::string> labels;
+    labels.insert(std::make_pair("label", "value" + StringUtils::TypeToStr(i)));
+    requests[i].SetLabels(labels);
+    requests[i].SetSubset(subset);
+    request_list.push_back(&requests[i]);
+  }
+  QuotaResultCode quota_result;
+  std::vector<QuotaResultCode> quota_results;
+  uint64_t wait_time;
+  while (state.KeepRunning()) {
+    if (state.range(1) == 1) {
+      ret_code     = limit_api_->BatchGetQuota(request_list, quota_results, wait_time);
+      quota_result = quota_results[0];
+    } else {
+      for (int i = 0; i < kLabelCount; ++i) {
+        if ((ret_code = limit_api_->GetQuota(requests[i], quota_result)) != kReturnOk ||
+            quota_result != kQuotaResultOk) {
+          break;
+        }
+      }
+    }
+    if (ret_code != kReturnOk) {
+      std::string err_msg = "get quota failed:" + ReturnCodeToMsg(ret_code);
+      state.SkipWithError(err_msg.c_str());
+      break;
+    }
+    if (quota_result != kQuotaResultOk) {
+      state.SkipWithError("quota limited");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(BM_RateLimit, GetQuotaMultiLabel)
+    ->ArgNames({"label_num", "batch_flag"})
+    ->Args({3, 0})
+    ->Args({3, 1})
+    ->Args({8, 0})
+    ->Args({8, 1})
+    ->ThreadRange(1, 8)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
 // 测试LimitApi给业务程序带来的性能损失
 BENCHMARK_DEFINE_F(BM_RateLimit, GetQuotaQpsLoss)(benchmark::State &state) {
   ReturnCode ret_code;
@@ -251,4 +325,206 @@ BENCHMARK_REGISTER_F(BM_RateLimit, LimitRuleMatch)
     ->MinTime(10)
     ->UseRealTime();
 
+// 测试不同数量的正则规则对限流API的性能影响
+BENCHMARK_DEFINE_F(BM_RateLimit, LimitRegexRuleMatch)(benchmark::State &state) {
+  int uin_count = state.range(0);
+  ReturnCode ret_code;
+  if (state.thread_index == 0) {
+    if ((ret_code = InitServiceData(service_key_, uin_count, v1::MatchString::REGEX)) !=
+        kReturnOk) {
+      std::string err_msg = "init service failed:" + ReturnCodeToMsg(ret_code);
+      state.SkipWithError(err_msg.c_str());
+    }
+  }
+
+  while (state.KeepRunning()) {
+    QuotaRequest request;
+    request.SetServiceNamespace(service_key_.namespace_);
+    request.SetServiceName(service_key_.name_);
+    std::map<std::string, std::string> labels;
+    labels.insert(std::make_pair("uin", StringUtils::TypeToStr(123456789 + rand() % uin_count)));
+    request.SetLabels(labels);
+    QuotaResultCode quota_result;
+    if ((ret_code = limit_api_->GetQuota(request, quota_result)) != kReturnOk) {
+      std::string err_msg = "get quota failed:" + ReturnCodeToMsg(ret_code);
+      state.SkipWithError(err_msg.c_str());
+      break;
+    }
+    if (quota_result == kQuotaResultLimited) {
+      state.SkipWithError("quota limited");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(BM_RateLimit, LimitRegexRuleMatch)
+    ->ArgName("rule_num")
+    ->Arg(10)
+    ->Arg(50)
+    ->Arg(100)
+    ->Arg(500)
+    ->Arg(1000)
+    ->Unit(benchmark::kMicrosecond)
+    ->MinTime(10)
+    ->UseRealTime();
+
+class BM_TokenBucket : public ::benchmark::Fixture {
+public:
+  void SetUp(::benchmark::State &state) {
+    if (state.thread_index != 0) return;
+
+    RateLimitAmount amount;
+    amount.max_amount_     = 4000000000U;  // 测试期间不会用完配额
+    amount.valid_duration_ = 1000 * 1000;
+    uint64_t current_time  = Time::GetCurrentTimeMs();
+    bucket_time_           = current_time / amount.valid_duration_;
+    token_bucket_          = new TokenBucket();
+    token_bucket_->Init(amount, current_time, amount.max_amount_, state.range(0));
+  }
+
+  void TearDown(::benchmark::State &state) {
+    if (state.thread_index != 0) return;
+
+    delete token_bucket_;
+    token_bucket_ = NULL;
+  }
+
+protected:
+  TokenBucket *token_bucket_;
+  uint64_t bucket_time_;
+};
+
+// 测试令牌桶在共享计数和分段计数模式下多线程划扣配额的扩展性
+BENCHMARK_DEFINE_F(BM_TokenBucket, GetToken)(benchmark::State &state) {
+  int64_t left_quota;
+  while (state.KeepRunning()) {
+    if (!token_bucket_->GetToken(1, bucket_time_, false, left_quota)) {
+      state.SkipWithError("quota limited");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(BM_TokenBucket, GetToken)
+    ->ArgName("stripe_num")
+    ->Arg(0)
+    ->Arg(64)
+    ->Threads(1)
+    ->Threads(2)
+    ->Threads(4)
+    ->Threads(8)
+    ->Threads(16)
+    ->Threads(32)
+    ->Threads(64)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+class BM_UnirateBucket : public ::benchmark::Fixture {
+public:
+  void SetUp(::benchmark::State &state) {
+    if (state.thread_index != 0) return;
+
+    v1::Rule rule;
+    v1::Amount *amount = rule.add_amounts();
+    amount->mutable_maxamount()->set_value(state.range(0));
+    amount->mutable_validduration()->set_seconds(1);
+    rate_limit_rule_ = new RateLimitRule();
+    rate_limit_rule_->Init(rule);
+    UnirateServiceRateLimiter limiter;
+    quota_bucket_ = NULL;
+    limiter.InitQuotaBucket(rate_limit_rule_, quota_bucket_);
+  }
+
+  void TearDown(::benchmark::State &state) {
+    if (state.thread_index != 0) return;
+
+    delete quota_bucket_;
+    quota_bucket_ = NULL;
+    delete rate_limit_rule_;
+    rate_limit_rule_ = NULL;
+  }
+
+protected:
+  RateLimitRule *rate_limit_rule_;
+  QuotaBucket *quota_bucket_;
+};
+
+// 测试匀速排队在多线程高QPS下获取配额的扩展性，超过排队时间的请求被拒绝
+BENCHMARK_DEFINE_F(BM_UnirateBucket, GetQuota)(benchmark::State &state) {
+  int64_t ok_count = 0;
+  while (state.KeepRunning()) {
+    if (quota_bucket_->GetQuota(1).result_code_ == kQuotaResultOk) {
+      ok_count++;
+    }
+  }
+  state.counters["ok"] = benchmark::Counter(ok_count, benchmark::Counter::kIsRate);
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(BM_UnirateBucket, GetQuota)
+    ->ArgName("max_qps")
+    ->Arg(100000)
+    ->Arg(10000000)
+    ->Threads(1)
+    ->Threads(4)
+    ->Threads(16)
+    ->Threads(64)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
+class BM_RemoteAwareBucket : public ::benchmark::Fixture {
+public:
+  void SetUp(::benchmark::State &state) {
+    if (state.thread_index != 0) return;
+
+    v1::Rule rule;
+    v1::Amount *amount = rule.add_amounts();
+    amount->mutable_maxamount()->set_value(4000000000U);  // 测试期间不会用完配额
+    amount->mutable_validduration()->set_seconds(1);
+    rate_limit_rule_ = new RateLimitRule();
+    rate_limit_rule_->Init(rule);
+    if (state.range(0) == 0) {
+      bucket_ = new RemoteAwareQpsBucket(rate_limit_rule_);
+    } else {
+      bucket_ = new RemoteAwareSlidingWindowBucket(rate_limit_rule_);
+    }
+  }
+
+  void TearDown(::benchmark::State &state) {
+    if (state.thread_index != 0) return;
+
+    delete bucket_;
+    bucket_ = NULL;
+    delete rate_limit_rule_;
+    rate_limit_rule_ = NULL;
+  }
+
+protected:
+  RateLimitRule *rate_limit_rule_;
+  RemoteAwareBucket *bucket_;
+};
+
+// 对比固定窗口和滑动窗口在多线程下分配配额的开销
+BENCHMARK_DEFINE_F(BM_RemoteAwareBucket, Allocate)(benchmark::State &state) {
+  LimitAllocateResult limit_result;
+  QuotaResultInfo info;
+  while (state.KeepRunning()) {
+    bucket_->Allocate(1, Time::GetCurrentTimeMs(), info, &limit_result);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(BM_RemoteAwareBucket, Allocate)
+    ->ArgName("sliding_window")
+    ->Arg(0)
+    ->Arg(1)
+    ->Threads(1)
+    ->Threads(4)
+    ->Threads(16)
+    ->Threads(64)
+    ->Unit(benchmark::kMicrosecond)
+    ->UseRealTime();
+
 }  // namespace polaris
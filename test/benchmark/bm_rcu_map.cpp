@@ -0,0 +1,95 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use
+//  this file
+//  except in compliance with the License. You may obtain a copy of the License
+//  at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the
+//  specific
+//  language governing permissions and limitations under the License.
+//
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include "cache/lru_map.h"
+#include "cache/rcu_hash_map.h"
+#include "cache/rcu_map.h"
+#include "utils/scoped_ptr.h"
+#include "utils/string_utils.h"
+
+namespace polaris {
+
+// 对比std::map和开放寻址哈希表作为内部map时，RcuMap在不同key数量下的查询性能
+template <typename Map>
+class BM_RcuMapBase : public benchmark::Fixture {
+public:
+  void SetUp(const ::benchmark::State &state) {
+    if (state.thread_index != 0) {
+      return;
+    }
+    int key_count = state.range(0);
+    keys_.clear();
+    for (int i = 0; i < key_count; ++i) {
+      ServiceKey service_key = {"Production", "benchmark.service." + StringUtils::TypeToStr(i)};
+      keys_.push_back(service_key);
+    }
+    rcu_map_.Set(new Map(ValueNoOp, ValueDelete));
+    for (std::size_t i = 0; i < keys_.size(); ++i) {
+      rcu_map_->Update(keys_[i], new int(i));
+    }
+    for (std::size_t i = 0; i < keys_.size(); ++i) {  // 促使dirty map交换成read map
+      rcu_map_->Get(keys_[i]);
+    }
+  }
+
+  void TearDown(const ::benchmark::State &state) {
+    if (state.thread_index != 0) {
+      return;
+    }
+    rcu_map_.Reset(NULL);
+  }
+
+  void RunGet(benchmark::State &state) {
+    unsigned int seed = state.thread_index;
+    std::size_t size  = keys_.size();
+    while (state.KeepRunning()) {
+      benchmark::DoNotOptimize(rcu_map_->Get(keys_[rand_r(&seed) % size], false));
+    }
+    state.SetItemsProcessed(state.iterations());
+  }
+
+  std::vector<ServiceKey> keys_;
+  ScopedPtr<Map> rcu_map_;
+};
+
+typedef RcuMap<ServiceKey, int> ServiceKeyTreeMap;
+typedef RcuHashMap<ServiceKey, int, MurmurServiceKey> ServiceKeyHashMap;
+
+BENCHMARK_TEMPLATE_DEFINE_F(BM_RcuMapBase, TreeMapGet, ServiceKeyTreeMap)
+(benchmark::State &state) { RunGet(state); }
+
+BENCHMARK_TEMPLATE_DEFINE_F(BM_RcuMapBase, HashMapGet, ServiceKeyHashMap)
+(benchmark::State &state) { RunGet(state); }
+
+BENCHMARK_REGISTER_F(BM_RcuMapBase, TreeMapGet)
+    ->RangeMultiplier(10)
+    ->Range(10, 100000)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+BENCHMARK_REGISTER_F(BM_RcuMapBase, HashMapGet)
+    ->RangeMultiplier(10)
+    ->Range(10, 100000)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+}  // namespace polaris
@@ -0,0 +1,109 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#include <benchmark/benchmark.h>
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "reactor/reactor.h"
+
+namespace polaris {
+
+static void EmptyTimingFunc(Reactor* /*reactor*/) {}
+
+// 预先添加range(0)个定时任务，测试在此基础上添加并取消定时任务的耗时
+class BM_ReactorTimer : public benchmark::Fixture {
+public:
+  void SetUp(const ::benchmark::State& state) {
+    reactor_ = new Reactor();
+    reactor_->RunOnce();  // 进入运行状态才能取消任务
+    for (int i = 0; i < state.range(0); ++i) {
+      reactor_->AddTimingTask(NewTask(rand() % 3600000));
+    }
+  }
+
+  void TearDown(const ::benchmark::State& /*state*/) {
+    reactor_->Stop();
+    delete reactor_;
+  }
+
+  TimingTask* NewTask(uint64_t interval) {
+    return new TimingFuncTask<Reactor>(EmptyTimingFunc, reactor_, interval);
+  }
+
+protected:
+  Reactor* reactor_;
+};
+
+// 模拟请求超时检查：添加后很快被取消
+BENCHMARK_DEFINE_F(BM_ReactorTimer, AddAndCancel)
+(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    TimingTaskIter iter = reactor_->AddTimingTask(NewTask(1000 + rand() % 60000));
+    reactor_->CancelTimingTask(iter);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(BM_ReactorTimer, AddAndCancel)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kNanosecond);
+
+// 批量添加任务后随机顺序取消
+BENCHMARK_DEFINE_F(BM_ReactorTimer, BatchAddAndCancel)
+(benchmark::State& state) {
+  const int kBatchSize = 1024;
+  std::vector<TimingTaskIter> iters(kBatchSize);
+  while (state.KeepRunning()) {
+    for (int i = 0; i < kBatchSize; ++i) {
+      iters[i] = reactor_->AddTimingTask(NewTask(rand() % 3600000));
+    }
+    for (int i = kBatchSize - 1; i > 0; --i) {
+      std::swap(iters[i], iters[rand() % (i + 1)]);
+    }
+    for (int i = 0; i < kBatchSize; ++i) {
+      reactor_->CancelTimingTask(iters[i]);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+
+BENCHMARK_REGISTER_F(BM_ReactorTimer, BatchAddAndCancel)
+    ->Arg(1000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMicrosecond);
+
+// 到期任务的执行：每轮添加一批立即到期的任务并执行
+BENCHMARK_DEFINE_F(BM_ReactorTimer, RunExpired)
+(benchmark::State& state) {
+  const int kBatchSize = 1024;
+  while (state.KeepRunning()) {
+    for (int i = 0; i < kBatchSize; ++i) {
+      reactor_->AddTimingTask(NewTask(0));
+    }
+    reactor_->RunOnce();
+  }
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+
+BENCHMARK_REGISTER_F(BM_ReactorTimer, RunExpired)
+    ->Arg(1000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMicrosecond);
+
+}  // namespace polaris
@@ -0,0 +1,83 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use
+//  this file
+//  except in compliance with the License. You may obtain a copy of the License
+//  at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the
+//  specific
+//  language governing permissions and limitations under the License.
+//
+
+#include <benchmark/benchmark.h>
+
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "plugin/stat_reporter/stat_reporter.h"
+#include "utils/string_utils.h"
+
+namespace polaris {
+
+// 多线程上报调用结果，第一个参数为实例数
+class BM_StatReporter : public benchmark::Fixture {
+public:
+  void SetUp(const ::benchmark::State &state) {
+    if (state.thread_index != 0) {
+      return;
+    }
+    stat_reporter_ = new MonitorStatReporter();
+    gauges_.clear();
+    for (int i = 0; i < state.range(0); ++i) {
+      InstanceGauge instance_gauge;
+      instance_gauge.service_namespace = "Production";
+      instance_gauge.service_name      = "benchmark.service." + StringUtils::TypeToStr(i % 10);
+      instance_gauge.instance_id       = "instance_" + StringUtils::TypeToStr(i);
+      instance_gauge.call_daley        = 10;
+      gauges_.push_back(instance_gauge);
+    }
+  }
+
+  void TearDown(const ::benchmark::State &state) {
+    if (state.thread_index != 0) {
+      return;
+    }
+    std::map<ServiceKey, ServiceStat> report_data;
+    stat_reporter_->CollectData(report_data);
+    delete stat_reporter_;
+    stat_reporter_ = NULL;
+  }
+
+  std::vector<InstanceGauge> gauges_;
+  MonitorStatReporter *stat_reporter_;
+};
+
+BENCHMARK_DEFINE_F(BM_StatReporter, ReportStat)
+(benchmark::State &state) {
+  unsigned int seed                  = state.thread_index;
+  std::vector<InstanceGauge> gauges = gauges_;  // 每个线程修改自己的副本
+  std::size_t size                  = gauges.size();
+  while (state.KeepRunning()) {
+    InstanceGauge &instance_gauge = gauges[rand_r(&seed) % size];
+    instance_gauge.call_ret_code   = rand_r(&seed) % 4;
+    instance_gauge.call_ret_status = instance_gauge.call_ret_code == 0 ? kCallRetOk : kCallRetError;
+    stat_reporter_->ReportStat(instance_gauge);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_REGISTER_F(BM_StatReporter, ReportStat)
+    ->RangeMultiplier(10)
+    ->Range(10, 1000)
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+}  // namespace polaris
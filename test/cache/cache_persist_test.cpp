@@ -17,6 +17,7 @@
 
 #include "cache/cache_persist.h"
 
+#include <google/protobuf/util/json_util.h>
 #include <gtest/gtest.h>
 
 #include <fstream>
@@ -26,6 +27,7 @@
 
 #include "cache/persist_task.h"
 #include "mock/fake_server_response.h"
+#include "model/model_impl.h"
 #include "reactor/reactor.h"
 #include "test_utils.h"
 #include "utils/file_utils.h"
@@ -177,6 +179,32 @@ TEST_F(CachePersistTest, PersistAndLoad) {
   delete load_location;
 }
 
+TEST_F(CachePersistTest, PersistServiceDataWithLazyJson) {
+  ServiceKey service_key = {"test", "test.cache.lazy"};
+  v1::DiscoverResponse response;
+  response.set_type(v1::DiscoverResponse::CIRCUIT_BREAKER);
+  response.mutable_service()->mutable_namespace_()->set_value(service_key.namespace_);
+  response.mutable_service()->mutable_name()->set_value(service_key.name_);
+  response.mutable_circuitbreaker()->mutable_name()->set_value("lazy_circuit_breaker");
+  std::string expect_json;
+  google::protobuf::util::MessageToJsonString(response, &expect_json);
+  // 解析时熔断配置会从response中转移走，json需要与解析前的数据一致
+  ServiceData *service_data = ServiceData::CreateFromPb(&response, kDataIsSyncing);
+  ASSERT_TRUE(service_data != NULL);
+  cache_persist->PersistServiceData(service_data);
+  reactor_.RunOnce();
+  ASSERT_EQ(service_data->ToJsonString(), expect_json);
+  service_data->DecrementRef();
+
+  ServiceData *disk_service_data =
+      cache_persist->LoadServiceData(service_key, kCircuitBreakerConfig);
+  ASSERT_TRUE(disk_service_data != NULL);
+  ASSERT_EQ(disk_service_data->ToJsonString(), expect_json);
+  ASSERT_EQ(disk_service_data->GetServiceDataImpl()->GetCircuitBreaker()->name().value(),
+            "lazy_circuit_breaker");
+  disk_service_data->DecrementRef();
+}
+
 struct ThreadArg {
   pthread_t tid;
   std::string file;
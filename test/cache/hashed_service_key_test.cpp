@@ -0,0 +1,67 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#include "cache/hashed_service_key.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "cache/lru_map.h"
+#include "cache/rcu_hash_map.h"
+#include "utils/string_utils.h"
+
+namespace polaris {
+
+TEST(HashedServiceKeyTest, SetAndCompare) {
+  ServiceKey service_key = {"hashed_namespace", "hashed_service"};
+  HashedServiceKey hashed_key;
+  SetHashedServiceKey(hashed_key, service_key);
+  ASSERT_EQ(hashed_key.service_key_, service_key);
+  ASSERT_EQ(hashed_key.hash_, MurmurServiceKey(service_key));
+  ASSERT_EQ(HashedServiceKeyHash(hashed_key), hashed_key.hash_);
+
+  // 线程本地的查询key与独立创建的key相等
+  ASSERT_TRUE(ThreadLocalHashedServiceKey(service_key) == hashed_key);
+  ServiceKey other_key = {service_key.name_, service_key.namespace_};
+  ASSERT_FALSE(ThreadLocalHashedServiceKey(other_key) == hashed_key);
+}
+
+struct HashedKeyValue {
+  void IncrementRef() {}
+  void DecrementRef() {}
+};
+
+TEST(HashedServiceKeyTest, UseInRcuHashMap) {
+  RcuHashMap<HashedServiceKey, HashedKeyValue, HashedServiceKeyHash> rcu_map;
+  HashedKeyValue values[100];
+  for (int i = 0; i < 100; ++i) {
+    ServiceKey service_key = {"hashed_namespace", "service_" + StringUtils::TypeToStr(i)};
+    HashedServiceKey hashed_key;
+    SetHashedServiceKey(hashed_key, service_key);
+    rcu_map.Update(hashed_key, &values[i]);
+  }
+  for (int i = 0; i < 100; ++i) {
+    ServiceKey service_key = {"hashed_namespace", "service_" + StringUtils::TypeToStr(i)};
+    ASSERT_EQ(rcu_map.Get(ThreadLocalHashedServiceKey(service_key)), &values[i]);
+  }
+  ServiceKey service_key = {"hashed_namespace", "service_not_exist"};
+  ASSERT_TRUE(rcu_map.Get(ThreadLocalHashedServiceKey(service_key)) == NULL);
+
+  // 删除后key随表项释放
+  ServiceKey deleted_key = {"hashed_namespace", "service_0"};
+  rcu_map.Delete(ThreadLocalHashedServiceKey(deleted_key));
+  ASSERT_TRUE(rcu_map.Get(ThreadLocalHashedServiceKey(deleted_key)) == NULL);
+}
+
+}  // namespace polaris
@@ -0,0 +1,271 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use
+//  this file
+//  except in compliance with the License. You may obtain a copy of the License
+//  at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the
+//  specific
+//  language governing permissions and limitations under the License.
+//
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <pthread.h>
+
+#include <map>
+
+#include "cache/flat_hash_map.h"
+#include "cache/lru_map.h"
+#include "cache/rcu_hash_map.h"
+#include "cache/rcu_time.h"
+
+#include "test_utils.h"
+
+#include "polaris/model.h"
+
+namespace polaris {
+
+// 所有key都冲突的哈希函数，用于测试探测链和删除后移
+static uint32_t ConflictHash(const int& /*key*/) { return 7; }
+
+TEST(FlatHashMapTest, InsertFindErase) {
+  FlatHashMap<int, int, MurmurInt32> flat_map;
+  std::map<int, int> std_map;
+  for (int i = 0; i < 10000; ++i) {
+    int key = rand() % 2000;
+    if (i % 3 == 0) {
+      ASSERT_EQ(flat_map.erase(key), std_map.erase(key));
+    } else {
+      flat_map[key] = i;
+      std_map[key]  = i;
+    }
+    ASSERT_EQ(flat_map.size(), std_map.size());
+  }
+  for (std::map<int, int>::iterator it = std_map.begin(); it != std_map.end(); ++it) {
+    FlatHashMap<int, int, MurmurInt32>::iterator flat_it = flat_map.find(it->first);
+    ASSERT_TRUE(flat_it != flat_map.end());
+    ASSERT_EQ(flat_it->second, it->second);
+  }
+  std::size_t count = 0;
+  for (FlatHashMap<int, int, MurmurInt32>::iterator it = flat_map.begin(); it != flat_map.end();
+       ++it) {
+    ASSERT_EQ(std_map[it->first], it->second);
+    count++;
+  }
+  ASSERT_EQ(count, std_map.size());
+
+  FlatHashMap<int, int, MurmurInt32> copy_map(flat_map);
+  ASSERT_EQ(copy_map.size(), flat_map.size());
+  for (std::map<int, int>::iterator it = std_map.begin(); it != std_map.end(); ++it) {
+    ASSERT_TRUE(copy_map.find(it->first) != copy_map.end());
+  }
+}
+
+TEST(FlatHashMapTest, EraseWithConflict) {
+  FlatHashMap<int, int, ConflictHash> flat_map;
+  for (int i = 0; i < 100; ++i) {
+    flat_map[i] = i;
+  }
+  for (int i = 0; i < 100; i += 2) {
+    flat_map.erase(flat_map.find(i));
+  }
+  ASSERT_EQ(flat_map.size(), 50);
+  for (int i = 0; i < 100; ++i) {
+    FlatHashMap<int, int, ConflictHash>::iterator it = flat_map.find(i);
+    if (i % 2 == 0) {
+      ASSERT_TRUE(it == flat_map.end());
+    } else {
+      ASSERT_TRUE(it != flat_map.end());
+      ASSERT_EQ(it->second, i);
+    }
+  }
+}
+
+class ServiceKeyValue : public ServiceBase {
+public:
+  explicit ServiceKeyValue(int value) { value_ = value; }
+
+  virtual ~ServiceKeyValue() {}
+
+  int GetValue() { return value_; }
+
+private:
+  int value_;
+};
+
+class RcuHashMapTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    rcu_map_ = new RcuHashMap<ServiceKey, ServiceKeyValue, MurmurServiceKey>();
+  }
+
+  virtual void TearDown() {
+    if (rcu_map_ != NULL) {
+      delete rcu_map_;
+      rcu_map_ = NULL;
+    }
+  }
+
+  static ServiceKey MakeKey(int i) {
+    ServiceKey service_key = {"Test", "service_" + StringUtils::TypeToStr(i)};
+    return service_key;
+  }
+
+protected:
+  RcuHashMap<ServiceKey, ServiceKeyValue, MurmurServiceKey> *rcu_map_;
+};
+
+TEST_F(RcuHashMapTest, SingleThreadTest) {
+  ASSERT_TRUE(rcu_map_->Get(MakeKey(0)) == NULL);
+  for (int i = 0; i < 100; ++i) {
+    ServiceKey key = MakeKey(i);
+    rcu_map_->Update(key, new ServiceKeyValue(i));
+    for (int j = 0; j < i; j++) {
+      if (j % 2 == 0) {
+        rcu_map_->Delete(key);
+        ASSERT_TRUE(rcu_map_->Get(key) == NULL);
+        rcu_map_->Update(key, new ServiceKeyValue(j));
+      } else {
+        rcu_map_->Update(key, new ServiceKeyValue(i - 1));
+      }
+      ServiceKeyValue *value = rcu_map_->Get(key);
+      ASSERT_TRUE(value != NULL);
+      ASSERT_EQ(value->GetValue(), j % 2 == 0 ? j : i - 1);
+      value->DecrementRef();
+    }
+    rcu_map_->CheckGc(Time::GetCurrentTimeMs());
+  }
+
+  std::vector<ServiceKey> expired_keys;
+  rcu_map_->CheckExpired(Time::GetCurrentTimeMs() + 1, expired_keys);
+  ASSERT_EQ(expired_keys.size(), 100);
+
+  ServiceKeyValue *value = new ServiceKeyValue(0);
+  ServiceKeyValue *old   = rcu_map_->PutIfAbsent(MakeKey(0), value);
+  ASSERT_TRUE(old != NULL);
+  value->DecrementRef();
+  value = new ServiceKeyValue(0);
+  ASSERT_TRUE(rcu_map_->PutIfAbsent(MakeKey(100), value) == NULL);
+}
+
+TEST(RcuHashMapCapacityTest, EvictLeastRecentlyUsed) {
+  TestUtils::SetUpFakeTime();
+  RcuHashMap<int, int, MurmurInt32> rcu_map(ValueNoOp, ValueDelete);
+  const int capacity = 100;
+  rcu_map.SetCapacity(capacity);
+  for (int i = 0; i < capacity; ++i) {
+    rcu_map.Update(i, new int(i));
+    TestUtils::FakeNowIncrement(1);
+  }
+  // 访问前一半key，后一半key成为最久未访问的key
+  for (int i = 0; i < capacity / 2; ++i) {
+    ASSERT_TRUE(rcu_map.Get(i) != NULL);
+  }
+  TestUtils::FakeNowIncrement(1);
+  for (int i = capacity; i < capacity + capacity / 2; ++i) {
+    rcu_map.Update(i, new int(i));
+  }
+  std::vector<int*> values;
+  rcu_map.GetAllValuesWithRef(values);
+  ASSERT_EQ(values.size(), static_cast<std::size_t>(capacity));
+  int recent_count = 0;
+  for (int i = 0; i < capacity / 2; ++i) {
+    if (rcu_map.Get(i) != NULL) {
+      recent_count++;
+    }
+  }
+  // 采样淘汰是近似LRU，最近访问过的key大部分应该被保留
+  ASSERT_GT(recent_count, capacity / 4);
+  for (int i = capacity; i < capacity + capacity / 2; ++i) {
+    ASSERT_TRUE(rcu_map.Get(i) != NULL);
+  }
+  TestUtils::FakeNowIncrement(1);
+  rcu_map.CheckGc(Time::GetCurrentTimeMs());
+  TestUtils::TearDownFakeTime();
+}
+
+TEST(RcuHashMapCapacityTest, NotEvictInsertedKey) {
+  TestUtils::SetUpFakeTime();
+  RcuHashMap<int, int, MurmurInt32> rcu_map(ValueNoOp, ValueDelete);
+  rcu_map.SetCapacity(4);
+  // 通过基类接口插入同样触发淘汰
+  RcuMap<int, int, FlatHashMap<int, RcuMapValue<int>*, MurmurInt32> >& base_map = rcu_map;
+  for (int i = 0; i < 100; ++i) {  // 访问时间相同时也不能淘汰刚插入的key
+    if (i % 2 == 0) {
+      base_map.Update(i, new int(i));
+    } else {
+      ASSERT_TRUE(base_map.PutIfAbsent(i, new int(i)) == NULL);
+    }
+    ASSERT_TRUE(rcu_map.Get(i) != NULL) << i;
+  }
+  std::vector<int*> values;
+  rcu_map.GetAllValuesWithRef(values);
+  ASSERT_EQ(values.size(), 4);
+  TestUtils::FakeNowIncrement(1);
+  rcu_map.CheckGc(Time::GetCurrentTimeMs());
+  TestUtils::TearDownFakeTime();
+}
+
+struct HashThreadArgs {
+  RcuHashMap<ServiceKey, ServiceKeyValue, MurmurServiceKey> *cache_;
+  ThreadTimeMgr *thread_time_mgr_;
+  std::vector<ServiceKey> *keys_;
+};
+
+void *RandomOperationHashCache(void *args) {
+  HashThreadArgs *thread_args = static_cast<HashThreadArgs *>(args);
+  int cache_num               = static_cast<int>(thread_args->keys_->size());
+  int total                   = cache_num * 5000;
+  unsigned int seed           = time(NULL) ^ pthread_self();
+  for (int i = 0; i < total; ++i) {
+    int key_index = i % cache_num;
+    ServiceKey &key = (*thread_args->keys_)[key_index];
+    int op          = rand_r(&seed) % 6;
+    if (op == 0 || op == 2 || op == 4) {
+      thread_args->thread_time_mgr_->RcuEnter();
+      ServiceKeyValue *value = thread_args->cache_->Get(key);
+      if (value != NULL) {
+        EXPECT_EQ(value->GetValue() % cache_num, key_index);
+        value->DecrementRef();
+      }
+      thread_args->thread_time_mgr_->RcuExit();
+    } else if (op == 1 || op == 3) {
+      thread_args->cache_->Update(key, new ServiceKeyValue(i));
+    } else {
+      thread_args->cache_->Delete(key);
+    }
+    if (key_index == 0) {
+      thread_args->cache_->CheckGc(thread_args->thread_time_mgr_->MinTime());
+    }
+  }
+  return NULL;
+}
+
+TEST_F(RcuHashMapTest, MultiThreadTest) {
+  ThreadTimeMgr *thread_time_mgr = new ThreadTimeMgr();
+  std::vector<ServiceKey> keys;
+  for (int i = 0; i < 100; ++i) {
+    keys.push_back(MakeKey(i));
+  }
+  HashThreadArgs thread_args = {rcu_map_, thread_time_mgr, &keys};
+  std::vector<pthread_t> thread_list;
+  pthread_t tid;
+  for (int i = 0; i < 16; ++i) {
+    pthread_create(&tid, NULL, RandomOperationHashCache, &thread_args);
+    thread_list.push_back(tid);
+  }
+  for (std::size_t i = 0; i < thread_list.size(); ++i) {
+    pthread_join(thread_list[i], NULL);
+  }
+  delete thread_time_mgr;
+}
+
+}  // namespace polaris
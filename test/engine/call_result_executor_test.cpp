@@ -0,0 +1,150 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use
+//  this file
+//  except in compliance with the License. You may obtain a copy of the License
+//  at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the
+//  specific
+//  language governing permissions and limitations under the License.
+//
+
+#include "engine/call_result_executor.h"
+
+#include <gtest/gtest.h>
+#include <pthread.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "plugin/stat_reporter/stat_reporter.h"
+#include "test_context.h"
+#include "utils/string_utils.h"
+
+namespace polaris {
+
+TEST(CallResultRingTest, PushAndConsume) {
+  CallResultRing ring(5);  // 容量取整为8
+  InstanceGauge gauge;
+  gauge.service_namespace = "namespace";
+  gauge.service_name      = "service";
+  gauge.labels_["key"]    = "value";
+  for (int i = 0; i < 8; ++i) {
+    gauge.instance_id = "instance_" + StringUtils::TypeToStr<int>(i);
+    ASSERT_TRUE(ring.Push(gauge));
+  }
+  ASSERT_FALSE(ring.Push(gauge));
+  ASSERT_EQ(ring.ReadBegin(), 0);
+  ASSERT_EQ(ring.ReadEnd(), 8);
+  ASSERT_EQ(ring.At(0).labels_.size(), 1);  // map交换到队列中
+  for (uint64_t i = ring.ReadBegin(); i < ring.ReadEnd(); ++i) {
+    ASSERT_EQ(ring.At(i).instance_id, "instance_" + StringUtils::TypeToStr<int>(i));
+  }
+  ring.Consume(4);
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_TRUE(ring.Push(gauge));
+  }
+  ASSERT_FALSE(ring.Push(gauge));
+  ASSERT_EQ(ring.ReadBegin(), 4);
+  ASSERT_EQ(ring.ReadEnd(), 12);
+}
+
+class CallResultExecutorTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    context_ = TestContext::CreateContext();
+    ASSERT_TRUE(context_ != NULL);
+    executor_ = new CallResultExecutor(context_);
+  }
+
+  virtual void TearDown() {
+    delete executor_;
+    delete context_;
+  }
+
+  static void *EnqueueFunc(void *arg) {
+    CallResultExecutor *executor = static_cast<CallResultExecutor *>(arg);
+    InstanceGauge gauge;
+    for (int i = 0; i < 100; ++i) {
+      gauge.service_namespace = "namespace";
+      gauge.service_name      = "service_" + StringUtils::TypeToStr<int>(i % 2);
+      gauge.instance_id       = "instance_" + StringUtils::TypeToStr<int>(i % 4);
+      gauge.call_daley        = 10;
+      gauge.call_ret_status   = kCallRetOk;
+      EXPECT_TRUE(executor->Enqueue(gauge));
+    }
+    return NULL;
+  }
+
+protected:
+  Context *context_;
+  CallResultExecutor *executor_;
+};
+
+TEST_F(CallResultExecutorTest, DrainMultiThread) {
+  std::vector<pthread_t> thread_list;
+  for (int i = 0; i < 4; ++i) {
+    pthread_t tid;
+    pthread_create(&tid, NULL, EnqueueFunc, executor_);
+    thread_list.push_back(tid);
+  }
+  for (std::size_t i = 0; i < thread_list.size(); ++i) {
+    pthread_join(thread_list[i], NULL);
+  }
+  EnqueueFunc(executor_);
+  executor_->Drain();
+  // 调用结果在后台批量处理后进入统计插件
+  MonitorStatReporter *stat_reporter =
+      dynamic_cast<MonitorStatReporter *>(context_->GetContextImpl()->GetStatReporter());
+  ASSERT_TRUE(stat_reporter != NULL);
+  std::map<ServiceKey, ServiceStat> report_data;
+  stat_reporter->CollectData(report_data);
+  // 统计数据中还包含上下文访问服务端的调用结果，只检查测试服务
+  for (int i = 0; i < 2; ++i) {
+    ServiceKey service_key = {"namespace", "service_" + StringUtils::TypeToStr<int>(i)};
+    ASSERT_EQ(report_data.count(service_key), 1);
+    ServiceStat& service_stat = report_data[service_key];
+    ASSERT_EQ(service_stat.size(), 2);
+    for (ServiceStat::iterator it = service_stat.begin(); it != service_stat.end(); ++it) {
+      ASSERT_EQ(it->second.ret_code_stat_[0].success_count_, 5 * 25);
+    }
+  }
+  // 数据已处理完，再次处理不会重复统计
+  executor_->Drain();
+  report_data.clear();
+  stat_reporter->CollectData(report_data);
+  for (int i = 0; i < 2; ++i) {
+    ServiceKey service_key = {"namespace", "service_" + StringUtils::TypeToStr<int>(i)};
+    ASSERT_EQ(report_data.count(service_key), 0);
+  }
+}
+
+TEST_F(CallResultExecutorTest, DrainWhenStop) {
+  ASSERT_EQ(executor_->Start(), kReturnOk);
+  EnqueueFunc(executor_);
+  // 停止时处理线程退出后仍会处理队列中剩余的调用结果
+  ASSERT_EQ(executor_->StopAndWait(), kReturnOk);
+  MonitorStatReporter *stat_reporter =
+      dynamic_cast<MonitorStatReporter *>(context_->GetContextImpl()->GetStatReporter());
+  ASSERT_TRUE(stat_reporter != NULL);
+  std::map<ServiceKey, ServiceStat> report_data;
+  stat_reporter->CollectData(report_data);
+  for (int i = 0; i < 2; ++i) {
+    ServiceKey service_key = {"namespace", "service_" + StringUtils::TypeToStr<int>(i)};
+    ASSERT_EQ(report_data.count(service_key), 1);
+    ServiceStat &service_stat = report_data[service_key];
+    ASSERT_EQ(service_stat.size(), 2);
+    for (ServiceStat::iterator it = service_stat.begin(); it != service_stat.end(); ++it) {
+      ASSERT_EQ(it->second.ret_code_stat_[0].success_count_, 25);
+    }
+  }
+}
+
+}  // namespace polaris
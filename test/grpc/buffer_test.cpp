@@ -52,6 +52,28 @@ TEST(GrpcBufferTest, CreateSlice) {
   slice->Release();
 }
 
+TEST(GrpcBufferTest, SliceCache) {
+  Slice *slice     = Slice::Create(16);
+  uint64_t size    = slice->ReservableSize();
+  Slice *old_slice = slice;
+  slice->Append("ABCD", 4);
+  slice->Release();
+  slice = Slice::Create(size);  // 相同规格的Slice从线程缓存中复用
+  ASSERT_EQ(slice, old_slice);
+  ASSERT_EQ(slice->DataSize(), 0);
+  ASSERT_EQ(slice->ReservableSize(), size);
+  slice->Release();
+
+  slice = Slice::Create(3 * 4096);  // 按页数向上取2的幂
+  ASSERT_GE(slice->ReservableSize(), 3 * 4096);
+  ASSERT_LT(slice->ReservableSize(), 4 * 4096);
+  slice->Release();
+
+  slice = Slice::Create(1024 * 1024);  // 超过最大规格的Slice不缓存
+  ASSERT_GE(slice->ReservableSize(), 1024 * 1024);
+  slice->Release();
+}
+
 TEST(GrpcBufferTest, SliceOperate) {
   Slice *slice = Slice::Create(16);
   ASSERT_TRUE(slice != NULL);
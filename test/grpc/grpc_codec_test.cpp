@@ -33,17 +33,17 @@ TEST(GrpcCodecTest, EncodeAndDecode) {
   ASSERT_TRUE(buffer != NULL);
 
   GrpcDecoder decoder;
-  std::vector<LengthPrefixedMessage> decode_result;
+  std::vector<LengthPrefixedMessage*> decode_result;
   ASSERT_TRUE(decoder.Decode(*buffer, decode_result));
   delete buffer;
   ASSERT_EQ(decode_result.size(), 1);
-  LengthPrefixedMessage& prefixed_message = decode_result[0];
-  ASSERT_EQ(prefixed_message.flags_, 0);
-  ASSERT_EQ(prefixed_message.length_, prefixed_message.data_->Length());
+  LengthPrefixedMessage* prefixed_message = decode_result[0];
+  ASSERT_EQ(prefixed_message->flags_, 0);
+  ASSERT_EQ(prefixed_message->length_, prefixed_message->data_->Length());
 
   v1::DiscoverResponse decode_response;
-  ASSERT_TRUE(GrpcCodec::ParseBufferToMessage(prefixed_message.data_, decode_response));
-  prefixed_message.data_ = NULL;
+  ASSERT_TRUE(GrpcCodec::ParseBufferToMessage(prefixed_message->ReleaseData(), decode_response));
+  GrpcDecoder::FreeMessages(decode_result);
   ASSERT_EQ(decode_response.service().namespace_().value(),
             response.service().namespace_().value());
   ASSERT_EQ(decode_response.service().name().value(), response.service().name().value());
@@ -62,13 +62,14 @@ uint8_t* BufferSetLength(Buffer& buffer, int len) {
 TEST(GrpcCodecTest, TestErrorFlag) {
   Buffer buffer;
   uint8_t* current = BufferSetLength(buffer, 1);
-  std::vector<LengthPrefixedMessage> output;
+  std::vector<LengthPrefixedMessage*> output;
   const uint8_t kUint8Max = 0xffu;
   for (uint8_t i = 1; i < (uint8_t)2; i++) {  // 压缩标记正确
     *current = i;
     GrpcDecoder decoder;
     ASSERT_TRUE(decoder.Decode(buffer, output));
   }
+  GrpcDecoder::FreeMessages(output);
   for (uint8_t i = 2; i < kUint8Max; i++) {  // 压缩标记错误
     *current = i;
     GrpcDecoder decoder;
@@ -84,11 +85,56 @@ TEST(GrpcCodecTest, TestNotAllMessage) {
     const uint32_t network_size = htonl(i);
     memcpy(current, reinterpret_cast<const void*>(&network_size), sizeof(uint32_t));
     GrpcDecoder decoder;
-    std::vector<LengthPrefixedMessage> output;
+    std::vector<LengthPrefixedMessage*> output;
     ASSERT_TRUE(decoder.Decode(buffer, output));
     ASSERT_EQ(output.size(), i == 0 ? 1 : 0);  // i为0时，message长度为0，足够解析
+    GrpcDecoder::FreeMessages(output);
   }
 }
 
+TEST(GrpcCodecTest, TestDecodeMultiMessage) {
+  Buffer buffer;
+  const int kMessageCount = 100;
+  for (int i = 0; i < kMessageCount; ++i) {
+    v1::DiscoverResponse response;
+    response.mutable_service()->mutable_name()->set_value("service" + StringUtils::TypeToStr(i));
+    Buffer* frame = GrpcCodec::SerializeToGrpcFrame(response);
+    ASSERT_TRUE(frame != NULL);
+    buffer.Move(*frame);
+    delete frame;
+  }
+  GrpcDecoder decoder;
+  std::vector<LengthPrefixedMessage*> output;
+  ASSERT_TRUE(decoder.Decode(buffer, output));  // 一次解码出多个消息
+  ASSERT_EQ(output.size(), kMessageCount);
+  for (int i = 0; i < kMessageCount; ++i) {
+    v1::DiscoverResponse response;
+    ASSERT_TRUE(GrpcCodec::ParseBufferToMessage(output[i]->ReleaseData(), response));
+    ASSERT_EQ(response.service().name().value(), "service" + StringUtils::TypeToStr(i));
+  }
+  GrpcDecoder::FreeMessages(output);
+}
+
+TEST(GrpcCodecTest, TestSerializeToBuffer) {
+  Buffer buffer;
+  const int kMessageCount = 10;
+  for (int i = 0; i < kMessageCount; ++i) {
+    v1::DiscoverResponse response;
+    response.mutable_service()->mutable_name()->set_value("service" + StringUtils::TypeToStr(i));
+    GrpcCodec::SerializeToGrpcFrame(response, buffer);
+  }
+  ASSERT_EQ(buffer.GetRawSlices(NULL, 0), 1);  // 小消息连续写入同一个Slice
+  GrpcDecoder decoder;
+  std::vector<LengthPrefixedMessage*> output;
+  ASSERT_TRUE(decoder.Decode(buffer, output));
+  ASSERT_EQ(output.size(), kMessageCount);
+  for (int i = 0; i < kMessageCount; ++i) {
+    v1::DiscoverResponse response;
+    ASSERT_TRUE(GrpcCodec::ParseBufferToMessage(output[i]->ReleaseData(), response));
+    ASSERT_EQ(response.service().name().value(), "service" + StringUtils::TypeToStr(i));
+  }
+  GrpcDecoder::FreeMessages(output);
+}
+
 }  // namespace grpc
 }  // namespace polaris
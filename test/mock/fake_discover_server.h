@@ -0,0 +1,75 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use
+//  this file
+//  except in compliance with the License. You may obtain a copy of the License
+//  at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the
+//  specific
+//  language governing permissions and limitations under the License.
+
+#ifndef POLARIS_CPP_TEST_MOCK_FAKE_DISCOVER_SERVER_H_
+#define POLARIS_CPP_TEST_MOCK_FAKE_DISCOVER_SERVER_H_
+
+#include <string>
+
+#include "mock/fake_grpc_server.h"
+#include "sync/atomic.h"
+#include "v1/code.pb.h"
+#include "v1/request.pb.h"
+#include "v1/response.pb.h"
+
+namespace polaris {
+
+/// @brief 本地服务发现服务端，对每个服务发现请求应答revision固定的空数据
+///
+/// 记录收到的请求数和DATA帧数，用于检查客户端请求的合并情况
+class FakeDiscoverServer : public FakeGrpcServer {
+public:
+  FakeDiscoverServer() {}
+
+  virtual ~FakeDiscoverServer() { Stop(); }
+
+  int GetRequestCount() const { return request_count_; }
+
+  int GetDataFrameCount() const { return data_frame_count_; }
+
+protected:
+  virtual void OnRequestHeaders(Connection *connection, int32_t stream_id) {
+    SubmitResponse(connection, stream_id);
+  }
+
+  virtual void OnRequestData(Connection * /*connection*/, int32_t /*stream_id*/,
+                             bool /*request_end*/) {
+    data_frame_count_++;
+  }
+
+  virtual void OnMessage(Connection *connection, int32_t stream_id, const char *data,
+                         uint32_t length) {
+    v1::DiscoverRequest request;
+    request.ParseFromArray(data, length);
+    request_count_++;
+    v1::DiscoverResponse response;
+    response.mutable_code()->set_value(v1::ExecuteSuccess);
+    response.set_type(static_cast<v1::DiscoverResponse::DiscoverResponseType>(request.type()));
+    response.mutable_service()->mutable_namespace_()->set_value(
+        request.service().namespace_().value());
+    response.mutable_service()->mutable_name()->set_value(request.service().name().value());
+    response.mutable_service()->mutable_revision()->set_value("fake_revision");
+    AppendMessage(response, connection->send_data_[stream_id]);
+  }
+
+private:
+  sync::Atomic<int> request_count_;
+  sync::Atomic<int> data_frame_count_;
+};
+
+}  // namespace polaris
+
+#endif  // POLARIS_CPP_TEST_MOCK_FAKE_DISCOVER_SERVER_H_
@@ -0,0 +1,289 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use
+//  this file
+//  except in compliance with the License. You may obtain a copy of the License
+//  at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the
+//  specific
+//  language governing permissions and limitations under the License.
+
+#ifndef POLARIS_CPP_TEST_MOCK_FAKE_GRPC_SERVER_H_
+#define POLARIS_CPP_TEST_MOCK_FAKE_GRPC_SERVER_H_
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <google/protobuf/message.h>
+#include <nghttp2/nghttp2.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace polaris {
+
+/// @brief 本地Grpc服务端基类，在单独线程中处理连接和HTTP2协议，按Grpc格式拆分请求消息
+///
+/// 子类实现请求处理，将应答消息追加到stream的待发送数据中。
+/// 服务线程会调用子类的虚函数，子类析构时需要先调用Stop停止服务线程
+class FakeGrpcServer {
+public:
+  FakeGrpcServer() : port_(0), listen_fd_(-1), stop_(false), tid_(0) {}
+
+  virtual ~FakeGrpcServer() { Stop(); }
+
+  bool Start() {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = 0;
+    socklen_t len        = sizeof(addr);
+    if (bind(listen_fd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        listen(listen_fd_, 128) < 0 ||
+        getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&addr), &len) < 0) {
+      close(listen_fd_);
+      listen_fd_ = -1;
+      return false;
+    }
+    port_ = ntohs(addr.sin_port);
+    return pthread_create(&tid_, NULL, Run, this) == 0;
+  }
+
+  void Stop() {
+    if (tid_ != 0) {
+      stop_ = true;
+      pthread_join(tid_, NULL);
+      tid_ = 0;
+    }
+    for (std::size_t i = 0; i < connections_.size(); ++i) {
+      nghttp2_session_del(connections_[i]->session_);
+      close(connections_[i]->fd_);
+      delete connections_[i];
+    }
+    connections_.clear();
+    if (listen_fd_ >= 0) {
+      close(listen_fd_);
+      listen_fd_ = -1;
+    }
+  }
+
+  int GetPort() const { return port_; }
+
+protected:
+  struct Connection {
+    FakeGrpcServer *server_;
+    int fd_;
+    bool closed_;
+    nghttp2_session *session_;
+    std::map<int32_t, std::string> paths_;      // 每个stream请求的方法
+    std::map<int32_t, std::string> recv_data_;  // 每个stream未解析的请求数据
+    std::map<int32_t, std::string> send_data_;  // 每个stream待发送的应答数据
+  };
+
+  // 收到请求头部
+  virtual void OnRequestHeaders(Connection *connection, int32_t stream_id) = 0;
+
+  // 收到请求的DATA帧，request_end表示请求结束
+  virtual void OnRequestData(Connection * /*connection*/, int32_t /*stream_id*/,
+                             bool /*request_end*/) {}
+
+  // 收到一个完整的请求消息
+  virtual void OnMessage(Connection *connection, int32_t stream_id, const char *data,
+                         uint32_t length) = 0;
+
+  // 待发送的应答数据发送完后是否结束stream
+  virtual bool EndAfterResponse(Connection * /*connection*/, int32_t /*stream_id*/) {
+    return false;
+  }
+
+  // 应答头部，应答数据在追加到待发送数据后发送
+  static void SubmitResponse(Connection *connection, int32_t stream_id) {
+    nghttp2_nv headers[] = {MakeHeader(":status", "200"),
+                            MakeHeader("content-type", "application/grpc")};
+    nghttp2_data_provider provider;
+    provider.source.ptr    = connection;
+    provider.read_callback = OnDataRead;
+    nghttp2_submit_response(connection->session_, stream_id, headers, 2, &provider);
+  }
+
+  // 按Grpc格式追加消息：1字节压缩标记和4字节长度
+  static void AppendMessage(const google::protobuf::Message &message, std::string &send_data) {
+    std::string body = message.SerializeAsString();
+    uint32_t length  = body.size();
+    char header[5]   = {0, static_cast<char>(length >> 24), static_cast<char>(length >> 16),
+                      static_cast<char>(length >> 8), static_cast<char>(length)};
+    send_data.append(header, sizeof(header));
+    send_data.append(body);
+  }
+
+private:
+  static void *Run(void *arg) {
+    FakeGrpcServer *server = static_cast<FakeGrpcServer *>(arg);
+    while (!server->stop_) {
+      std::vector<pollfd> fds(1);
+      std::vector<Connection *> connections(1);
+      fds[0].fd     = server->listen_fd_;
+      fds[0].events = POLLIN;
+      for (std::size_t i = 0; i < server->connections_.size(); ++i) {
+        if (!server->connections_[i]->closed_) {
+          pollfd fd = {server->connections_[i]->fd_, POLLIN, 0};
+          fds.push_back(fd);
+          connections.push_back(server->connections_[i]);
+        }
+      }
+      if (poll(&fds[0], fds.size(), 10) <= 0) {
+        continue;
+      }
+      if (fds[0].revents & POLLIN) {
+        server->Accept();
+      }
+      for (std::size_t i = 1; i < fds.size(); ++i) {
+        if (fds[i].revents != 0) {
+          server->OnRead(connections[i]);
+        }
+      }
+    }
+    return NULL;
+  }
+
+  void Accept() {
+    int fd = accept(listen_fd_, NULL, NULL);
+    if (fd < 0) {
+      return;
+    }
+    Connection *connection = new Connection();
+    connection->server_    = this;
+    connection->fd_        = fd;
+    connection->closed_    = false;
+    nghttp2_session_callbacks *callbacks;
+    nghttp2_session_callbacks_new(&callbacks);
+    nghttp2_session_callbacks_set_send_callback(callbacks, OnSend);
+    nghttp2_session_callbacks_set_on_header_callback(callbacks, OnHeader);
+    nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks, OnFrameRecv);
+    nghttp2_session_callbacks_set_on_data_chunk_recv_callback(callbacks, OnDataChunkRecv);
+    nghttp2_session_server_new(&connection->session_, callbacks, connection);
+    nghttp2_session_callbacks_del(callbacks);
+    nghttp2_submit_settings(connection->session_, NGHTTP2_FLAG_NONE, NULL, 0);
+    connections_.push_back(connection);
+  }
+
+  void OnRead(Connection *connection) {
+    char buffer[16 * 1024];
+    ssize_t read_bytes = recv(connection->fd_, buffer, sizeof(buffer), 0);
+    if (read_bytes <= 0) {  // 连接关闭后不再读取，等待服务停止时释放
+      connection->closed_ = true;
+      return;
+    }
+    nghttp2_session_mem_recv(connection->session_, reinterpret_cast<uint8_t *>(buffer),
+                             read_bytes);
+    nghttp2_session_send(connection->session_);
+  }
+
+  static ssize_t OnSend(nghttp2_session * /*session*/, const uint8_t *data, size_t length,
+                        int /*flags*/, void *user_data) {
+    Connection *connection = static_cast<Connection *>(user_data);
+    size_t send_bytes      = 0;
+    while (send_bytes < length) {
+      ssize_t rc = send(connection->fd_, data + send_bytes, length - send_bytes, MSG_NOSIGNAL);
+      if (rc <= 0) {
+        return NGHTTP2_ERR_CALLBACK_FAILURE;
+      }
+      send_bytes += rc;
+    }
+    return length;
+  }
+
+  static int OnHeader(nghttp2_session * /*session*/, const nghttp2_frame *frame,
+                      const uint8_t *name, size_t namelen, const uint8_t *value, size_t valuelen,
+                      uint8_t /*flags*/, void *user_data) {
+    Connection *connection = static_cast<Connection *>(user_data);
+    if (frame->hd.type == NGHTTP2_HEADERS && namelen == 5 && memcmp(name, ":path", 5) == 0) {
+      connection->paths_[frame->hd.stream_id].assign(reinterpret_cast<const char *>(value),
+                                                     valuelen);
+    }
+    return 0;
+  }
+
+  static int OnFrameRecv(nghttp2_session * /*session*/, const nghttp2_frame *frame,
+                         void *user_data) {
+    Connection *connection = static_cast<Connection *>(user_data);
+    if (frame->hd.type == NGHTTP2_DATA) {
+      bool request_end = (frame->hd.flags & NGHTTP2_FLAG_END_STREAM) != 0;
+      connection->server_->OnRequestData(connection, frame->hd.stream_id, request_end);
+    } else if (frame->hd.type == NGHTTP2_HEADERS &&
+               frame->headers.cat == NGHTTP2_HCAT_REQUEST) {
+      connection->server_->OnRequestHeaders(connection, frame->hd.stream_id);
+    }
+    return 0;
+  }
+
+  static int OnDataChunkRecv(nghttp2_session *session, uint8_t /*flags*/, int32_t stream_id,
+                             const uint8_t *data, size_t len, void *user_data) {
+    Connection *connection = static_cast<Connection *>(user_data);
+    std::string &recv_data = connection->recv_data_[stream_id];
+    recv_data.append(reinterpret_cast<const char *>(data), len);
+    std::size_t offset = 0;
+    while (recv_data.size() - offset >= 5) {
+      const uint8_t *header = reinterpret_cast<const uint8_t *>(recv_data.data() + offset);
+      uint32_t length = (header[1] << 24) | (header[2] << 16) | (header[3] << 8) | header[4];
+      if (recv_data.size() - offset - 5 < length) {
+        break;
+      }
+      connection->server_->OnMessage(connection, stream_id, recv_data.data() + offset + 5,
+                                     length);
+      offset += 5 + length;
+    }
+    recv_data.erase(0, offset);
+    nghttp2_session_resume_data(session, stream_id);
+    return 0;
+  }
+
+  static ssize_t OnDataRead(nghttp2_session * /*session*/, int32_t stream_id, uint8_t *buf,
+                            size_t length, uint32_t *data_flags, nghttp2_data_source *source,
+                            void * /*user_data*/) {
+    Connection *connection = static_cast<Connection *>(source->ptr);
+    std::string &send_data = connection->send_data_[stream_id];
+    if (send_data.empty()) {
+      return NGHTTP2_ERR_DEFERRED;
+    }
+    std::size_t copy_size = send_data.size() < length ? send_data.size() : length;
+    memcpy(buf, send_data.data(), copy_size);
+    send_data.erase(0, copy_size);
+    if (send_data.empty() && connection->server_->EndAfterResponse(connection, stream_id)) {
+      *data_flags |= NGHTTP2_DATA_FLAG_EOF;
+    }
+    return copy_size;
+  }
+
+  static nghttp2_nv MakeHeader(const char *name, const char *value) {
+    nghttp2_nv header = {reinterpret_cast<uint8_t *>(const_cast<char *>(name)),
+                         reinterpret_cast<uint8_t *>(const_cast<char *>(value)), strlen(name),
+                         strlen(value), NGHTTP2_NV_FLAG_NONE};
+    return header;
+  }
+
+private:
+  int port_;
+  int listen_fd_;
+  volatile bool stop_;
+  pthread_t tid_;
+  std::vector<Connection *> connections_;
+};
+
+}  // namespace polaris
+
+#endif  // POLARIS_CPP_TEST_MOCK_FAKE_GRPC_SERVER_H_
@@ -0,0 +1,133 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use
+//  this file
+//  except in compliance with the License. You may obtain a copy of the License
+//  at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the
+//  specific
+//  language governing permissions and limitations under the License.
+
+#ifndef POLARIS_CPP_TEST_MOCK_FAKE_RATE_LIMIT_SERVER_H_
+#define POLARIS_CPP_TEST_MOCK_FAKE_RATE_LIMIT_SERVER_H_
+
+#include <string>
+
+#include "mock/fake_grpc_server.h"
+#include "sync/atomic.h"
+#include "utils/time_clock.h"
+#include "v1/code.pb.h"
+#include "v2/ratelimit_v2.pb.h"
+
+namespace polaris {
+
+/// @brief 本地限流服务端，应答时间同步、限流初始化和上报请求
+///
+/// 记录收到的初始化请求数、上报消息数以及上报消息中的计数器个数，用于检查客户端上报的合并情况。
+/// 服务端时间与客户端使用同一时钟，测试中可以使用假时间
+class FakeRateLimitServer : public FakeGrpcServer {
+public:
+  FakeRateLimitServer() : counter_key_(0), drop_report_(false) {}
+
+  virtual ~FakeRateLimitServer() { Stop(); }
+
+  int GetInitCount() const { return init_count_; }
+
+  int GetReportCount() const { return report_count_; }
+
+  int GetQuotaSumCount() const { return quota_sum_count_; }
+
+  // 设置是否丢弃上报请求，用于模拟上报超时
+  void SetDropReport(bool drop_report) { drop_report_ = drop_report; }
+
+protected:
+  virtual void OnRequestHeaders(Connection *connection, int32_t stream_id) {
+    if (!IsTimeAdjust(connection, stream_id)) {
+      SubmitResponse(connection, stream_id);  // 流式请求立即应答头部
+    }
+  }
+
+  virtual void OnRequestData(Connection *connection, int32_t stream_id, bool request_end) {
+    if (request_end && IsTimeAdjust(connection, stream_id)) {
+      metric::v2::TimeAdjustResponse response;
+      response.set_servertimestamp(Time::GetCurrentTimeMs());
+      AppendMessage(response, connection->send_data_[stream_id]);
+      SubmitResponse(connection, stream_id);
+    }
+  }
+
+  virtual void OnMessage(Connection *connection, int32_t stream_id, const char *data,
+                         uint32_t length) {
+    if (IsTimeAdjust(connection, stream_id)) {
+      return;  // 时间同步请求为空消息，在请求结束时应答
+    }
+    metric::v2::RateLimitRequest request;
+    request.ParseFromArray(data, length);
+    AppendResponse(request, connection->send_data_[stream_id]);
+  }
+
+  virtual bool EndAfterResponse(Connection *connection, int32_t stream_id) {
+    return IsTimeAdjust(connection, stream_id);  // 单次请求应答后结束stream
+  }
+
+private:
+  static bool IsTimeAdjust(Connection *connection, int32_t stream_id) {
+    return connection->paths_[stream_id] == "/polaris.metric.v2.RateLimitGRPCV2/TimeAdjust";
+  }
+
+  void AppendResponse(const metric::v2::RateLimitRequest &request, std::string &send_data) {
+    metric::v2::RateLimitResponse response;
+    response.set_cmd(request.cmd());
+    if (request.cmd() == metric::v2::INIT) {
+      init_count_++;
+      const metric::v2::RateLimitInitRequest &init_request = request.ratelimitinitrequest();
+      metric::v2::RateLimitInitResponse *init_response = response.mutable_ratelimitinitresponse();
+      init_response->set_code(v1::ExecuteSuccess);
+      init_response->mutable_target()->CopyFrom(init_request.target());
+      init_response->set_clientkey(1);
+      init_response->set_timestamp(Time::GetCurrentTimeMs());
+      for (int i = 0; i < init_request.totals_size(); ++i) {
+        metric::v2::QuotaCounter *counter = init_response->add_counters();
+        counter->set_counterkey(++counter_key_);
+        counter->set_duration(init_request.totals(i).duration());
+        counter->set_left(init_request.totals(i).maxamount());
+        counter->set_clientcount(1);
+      }
+    } else {
+      report_count_++;
+      const metric::v2::RateLimitReportRequest &report_request = request.ratelimitreportrequest();
+      quota_sum_count_ += report_request.quotauses_size();
+      if (drop_report_) {
+        return;
+      }
+      metric::v2::RateLimitReportResponse *report_response =
+          response.mutable_ratelimitreportresponse();
+      report_response->set_code(v1::ExecuteSuccess);
+      report_response->set_timestamp(Time::GetCurrentTimeMs());
+      for (int i = 0; i < report_request.quotauses_size(); ++i) {
+        metric::v2::QuotaLeft *left = report_response->add_quotalefts();
+        left->set_counterkey(report_request.quotauses(i).counterkey());
+        left->set_left(100);
+        left->set_clientcount(1);
+      }
+    }
+    AppendMessage(response, send_data);
+  }
+
+private:
+  uint32_t counter_key_;
+  volatile bool drop_report_;
+  sync::Atomic<int> init_count_;
+  sync::Atomic<int> report_count_;
+  sync::Atomic<int> quota_sum_count_;
+};
+
+}  // namespace polaris
+
+#endif  // POLARIS_CPP_TEST_MOCK_FAKE_RATE_LIMIT_SERVER_H_
@@ -152,4 +152,169 @@ TEST_F(ModelTest, TestInstanceLocalId) {
   }
 }
 
+TEST_F(ModelTest, CircuitBreakerSnapshot) {
+  Service service(service_key_, 1);
+  CircuitBreakerSnapshot *snapshot = service.GetServiceImpl()->GetCircuitBreakerSnapshot(NULL);
+  ASSERT_TRUE(snapshot != NULL);
+  ASSERT_TRUE(snapshot->open_instance_ids_.empty());
+
+  v1::DiscoverResponse response;
+  FakeServer::CreateServiceInstances(response, service_key_, 10);
+  ServiceData *service_data = ServiceData::CreateFromPb(&response, kDataIsSyncing);
+  service.UpdateData(service_data);
+  CircuitBreakerData circuit_breaker_data;
+  circuit_breaker_data.version = 1;
+  circuit_breaker_data.open_instances.insert("instance_0");
+  circuit_breaker_data.open_instances.insert("instance_5");
+  circuit_breaker_data.open_instances.insert("instance_x");
+  service.SetCircuitBreakerData(circuit_breaker_data);
+  // 熔断数据更新后快照未绑定服务实例数据
+  snapshot = service.GetServiceImpl()->GetCircuitBreakerSnapshot(NULL);
+  ASSERT_EQ(snapshot->version_, 1);
+  ASSERT_TRUE(snapshot->service_data_ == NULL);
+  snapshot = service.GetServiceImpl()->GetCircuitBreakerSnapshot(service_data);
+  ASSERT_TRUE(snapshot->IsBoundTo(service_data));
+  ASSERT_EQ(snapshot->open_instances_.size(), 2);  // instance_x不存在
+  ASSERT_EQ(snapshot->excluded_instances_.size(), 2);
+  ASSERT_EQ(service.GetServiceImpl()->GetCircuitBreakerSnapshot(service_data), snapshot);
+
+  ServiceInstances service_instances(service_data);
+  std::map<std::string, Instance *> &instances = service_instances.GetInstances();
+  for (std::map<std::string, Instance *>::iterator it = instances.begin(); it != instances.end();
+       ++it) {
+    bool is_open = circuit_breaker_data.open_instances.count(it->first) > 0;
+    ASSERT_EQ(snapshot->IsOpen(it->second, service_data), is_open) << it->first;
+  }
+
+  // 服务数据更新后，旧服务数据不再绑定快照，按实例ID判断
+  ServiceData *new_service_data = ServiceData::CreateFromPb(&response, kDataIsSyncing);
+  service.UpdateData(new_service_data);
+  snapshot = service.GetServiceImpl()->GetCircuitBreakerSnapshot(service_data);
+  ASSERT_EQ(snapshot->service_data_, new_service_data);
+  ASSERT_TRUE(snapshot->IsOpen(instances["instance_5"], service_data));
+  ASSERT_FALSE(snapshot->IsOpen(instances["instance_1"], service_data));
+
+  // 被替换的快照在回收时间之后才释放
+  service.GetServiceImpl()->CheckGc(Time::GetCurrentTimeMs());
+  TestUtils::FakeNowIncrement(1);
+  service.GetServiceImpl()->CheckGc(Time::GetCurrentTimeMs());
+  new_service_data->DecrementRef();
+}
+
+TEST_F(ModelTest, DiffInstancesData) {
+  v1::DiscoverResponse response;
+  FakeServer::CreateServiceInstances(response, service_key_, 10);
+  ServiceData *old_data = ServiceData::CreateFromPb(&response, kDataIsSyncing);
+
+  response.mutable_instances(2)->mutable_weight()->set_value(50);
+  response.mutable_instances(3)->mutable_isolate()->set_value(true);
+  response.mutable_instances()->RemoveLast();
+  ::v1::Instance *instance = response.add_instances();
+  instance->mutable_id()->set_value("instance_new");
+  instance->mutable_host()->set_value("host_new");
+  instance->mutable_port()->set_value(2000);
+  instance->mutable_weight()->set_value(100);
+  ServiceData *new_data = ServiceData::CreateFromPb(&response, kDataIsSyncing);
+  new_data->GetServiceDataImpl()->DiffInstancesData(old_data->GetServiceDataImpl());
+  InstancesData *old_instances = old_data->GetServiceDataImpl()->GetInstancesData();
+  InstancesData *new_instances = new_data->GetServiceDataImpl()->GetInstancesData();
+  ASSERT_EQ(new_instances->added_instances_.size(), 1);
+  ASSERT_EQ(new_instances->added_instances_[0]->GetId(), "instance_new");
+  ASSERT_EQ(new_instances->changed_instances_.size(), 2);
+  ASSERT_EQ(new_instances->changed_instances_[0]->GetId(), "instance_2");
+  ASSERT_EQ(new_instances->changed_instances_[1]->GetId(), "instance_3");
+  ASSERT_EQ(new_instances->deleted_instance_ids_.size(), 1);
+  ASSERT_EQ(new_instances->deleted_instance_ids_[0], "instance_9");
+  ASSERT_FALSE(new_instances->available_unchanged_);
+  // ID相同的实例复用本地数据
+  ASSERT_EQ(new_instances->instances_map_["instance_0"]->GetLocalValue(),
+            old_instances->instances_map_["instance_0"]->GetLocalValue());
+  ASSERT_EQ(new_instances->instances_map_["instance_2"]->GetLocalValue(),
+            old_instances->instances_map_["instance_2"]->GetLocalValue());
+  old_data->DecrementRef();
+
+  // 只有隔离实例变化时，可用实例不变
+  old_data = new_data;
+  (*response.mutable_instances(3)->mutable_metadata())["key"] = "value";
+  new_data = ServiceData::CreateFromPb(&response, kDataIsSyncing);
+  new_data->GetServiceDataImpl()->DiffInstancesData(old_data->GetServiceDataImpl());
+  new_instances = new_data->GetServiceDataImpl()->GetInstancesData();
+  ASSERT_TRUE(new_instances->added_instances_.empty());
+  ASSERT_EQ(new_instances->changed_instances_.size(), 1);
+  ASSERT_TRUE(new_instances->deleted_instance_ids_.empty());
+  ASSERT_TRUE(new_instances->available_unchanged_);
+  old_data->DecrementRef();
+  new_data->DecrementRef();
+}
+
+TEST_F(ModelTest, ServiceDataToJsonString) {
+  v1::DiscoverResponse response;
+  FakeServer::CreateServiceInstances(response, service_key_, 2);
+  ServiceData *service_data = ServiceData::CreateFromPb(&response, kDataIsSyncing);
+  std::string content;
+  SharedDiscoverResponse *pb_response =
+      service_data->GetServiceDataImpl()->GetPersistContent(content);
+  ASSERT_TRUE(pb_response != NULL);
+  ASSERT_TRUE(content.empty());
+  std::string json_content;
+  pb_response->ToJson(json_content);
+  pb_response->DecrementRef();
+  ASSERT_EQ(service_data->ToJsonString(), json_content);
+  // 生成json后持久化直接使用json数据
+  ASSERT_TRUE(service_data->GetServiceDataImpl()->GetPersistContent(content) == NULL);
+  ASSERT_EQ(content, json_content);
+  service_data->DecrementRef();
+
+  service_data = ServiceData::CreateFromJson(json_content, kDataInitFromDisk, 0);
+  ASSERT_EQ(service_data->ToJsonString(), json_content);
+  service_data->DecrementRef();
+}
+
+TEST(ThreadLocalRouteInfoTest, ResetAfterUse) {
+  ServiceKey service_key = {"test_namespace", "test_service"};
+  RouteInfo *reused_route_info = NULL;
+  {
+    ThreadLocalRouteInfo thread_route_info(service_key, NULL);
+    RouteInfo &route_info = thread_route_info.Get();
+    std::map<std::string, std::string> labels;
+    labels["key"] = "value";
+    route_info.SetLables(labels);
+    route_info.SetRouterFlag("ruleRouter", false);
+    route_info.SetIncludeUnhealthyInstances();
+    route_info.SetRouterChainEnd(true);
+    reused_route_info = &route_info;
+
+    // 同一线程嵌套使用时创建新对象
+    ThreadLocalRouteInfo nested_route_info(service_key, NULL);
+    ASSERT_NE(&nested_route_info.Get(), reused_route_info);
+  }
+
+  // 再次使用时复用线程本地对象，且不带上一次设置的参数
+  ServiceKey other_service_key = {"test_namespace", "other_service"};
+  ServiceInfo *source_service_info = new ServiceInfo();
+  ThreadLocalRouteInfo thread_route_info(other_service_key, source_service_info);
+  RouteInfo &route_info = thread_route_info.Get();
+  ASSERT_EQ(&route_info, reused_route_info);
+  ASSERT_EQ(route_info.GetServiceKey(), other_service_key);
+  ASSERT_EQ(route_info.GetSourceServiceInfo(), source_service_info);
+  ASSERT_TRUE(route_info.GetLabels().empty());
+  ASSERT_TRUE(route_info.IsRouterEnable("ruleRouter"));
+  ASSERT_EQ(route_info.GetRequestFlags(), 0);
+  ASSERT_FALSE(route_info.IsRouterChainEnd());
+  ASSERT_TRUE(route_info.GetServiceInstances() == NULL);
+}
+
+TEST(RouteObjectCacheTest, CompatibleWithPlainDelete) {
+  // 直接new创建的对象可以释放到缓存，缓存的内存再次用于创建对象
+  ServiceRouteRule* route_rule = new ServiceRouteRule(NULL);
+  RouteObjectCache::DeleteServiceRouteRule(route_rule);
+  ServiceRouteRule* cached_route_rule = RouteObjectCache::NewServiceRouteRule(NULL);
+  ASSERT_EQ(cached_route_rule, route_rule);
+  ASSERT_TRUE(cached_route_rule->GetServiceData() == NULL);
+
+  // 通过缓存创建的对象可以直接delete
+  delete cached_route_rule;
+  RouteObjectCache::DeleteServiceRouteRule(NULL);
+}
+
 }  // namespace polaris
@@ -155,8 +155,8 @@ void *ErrorCountCircuitBreakerTest::MultiThreadGetOrCreateErrorCountInstance(voi
     ErrorCountStatus &status =
         test->error_count_circuit_breaker_->GetOrCreateErrorCountStatus(instance_id.str(), 0);
     // 并发修改数据
-    ATOMIC_INC(&status.error_count);
-    ATOMIC_INC(&status.last_update_time);
+    status.error_count++;
+    status.last_update_time++;
   }
   return NULL;
 }
@@ -95,19 +95,19 @@ TEST_F(ErrorRateCircuitBreakerTest, OneThreadGetOrCreateStatus) {
   ASSERT_EQ(status.last_access_time, 0);
 
   // 修改数据
-  status.buckets[0].bucket_time = 1;
-  status.buckets[0].error_count = 2;
-  status.buckets[0].total_count = 3;
-  status.last_access_time       = 1;
-  status.last_update_time       = 2;
+  status.buckets[0].Add(1, true);
+  status.buckets[0].Add(1, true);
+  status.buckets[0].Add(1, false);
+  status.last_access_time = 1;
+  status.last_update_time = 2;
 
   // 再次获取，是同一个状态对象
   ErrorRateStatus &status2 =
       error_rate_circuit_breaker_->GetOrCreateErrorRateStatus(instance_id, 3);
   ASSERT_EQ(&status, &status2);
-  ASSERT_EQ(status2.buckets[0].bucket_time, 1);
-  ASSERT_EQ(status2.buckets[0].error_count, 2);
-  ASSERT_EQ(status2.buckets[0].total_count, 3);
+  ASSERT_EQ(status2.buckets[0].GetBucketTime(), 1);
+  ASSERT_EQ(status2.buckets[0].GetErrorCount(), 2);
+  ASSERT_EQ(status2.buckets[0].GetTotalCount(), 3);
   ASSERT_EQ(status2.last_access_time, 3);
   ASSERT_EQ(status2.last_update_time, 2);
 }
@@ -164,7 +164,7 @@ void *ErrorRateCircuitBreakerTest::MultiThreadGetOrCreateErrorRateInstance(void
     ErrorRateStatus &status = test->error_rate_circuit_breaker_->GetOrCreateErrorRateStatus(
         instance_id.str(), kTestMultiThreadGetOrCreateTime);
     // 并发修改数据
-    ATOMIC_INC(&status.last_update_time);
+    status.last_update_time++;
   }
   return NULL;
 }
@@ -208,10 +208,11 @@ TEST_F(ErrorRateCircuitBreakerTest, TestRequestVolumeThreshold) {
     error_rate_circuit_breaker_->RealTimeCircuitBreak(instance_gauge_, circuit_breaker_status_);
     error_rate_circuit_breaker_->TimingCircuitBreak(circuit_breaker_status_);
     ASSERT_EQ(error_rate_status.status, kCircuitBreakerClose);
-    ASSERT_EQ(error_rate_status.buckets[bucket_index].bucket_time,
-              current_time / default_bucket_time_);
-    ASSERT_EQ(error_rate_status.buckets[bucket_index].error_count, 1);
-    ASSERT_EQ(error_rate_status.buckets[bucket_index].total_count, 1);
+    // 桶中只保存桶时间的低20位
+    ASSERT_EQ(error_rate_status.buckets[bucket_index].GetBucketTime(),
+              (current_time / default_bucket_time_) & 0xFFFFF);
+    ASSERT_EQ(error_rate_status.buckets[bucket_index].GetErrorCount(), 1);
+    ASSERT_EQ(error_rate_status.buckets[bucket_index].GetTotalCount(), 1);
     ASSERT_EQ(error_rate_status.last_access_time, current_time);
     TestUtils::FakeNowIncrement(default_bucket_time_);
   }
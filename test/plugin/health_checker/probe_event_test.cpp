@@ -0,0 +1,199 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use
+//  this file
+//  except in compliance with the License. You may obtain a copy of the License
+//  at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the
+//  specific
+//  language governing permissions and limitations under the License.
+//
+
+#include "plugin/health_checker/probe_event.h"
+
+#include <gtest/gtest.h>
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+
+#include "mock/fake_net_server.h"
+#include "plugin/health_checker/http_detector.h"
+#include "plugin/health_checker/tcp_detector.h"
+#include "plugin/health_checker/udp_detector.h"
+#include "plugin/plugin_manager.h"
+#include "test_utils.h"
+#include "utils/time_clock.h"
+
+namespace polaris {
+
+class TestDetectCallback : public DetectCallback {
+public:
+  TestDetectCallback() : done_(false) {}
+
+  virtual void OnDetectDone(const DetectResult& detect_result) {
+    done_          = true;
+    detect_result_ = detect_result;
+  }
+
+  bool done_;
+  DetectResult detect_result_;
+};
+
+class ProbeEventTest : public ::testing::Test {
+protected:
+  static void SetUpTestCase() {
+    server_list_.push_back(NetServerParam(TestUtils::PickUnusedPort(), "OK", kNetServerInit, 0));
+    server_list_.push_back(
+        NetServerParam(TestUtils::PickUnusedPort(), "0x987654321", kNetServerInit, 0));
+    server_list_.push_back(
+        NetServerParam(TestUtils::PickUnusedPort(), "HTTP/1.0 200 OK\r\n\r\n", kNetServerInit, 0));
+    server_list_.push_back(NetServerParam(TestUtils::PickUnusedPort(), "OK", kNetServerInit, 0));
+    for (std::size_t i = 0; i < server_list_.size(); ++i) {
+      pthread_create(&server_list_[i].tid_,
+                     NULL, i + 1 < server_list_.size() ? FakeNetServer::StartTcp
+                                                       : FakeNetServer::StartUdp,
+                     &server_list_[i]);
+    }
+    bool all_server_start = false;
+    while (!all_server_start) {
+      all_server_start = true;
+      for (std::size_t i = 0; i < server_list_.size(); ++i) {
+        if (server_list_[i].status_ == kNetServerInit) {
+          all_server_start = false;
+        } else {
+          ASSERT_EQ(server_list_[i].status_, kNetServerStart);
+        }
+      }
+      usleep(2000);
+    }
+  }
+
+  static void TearDownTestCase() {
+    for (std::size_t i = 0; i < server_list_.size(); ++i) {
+      server_list_[i].status_ = kNetServerStop;
+      pthread_join(server_list_[i].tid_, NULL);
+    }
+  }
+
+  static std::vector<NetServerParam> server_list_;
+
+  virtual void SetUp() { config_ = NULL; }
+
+  virtual void TearDown() {
+    reactor_.Stop();
+    if (config_ != NULL) {
+      delete config_;
+      config_ = NULL;
+    }
+  }
+
+  void InitChecker(HealthChecker* checker, const std::string& content) {
+    std::string err_msg;
+    config_ = Config::CreateFromString(content, err_msg);
+    ASSERT_TRUE(config_ != NULL && err_msg.empty());
+    ASSERT_EQ(checker->Init(config_, NULL), kReturnOk);
+  }
+
+  void Probe(AsyncHealthChecker* checker, int port, ReturnCode expect_code) {
+    TestDetectCallback callback;
+    ProbeEvent* probe = new ProbeEvent(reactor_, checker, &callback);
+    probe->Start("127.0.0.1", port);
+    uint64_t begin_time = Time::GetCurrentTimeMs();
+    while (!callback.done_ && Time::GetCurrentTimeMs() < begin_time + 5000) {
+      reactor_.RunOnce();
+    }
+    reactor_.RunOnce();  // 释放探测对象
+    ASSERT_TRUE(callback.done_);
+    ASSERT_EQ(callback.detect_result_.return_code, expect_code) << port;
+    ASSERT_EQ(callback.detect_result_.detect_type, checker->GetDetectType());
+  }
+
+protected:
+  Reactor reactor_;
+  Config* config_;
+};
+
+std::vector<NetServerParam> ProbeEventTest::server_list_;
+
+TEST_F(ProbeEventTest, TcpProbe) {
+  TcpHealthChecker tcp_checker;
+  InitChecker(&tcp_checker,
+              "send:\n  0x12345678\n"
+              "receive:\n  0x4f4b\n"  // 0x4f4b为OK的二进制表示
+              "timeout:\n  1000");
+  Probe(&tcp_checker, server_list_[0].port_, kReturnOk);
+  Probe(&tcp_checker, server_list_[1].port_, kReturnServerError);
+  Probe(&tcp_checker, TestUtils::PickUnusedPort(), kReturnNetworkFailed);
+}
+
+TEST_F(ProbeEventTest, TcpConnectProbe) {
+  TcpHealthChecker tcp_checker;
+  InitChecker(&tcp_checker, "timeout:\n  1000");
+  Probe(&tcp_checker, server_list_[1].port_, kReturnOk);
+  Probe(&tcp_checker, TestUtils::PickUnusedPort(), kReturnNetworkFailed);
+}
+
+TEST_F(ProbeEventTest, TcpProbeTimeout) {
+  TcpHealthChecker tcp_checker;
+  InitChecker(&tcp_checker,
+              "send:\n  0x12345678\n"
+              "timeout:\n  3");  // 服务端10ms后才应答
+  Probe(&tcp_checker, server_list_[0].port_, kReturnTimeout);
+}
+
+TEST_F(ProbeEventTest, HttpProbe) {
+  HttpHealthChecker http_checker;
+  InitChecker(&http_checker,
+              "path:\n  /health\n"
+              "timeout:\n  1000");
+  Probe(&http_checker, server_list_[2].port_, kReturnOk);
+  Probe(&http_checker, server_list_[1].port_, kReturnServerError);
+}
+
+TEST_F(ProbeEventTest, UdpProbe) {
+  UdpHealthChecker udp_checker;
+  InitChecker(&udp_checker,
+              "send:\n  0x12345678\n"
+              "receive:\n  0x4f4b\n"
+              "timeout:\n  1000");
+  Probe(&udp_checker, server_list_[3].port_, kReturnOk);
+  Probe(&udp_checker, TestUtils::PickUnusedPort(), kReturnNetworkFailed);
+}
+
+TEST_F(ProbeEventTest, ConcurrentProbe) {
+  TcpHealthChecker tcp_checker;
+  InitChecker(&tcp_checker,
+              "send:\n  0x12345678\n"
+              "receive:\n  0x4f4b\n"
+              "timeout:\n  1000");
+  // 多个探测同时在reactor中进行
+  const int kProbeCount = 20;
+  std::vector<TestDetectCallback> callbacks(kProbeCount);
+  for (int i = 0; i < kProbeCount; ++i) {
+    ProbeEvent* probe = new ProbeEvent(reactor_, &tcp_checker, &callbacks[i]);
+    probe->Start("127.0.0.1", server_list_[0].port_);
+  }
+  int done_count      = 0;
+  uint64_t begin_time = Time::GetCurrentTimeMs();
+  while (done_count < kProbeCount && Time::GetCurrentTimeMs() < begin_time + 5000) {
+    reactor_.RunOnce();
+    done_count = 0;
+    for (int i = 0; i < kProbeCount; ++i) {
+      done_count += callbacks[i].done_ ? 1 : 0;
+    }
+  }
+  reactor_.RunOnce();
+  ASSERT_EQ(done_count, kProbeCount);
+  for (int i = 0; i < kProbeCount; ++i) {
+    ASSERT_EQ(callbacks[i].detect_result_.return_code, kReturnOk);
+  }
+}
+
+}  // namespace polaris
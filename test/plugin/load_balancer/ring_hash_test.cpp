@@ -21,6 +21,8 @@
 
 #include "mock/fake_server_response.h"
 #include "model/model_impl.h"
+#include "plugin/load_balancer/hash/murmur.h"
+#include "plugin/load_balancer/ringhash/continuum.h"
 #include "test_context.h"
 #include "utils/scoped_ptr.h"
 #include "utils/string_utils.h"
@@ -130,6 +132,75 @@ TEST_F(RingHashCstLbTest, TestSelectWithInstancesUpdate) {
   local_registry->GetServiceDataWithRef(service_key_, kServiceDataInstances, service_data);
   ASSERT_TRUE(service_data != NULL);
   CheckChooseInstance(service_data);
+
+  // 可用实例未变化时复用哈希环
+  ServiceData *old_service_data = NULL;
+  local_registry->GetServiceDataWithRef(service_key_, kServiceDataInstances, old_service_data);
+  ASSERT_TRUE(old_service_data != NULL);
+  ServiceInstances old_instances(old_service_data);
+  Instance *old_instance = NULL;
+  Criteria criteria;
+  criteria.hash_key_ = random();
+  ASSERT_EQ(load_balancer_->ChooseInstance(&old_instances, criteria, old_instance), kReturnOk);
+  response.mutable_service()->mutable_revision()->set_value("new_revision");
+  service_data = ServiceData::CreateFromPb(&response, kDataIsSyncing);
+  local_registry->UpdateServiceData(service_key_, kServiceDataInstances, service_data);
+  service_data = NULL;
+  local_registry->GetServiceDataWithRef(service_key_, kServiceDataInstances, service_data);
+  ASSERT_TRUE(service_data != NULL);
+  ASSERT_NE(service_data, old_service_data);
+  ServiceInstances service_instances(service_data);
+  ASSERT_TRUE(service_instances.GetAvailableInstances()->GetSelector() != NULL);
+  Instance *instance = NULL;
+  ASSERT_EQ(load_balancer_->ChooseInstance(&service_instances, criteria, instance), kReturnOk);
+  ASSERT_EQ(instance->GetId(), old_instance->GetId());
+}
+
+TEST_F(RingHashCstLbTest, TestPatchContinuum) {
+  v1::DiscoverResponse response;
+  FakeServer::CreateServiceInstances(response, service_key_, 10);
+  ServiceData *old_data = ServiceData::CreateFromPb(&response, kDataIsSyncing);
+  InstancesData *old_instances = old_data->GetServiceDataImpl()->GetInstancesData();
+  ContinuumSelector old_selector;
+  ASSERT_TRUE(old_selector.FastSetup(old_instances->instances_, 1024, Murmur3_64));
+
+  // 修改一个实例的权重，删除一个实例并新增一个实例
+  response.mutable_instances(2)->mutable_weight()->set_value(20);
+  response.mutable_instances()->RemoveLast();
+  v1::Instance *instance = response.add_instances();
+  instance->mutable_id()->set_value("instance_new");
+  instance->mutable_host()->set_value("host_new");
+  instance->mutable_port()->set_value(2000);
+  instance->mutable_weight()->set_value(100);
+  ServiceData *new_data = ServiceData::CreateFromPb(&response, kDataIsSyncing);
+  new_data->GetServiceDataImpl()->DiffInstancesData(old_data->GetServiceDataImpl());
+  InstancesData *new_instances = new_data->GetServiceDataImpl()->GetInstancesData();
+  ContinuumSelector selector;
+  ASSERT_TRUE(selector.Patch(old_selector, old_instances, new_instances));
+
+  // 与全量构建的哈希环选择结果相同
+  ServiceData *rebuild_data = ServiceData::CreateFromPb(&response, kDataIsSyncing);
+  ContinuumSelector rebuild_selector;
+  ASSERT_TRUE(rebuild_selector.FastSetup(
+      rebuild_data->GetServiceDataImpl()->GetInstancesData()->instances_, 1024, Murmur3_64));
+  for (int i = 0; i < 10000; ++i) {
+    Criteria criteria;
+    criteria.hash_key_ = random();
+    ASSERT_EQ(selector.Select(criteria), rebuild_selector.Select(criteria));
+  }
+
+  // 上一版本哈希环由负载均衡器构建时，实例更新后直接修改哈希环
+  ServiceInstances old_service_instances(old_data);
+  Instance *old_instance = NULL;
+  Criteria criteria;
+  criteria.hash_key_ = random();
+  ASSERT_EQ(load_balancer_->ChooseInstance(&old_service_instances, criteria, old_instance),
+            kReturnOk);
+  KetamaLoadBalancer::OnInstanceUpdate(old_instances, new_instances);
+  ASSERT_TRUE(new_instances->instances_->GetSelector() != NULL);
+  old_data->DecrementRef();
+  new_data->DecrementRef();
+  rebuild_data->DecrementRef();
 }
 
 }  // namespace polaris
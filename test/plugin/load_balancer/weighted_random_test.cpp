@@ -0,0 +1,217 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use
+//  this file
+//  except in compliance with the License. You may obtain a copy of the License
+//  at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software
+//  distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the
+//  specific
+//  language governing permissions and limitations under the License.
+//
+
+#include "plugin/load_balancer/weighted_random.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <string>
+
+#include "mock/fake_server_response.h"
+#include "model/model_impl.h"
+#include "test_context.h"
+#include "test_utils.h"
+#include "utils/scoped_ptr.h"
+#include "utils/string_utils.h"
+
+namespace polaris {
+
+class WeightedRandomLbTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    context_.Set(TestContext::CreateContext());
+    ASSERT_TRUE(context_.NotNull());
+    load_balancer_.Set(new RandomLoadBalancer());
+    Config *config = Config::CreateEmptyConfig();
+    ASSERT_EQ(load_balancer_->Init(config, context_.Get()), kReturnOk);
+    delete config;
+    service_key_.namespace_ = "test_namespace";
+    service_key_.name_      = "test_name";
+    service_data_           = NULL;
+  }
+
+  virtual void TearDown() {
+    if (service_data_ != NULL) {
+      service_data_->DecrementRef();
+      service_data_ = NULL;
+    }
+  }
+
+  // 创建权重分别为weights的实例
+  void CreateServiceData(const std::vector<int> &weights) {
+    v1::DiscoverResponse response;
+    FakeServer::InstancesResponse(response, service_key_);
+    for (std::size_t i = 0; i < weights.size(); ++i) {
+      v1::Instance *instance = response.add_instances();
+      instance->mutable_id()->set_value("instance_" + StringUtils::TypeToStr(i));
+      instance->mutable_host()->set_value("host_" + StringUtils::TypeToStr(i));
+      instance->mutable_port()->set_value(8000 + i);
+      instance->mutable_weight()->set_value(weights[i]);
+    }
+    service_data_ = ServiceData::CreateFromPb(&response, kDataIsSyncing);
+  }
+
+protected:
+  ServiceKey service_key_;
+  ServiceData *service_data_;
+  ScopedPtr<RandomLoadBalancer> load_balancer_;
+  ScopedPtr<Context> context_;
+};
+
+TEST_F(WeightedRandomLbTest, AliasTableMatchWeight) {
+  std::vector<int> weights;
+  int sum_weight = 0;
+  for (int i = 0; i < 20; ++i) {
+    weights.push_back(i % 5 == 0 ? 0 : i * 7 + 1);
+    sum_weight += weights.back();
+  }
+  CreateServiceData(weights);
+  Service service(service_key_, 1);
+  service.UpdateData(service_data_);
+  service_data_->IncrementRef();
+  ServiceInstances service_instances(service_data_);
+  InstancesSet *instances_set = service_instances.GetAvailableInstances();
+  const std::vector<Instance *> &instances = instances_set->GetInstances();
+
+  AliasSelector selector;
+  selector.Setup(&service_instances, instances_set, false);
+  // 遍历所有随机数组合，统计每个实例被选中的概率
+  std::map<int, double> probability;
+  // 列数为权重非0的实例数
+  const uint32_t kColumnCount    = 16;
+  const uint32_t kThresholdSteps = 1 << 12;
+  for (uint32_t column = 0; column < kColumnCount; ++column) {
+    for (uint32_t step = 0; step < kThresholdSteps; ++step) {
+      int index = selector.Select(column << 27, step << 19);
+      ASSERT_GE(index, 0);
+      probability[index] += 1.0 / (kColumnCount * kThresholdSteps);
+    }
+  }
+  for (std::size_t i = 0; i < instances.size(); ++i) {
+    double expect = static_cast<double>(instances[i]->GetWeight()) / sum_weight;
+    ASSERT_NEAR(probability[i], expect, 0.001) << instances[i]->GetId();
+  }
+}
+
+TEST_F(WeightedRandomLbTest, ChooseInstance) {
+  std::vector<int> weights;
+  weights.push_back(0);
+  weights.push_back(100);
+  weights.push_back(300);
+  CreateServiceData(weights);
+  Service service(service_key_, 1);
+  service.UpdateData(service_data_);
+  service_data_->IncrementRef();
+  ServiceInstances service_instances(service_data_);
+
+  Criteria criteria;
+  std::map<std::string, int> choose_count;
+  for (int i = 0; i < 40000; ++i) {
+    Instance *instance = NULL;
+    ASSERT_EQ(load_balancer_->ChooseInstance(&service_instances, criteria, instance), kReturnOk);
+    ASSERT_TRUE(instance != NULL);
+    choose_count[instance->GetId()]++;
+  }
+  ASSERT_EQ(choose_count["instance_0"], 0);
+  ASSERT_NEAR(choose_count["instance_1"], 10000, 1000);
+  ASSERT_NEAR(choose_count["instance_2"], 30000, 1000);
+}
+
+TEST_F(WeightedRandomLbTest, RebuildAfterCircuitBreakerChange) {
+  std::vector<int> weights(2, 100);
+  CreateServiceData(weights);
+  Service service(service_key_, 1);
+  service.UpdateData(service_data_);
+  service_data_->IncrementRef();
+  ServiceInstances service_instances(service_data_);
+
+  Criteria criteria;
+  criteria.ignore_half_open_ = true;
+  std::map<std::string, int> choose_count;
+  for (int i = 0; i < 10000; ++i) {
+    Instance *instance = NULL;
+    ASSERT_EQ(load_balancer_->ChooseInstance(&service_instances, criteria, instance), kReturnOk);
+    choose_count[instance->GetId()]++;
+  }
+  ASSERT_NEAR(choose_count["instance_0"], 5000, 500);
+
+  // 熔断数据更新后重新构建别名表，半开实例按权重1参与分配
+  CircuitBreakerData circuit_breaker_data;
+  circuit_breaker_data.version                           = 1;
+  circuit_breaker_data.half_open_instances["instance_0"] = 1;
+  service.SetCircuitBreakerData(circuit_breaker_data);
+  choose_count.clear();
+  for (int i = 0; i < 10100; ++i) {
+    Instance *instance = NULL;
+    ASSERT_EQ(load_balancer_->ChooseInstance(&service_instances, criteria, instance), kReturnOk);
+    choose_count[instance->GetId()]++;
+  }
+  ASSERT_LT(choose_count["instance_0"], 300);
+}
+
+TEST_F(WeightedRandomLbTest, ChooseWithAllZeroWeight) {
+  std::vector<int> weights(3, 0);
+  CreateServiceData(weights);
+  Service service(service_key_, 1);
+  service.UpdateData(service_data_);
+  service_data_->IncrementRef();
+  ServiceInstances service_instances(service_data_);
+
+  Criteria criteria;
+  Instance *instance = NULL;
+  ASSERT_EQ(load_balancer_->ChooseInstance(&service_instances, criteria, instance),
+            kReturnInstanceNotFound);
+  ASSERT_TRUE(instance == NULL);
+}
+
+TEST_F(WeightedRandomLbTest, HalfOpenInstanceWeight) {
+  TestUtils::SetUpFakeTime();
+  std::vector<int> weights(2, 100);
+  CreateServiceData(weights);
+  Service service(service_key_, 1);
+  service.UpdateData(service_data_);
+  CircuitBreakerData circuit_breaker_data;
+  circuit_breaker_data.version                           = 1;
+  circuit_breaker_data.half_open_instances["instance_0"] = 1;
+  service.SetCircuitBreakerData(circuit_breaker_data);
+  service_data_->IncrementRef();
+  ServiceInstances service_instances(service_data_);
+
+  // 忽略半开优先分配时，半开实例按权重1参与随机分配
+  Criteria criteria;
+  criteria.ignore_half_open_ = true;
+  std::map<std::string, int> choose_count;
+  for (int i = 0; i < 10100; ++i) {
+    Instance *instance = NULL;
+    ASSERT_EQ(load_balancer_->ChooseInstance(&service_instances, criteria, instance), kReturnOk);
+    choose_count[instance->GetId()]++;
+  }
+  ASSERT_LT(choose_count["instance_0"], 300);
+
+  // 半开优先分配，每20个请求释放一个半开请求
+  criteria.ignore_half_open_ = false;
+  TestUtils::FakeNowIncrement(60 * 1000);
+  Instance *instance = NULL;
+  for (int i = 0; i < 20; ++i) {
+    ASSERT_EQ(load_balancer_->ChooseInstance(&service_instances, criteria, instance), kReturnOk);
+  }
+  ASSERT_EQ(instance->GetId(), "instance_0");
+  TestUtils::TearDownFakeTime();
+}
+
+}  // namespace polaris
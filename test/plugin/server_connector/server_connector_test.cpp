@@ -24,8 +24,10 @@
 #include <string>
 #include <vector>
 
+#include "mock/fake_discover_server.h"
 #include "polaris/accessors.h"
 #include "polaris/provider.h"
+#include "sync/atomic.h"
 #include "test_context.h"
 #include "test_utils.h"
 #include "v1/code.pb.h"
@@ -353,4 +355,87 @@ TEST_F(GrpcServerConnectorTest, TestDiscoverMutilService) {
   usleep(1000);
 }
 
+class CountServiceEventHandler : public ServiceEventHandler {
+public:
+  CountServiceEventHandler(sync::Atomic<int> &update_count, sync::Atomic<int> &release_count)
+      : update_count_(update_count), release_count_(release_count) {}
+
+  virtual void OnEventUpdate(const ServiceKey & /*service_key*/, ServiceDataType /*data_type*/,
+                             void *data) {
+    if (data != NULL) {
+      reinterpret_cast<ServiceData *>(data)->DecrementRef();
+      update_count_++;
+    } else {
+      release_count_++;
+    }
+  }
+
+  virtual void OnEventSync(const ServiceKey & /*service_key*/, ServiceDataType /*data_type*/) {}
+
+private:
+  sync::Atomic<int> &update_count_;
+  sync::Atomic<int> &release_count_;
+};
+
+// 连接建立前注册的服务发现请求在连接建立后合并发送
+TEST_F(GrpcServerConnectorTest, TestDiscoverBatchRequest) {
+  FakeDiscoverServer discover_server;
+  ASSERT_TRUE(discover_server.Start());
+  std::string err_msg, content = "addresses: [127.0.0.1:" +
+                                 StringUtils::TypeToStr(discover_server.GetPort()) + "]";
+  Config *config = Config::CreateFromString(content, err_msg);
+  ASSERT_TRUE(config != NULL && err_msg.empty());
+  GrpcServerConnector connector;
+  sync::Atomic<int> update_count, release_count;
+  const int kServiceCount = 200;
+  for (int i = 0; i < kServiceCount; ++i) {
+    ServiceKey service_key = {service_namespace_, service_name_ + StringUtils::TypeToStr(i)};
+    connector.RegisterEventHandler(service_key, kServiceDataInstances, 60 * 1000,
+                                   new CountServiceEventHandler(update_count, release_count));
+  }
+  ASSERT_EQ(connector.Init(config, context_), kReturnOk);
+  delete config;
+  for (int i = 0; i < 500 && update_count < kServiceCount; ++i) {
+    usleep(10 * 1000);
+  }
+  ASSERT_EQ(update_count, kServiceCount);
+  ASSERT_EQ(discover_server.GetRequestCount(), kServiceCount);
+  // 请求合并后只需要少量数据帧
+  ASSERT_LT(discover_server.GetDataFrameCount(), kServiceCount / 10);
+}
+
+// 配置解码线程后，应答在解码线程中解析并执行回调
+TEST_F(GrpcServerConnectorTest, TestDiscoverDecodeThreads) {
+  FakeDiscoverServer discover_server;
+  ASSERT_TRUE(discover_server.Start());
+  std::string err_msg, content = "addresses: [127.0.0.1:" +
+                                 StringUtils::TypeToStr(discover_server.GetPort()) +
+                                 "]\ndiscoverDecodeThreads: 2";
+  Config *config = Config::CreateFromString(content, err_msg);
+  ASSERT_TRUE(config != NULL && err_msg.empty());
+  GrpcServerConnector connector;
+  ASSERT_EQ(connector.Init(config, context_), kReturnOk);
+  delete config;
+  sync::Atomic<int> update_count, release_count;
+  const int kServiceCount = 200;
+  for (int i = 0; i < kServiceCount; ++i) {
+    ServiceKey service_key = {service_namespace_, service_name_ + StringUtils::TypeToStr(i)};
+    connector.RegisterEventHandler(service_key, kServiceDataInstances, 60 * 1000,
+                                   new CountServiceEventHandler(update_count, release_count));
+  }
+  for (int i = 0; i < 500 && update_count < kServiceCount; ++i) {
+    usleep(10 * 1000);
+  }
+  ASSERT_EQ(update_count, kServiceCount);
+  // 反注册在服务对应的解码线程中释放数据，排在该服务的更新之后
+  for (int i = 0; i < kServiceCount; ++i) {
+    ServiceKey service_key = {service_namespace_, service_name_ + StringUtils::TypeToStr(i)};
+    connector.DeregisterEventHandler(service_key, kServiceDataInstances);
+  }
+  for (int i = 0; i < 500 && release_count < kServiceCount; ++i) {
+    usleep(10 * 1000);
+  }
+  ASSERT_EQ(release_count, kServiceCount);
+}
+
 }  // namespace polaris
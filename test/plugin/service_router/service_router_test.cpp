@@ -425,4 +425,70 @@ TEST_F(ServiceRouterChainTest, RouteRuleNotMatch) {
   EXPECT_EQ(service_route_->DecrementAndGetRef(), 0);
 }
 
+TEST_F(ServiceRouterChainTest, RouteResultCache) {
+  std::string err_msg;
+  Config *config = Config::CreateFromString(
+      "chain:\n  - nearbyBasedRouter\nenableResultCache: true", err_msg);
+  ASSERT_TRUE(config != NULL && err_msg.empty());
+  ASSERT_EQ(service_router_chain_->Init(config, context_), kReturnOk);
+  delete config;
+
+  v1::DiscoverResponse response;
+  FakeServer::CreateServiceInstances(response, service_key_, 10);
+  service_data_ = ServiceData::CreateFromPb(&response, kDataIsSyncing);
+  Service service(service_key_, 1);
+  service.UpdateData(service_data_);
+
+  // 相同输入第一次执行路由链，之后命中缓存，结果相同
+  InstancesSet *cached_result = NULL;
+  for (int i = 0; i < 3; i++) {
+    RouteInfo route_info(service_key_, NULL);
+    service_data_->IncrementRef();
+    route_info.SetServiceInstances(new ServiceInstances(service_data_));
+    RouteResult route_result;
+    ASSERT_EQ(service_router_chain_->DoRoute(route_info, &route_result), kReturnOk);
+    InstancesSet *result = route_result.GetServiceInstances()->GetAvailableInstances();
+    ASSERT_EQ(result->GetInstances().size(), 10);
+    if (cached_result == NULL) {
+      cached_result = result;
+    } else {
+      ASSERT_EQ(result, cached_result);
+    }
+  }
+
+  // 请求标志不同，不能命中缓存
+  RouteInfo route_info(service_key_, NULL);
+  route_info.SetIncludeUnhealthyInstances();
+  service_data_->IncrementRef();
+  route_info.SetServiceInstances(new ServiceInstances(service_data_));
+  RouteResult route_result;
+  ASSERT_EQ(service_router_chain_->DoRoute(route_info, &route_result), kReturnOk);
+
+  // metadata路由参数不同，不能命中缓存
+  for (int i = 0; i < 2; i++) {
+    RouteInfo metadata_route_info(service_key_, NULL);
+    MetadataRouterParam metadata_param;
+    metadata_param.metadata_["env"] = i == 0 ? "base" : "test";
+    metadata_route_info.SetMetadataPara(metadata_param);
+    service_data_->IncrementRef();
+    metadata_route_info.SetServiceInstances(new ServiceInstances(service_data_));
+    RouteResult metadata_route_result;
+    ASSERT_EQ(service_router_chain_->DoRoute(metadata_route_info, &metadata_route_result),
+              kReturnOk);
+  }
+
+  ServiceKey service_key;
+  std::map<std::string, RouterStatData *> stat_data;
+  service_router_chain_->CollectStat(service_key, stat_data);
+  ASSERT_EQ(stat_data.size(), 1);
+  RouterStatData *data = stat_data[ServiceRouterConfig::kChainResultCacheStatName];
+  ASSERT_TRUE(data != NULL);
+  ASSERT_EQ(data->record_.results_size(), 2);
+  ASSERT_EQ(data->record_.results(0).ret_code(), "CacheHit");
+  ASSERT_EQ(data->record_.results(0).period_times(), 2);
+  ASSERT_EQ(data->record_.results(1).ret_code(), "CacheMiss");
+  ASSERT_EQ(data->record_.results(1).period_times(), 4);
+  delete data;
+}
+
 }  // namespace polaris
@@ -154,4 +154,99 @@ TEST_F(StatReporterTest, MultiThreadWithStopTest) {
   }
 }
 
+TEST_F(StatReporterTest, ManyRetCodeTest) {
+  InstanceGauge instance_gauge;
+  instance_gauge.service_namespace = "namespace";
+  instance_gauge.service_name      = "service";
+  instance_gauge.instance_id       = "instance_0";
+  instance_gauge.call_daley        = 1;
+  // 返回码数超过线程统计表大小时走慢路径统计
+  for (int run = 0; run < 3; ++run) {
+    for (int i = 0; i < 100; ++i) {
+      instance_gauge.call_ret_code = i % 20;
+      stat_reporter_->ReportStat(instance_gauge);
+    }
+    ASSERT_TRUE(stat_reporter_->PerpareReport());
+    std::map<ServiceKey, ServiceStat> report_data;
+    stat_reporter_->CollectData(report_data);
+    ASSERT_EQ(report_data.size(), 1);
+    ServiceStat &service_stat = report_data.begin()->second;
+    ASSERT_EQ(service_stat.size(), 1);
+    InstanceStat &instance_stat = service_stat["instance_0"];
+    ASSERT_EQ(instance_stat.ret_code_stat_.size(), 20);
+    for (int i = 0; i < 20; ++i) {
+      ASSERT_EQ(instance_stat.ret_code_stat_[i].success_count_, 5);
+      ASSERT_EQ(instance_stat.ret_code_stat_[i].success_delay_, 5);
+    }
+  }
+}
+
+TEST_F(StatReporterTest, ManyInstanceTest) {
+  InstanceGauge instance_gauge;
+  instance_gauge.service_namespace = "namespace";
+  instance_gauge.call_daley        = 1;
+  // 实例数超过上限时走慢路径统计
+  int instance_count = kCallStatMaxInstances + 100;
+  for (int i = 0; i < instance_count; ++i) {
+    instance_gauge.service_name = "service_" + StringUtils::TypeToStr<int>(i % 2);
+    instance_gauge.instance_id  = "instance_" + StringUtils::TypeToStr<int>(i);
+    stat_reporter_->ReportStat(instance_gauge);
+  }
+  ASSERT_TRUE(stat_reporter_->PerpareReport());
+  std::map<ServiceKey, ServiceStat> report_data;
+  stat_reporter_->CollectData(report_data);
+  ASSERT_EQ(report_data.size(), 2);
+  std::size_t total = 0;
+  for (std::map<ServiceKey, ServiceStat>::iterator it = report_data.begin();
+       it != report_data.end(); ++it) {
+    total += it->second.size();
+  }
+  ASSERT_EQ(total, instance_count);
+  report_data.clear();
+  stat_reporter_->CollectData(report_data);
+  ASSERT_TRUE(report_data.empty());
+
+  // 空闲实例的下标释放后可以给新实例使用
+  stat_reporter_->CollectData(report_data);
+  for (int i = 0; i < instance_count; ++i) {
+    instance_gauge.service_name = "service_new";
+    instance_gauge.instance_id  = "instance_new_" + StringUtils::TypeToStr<int>(i);
+    stat_reporter_->ReportStat(instance_gauge);
+  }
+  report_data.clear();
+  stat_reporter_->CollectData(report_data);
+  ASSERT_EQ(report_data.size(), 1);
+  ASSERT_EQ(report_data.begin()->second.size(), instance_count);
+}
+
+TEST(CallStatIndexTest, ReleaseIdleIndex) {
+  CallStatIndex call_stat_index;
+  InstanceGauge instance_gauge;
+  instance_gauge.service_namespace = "namespace";
+  instance_gauge.service_name      = "service";
+  instance_gauge.instance_id       = "instance_0";
+  uint32_t index                   = call_stat_index.GetIndex(instance_gauge);
+  ASSERT_EQ(call_stat_index.GetIndex(instance_gauge), index);
+  std::vector<bool> active_indexes(kCallStatMaxInstances, false);
+  call_stat_index.EndPeriod(active_indexes, call_stat_index.GetPeriod());  // 本周期分配的下标不释放
+  ASSERT_TRUE(call_stat_index.GetKey(index) != NULL);
+  active_indexes[index] = true;
+  call_stat_index.EndPeriod(active_indexes, call_stat_index.GetPeriod());
+  ASSERT_TRUE(call_stat_index.GetKey(index) != NULL);
+
+  active_indexes[index] = false;
+  call_stat_index.EndPeriod(active_indexes, call_stat_index.GetPeriod());  // 一个周期没有调用则释放
+  ASSERT_TRUE(call_stat_index.GetKey(index) == NULL);
+  instance_gauge.instance_id = "instance_1";
+  uint32_t new_index         = call_stat_index.GetIndex(instance_gauge);
+  ASSERT_NE(new_index, index);  // 释放的下标延迟一个周期复用
+  active_indexes[new_index] = true;
+  call_stat_index.EndPeriod(active_indexes, call_stat_index.GetPeriod());
+  instance_gauge.instance_id = "instance_2";
+  ASSERT_EQ(call_stat_index.GetIndex(instance_gauge), index);
+  ASSERT_EQ(call_stat_index.GetKey(index)->instance_id_, "instance_2");
+  instance_gauge.instance_id = "instance_1";
+  ASSERT_EQ(call_stat_index.GetIndex(instance_gauge), new_index);
+}
+
 }  // namespace polaris
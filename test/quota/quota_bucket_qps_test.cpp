@@ -18,6 +18,9 @@
 #include "quota/quota_bucket_qps.h"
 
 #include <gtest/gtest.h>
+#include <pthread.h>
+
+#include <vector>
 
 #include "polaris/limit.h"
 #include "quota/rate_limit_window.h"
@@ -132,6 +135,125 @@ TEST_F(TokenBucketTest, RefreshTokenWithLeft) {
   }
 }
 
+TEST(StripedTokenBucketTest, SmallQuotaNotStriped) {
+  RateLimitAmount amount;
+  amount.max_amount_     = 100;
+  amount.valid_duration_ = 1000;
+  uint64_t current_time  = Time::GetCurrentTimeMs();
+  TokenBucket token_bucket;
+  token_bucket.Init(amount, current_time, amount.max_amount_, 8);
+  uint64_t expect_bucket_time = current_time / amount.valid_duration_;
+  int64_t left_quota;
+  // 配额过小时不分段预取，剩余配额精确
+  for (uint32_t i = 0; i < amount.max_amount_; ++i) {
+    ASSERT_TRUE(token_bucket.GetToken(1, expect_bucket_time, false, left_quota));
+    ASSERT_EQ(left_quota, amount.max_amount_ - i - 1);
+  }
+  ASSERT_FALSE(token_bucket.GetToken(1, expect_bucket_time, false, left_quota));
+  ASSERT_EQ(left_quota, -1);
+}
+
+TEST(StripedTokenBucketTest, SingleThreadUseUp) {
+  RateLimitAmount amount;
+  amount.max_amount_     = 100000;
+  amount.valid_duration_ = 1000;
+  uint64_t current_time  = Time::GetCurrentTimeMs();
+  TokenBucket token_bucket;
+  token_bucket.Init(amount, current_time, amount.max_amount_, 4);
+  uint64_t expect_bucket_time = current_time / amount.valid_duration_;
+  int64_t left_quota;
+  for (uint32_t i = 0; i < amount.max_amount_; ++i) {
+    ASSERT_TRUE(token_bucket.GetToken(1, expect_bucket_time, false, left_quota));
+  }
+  for (int i = 0; i < 10; ++i) {  // 失败后与非分段模式一样需要归还
+    ASSERT_FALSE(token_bucket.GetToken(1, expect_bucket_time, false, left_quota));
+    token_bucket.ReturnToken(1, false);
+  }
+  // 成功后归还的配额可以再次分配
+  token_bucket.ReturnToken(1, false);
+  ASSERT_TRUE(token_bucket.GetToken(1, expect_bucket_time, false, left_quota));
+  ASSERT_FALSE(token_bucket.GetToken(1, expect_bucket_time, false, left_quota));
+  token_bucket.ReturnToken(1, false);
+
+  // 进入下个周期后分段中旧周期预取的令牌失效，重新按周期配额分配
+  for (uint32_t i = 0; i < amount.max_amount_; ++i) {
+    ASSERT_TRUE(token_bucket.GetToken(1, expect_bucket_time + 1, false, left_quota));
+  }
+  ASSERT_FALSE(token_bucket.GetToken(1, expect_bucket_time + 1, false, left_quota));
+}
+
+TEST(StripedTokenBucketTest, LeasedTokenNotCountedAsUsed) {
+  RateLimitAmount amount;
+  amount.max_amount_     = 100000;
+  amount.valid_duration_ = 1000;
+  uint64_t current_time  = Time::GetCurrentTimeMs();
+  TokenBucket token_bucket;
+  token_bucket.Init(amount, current_time, amount.max_amount_, 4);
+  uint64_t expect_bucket_time = current_time / amount.valid_duration_;
+  int64_t left_quota;
+  // 分段中预取未使用的令牌不计入已使用配额
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_TRUE(token_bucket.GetToken(1, expect_bucket_time, false, left_quota));
+    ASSERT_EQ(left_quota, amount.max_amount_ - i - 1);
+  }
+  ASSERT_EQ(token_bucket.GetLeftQuota(expect_bucket_time, false), amount.max_amount_ - 10);
+  token_bucket.ReturnToken(1, false);
+  ASSERT_EQ(token_bucket.GetLeftQuota(expect_bucket_time, false), amount.max_amount_ - 9);
+
+  // 本地配额变更时分段中的令牌归还到周期计数
+  token_bucket.UpdateLocalMaxAmount(amount.max_amount_ / 2);
+  ASSERT_EQ(token_bucket.GetLeftQuota(expect_bucket_time, false), amount.max_amount_ / 2 - 9);
+}
+
+struct StripedTokenArg {
+  TokenBucket* token_bucket_;
+  uint64_t expect_bucket_time_;
+  int acquire_times_;
+  int acquired_;
+};
+
+void* AcquireStripedToken(void* arg) {
+  StripedTokenArg* token_arg = static_cast<StripedTokenArg*>(arg);
+  int64_t left_quota;
+  for (int i = 0; i < token_arg->acquire_times_; ++i) {
+    if (token_arg->token_bucket_->GetToken(1, token_arg->expect_bucket_time_, false, left_quota)) {
+      token_arg->acquired_++;
+    } else {
+      token_arg->token_bucket_->ReturnToken(1, false);
+    }
+  }
+  return NULL;
+}
+
+TEST(StripedTokenBucketTest, MultiThreadUseUp) {
+  RateLimitAmount amount;
+  amount.max_amount_     = 200000;
+  amount.valid_duration_ = 1000;
+  uint64_t current_time  = Time::GetCurrentTimeMs();
+  int stripe_count       = 4;
+  TokenBucket token_bucket;
+  token_bucket.Init(amount, current_time, amount.max_amount_, stripe_count);
+
+  int thread_num = 8;
+  std::vector<StripedTokenArg> args(thread_num);
+  std::vector<pthread_t> thread_list(thread_num);
+  for (int i = 0; i < thread_num; ++i) {
+    args[i].token_bucket_       = &token_bucket;
+    args[i].expect_bucket_time_ = current_time / amount.valid_duration_;
+    args[i].acquire_times_      = amount.max_amount_ / thread_num * 2;
+    args[i].acquired_           = 0;
+    pthread_create(&thread_list[i], NULL, AcquireStripedToken, &args[i]);
+  }
+  int64_t total_acquired = 0;
+  for (int i = 0; i < thread_num; ++i) {
+    pthread_join(thread_list[i], NULL);
+    total_acquired += args[i].acquired_;
+  }
+  // 不会超额分配，并发时少分配的配额不超过所有分段一次预取的令牌数
+  ASSERT_LE(total_acquired, amount.max_amount_);
+  ASSERT_GE(total_acquired, amount.max_amount_ - amount.max_amount_ / 64);
+}
+
 class QuotaBucketQpsTest : public ::testing::Test {
 protected:
   void SetUp() {
@@ -169,26 +291,27 @@ void QuotaBucketQpsTest::InitRateLimitRule(RateLimitRule &rate_limit_rule) {
 
 TEST_F(QuotaBucketQpsTest, AllocateMulti) {
   LimitAllocateResult limit_result;
-  QuotaResponse *response =
-      qps_bucket_->Allocate(acquire_amount_, Time::GetCurrentTimeMs(), &limit_result);
-  ASSERT_EQ(response->GetResultCode(), kQuotaResultOk);
+  QuotaResultInfo info;
+  ASSERT_EQ(qps_bucket_->Allocate(acquire_amount_, Time::GetCurrentTimeMs(), info, &limit_result),
+            kQuotaResultOk);
   ASSERT_EQ(limit_result.violate_duration_, 0);
-  delete response;
   acquire_amount_ = 39;
-  response        = qps_bucket_->Allocate(acquire_amount_, Time::GetCurrentTimeMs(), &limit_result);
-  ASSERT_EQ(response->GetResultCode(), kQuotaResultLimited);
+  ASSERT_EQ(qps_bucket_->Allocate(acquire_amount_, Time::GetCurrentTimeMs(), info, &limit_result),
+            kQuotaResultLimited);
   ASSERT_EQ(limit_result.violate_duration_, 1000);
-  delete response;
+  ASSERT_EQ(limit_result.violate_index_, 0);
+  ASSERT_EQ(info.left_quota_, 0);
+  ASSERT_EQ(info.duration_, 1000);
 }
 
 TEST_F(QuotaBucketQpsTest, AllocateBeforeInit) {
   LimitAllocateResult limit_result;
   for (int i = 0; i < 20; ++i) {
-    QuotaResponse *response =
-        qps_bucket_->Allocate(acquire_amount_, Time::GetCurrentTimeMs(), &limit_result);
-    ASSERT_EQ(response->GetResultCode(), i < 10 ? kQuotaResultOk : kQuotaResultLimited);
+    QuotaResultInfo info;
+    QuotaResultCode result_code =
+        qps_bucket_->Allocate(acquire_amount_, Time::GetCurrentTimeMs(), info, &limit_result);
+    ASSERT_EQ(result_code, i < 10 ? kQuotaResultOk : kQuotaResultLimited);
     ASSERT_EQ(limit_result.violate_duration_, i < 10 ? 0 : 1000);
-    delete response;
   }
 }
 
@@ -204,10 +327,10 @@ TEST_F(QuotaBucketQpsTest, AllocateWithExpired) {
       qps_bucket_->SetRemoteQuota(result);
     }
     for (int i = 0; i < 20; ++i) {
-      QuotaResponse *response =
-          qps_bucket_->Allocate(acquire_amount_, Time::GetCurrentTimeMs(), &limit_result);
-      ASSERT_EQ(response->GetResultCode(), i < 10 ? kQuotaResultOk : kQuotaResultLimited);
-      delete response;
+      QuotaResultInfo info;
+      QuotaResultCode result_code =
+          qps_bucket_->Allocate(acquire_amount_, Time::GetCurrentTimeMs(), info, &limit_result);
+      ASSERT_EQ(result_code, i < 10 ? kQuotaResultOk : kQuotaResultLimited);
     }
     TestUtils::FakeNowIncrement(1000);  // quota未更新会过期
   }
@@ -223,11 +346,11 @@ TEST_F(QuotaBucketQpsTest, AllocateAfterInit) {
   qps_bucket_->SetRemoteQuota(result);
   LimitAllocateResult limit_result;
   for (int i = 0; i < 10; ++i) {
-    QuotaResponse *response =
-        qps_bucket_->Allocate(acquire_amount_, Time::GetCurrentTimeMs(), &limit_result);
-    ASSERT_EQ(response->GetResultCode(), i < 5 ? kQuotaResultOk : kQuotaResultLimited);
+    QuotaResultInfo info;
+    QuotaResultCode result_code =
+        qps_bucket_->Allocate(acquire_amount_, Time::GetCurrentTimeMs(), info, &limit_result);
+    ASSERT_EQ(result_code, i < 5 ? kQuotaResultOk : kQuotaResultLimited);
     ASSERT_EQ(limit_result.violate_duration_, i < 5 ? 0 : 1000);
-    delete response;
     if (i == 1) {  // 第40%*5次时触发上报
       uint64_t current_server_time = Time::GetCurrentTimeMs();
       QuotaUsageInfo *usage        = qps_bucket_->GetQuotaUsage(current_server_time);
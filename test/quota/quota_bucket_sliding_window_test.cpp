@@ -0,0 +1,211 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#include "quota/quota_bucket_sliding_window.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "polaris/limit.h"
+#include "quota/model/rate_limit_rule.h"
+#include "quota/rate_limit_window.h"
+#include "test_utils.h"
+#include "utils/time_clock.h"
+
+namespace polaris {
+
+TEST(SlidingWindowCounterTest, WeightedPreviousUsage) {
+  SlidingWindowCounter counter;
+  ASSERT_EQ(counter.WeightedPreviousUsage(6000, 1000), 0);
+  counter.RecordUsage(5, 40);
+  counter.RecordUsage(5, 100);
+  counter.RecordUsage(5, 60);  // 同一周期只保留最大值
+  ASSERT_EQ(counter.WeightedPreviousUsage(5500, 1000), 0);
+  ASSERT_EQ(counter.WeightedPreviousUsage(6000, 1000), 100);
+  ASSERT_EQ(counter.WeightedPreviousUsage(6500, 1000), 50);
+  ASSERT_EQ(counter.WeightedPreviousUsage(6999, 1000), 0);
+  ASSERT_EQ(counter.WeightedPreviousUsage(7000, 1000), 0);  // 两个周期前的使用量不再计算
+
+  counter.RecordUsage(7, 10);  // 覆盖两个周期前的数据
+  ASSERT_EQ(counter.WeightedPreviousUsage(8200, 1000), 8);
+  ASSERT_EQ(counter.WeightedPreviousUsage(6000, 1000), 0);
+}
+
+// 设置本地配额，模拟全局模式下按实例数分摊的本地配额
+class LocalAmountSlidingWindowBucket : public RemoteAwareSlidingWindowBucket {
+public:
+  explicit LocalAmountSlidingWindowBucket(RateLimitRule *rule)
+      : RemoteAwareSlidingWindowBucket(rule) {}
+
+  void SetLocalMaxAmount(uint64_t duration, int64_t local_max_amount) {
+    FindBucket(duration)->UpdateLocalMaxAmount(local_max_amount);
+  }
+};
+
+class QuotaBucketSlidingWindowTest : public ::testing::Test {
+protected:
+  void SetUp() {
+    TestUtils::SetUpFakeTime();
+    // 从下一个整秒开始，便于控制周期内的时间
+    begin_time_ = (Time::GetCurrentTimeMs() / 1000 + 1) * 1000;
+  }
+
+  void TearDown() { TestUtils::TearDownFakeTime(); }
+
+  static void InitRateLimitRule(RateLimitRule &rate_limit_rule, v1::Rule::Type type,
+                                const char *action) {
+    v1::Rule rule;
+    rule.set_type(type);
+    rule.mutable_action()->set_value(action);
+    v1::Amount *amount = rule.add_amounts();
+    amount->mutable_maxamount()->set_value(100);
+    amount->mutable_validduration()->set_seconds(1);
+    ASSERT_TRUE(rate_limit_rule.Init(rule));
+  }
+
+  // 只在每隔一个周期边界的前后100ms内每1ms请求5次，返回所有1s时间段内通过请求数的最大值
+  static int MaxPassInOneSecond(RemoteAwareBucket &bucket, uint64_t begin_time) {
+    std::vector<int> pass_per_ms(5000, 0);
+    for (uint64_t ms = 0; ms < pass_per_ms.size(); ++ms) {
+      if (ms % 2000 < 900 || ms % 2000 >= 1100) {
+        continue;
+      }
+      for (int i = 0; i < 5; ++i) {
+        LimitAllocateResult limit_result;
+        QuotaResultInfo info;
+        if (bucket.Allocate(1, begin_time + ms, info, &limit_result) == kQuotaResultOk) {
+          pass_per_ms[ms]++;
+        }
+      }
+    }
+    int max_pass = 0;
+    int pass     = 0;
+    for (std::size_t ms = 0; ms < pass_per_ms.size(); ++ms) {
+      pass += pass_per_ms[ms];
+      if (ms >= 1000) {
+        pass -= pass_per_ms[ms - 1000];
+      }
+      max_pass = pass > max_pass ? pass : max_pass;
+    }
+    return max_pass;
+  }
+
+protected:
+  uint64_t begin_time_;
+};
+
+TEST_F(QuotaBucketSlidingWindowTest, InitRuleWithSlidingWindowAction) {
+  RateLimitRule rate_limit_rule;
+  InitRateLimitRule(rate_limit_rule, v1::Rule::LOCAL, "sliding_window");
+  ASSERT_EQ(rate_limit_rule.GetActionType(), kRateLimitActionSlidingWindow);
+  ASSERT_EQ(rate_limit_rule.GetActionString(), "sliding_window");
+}
+
+TEST_F(QuotaBucketSlidingWindowTest, BoundaryBurst) {
+  RateLimitRule rate_limit_rule;
+  InitRateLimitRule(rate_limit_rule, v1::Rule::LOCAL, "sliding_window");
+  RemoteAwareSlidingWindowBucket sliding_bucket(&rate_limit_rule);
+  LimitAllocateResult limit_result;
+  QuotaResultInfo info;
+  // 周期末尾用完配额
+  for (int i = 0; i < 101; ++i) {
+    ASSERT_EQ(sliding_bucket.Allocate(1, begin_time_ + 900, info, &limit_result),
+              i < 100 ? kQuotaResultOk : kQuotaResultLimited);
+  }
+  // 下个周期开始时上个周期的使用量仍占用99%的配额
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_EQ(sliding_bucket.Allocate(1, begin_time_ + 1010, info, &limit_result),
+              i < 1 ? kQuotaResultOk : kQuotaResultLimited);
+  }
+  ASSERT_EQ(limit_result.violate_duration_, 1000);
+  // 周期过半时上个周期的使用量占用50%的配额
+  for (int i = 0; i < 50; ++i) {
+    ASSERT_EQ(sliding_bucket.Allocate(1, begin_time_ + 1500, info, &limit_result),
+              i < 49 ? kQuotaResultOk : kQuotaResultLimited);
+  }
+  ASSERT_EQ(info.left_quota_, 0);
+}
+
+TEST_F(QuotaBucketSlidingWindowTest, CompareWithFixedWindow) {
+  RateLimitRule rate_limit_rule;
+  InitRateLimitRule(rate_limit_rule, v1::Rule::LOCAL, "sliding_window");
+  RemoteAwareQpsBucket qps_bucket(&rate_limit_rule);
+  // 固定窗口在周期边界前后各放过一个周期的配额
+  ASSERT_EQ(MaxPassInOneSecond(qps_bucket, begin_time_), 200);
+
+  RemoteAwareSlidingWindowBucket sliding_bucket(&rate_limit_rule);
+  int max_pass = MaxPassInOneSecond(sliding_bucket, begin_time_);
+  ASSERT_GE(max_pass, 100);
+  ASSERT_LE(max_pass, 110);
+}
+
+TEST_F(QuotaBucketSlidingWindowTest, RemoteQuotaSync) {
+  RateLimitRule rate_limit_rule;
+  InitRateLimitRule(rate_limit_rule, v1::Rule::GLOBAL, "sliding_window");
+  TestUtils::FakeNowIncrement(begin_time_ + 800 - Time::GetCurrentTimeMs());
+  RemoteAwareSlidingWindowBucket sliding_bucket(&rate_limit_rule);
+  // 远程配额显示集群已经使用了80个配额
+  RemoteQuotaResult result;
+  result.local_usage_                                      = NULL;
+  result.curret_server_time_                               = Time::GetCurrentTimeMs();
+  result.remote_usage_.create_server_time_                 = result.curret_server_time_;
+  result.remote_usage_.quota_usage_[1000].quota_allocated_ = 20;
+  sliding_bucket.SetRemoteQuota(result);
+  LimitAllocateResult limit_result;
+  QuotaResultInfo info;
+  for (int i = 0; i < 21; ++i) {
+    ASSERT_EQ(sliding_bucket.Allocate(1, Time::GetCurrentTimeMs(), info, &limit_result),
+              i < 20 ? kQuotaResultOk : kQuotaResultLimited);
+    ASSERT_TRUE(limit_result.use_remote_quota_);
+  }
+
+  // 下个周期开始时远程配额重置，按集群在上个周期的使用量限流
+  TestUtils::FakeNowIncrement(300);
+  result.curret_server_time_                               = Time::GetCurrentTimeMs();
+  result.remote_usage_.create_server_time_                 = result.curret_server_time_;
+  result.remote_usage_.quota_usage_[1000].quota_allocated_ = 100;
+  sliding_bucket.SetRemoteQuota(result);
+  for (int i = 0; i < 11; ++i) {
+    ASSERT_EQ(sliding_bucket.Allocate(1, Time::GetCurrentTimeMs(), info, &limit_result),
+              i < 10 ? kQuotaResultOk : kQuotaResultLimited);
+  }
+  // 只上报实际分配的配额，被滑动窗口拒绝的请求不占用远程配额
+  QuotaUsageInfo *usage = sliding_bucket.GetQuotaUsage(Time::GetCurrentTimeMs());
+  ASSERT_EQ(usage->quota_usage_[1000].quota_allocated_, 10);
+  delete usage;
+}
+
+TEST_F(QuotaBucketSlidingWindowTest, DegradedGlobalRule) {
+  RateLimitRule rate_limit_rule;
+  InitRateLimitRule(rate_limit_rule, v1::Rule::GLOBAL, "sliding_window");
+  LocalAmountSlidingWindowBucket sliding_bucket(&rate_limit_rule);
+  sliding_bucket.SetLocalMaxAmount(1000, 50);  // 两个实例分摊全局配额
+  LimitAllocateResult limit_result;
+  QuotaResultInfo info;
+  // 没有同步远程配额，降级使用本地配额
+  for (int i = 0; i < 51; ++i) {
+    ASSERT_EQ(sliding_bucket.Allocate(1, begin_time_ + 1900, info, &limit_result),
+              i < 50 ? kQuotaResultOk : kQuotaResultLimited);
+    ASSERT_TRUE(limit_result.is_degrade_);
+    ASSERT_FALSE(limit_result.use_remote_quota_);
+  }
+  // 上个周期的使用量按本地配额计算，周期过半时占用25个配额
+  for (int i = 0; i < 26; ++i) {
+    ASSERT_EQ(sliding_bucket.Allocate(1, begin_time_ + 2500, info, &limit_result),
+              i < 25 ? kQuotaResultOk : kQuotaResultLimited)
+        << i;
+  }
+}
+
+}  // namespace polaris
@@ -226,4 +226,68 @@ TEST(RateLimitRuleTest, RuleIndex) {
   }
 }
 
+TEST(RateLimitRuleTest, RuleIndexMatchFirstRule) {
+  RateLimitData limit_data;
+  srand(time(NULL));
+  for (int i = 0; i < 200; ++i) {
+    v1::Rule rule;
+    InitRuleAmount(rule);
+    rule.mutable_id()->set_value(StringUtils::TypeToStr(i));
+    rule.mutable_priority()->set_value(rand() % 3);
+    for (int j = 0; j < 3; ++j) {
+      v1::MatchString match_string;
+      switch (rand() % 4) {
+        case 0:
+          continue;  // 不设置该label
+        case 1:
+          match_string.set_type(v1::MatchString::EXACT);
+          match_string.mutable_value()->set_value("v" + StringUtils::TypeToStr(rand() % 5));
+          break;
+        case 2:
+          match_string.set_type(v1::MatchString::REGEX);
+          match_string.mutable_value()->set_value("v[0-" + StringUtils::TypeToStr(rand() % 5) +
+                                                  "]");
+          break;
+        default:
+          match_string.set_type(v1::MatchString::EXACT);
+          match_string.set_value_type(v1::MatchString::PARAMETER);
+          break;
+      }
+      (*rule.mutable_labels())["k" + StringUtils::TypeToStr(j)] = match_string;
+    }
+    if (rand() % 2 == 0) {
+      v1::MatchString match_string;
+      match_string.set_type(v1::MatchString::REGEX);
+      match_string.mutable_value()->set_value("^s" + StringUtils::TypeToStr(rand() % 3) + "$");
+      (*rule.mutable_subset())["set"] = match_string;
+    }
+    RateLimitRule* rate_limit_rule = new RateLimitRule();
+    ASSERT_TRUE(rate_limit_rule->Init(rule));
+    limit_data.AddRule(rate_limit_rule);
+  }
+  limit_data.SortByPriority();
+  limit_data.SetupIndexMap();
+  const std::vector<RateLimitRule*>& rules = limit_data.GetRules();
+  for (int i = 0; i < 1000; ++i) {
+    std::map<std::string, std::string> subset;
+    std::map<std::string, std::string> labels;
+    for (int j = 0; j < 3; ++j) {
+      if (rand() % 4 != 0) {
+        labels["k" + StringUtils::TypeToStr(j)] = "v" + StringUtils::TypeToStr(rand() % 6);
+      }
+    }
+    if (rand() % 4 != 0) {
+      subset["set"] = "s" + StringUtils::TypeToStr(rand() % 4);
+    }
+    // 索引查询结果与按优先级线性查找的结果一致
+    RateLimitRule* expect_rule = NULL;
+    for (std::size_t j = 0; j < rules.size() && expect_rule == NULL; ++j) {
+      if (rules[j]->IsMatch(subset, labels)) {
+        expect_rule = rules[j];
+      }
+    }
+    ASSERT_EQ(limit_data.MatchRule(subset, labels), expect_rule);
+  }
+}
+
 }  // namespace polaris
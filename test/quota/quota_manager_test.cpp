@@ -18,6 +18,10 @@
 
 #include <gtest/gtest.h>
 
+#include <map>
+#include <string>
+#include <vector>
+
 #include "mock/fake_server_response.h"
 #include "polaris/limit.h"
 #include "quota/quota_model.h"
@@ -140,6 +144,151 @@ TEST_F(QuotaManagerTest, GetQuotaWithRule) {
   ASSERT_EQ(service_rate_limit->DecrementAndGetRef(), 1);  // window里面会引用
 }
 
+static void SetQuotaRequest(QuotaRequest &req, const ServiceKey &service_key,
+                            const std::string &label_value) {
+  req.SetServiceNamespace(service_key.namespace_);
+  req.SetServiceName(service_key.name_);
+  req.SetTimeout(1000);
+  std::map<std::string, std::string> labels;
+  labels["label"] = label_value;
+  req.SetLabels(labels);
+  std::map<std::string, std::string> subset;
+  subset["subset"] = "value";
+  req.SetSubset(subset);
+}
+
+TEST_F(QuotaManagerTest, BatchGetQuotaAllOrNothing) {
+  CreateQuotaManager(true);
+  MockLocalRegistry *mock_local_registry = TestContext::SetupMockLocalRegistry(context_);
+  ASSERT_TRUE(mock_local_registry != NULL);
+  v1::DiscoverResponse response;
+  FakeServer::CreateServiceRateLimit(response, service_key_, 20);
+  v1::Amount *amount = response.mutable_ratelimit()->mutable_rules(0)->mutable_amounts(0);
+  amount->mutable_validduration()->set_seconds(3600);  // 使用较长的周期，避免测试过程中切换周期
+  ServiceData *service_rate_limit = ServiceData::CreateFromPb(&response, kDataIsSyncing);
+  mock_local_registry->service_data_list_.push_back(service_rate_limit);
+  std::vector<ReturnCode> return_code_list;
+  return_code_list.push_back(kReturnOk);
+  mock_local_registry->ExpectReturnData(return_code_list, service_key_);
+
+  // 正则规则按标签值区分窗口，两个请求对应两个窗口
+  QuotaRequest first_req;
+  SetQuotaRequest(first_req, service_key_, "v1");
+  QuotaRequest second_req;
+  SetQuotaRequest(second_req, service_key_, "v2");
+  QuotaInfo quota_info;
+  ASSERT_EQ(quota_manager_->PrepareQuotaInfo(first_req, &quota_info), kReturnOk);
+  QuotaResponseImpl quota_response;
+  for (int i = 0; i < 15; ++i) {  // 第二个窗口先用掉15个配额
+    ASSERT_EQ(quota_manager_->GetQuotaResponse(second_req, quota_info, quota_response), kReturnOk);
+    ASSERT_EQ(quota_response.result_code_, kQuotaResultOk);
+  }
+
+  std::vector<QuotaRequest *> requests;
+  requests.push_back(&first_req);
+  requests.push_back(&second_req);
+  std::vector<const QuotaInfo *> quota_infos(requests.size(), &quota_info);
+  std::vector<QuotaResultCode> results;
+  uint64_t wait_time = 0;
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_EQ(quota_manager_->BatchGetQuotaResponse(requests, quota_infos, results, wait_time),
+              kReturnOk);
+    ASSERT_EQ(results.size(), requests.size());
+    if (i < 5) {
+      ASSERT_EQ(results[0], kQuotaResultOk) << i;
+      ASSERT_EQ(results[1], kQuotaResultOk) << i;
+    } else {  // 第二个窗口配额用完，第一个窗口的配额被归还
+      ASSERT_EQ(results[0], kQuotaResultWait) << i;
+      ASSERT_EQ(results[1], kQuotaResultLimited) << i;
+    }
+    ASSERT_EQ(wait_time, 0);
+  }
+
+  // 第一个窗口只被批量请求成功时占用了5个配额
+  for (int i = 0; i < 16; ++i) {
+    ASSERT_EQ(quota_manager_->GetQuotaResponse(first_req, quota_info, quota_response), kReturnOk);
+    ASSERT_EQ(quota_response.result_code_, i < 15 ? kQuotaResultOk : kQuotaResultLimited) << i;
+  }
+  service_rate_limit->DecrementRef();
+}
+
+TEST_F(QuotaManagerTest, BatchGetQuotaMergeSameWindow) {
+  CreateQuotaManager(true);
+  MockLocalRegistry *mock_local_registry = TestContext::SetupMockLocalRegistry(context_);
+  ASSERT_TRUE(mock_local_registry != NULL);
+  v1::DiscoverResponse response;
+  FakeServer::CreateServiceRateLimit(response, service_key_, 10);
+  v1::Amount *amount = response.mutable_ratelimit()->mutable_rules(0)->mutable_amounts(0);
+  amount->mutable_validduration()->set_seconds(3600);
+  ServiceData *service_rate_limit = ServiceData::CreateFromPb(&response, kDataIsSyncing);
+  mock_local_registry->service_data_list_.push_back(service_rate_limit);
+  std::vector<ReturnCode> return_code_list;
+  return_code_list.push_back(kReturnOk);
+  mock_local_registry->ExpectReturnData(return_code_list, service_key_);
+
+  QuotaRequest first_req;
+  SetQuotaRequest(first_req, service_key_, "v1");
+  QuotaRequest same_window_req;
+  SetQuotaRequest(same_window_req, service_key_, "v1");
+  same_window_req.SetAcquireAmount(2);
+  QuotaRequest no_rule_req;  // 没有规则中的标签，不限流
+  no_rule_req.SetServiceNamespace(service_key_.namespace_);
+  no_rule_req.SetServiceName(service_key_.name_);
+  QuotaInfo quota_info;
+  ASSERT_EQ(quota_manager_->PrepareQuotaInfo(first_req, &quota_info), kReturnOk);
+
+  std::vector<QuotaRequest *> requests;
+  requests.push_back(&first_req);
+  requests.push_back(&no_rule_req);
+  requests.push_back(&same_window_req);
+  std::vector<const QuotaInfo *> quota_infos(requests.size(), &quota_info);
+  std::vector<QuotaResultCode> results;
+  uint64_t wait_time = 0;
+  for (int i = 0; i < 4; ++i) {  // 每次合并占用3个配额
+    ASSERT_EQ(quota_manager_->BatchGetQuotaResponse(requests, quota_infos, results, wait_time),
+              kReturnOk);
+    ASSERT_EQ(results.size(), requests.size());
+    QuotaResultCode expect_result = i < 3 ? kQuotaResultOk : kQuotaResultLimited;
+    ASSERT_EQ(results[0], expect_result) << i;
+    ASSERT_EQ(results[1], i < 3 ? kQuotaResultOk : kQuotaResultWait) << i;
+    ASSERT_EQ(results[2], expect_result) << i;
+  }
+  QuotaResponseImpl quota_response;
+  ASSERT_EQ(quota_manager_->GetQuotaResponse(first_req, quota_info, quota_response), kReturnOk);
+  ASSERT_EQ(quota_response.result_code_, kQuotaResultOk);
+  ASSERT_EQ(quota_manager_->GetQuotaResponse(first_req, quota_info, quota_response), kReturnOk);
+  ASSERT_EQ(quota_response.result_code_, kQuotaResultLimited);
+  service_rate_limit->DecrementRef();
+}
+
+TEST_F(QuotaManagerTest, BatchGetQuotaRejectUnirate) {
+  CreateQuotaManager(true);
+  MockLocalRegistry *mock_local_registry = TestContext::SetupMockLocalRegistry(context_);
+  ASSERT_TRUE(mock_local_registry != NULL);
+  v1::DiscoverResponse response;
+  FakeServer::CreateServiceRateLimit(response, service_key_, 10);
+  response.mutable_ratelimit()->mutable_rules(0)->mutable_action()->set_value("unirate");
+  ServiceData *service_rate_limit = ServiceData::CreateFromPb(&response, kDataIsSyncing);
+  mock_local_registry->service_data_list_.push_back(service_rate_limit);
+  std::vector<ReturnCode> return_code_list;
+  return_code_list.push_back(kReturnOk);
+  mock_local_registry->ExpectReturnData(return_code_list, service_key_);
+
+  QuotaRequest req;
+  SetQuotaRequest(req, service_key_, "v1");
+  QuotaInfo quota_info;
+  ASSERT_EQ(quota_manager_->PrepareQuotaInfo(req, &quota_info), kReturnOk);
+  std::vector<QuotaRequest *> requests;
+  requests.push_back(&req);
+  std::vector<const QuotaInfo *> quota_infos(requests.size(), &quota_info);
+  std::vector<QuotaResultCode> results;
+  uint64_t wait_time = 0;
+  // 匀速排队的排队时间无法归还，批量获取直接拒绝
+  ASSERT_EQ(quota_manager_->BatchGetQuotaResponse(requests, quota_infos, results, wait_time),
+            kReturnInvalidArgument);
+  service_rate_limit->DecrementRef();
+}
+
 TEST_F(QuotaManagerTest, PrepareQuotaInfo) {
   CreateQuotaManager(true);
 
@@ -18,9 +18,14 @@
 
 #include <gtest/gtest.h>
 
+#include <vector>
+
+#include "mock/fake_rate_limit_server.h"
 #include "quota/rate_limit_window.h"
 #include "test_context.h"
 #include "test_utils.h"
+#include "utils/string_utils.h"
+#include "utils/time_clock.h"
 #include "v1/code.pb.h"
 
 namespace polaris {
@@ -28,7 +33,8 @@ namespace polaris {
 class RateLimitConnectorForTest : public RateLimitConnector {
 public:
   RateLimitConnectorForTest(Reactor& reactor, Context* context)
-      : RateLimitConnector(reactor, context, 1000), server_host_("127.0.0.1") {}
+      : RateLimitConnector(reactor, context, 1000), server_host_("127.0.0.1"),
+        server_port_(8081) {}
 
   std::map<std::string, RateLimitConnection*>& GetConnectionMgr() { return connection_mgr_; }
 
@@ -41,12 +47,13 @@ protected:
     if (server_host_.empty()) {
       return kReturnInstanceNotFound;
     }
-    *instance = new Instance(hash_key, server_host_, 8081, 100);
+    *instance = new Instance(hash_key, server_host_, server_port_, 100);
     return kReturnOk;
   }
 
 public:
   std::string server_host_;
+  int server_port_;
 };
 
 class RateLimitConnectorTest : public ::testing::Test {
@@ -85,6 +92,41 @@ class RateLimitConnectorTest : public ::testing::Test {
     }
   }
 
+protected:
+  // 创建使用同一全局规则、标签不同的多个窗口
+  void CreateGlobalWindows(RateLimitRule& rate_limit_rule, int window_count,
+                           std::vector<RateLimitWindow*>& windows) {
+    v1::Rule rule;
+    rule.set_type(v1::Rule::GLOBAL);
+    v1::Amount* amount = rule.add_amounts();
+    amount->mutable_maxamount()->set_value(100);
+    amount->mutable_validduration()->set_seconds(1);
+    rule.mutable_namespace_()->set_value("Test");
+    rule.mutable_service()->set_value("service");
+    rule.mutable_id()->set_value("global_id");
+    ASSERT_TRUE(rate_limit_rule.Init(rule));
+    for (int i = 0; i < window_count; ++i) {
+      RateLimitWindowKey window_key;
+      window_key.regex_labels_ = "key:" + StringUtils::TypeToStr(i);
+      RateLimitWindow* window  = new RateLimitWindow(reactor_, NULL, window_key);
+      ASSERT_EQ(window->Init(NULL, &rate_limit_rule, "global_id#" + window_key.regex_labels_,
+                             connector_),
+                kReturnOk);
+      windows.push_back(window);
+    }
+  }
+
+  // 使用假时间时按步长推进时间，每步先执行到期任务再等待处理网络应答
+  void RunReactor(uint64_t run_time) {
+    const uint64_t kStepTime = 10;
+    for (uint64_t time = 0; time < run_time; time += kStepTime) {
+      TestUtils::FakeNowIncrement(kStepTime);
+      for (int i = 0; i < 2; ++i) {
+        reactor_.RunOnce();
+      }
+    }
+  }
+
 protected:
   Reactor reactor_;
   Context* context_;
@@ -186,4 +228,49 @@ TEST_F(RateLimitConnectorTest, WindowReconnectWithNoInstance) {
   ASSERT_EQ("127.0.0.2:8081", window_->GetConnectionId());
 }
 
+// 多个窗口的定时上报合并到少量消息中发送
+TEST_F(RateLimitConnectorTest, BatchReportWindows) {
+  TestUtils::SetUpFakeTime();
+  FakeRateLimitServer server;
+  ASSERT_TRUE(server.Start());
+  connector_->server_port_ = server.GetPort();
+  RateLimitRule rate_limit_rule;
+  const int kWindowCount = 100;
+  std::vector<RateLimitWindow*> windows;
+  CreateGlobalWindows(rate_limit_rule, kWindowCount, windows);
+  RunReactor(1000);
+  ASSERT_EQ(server.GetInitCount(), kWindowCount);
+  // 默认上报间隔为40~56ms，每个窗口在1s内上报多次
+  int quota_sum_count = server.GetQuotaSumCount();
+  ASSERT_GE(quota_sum_count, kWindowCount * 10);
+  // 逐个窗口上报时消息数等于上报的计数器数，合并后每个消息平均包含十个以上的窗口
+  ASSERT_LE(server.GetReportCount() * 10, quota_sum_count);
+  for (std::size_t i = 0; i < windows.size(); ++i) {
+    windows[i]->DecrementRef();
+  }
+  server.Stop();  // 服务线程使用假时间，先停止服务
+  TestUtils::TearDownFakeTime();
+}
+
+// 合并上报的应答超时后窗口重新初始化
+TEST_F(RateLimitConnectorTest, BatchReportTimeout) {
+  TestUtils::SetUpFakeTime();
+  FakeRateLimitServer server;
+  ASSERT_TRUE(server.Start());
+  connector_->server_port_ = server.GetPort();
+  RateLimitRule rate_limit_rule;
+  const int kWindowCount = 10;
+  std::vector<RateLimitWindow*> windows;
+  CreateGlobalWindows(rate_limit_rule, kWindowCount, windows);
+  server.SetDropReport(true);
+  RunReactor(1500);  // 超过上报超时时间
+  ASSERT_GT(server.GetReportCount(), 0);
+  ASSERT_GT(server.GetInitCount(), kWindowCount);
+  for (std::size_t i = 0; i < windows.size(); ++i) {
+    windows[i]->DecrementRef();
+  }
+  server.Stop();  // 服务线程使用假时间，先停止服务
+  TestUtils::TearDownFakeTime();
+}
+
 }  // namespace polaris
@@ -21,6 +21,7 @@
 
 #include "metric/metric_connector.h"
 #include "polaris/limit.h"
+#include "quota/quota_model.h"
 #include "quota/rate_limit_connector.h"
 #include "test_context.h"
 #include "test_utils.h"
@@ -96,11 +97,10 @@ TEST_F(RateLimitWindowTest, WindowWithLocalRule) {
   ASSERT_EQ(window_->WaitRemoteInit(0), kReturnOk);
   for (int i = 0; i < 10; i++) {
     for (int j = 0; j < 20; ++j) {
-      QuotaResponse* response = window_->AllocateQuota(1);
-      ASSERT_TRUE(response != NULL);
-      ASSERT_EQ(response->GetResultCode(), j < 10 ? kQuotaResultOk : kQuotaResultLimited)
+      QuotaResponseImpl response;
+      window_->AllocateQuota(1, response);
+      ASSERT_EQ(response.result_code_, j < 10 ? kQuotaResultOk : kQuotaResultLimited)
           << i << " " << j;
-      delete response;
     }
     TestUtils::FakeNowIncrement(1000);
   }
@@ -123,10 +123,106 @@ TEST_F(RateLimitWindowTest, WindowWithRemoteRuleSyncFailed) {
     if (i % 20 == 0) {
       TestUtils::FakeNowIncrement(2000);
     }
-    QuotaResponse* response = window_->AllocateQuota(1);
-    ASSERT_TRUE(response != NULL);
-    ASSERT_EQ(response->GetResultCode(), i % 20 < 10 ? kQuotaResultOk : kQuotaResultLimited) << i;
-    delete response;
+    QuotaResponseImpl response;
+    window_->AllocateQuota(1, response);
+    ASSERT_EQ(response.result_code_, i % 20 < 10 ? kQuotaResultOk : kQuotaResultLimited) << i;
+  }
+  TestUtils::TearDownFakeTime();
+}
+
+TEST_F(RateLimitWindowTest, WindowRecordByDuration) {
+  v1::Rule rule;
+  rule.set_type(v1::Rule::LOCAL);
+  v1::Amount* amount = rule.add_amounts();  // 配置顺序与周期大小顺序不同
+  amount->mutable_maxamount()->set_value(8);
+  amount->mutable_validduration()->set_seconds(10);
+  amount = rule.add_amounts();
+  amount->mutable_maxamount()->set_value(5);
+  amount->mutable_validduration()->set_seconds(1);
+  ASSERT_TRUE(rate_limit_rule_.Init(rule));
+  TestUtils::SetUpFakeTime();
+  // 移动到10s周期的开始，避免测试过程中切换周期
+  TestUtils::FakeNowIncrement(10000 - Time::GetCurrentTimeMs() % 10000);
+  ASSERT_EQ(window_->Init(NULL, &rate_limit_rule_, rate_limit_rule_.GetId(), connector_),
+            kReturnOk);
+  QuotaResponseImpl response;
+  for (int i = 0; i < 10; ++i) {
+    window_->AllocateQuota(1, response);
+    ASSERT_EQ(response.result_code_, i < 5 ? kQuotaResultOk : kQuotaResultLimited) << i;
+  }
+  ASSERT_EQ(response.info_.duration_, 1000);
+  TestUtils::FakeNowIncrement(1000);
+  for (int i = 0; i < 5; ++i) {
+    window_->AllocateQuota(1, response);
+    ASSERT_EQ(response.result_code_, i < 3 ? kQuotaResultOk : kQuotaResultLimited) << i;
+  }
+  ASSERT_EQ(response.info_.duration_, 10000);
+
+  // 通过次数记录到所有周期，限流次数记录到违反的周期
+  v1::RateLimitRecord record;
+  ASSERT_TRUE(window_->CollectRecord(record));
+  ASSERT_EQ(record.limit_stats_size(), 2);
+  for (int i = 0; i < record.limit_stats_size(); ++i) {
+    const v1::LimitStat& stat = record.limit_stats(i);
+    ASSERT_EQ(stat.pass(), 8);
+    if (stat.limit_duration() == 1000) {
+      ASSERT_EQ(stat.period_times(), 5);
+    } else {
+      ASSERT_EQ(stat.limit_duration(), 10000);
+      ASSERT_EQ(stat.period_times(), 2);
+    }
+  }
+  TestUtils::TearDownFakeTime();
+}
+
+TEST_F(RateLimitWindowTest, WindowWithUnirateRule) {
+  v1::Rule rule;
+  rule.set_type(v1::Rule::LOCAL);
+  rule.mutable_action()->set_value("unirate");
+  v1::Amount* amount = rule.add_amounts();
+  amount->mutable_maxamount()->set_value(10);
+  amount->mutable_validduration()->set_seconds(1);
+  ASSERT_TRUE(rate_limit_rule_.Init(rule));
+  TestUtils::SetUpFakeTime();
+  ASSERT_EQ(window_->Init(NULL, &rate_limit_rule_, rate_limit_rule_.GetId(), connector_),
+            kReturnOk);
+  QuotaResponseImpl response;
+  for (int i = 0; i < 11; ++i) {
+    window_->AllocateQuota(1, response);
+    if (i < 10) {  // 匀速排队的等待时间通过应答返回
+      ASSERT_EQ(response.result_code_, kQuotaResultOk) << i;
+      ASSERT_EQ(response.wait_time_, i * 100) << i;
+    } else {  // 排队未超时，但配额已用完
+      ASSERT_EQ(response.result_code_, kQuotaResultLimited);
+      ASSERT_EQ(response.wait_time_, 0);
+    }
+  }
+  TestUtils::TearDownFakeTime();
+}
+
+TEST_F(RateLimitWindowTest, WindowWithSlidingWindowRule) {
+  v1::Rule rule;
+  rule.set_type(v1::Rule::LOCAL);
+  rule.mutable_action()->set_value("sliding_window");
+  v1::Amount* amount = rule.add_amounts();
+  amount->mutable_maxamount()->set_value(10);
+  amount->mutable_validduration()->set_seconds(1);
+  ASSERT_TRUE(rate_limit_rule_.Init(rule));
+  TestUtils::SetUpFakeTime();
+  // 移动到周期的第900ms
+  TestUtils::FakeNowIncrement(1900 - Time::GetCurrentTimeMs() % 1000);
+  ASSERT_EQ(window_->Init(NULL, &rate_limit_rule_, rate_limit_rule_.GetId(), connector_),
+            kReturnOk);
+  QuotaResponseImpl response;
+  for (int i = 0; i < 11; ++i) {
+    window_->AllocateQuota(1, response);
+    ASSERT_EQ(response.result_code_, i < 10 ? kQuotaResultOk : kQuotaResultLimited) << i;
+  }
+  // 下个周期的第100ms，上个周期的使用量仍占用90%的配额
+  TestUtils::FakeNowIncrement(200);
+  for (int i = 0; i < 2; ++i) {
+    window_->AllocateQuota(1, response);
+    ASSERT_EQ(response.result_code_, i < 1 ? kQuotaResultOk : kQuotaResultLimited) << i;
   }
   TestUtils::TearDownFakeTime();
 }
@@ -18,6 +18,7 @@
 #include "quota/service_rate_limiter.h"
 
 #include <gtest/gtest.h>
+#include <pthread.h>
 
 #include "test_utils.h"
 
@@ -29,11 +30,9 @@ TEST(ServiceRateLimiterTest, RejectQuotaBucket) {
   ASSERT_EQ(limiter->InitQuotaBucket(NULL, quota_bucket), kReturnOk);
   quota_bucket->Release();
   for (int i = 0; i < 100; ++i) {
-    QuotaResult* result = quota_bucket->GetQuota(1);
-    ASSERT_TRUE(result != NULL);
-    ASSERT_EQ(result->result_code_, kQuotaResultOk);
-    ASSERT_EQ(result->queue_time_, 0);
-    delete result;
+    QuotaResult result = quota_bucket->GetQuota(1);
+    ASSERT_EQ(result.result_code_, kQuotaResultOk);
+    ASSERT_EQ(result.queue_time_, 0);
   }
   delete quota_bucket;
   delete limiter;
@@ -50,11 +49,9 @@ TEST(ServiceRateLimiterTest, UnirateQuotaBucketRejectAll) {
   QuotaBucket* quota_bucket   = NULL;
   ASSERT_EQ(limiter->InitQuotaBucket(rate_limit_rule, quota_bucket), kReturnOk);
   for (int i = 0; i < 100; ++i) {
-    QuotaResult* result = quota_bucket->GetQuota(1);
-    ASSERT_TRUE(result != NULL);
-    ASSERT_EQ(result->result_code_, kQuotaResultOk);
-    ASSERT_EQ(result->queue_time_, 0);
-    delete result;
+    QuotaResult result = quota_bucket->GetQuota(1);
+    ASSERT_EQ(result.result_code_, kQuotaResultOk);
+    ASSERT_EQ(result.queue_time_, 0);
   }
   delete quota_bucket;
   delete limiter;
@@ -79,21 +76,19 @@ TEST(ServiceRateLimiterTest, UnirateQuotaBucket) {
   // 总体上每2000/20=100ms放一个请求
   ASSERT_EQ(limiter->InitQuotaBucket(rate_limit_rule, quota_bucket), kReturnOk);
   for (int i = 0; i < 20; ++i) {
-    QuotaResult* result = quota_bucket->GetQuota(1);
-    ASSERT_TRUE(result != NULL);
+    QuotaResult result = quota_bucket->GetQuota(1);
     if (i < 11) {  // 第0个请求肯定不排队，1-10个请求每个排队i*100s
-      ASSERT_EQ(result->result_code_, kQuotaResultOk);
-      ASSERT_EQ(result->queue_time_, i * 100);
+      ASSERT_EQ(result.result_code_, kQuotaResultOk);
+      ASSERT_EQ(result.queue_time_, i * 100);
     } else if (i == 11) {  // 第11个等待超过1s直接拒绝
-      ASSERT_EQ(result->result_code_, kQuotaResultLimited);
-      ASSERT_EQ(result->queue_time_, 0);
+      ASSERT_EQ(result.result_code_, kQuotaResultLimited);
+      ASSERT_EQ(result.queue_time_, 0);
       TestUtils::FakeNowIncrement(1100);  // 等待1s + 100ms
     } else {                              // 第12个开始以50ms间隔匀速进入
-      ASSERT_EQ(result->result_code_, kQuotaResultOk);
-      ASSERT_EQ(result->queue_time_, (i - 12) * 50);
+      ASSERT_EQ(result.result_code_, kQuotaResultOk);
+      ASSERT_EQ(result.queue_time_, (i - 12) * 50);
       TestUtils::FakeNowIncrement(50);
     }
-    delete result;
   }
   delete quota_bucket;
   delete limiter;
@@ -101,4 +96,77 @@ TEST(ServiceRateLimiterTest, UnirateQuotaBucket) {
   TestUtils::TearDownFakeTime();
 }
 
+// 创建每秒max_amount个配额的匀速排队桶
+static QuotaBucket* CreateUnirateBucket(RateLimitRule& rate_limit_rule, uint32_t max_amount) {
+  v1::Rule rule;
+  v1::Amount* amount = rule.add_amounts();
+  amount->mutable_maxamount()->set_value(max_amount);
+  amount->mutable_validduration()->set_seconds(1);
+  EXPECT_TRUE(rate_limit_rule.Init(rule));
+  UnirateServiceRateLimiter limiter;
+  QuotaBucket* quota_bucket = NULL;
+  EXPECT_EQ(limiter.InitQuotaBucket(&rate_limit_rule, quota_bucket), kReturnOk);
+  return quota_bucket;
+}
+
+TEST(ServiceRateLimiterTest, UnirateQuotaBucketHighRate) {
+  TestUtils::SetUpFakeTime();
+  RateLimitRule rate_limit_rule;
+  // 每秒10万个配额，每个配额间隔10us，时间不变时可排队1s
+  QuotaBucket* quota_bucket = CreateUnirateBucket(rate_limit_rule, 100000);
+  for (int i = 0; i <= 100000; ++i) {
+    QuotaResult result = quota_bucket->GetQuota(1);
+    ASSERT_EQ(result.result_code_, kQuotaResultOk) << i;
+    ASSERT_EQ(result.queue_time_, (i + 99) / 100) << i;  // 排队时间向上取整到毫秒
+  }
+  ASSERT_EQ(quota_bucket->GetQuota(1).result_code_, kQuotaResultLimited);
+  TestUtils::FakeNowIncrement(1);  // 1ms后可以再分配100个配额
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_EQ(quota_bucket->GetQuota(1).result_code_, kQuotaResultOk);
+  }
+  ASSERT_EQ(quota_bucket->GetQuota(1).result_code_, kQuotaResultLimited);
+  delete quota_bucket;
+  TestUtils::TearDownFakeTime();
+}
+
+struct UnirateThreadArg {
+  QuotaBucket* quota_bucket_;
+  int acquire_times_;
+  int ok_count_;
+};
+
+static void* UnirateAcquireThread(void* arg) {
+  UnirateThreadArg* thread_arg = static_cast<UnirateThreadArg*>(arg);
+  for (int i = 0; i < thread_arg->acquire_times_; ++i) {
+    if (thread_arg->quota_bucket_->GetQuota(1).result_code_ == kQuotaResultOk) {
+      thread_arg->ok_count_++;
+    }
+  }
+  return NULL;
+}
+
+TEST(ServiceRateLimiterTest, UnirateQuotaBucketMultiThread) {
+  TestUtils::SetUpFakeTime();
+  RateLimitRule rate_limit_rule;
+  QuotaBucket* quota_bucket = CreateUnirateBucket(rate_limit_rule, 10000);
+  // 时间不变时，多线程并发获取配额，总共只能分配排队1s内的配额
+  const int kThreadNum = 8;
+  pthread_t threads[kThreadNum];
+  UnirateThreadArg thread_args[kThreadNum];
+  for (int i = 0; i < kThreadNum; ++i) {
+    thread_args[i].quota_bucket_  = quota_bucket;
+    thread_args[i].acquire_times_ = 5000;
+    thread_args[i].ok_count_      = 0;
+    ASSERT_EQ(pthread_create(&threads[i], NULL, UnirateAcquireThread, &thread_args[i]), 0);
+  }
+  int ok_count = 0;
+  for (int i = 0; i < kThreadNum; ++i) {
+    pthread_join(threads[i], NULL);
+    ok_count += thread_args[i].ok_count_;
+  }
+  ASSERT_EQ(ok_count, 10000 + 1);
+  delete quota_bucket;
+  TestUtils::TearDownFakeTime();
+}
+
 }  // namespace polaris
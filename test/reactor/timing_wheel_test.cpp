@@ -0,0 +1,145 @@
+//  Copyright (C) 2019 THL A29 Limited, a Tencent company. All rights reserved.
+//
+//  Licensed under the BSD 3-Clause License (the "License"); you may not use this file
+//  except in compliance with the License. You may obtain a copy of the License at
+//
+//  https://opensource.org/licenses/BSD-3-Clause
+//
+//  Unless required by applicable law or agreed to in writing, software distributed
+//  under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+//  CONDITIONS OF ANY KIND, either express or implied. See the License for the specific
+//  language governing permissions and limitations under the License.
+//
+
+#include "reactor/timing_wheel.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace polaris {
+
+class TestTimingTask : public TimingTask {
+public:
+  TestTimingTask(uint64_t interval, int& delete_count)
+      : TimingTask(interval), delete_count_(delete_count) {}
+
+  virtual ~TestTimingTask() { delete_count_++; }
+
+  virtual void Run() {}
+
+private:
+  int& delete_count_;
+};
+
+class TimingWheelTest : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    begin_time_   = 1000000;
+    delete_count_ = 0;
+    timing_wheel_ = new TimingWheel(begin_time_);
+  }
+
+  virtual void TearDown() { delete timing_wheel_; }
+
+  TimingTask* AddTask(uint64_t interval) {
+    TimingTask* task = new TestTimingTask(interval, delete_count_);
+    timing_wheel_->AddTask(task, begin_time_ + interval);
+    return task;
+  }
+
+  // 取出current_time之前到期的所有任务，检查到期时间并释放
+  size_t PopTasks(uint64_t current_time) {
+    size_t count = 0;
+    TimingTask* task;
+    while ((task = timing_wheel_->PopExpiredTask(current_time)) != NULL) {
+      EXPECT_LE(task->GetExpireTime(), current_time);
+      delete task;
+      count++;
+    }
+    return count;
+  }
+
+protected:
+  uint64_t begin_time_;
+  int delete_count_;
+  TimingWheel* timing_wheel_;
+};
+
+TEST_F(TimingWheelTest, PopTaskInOrder) {
+  // 覆盖每一层及超出最大范围的任务
+  uint64_t intervals[] = {0,           1,           255,         256,
+                          257,         65535,       65536,       70000,
+                          1 << 24,     (1 << 24) + 5, 1ULL << 32, (1ULL << 32) + 1000};
+  const size_t kTaskCount = sizeof(intervals) / sizeof(intervals[0]);
+  for (size_t i = 0; i < kTaskCount; ++i) {
+    AddTask(intervals[kTaskCount - 1 - i]);
+  }
+  ASSERT_EQ(timing_wheel_->Size(), kTaskCount);
+  for (size_t i = 0; i < kTaskCount; ++i) {
+    uint64_t expire_time = begin_time_ + intervals[i];
+    ASSERT_EQ(PopTasks(expire_time - 1), 0) << intervals[i];
+    TimingTask* task = timing_wheel_->PopExpiredTask(expire_time);
+    ASSERT_TRUE(task != NULL) << intervals[i];
+    ASSERT_EQ(task->GetExpireTime(), expire_time);
+    delete task;
+  }
+  ASSERT_EQ(timing_wheel_->Size(), 0);
+  ASSERT_EQ(delete_count_, kTaskCount);
+}
+
+TEST_F(TimingWheelTest, PopTaskAfterLongTime) {
+  for (uint64_t i = 0; i < 1000; ++i) {
+    AddTask(i * 100);
+  }
+  ASSERT_EQ(PopTasks(begin_time_ + 50000), 501);  // 一次推进较长时间
+  ASSERT_EQ(PopTasks(begin_time_ + 100000), 499);
+  ASSERT_EQ(timing_wheel_->Size(), 0);
+}
+
+TEST_F(TimingWheelTest, AddExpiredTask) {
+  ASSERT_EQ(PopTasks(begin_time_ + 10), 0);
+  AddTask(5);  // 早于已处理时间的任务直接到期
+  AddTask(10);
+  AddTask(11);
+  ASSERT_EQ(PopTasks(begin_time_ + 10), 2);
+  ASSERT_EQ(PopTasks(begin_time_ + 11), 1);
+}
+
+TEST_F(TimingWheelTest, RemoveTask) {
+  std::vector<TimingTask*> tasks;
+  for (uint64_t i = 0; i < 100; ++i) {
+    tasks.push_back(AddTask(i * 1000));
+  }
+  for (size_t i = 0; i < tasks.size(); i += 2) {
+    timing_wheel_->RemoveTask(tasks[i]);
+    delete tasks[i];
+  }
+  ASSERT_EQ(timing_wheel_->Size(), 50);
+  ASSERT_EQ(PopTasks(begin_time_ + 100 * 1000), 50);
+  ASSERT_EQ(delete_count_, 100);
+}
+
+TEST_F(TimingWheelTest, CalculateWaitTime) {
+  ASSERT_EQ(timing_wheel_->CalculateWaitTime(begin_time_, 10), 10);
+  AddTask(3);
+  ASSERT_EQ(timing_wheel_->CalculateWaitTime(begin_time_, 10), 3);
+  ASSERT_EQ(timing_wheel_->CalculateWaitTime(begin_time_ + 5, 10), 0);
+  ASSERT_EQ(PopTasks(begin_time_ + 5), 1);
+  AddTask(100000);  // 任务在上层时最多等待到第0层转完一圈
+  ASSERT_LE(timing_wheel_->CalculateWaitTime(begin_time_ + 5, 1000), 256);
+  AddTask(1);
+  ASSERT_EQ(timing_wheel_->CalculateWaitTime(begin_time_ + 5, 10), 0);
+}
+
+TEST_F(TimingWheelTest, ClearTask) {
+  for (uint64_t i = 0; i < 100; ++i) {
+    AddTask(i * i * i);
+  }
+  timing_wheel_->Clear();
+  ASSERT_EQ(timing_wheel_->Size(), 0);
+  ASSERT_EQ(delete_count_, 100);
+  ASSERT_EQ(PopTasks(begin_time_ + 1000000), 0);
+}
+
+}  // namespace polaris